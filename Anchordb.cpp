@@ -0,0 +1,113 @@
+#include "Anchordb.h"
+#include "Msg20.h"
+#include "Conf.h"
+#include "Process.h"
+
+Anchordb g_anchordb;
+
+void Anchordb::reset() {
+	m_rdb.reset();
+}
+
+bool Anchordb::init ( ) {
+	// key sanity tests
+	uint32_t linkeeSiteHash32 = (uint32_t)rand();
+	uint64_t linkeeUrlHash64  = ((uint64_t)rand() << 32 | rand()) & ANCHORDB_MAXURLHASH;
+	int64_t  docId            = ((uint64_t)rand() << 32 | rand()) & DOCID_MASK;
+
+	key128_t k = makeKey ( linkeeSiteHash32, linkeeUrlHash64, docId, false );
+	if ( getLinkeeSiteHash32(&k) != linkeeSiteHash32 ) { g_process.shutdownAbort(true); }
+	if ( getLinkeeUrlHash64(&k) != linkeeUrlHash64 ) { g_process.shutdownAbort(true); }
+	if ( getLinkerDocId(&k) != docId ) { g_process.shutdownAbort(true); }
+	if ( KEYNEG((const char *)&k) ) { g_process.shutdownAbort(true); }
+
+	// . what's max # of tree nodes?
+	// . assume an average record of about 200 bytes
+	int32_t maxTreeNodes = g_conf.m_anchordbMaxTreeMem / 200;
+
+	return m_rdb.init ( "anchordb" ,
+			    -1       , // variable data size
+			    6        , // min files to merge
+			    g_conf.m_anchordbMaxTreeMem ,
+			    maxTreeNodes ,
+			    false    , // half keys?
+			    sizeof(key128_t),
+			    false);    // useIndexFile
+}
+
+key128_t Anchordb::makeKey ( uint32_t linkeeSiteHash32 ,
+			     uint64_t linkeeUrlHash64  ,
+			     int64_t  linkerDocId      ,
+			     bool     isDelete         ) {
+	// mask it
+	linkeeUrlHash64 &= ANCHORDB_MAXURLHASH;
+
+	key128_t k;
+	k.n1 = ((uint64_t)linkeeSiteHash32) << 32;
+	k.n1 |= linkeeUrlHash64 >> 15;
+	k.n0 = (linkeeUrlHash64 & 0x7fff) << 49;
+	k.n0 |= ((uint64_t)linkerDocId & DOCID_MASK) << 11;
+	if ( ! isDelete ) k.n0 |= 0x01;
+	return k;
+}
+
+bool AnchorRec::isValid ( const char *data , int32_t dataSize ) {
+	if ( dataSize < (int32_t)sizeof(AnchorRec) ) {
+		return false;
+	}
+
+	const AnchorRec *ar = (const AnchorRec *)data;
+	if ( ar->getStoredSize() != dataSize ) {
+		return false;
+	}
+
+	// strings must be \0 terminated
+	const uint16_t sizes[] = { ar->m_urlSize, ar->m_linkTextSize, ar->m_surroundingTextSize, ar->m_noteSize };
+	const char *p = ar->m_buf;
+	for ( size_t i = 0 ; i < sizeof(sizes)/sizeof(sizes[0]) ; i++ ) {
+		if ( sizes[i] > 0 && p[sizes[i] - 1] != '\0' ) {
+			return false;
+		}
+		p += sizes[i];
+	}
+
+	// msg25 needs the linker url
+	return ar->m_urlSize > 1;
+}
+
+void AnchorRec::setMsg20Reply ( Msg20Reply *r , int64_t docId , bool doLinkSpamCheck ) const {
+	bool isLinkSpam = doLinkSpamCheck && m_isLinkSpam;
+
+	r->m_docId               = docId;
+	r->m_ip                  = m_ip;
+	r->m_firstIp             = m_firstIp;
+	r->m_midDomHash          = m_midDomHash;
+	r->m_firstIndexedDate    = m_firstIndexedDate;
+	r->m_siteNumInlinks      = m_siteNumInlinks;
+	r->m_numOutlinks         = m_numOutlinks;
+	r->m_country             = m_country;
+	r->m_language            = m_language;
+	r->m_siteRank            = m_siteRank;
+	r->m_isLinkSpam          = isLinkSpam;
+	r->m_isPermalink         = m_isPermalink;
+	r->m_outlinkInContent    = m_outlinkInContent;
+	r->m_outlinkInComment    = m_outlinkInComment;
+	r->m_wordPosStart        = m_wordPosStart;
+	r->m_linkTextNumWords    = m_linkTextNumWords;
+
+	r->ptr_ubuf              = const_cast<char*>(getUrl());
+	r->ptr_linkText          = const_cast<char*>(getLinkText());
+	r->size_ubuf             = m_urlSize;
+	r->size_linkText         = m_linkTextSize;
+
+	// like the msg20 reply, a spammy voter has no surrounding text and
+	// the note is only there if we checked
+	if ( ! isLinkSpam ) {
+		r->ptr_surroundingText  = const_cast<char*>(getSurroundingText());
+		r->size_surroundingText = m_surroundingTextSize;
+	}
+	if ( doLinkSpamCheck ) {
+		r->ptr_note             = getNote();
+		r->size_note            = m_noteSize;
+	}
+}
@@ -0,0 +1,141 @@
+// Anchordb - stores the anchor text of each linkdb "url" record
+
+// . linkdb only tells Msg25 which docids link to a url, so it used to send
+//   a Msg20 to every inlinker to load its titlerec and parse out the link
+//   text. anchordb keeps what that Msg20Reply held, made when the linker
+//   was indexed, so Msg25 gets it with one range read.
+// . sharded like linkdb by the linkee sitehash32 so both are local to the
+//   host running Msg25
+//
+// . Format of a 16-byte key in anchordb
+// .
+// . HHHHHHHH HHHHHHHH HHHHHHHH HHHHHHHH H = sitehash32 of linkEE
+// . pppppppp pppppppp pppppppp pppppppp p = linkEEHash (47 bits)
+// . pppppppp pppppppd dddddddd dddddddd d = linkerdocid
+// . dddddddd dddddddd dddddd00 0000000Z Z = delbit
+//
+// the data is an AnchorRec followed by its strings
+
+#ifndef GB_ANCHORDB_H
+#define GB_ANCHORDB_H
+
+#include "Rdb.h"
+#include "Titledb.h" // DOCID_MASK
+
+#define ANCHORDB_MAXURLHASH 0x00007fffffffffffLL
+
+class Msg20Reply;
+
+class Anchordb {
+public:
+	void reset();
+
+	bool init();
+
+	Rdb *getRdb() { return &m_rdb; }
+
+	static key128_t makeKey ( uint32_t linkeeSiteHash32 ,
+				  uint64_t linkeeUrlHash64  ,
+				  int64_t  linkerDocId      ,
+				  bool     isDelete         );
+
+	static key128_t makeStartKey ( uint32_t linkeeSiteHash32 ,
+				       uint64_t linkeeUrlHash64  ) {
+		return makeKey ( linkeeSiteHash32, linkeeUrlHash64, 0, true );
+	}
+
+	static key128_t makeEndKey ( uint32_t linkeeSiteHash32 ,
+				     uint64_t linkeeUrlHash64  ) {
+		return makeKey ( linkeeSiteHash32, linkeeUrlHash64, MAX_DOCID, false );
+	}
+
+	static uint32_t getLinkeeSiteHash32 ( const key128_t *key ) {
+		return (uint32_t)(key->n1 >> 32);
+	}
+
+	static uint64_t getLinkeeUrlHash64 ( const key128_t *key ) {
+		uint64_t h = (key->n1 & 0x00000000ffffffffULL) << 15;
+		h |= key->n0 >> 49;
+		return h;
+	}
+
+	static int64_t getLinkerDocId ( const key128_t *key ) {
+		return (int64_t)((key->n0 >> 11) & DOCID_MASK);
+	}
+
+private:
+	Rdb m_rdb;
+};
+
+extern class Anchordb g_anchordb;
+
+// . the data of an anchordb record
+// . the strings follow in m_buf in this order, each \0 terminated and its
+//   size including the \0, or 0 if absent: linker url, link text,
+//   surrounding text, link spam note
+class AnchorRec {
+public:
+	// . size of the record for these strings
+	static int32_t getNeededSize ( int32_t urlSize , int32_t linkTextSize ,
+				       int32_t surroundingTextSize , int32_t noteSize ) {
+		return sizeof(AnchorRec) + urlSize + linkTextSize + surroundingTextSize + noteSize;
+	}
+
+	int32_t getStoredSize ( ) const {
+		return getNeededSize ( m_urlSize, m_linkTextSize, m_surroundingTextSize, m_noteSize );
+	}
+
+	const char *getUrl ( ) const {
+		return m_urlSize ? m_buf : NULL;
+	}
+	const char *getLinkText ( ) const {
+		return m_linkTextSize ? m_buf + m_urlSize : NULL;
+	}
+	const char *getSurroundingText ( ) const {
+		return m_surroundingTextSize ? m_buf + m_urlSize + m_linkTextSize : NULL;
+	}
+	const char *getNote ( ) const {
+		return m_noteSize ? m_buf + m_urlSize + m_linkTextSize + m_surroundingTextSize : NULL;
+	}
+
+	// . true if "dataSize" bytes hold an AnchorRec whose strings fit
+	// . Msg25 checks this before trusting a record it read
+	static bool isValid ( const char *data , int32_t dataSize );
+
+	// . make a Msg20Reply like XmlDoc::getMsg20Reply() makes for
+	//   Msg20Request::m_getLinkText, pointing into our strings
+	// . the link spam vote only counts if "doLinkSpamCheck" is true, like
+	//   Msg20Request::m_doLinkSpamCheck
+	void setMsg20Reply ( Msg20Reply *r , int64_t docId , bool doLinkSpamCheck ) const;
+
+	int32_t  m_ip;
+	int32_t  m_firstIp;
+	// hash of the linker's mid domain, Msg25 does not let ibm.com and
+	// ibm.ru both vote
+	int32_t  m_midDomHash;
+	int32_t  m_firstIndexedDate;
+	int32_t  m_siteNumInlinks;
+	uint16_t m_numOutlinks;
+	uint16_t m_country;
+	uint8_t  m_language;
+	char     m_siteRank;
+	// . ::isLinkSpam() for this linkee, the surrounding text is kept
+	//   either way for Msg25s not doing the link spam check
+	uint8_t  m_isLinkSpam       : 1;
+	uint8_t  m_isPermalink      : 1;
+	uint8_t  m_outlinkInContent : 1;
+	uint8_t  m_outlinkInComment : 1;
+	uint8_t  m_reserved         : 4;
+	uint8_t  m_reserved2;
+	int32_t  m_wordPosStart;
+	uint16_t m_linkTextNumWords;
+
+	uint16_t m_urlSize;
+	uint16_t m_linkTextSize;
+	uint16_t m_surroundingTextSize;
+	uint16_t m_noteSize;
+
+	char     m_buf[0];
+} __attribute__((packed));
+
+#endif // GB_ANCHORDB_H
@@ -0,0 +1,90 @@
+#include "Arena.h"
+#include "Mem.h"
+#include <stdint.h>
+
+
+static const size_t s_alignment = 16;
+
+static size_t alignUp(size_t size) {
+	return (size + s_alignment - 1) & ~(s_alignment - 1);
+}
+
+
+Arena::Arena(const char *note, size_t blockSize)
+  : m_note(note),
+    m_blockSize(alignUp(blockSize)),
+    m_blocks(NULL),
+    m_used(0),
+    m_allocated(0),
+    m_numAllocs(0),
+    m_numBlocks(0)
+{
+}
+
+Arena::~Arena() {
+	reset();
+}
+
+void Arena::reset() {
+	while (m_blocks) {
+		Block *next = m_blocks->m_next;
+		mfree(m_blocks, m_blocks->m_allocSize, m_note);
+		m_blocks = next;
+	}
+	m_used = 0;
+	m_allocated = 0;
+	m_numAllocs = 0;
+	m_numBlocks = 0;
+}
+
+Arena::Block *Arena::newBlock(size_t size) {
+	// Mem does not align what it hands out so leave room for that
+	size_t allocSize = sizeof(Block) + s_alignment + size;
+	Block *block = (Block *)mmalloc(allocSize, m_note);
+	if (!block) {
+		return NULL;
+	}
+	block->m_next = NULL;
+	block->m_data = (char *)alignUp((uintptr_t)(block + 1));
+	block->m_size = size;
+	block->m_used = 0;
+	block->m_allocSize = allocSize;
+	m_allocated += allocSize;
+	m_numBlocks++;
+	return block;
+}
+
+void *Arena::alloc(size_t size) {
+	size = alignUp(size ? size : 1);
+
+	Block *block = m_blocks;
+	if (!block || block->m_size - block->m_used < size) {
+		if (size > m_blockSize / 4) {
+			// big ones get a block of their own. put it after the
+			// current block so we keep filling that one
+			block = newBlock(size);
+			if (!block) {
+				return NULL;
+			}
+			if (m_blocks) {
+				block->m_next = m_blocks->m_next;
+				m_blocks->m_next = block;
+			} else {
+				m_blocks = block;
+			}
+		} else {
+			block = newBlock(m_blockSize);
+			if (!block) {
+				return NULL;
+			}
+			block->m_next = m_blocks;
+			m_blocks = block;
+		}
+	}
+
+	char *mem = block->m_data + block->m_used;
+	block->m_used += size;
+	m_used += size;
+	m_numAllocs++;
+	return mem;
+}
@@ -0,0 +1,60 @@
+#ifndef GB_ARENA_H
+#define GB_ARENA_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+// . bump allocator for the short-lived parsing structures of a document
+//   (Xml nodes, Bits, Pos, Phrases, ...)
+// . memory is taken from Mem in blocks labeled with the arena's note, so the
+//   mem table has one entry per block instead of one per allocation
+// . nothing is freed until reset(), which releases all blocks in one shot.
+//   users must not touch their arena memory after that
+// . not thread safe. an arena belongs to a single XmlDoc, which is only
+//   worked on by one thread at a time
+class Arena {
+public:
+	explicit Arena(const char *note, size_t blockSize = 64*1024);
+	~Arena();
+
+	// . returns NULL and sets g_errno on error
+	// . memory is aligned for any type
+	void *alloc(size_t size);
+
+	// free all blocks
+	void reset();
+
+	// bytes handed out since the last reset
+	size_t getUsed() const { return m_used; }
+	// bytes we got from Mem
+	size_t getAllocated() const { return m_allocated; }
+	int32_t getNumAllocs() const { return m_numAllocs; }
+	int32_t getNumBlocks() const { return m_numBlocks; }
+
+private:
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+
+	struct Block {
+		Block *m_next;
+		char  *m_data; // aligned start of the usable bytes
+		size_t m_size; // usable bytes
+		size_t m_used;
+		size_t m_allocSize; // what we got from Mem
+	};
+
+	Block *newBlock(size_t size);
+
+	const char *m_note;
+	size_t m_blockSize;
+
+	// all blocks. the first one is the one we bump allocate from
+	Block *m_blocks;
+
+	size_t m_used;
+	size_t m_allocated;
+	int32_t m_numAllocs;
+	int32_t m_numBlocks;
+};
+
+#endif // GB_ARENA_H
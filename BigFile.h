@@ -46,6 +46,9 @@ public:
 	void          (*m_callback) ( void *state ) ;
 	// goes from 0 to 1, the lower the niceness, the higher the priority
 	int32_t            m_niceness;
+	// class of i/o for the job scheduler. Set by the caller before
+	// read()/write(), it is not reset by BigFile
+	io_class_t      m_ioClass;
 
 	// . we get our fds before starting the read thread to avoid
 	//   problems with accessing m_files since RdbMerge may call unlinkPart
@@ -95,6 +98,7 @@ public:
 		m_state = NULL;
 		m_callback = NULL;
 		m_niceness = 0;
+		m_ioClass = io_class_unspecified;
 		m_filenum1 = 0;
 		m_filenum2 = 0;
 		m_fd1 = -1;
@@ -11,9 +11,11 @@
 #include "GbUtil.h"
 #include "Errno.h"
 #include "Log.h"
+#include "Arena.h"
 
 Bits::Bits()
   : m_tr(NULL),
+    m_arena(NULL),
     m_bits(NULL),
     m_bitsSize(0),
     m_swbits(NULL),
@@ -28,9 +30,10 @@ Bits::~Bits() {
 }
 
 void Bits::reset() {
-	if(m_bits && (void*)m_bits != (void*)m_localBuf)
+	// arena memory goes away with the arena
+	if(m_bits && (void*)m_bits != (void*)m_localBuf && !m_arena)
 		mfree ( m_bits , m_bitsSize , "Bits" );
-	if ( m_swbits && (void*)m_swbits != (void*)m_localBuf )
+	if ( m_swbits && (void*)m_swbits != (void*)m_localBuf && !m_arena )
 		mfree ( m_swbits , m_swbitsSize , "Bits" );
 	m_bits = NULL;
 	m_bitsSize = 0;
@@ -58,7 +61,7 @@ bool Bits::set(const TokenizerResult *tr) {
 		m_bits = (wbit_t *) m_localBuf;
 	} else {
 		m_bitsSize = need;
-		m_bits = (wbit_t *)mmalloc ( need , "Bits1" );
+		m_bits = (wbit_t *)(m_arena ? m_arena->alloc(need) : mmalloc(need, "Bits1"));
 	}
 	if ( ! m_bits ) {
 		log("build: Could not allocate Bits table used to parse words: %s", mstrerror(g_errno));
@@ -274,7 +277,7 @@ bool Bits::setForSummary ( const TokenizerResult *tr ) {
 	} else {
 		// i guess need to malloc
 		m_swbitsSize = need;
-		m_swbits = (swbit_t *)mmalloc( need, "BitsW" );
+		m_swbits = (swbit_t *)(m_arena ? m_arena->alloc(need) : mmalloc(need, "BitsW"));
 	}
 
 	if ( !m_swbits ) {
@@ -72,6 +72,7 @@ typedef uint16_t swbit_t;
 
 class TokenizerResult;
 class Sections;
+class Arena;
 
 class Bits {
 public:
@@ -84,6 +85,9 @@ public:
 
 	void reset();
 
+	// take the tables from "arena" instead of Mem. call before set()
+	void setArena(Arena *arena) { m_arena = arena; }
+
 	bool isStopWord( int32_t i ) const {
 		return m_bits[i] & D_IS_STOPWORD;
 	}
@@ -110,6 +114,8 @@ public:
  private:
 	const TokenizerResult *m_tr;
 
+	Arena *m_arena;
+
 	wbit_t *m_bits;
 	int32_t m_bitsSize;
 	
@@ -13,6 +13,7 @@
 #include "Spider.h"
 #include "Clusterdb.h"
 #include "Linkdb.h"
+#include "Anchordb.h"
 #include "SpiderCache.h"
 #include "Repair.h"
 #include "Parms.h"
@@ -155,6 +156,7 @@ bool Collectiondb::cleanTrees() {
 	g_doledb.getRdb()->cleanTree();
 	g_clusterdb.getRdb()->cleanTree();
 	g_linkdb.getRdb()->cleanTree();
+	g_anchordb.getRdb()->cleanTree();
 
 	// success
 	return true;
@@ -437,6 +439,7 @@ bool Collectiondb::addRdbBasesForCollRec ( CollectionRec *cr ) {
 	if ( ! g_tagdb.getRdb()->addRdbBase1        ( coll ) ) goto hadError;
 	if ( ! g_clusterdb.getRdb()->addRdbBase1    ( coll ) ) goto hadError;
 	if ( ! g_linkdb.getRdb()->addRdbBase1       ( coll ) ) goto hadError;
+	if ( ! g_anchordb.getRdb()->addRdbBase1     ( coll ) ) goto hadError;
 	if ( ! g_spiderdb.getRdb_deprecated()->addRdbBase1(coll) ) goto hadError;
 	if ( ! g_doledb.getRdb()->addRdbBase1       ( coll ) ) goto hadError;
 
@@ -508,6 +511,7 @@ bool Collectiondb::deleteRec2 ( collnum_t collnum ) {
 	g_doledb.getRdb()->delColl     ( coll );
 	g_clusterdb.getRdb()->delColl  ( coll );
 	g_linkdb.getRdb()->delColl     ( coll );
+	g_anchordb.getRdb()->delColl   ( coll );
 
 	// reset spider info
 	SpiderColl *sc = g_spiderCache.getSpiderCollIffNonNull(collnum);
@@ -768,6 +772,7 @@ bool Collectiondb::resetColl2(collnum_t oldCollnum, collnum_t newCollnum) {
 	g_doledb.getRdb()->deleteColl    ( oldCollnum , newCollnum );
 	g_clusterdb.getRdb()->deleteColl ( oldCollnum , newCollnum );
 	g_linkdb.getRdb()->deleteColl    ( oldCollnum , newCollnum );
+	g_anchordb.getRdb()->deleteColl  ( oldCollnum , newCollnum );
 
 	// reset crawl status too!
 	cr->m_spiderStatus = spider_status_t::SP_INITIALIZING;
@@ -997,6 +1002,7 @@ CollectionRec::CollectionRec()
 	m_thumbnailMaxWidthHeight = 0;
 	m_indexBody = false;
 	m_dedupingEnabled = false;
+	m_nearDupDedupingEnabled = false;
 	m_dedupURLByDefault = false;
 	m_dupCheckWWW = false;
 	m_useSimplifiedRedirects = false;
@@ -1014,6 +1020,7 @@ CollectionRec::CollectionRec()
 	m_computeSiteNumInlinks = true;
 	m_percentSimilarSummary = 0;
 	m_summDedupNumLines = 0;
+	m_simHashDedupDistance = -1;
 	m_maxQueryTerms = 0;
 	m_sameLangWeight = 0.0;
 	m_unknownLangWeight = 0.0;
@@ -220,6 +220,7 @@ public:
 	bool  m_indexBody;
 
 	bool  m_dedupingEnabled         ; // dedup content on same hostname
+	bool  m_nearDupDedupingEnabled  ; // also dedup content by simhash
 	bool  m_dedupURLByDefault       ;
 	bool  m_dupCheckWWW             ;
 	bool  m_useSimplifiedRedirects  ;
@@ -238,6 +239,7 @@ public:
 
 	int32_t  m_percentSimilarSummary       ; // Dedup by summary similiarity
 	int32_t  m_summDedupNumLines           ;
+	int32_t  m_simHashDedupDistance        ; // Dedup by simhash, -1 is off
 
 	int32_t  m_maxQueryTerms;
 
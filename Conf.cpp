@@ -105,6 +105,8 @@ Conf::Conf ( ) {
 	m_linkdbMaxLostPositivesPercentage = 0;
 	m_linkdbMaxTreeMem = 0;
 	m_linkdbMinFilesToMerge = 0;
+	m_anchordbMaxTreeMem = 0;
+	m_useAnchordb = false;
 	m_maxCpuThreads = 0;
 	m_maxIOThreads = 0;
 	m_maxExternalThreads = 0;
@@ -121,6 +123,9 @@ Conf::Conf ( ) {
 	m_msg40_msg39_timeout = 0;
 	m_msg3a_msg39_network_overhead = 0;
 	m_useHighFrequencyTermCache = false;
+	m_useFrequentPhrases = false;
+	m_maxDocIdsPerSite = 2;
+	m_siteClusterWhileScoring = false;
 	m_spideringEnabled = false;
 	m_injectionsEnabled = false;
 	m_queryingEnabled = false;
@@ -173,12 +178,26 @@ Conf::Conf ( ) {
 	m_detectMemLeaks = false;
 	m_forceIt = false;
 	m_doIncrementalUpdating = false;
+	m_skipUnchangedTitleRecs = false;
 	m_stableSummaryCacheSize = 0;
 	m_stableSummaryCacheMaxAge = 0;
 	m_unstableSummaryCacheSize = 0;
 	m_unstableSummaryCacheMaxAge = 0;
+	m_queryPlanCacheSize = 0;
+	m_queryPlanCacheMaxAge = 0;
+	m_truncatedTermlistsMaxMemory = 0;
+	m_truncatedTermlistsMinListSize = 0;
+	m_truncatedTermlistsMaxDocIds = 0;
+	m_bulkSearchMaxConcurrentQueries = 0;
+	m_bulkSearchTermlistCacheMem = 0;
+	m_searchCursorMaxItems = 0;
+	m_searchCursorMaxAge = 0;
+	m_searchCursorPages = 0;
+	m_serpBufferPoolSize = 0;
+	m_serpBufferMaxSize = 0;
 	m_useShotgun = false;
 	m_testMem = false;
+	m_memSampleRate = 0;
 	m_doConsistencyTesting = false;
 	m_titleRecVersion = TITLEREC_CURRENT_VERSION;
 	memset(m_spiderUserAgent, 0, sizeof(m_spiderUserAgent));
@@ -307,6 +326,12 @@ Conf::Conf ( ) {
 	memset(m_redirect, 0, sizeof(m_redirect));
 	m_useCompressionProxy = false;
 	m_gzipDownloads = false;
+	m_spiderKeepAlive = false;
+	m_spiderKeepAliveIdleTimeout = 4000;
+	m_spiderKeepAliveMaxPerHost = 2;
+	m_spiderIfModifiedSince = false;
+	m_skipUnchangedRecrawls = false;
+	m_spiderPrefetchMaxUrls = 0;
 	m_useTmpCluster = false;
 	m_allowScale = true;
 	m_bypassValidation = false;
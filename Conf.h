@@ -126,6 +126,18 @@ class Conf {
 	// used to limit all rdb's to one merge per machine at a time
 	int32_t  m_mergeBufSize;
 
+	// mmap the full segments of .map files instead of reading them in
+	bool     m_mmapRdbMaps;
+	// mmap the docId sets of .idx files instead of reading them in
+	bool     m_mmapRdbIndexes;
+
+	// record the hot posdb/titledb ranges and warm up with them on start
+	bool     m_warmupEnabled;
+	int32_t  m_warmupMaxRanges;
+	int64_t  m_warmupMaxBytes;
+	int32_t  m_warmupMaxReplays;
+	int32_t  m_warmupMaxTime;
+
 	int32_t m_doledbNukeInterval;
 	
 	// rdb settings
@@ -134,6 +146,7 @@ class Conf {
 	int32_t m_posdbMaxLostPositivesPercentage;
 	int64_t m_posdbFileCacheSize;
 	int32_t  m_posdbMaxTreeMem;
+	bool     m_posdbDumpSnapshot;	//keep adding to a fresh memtable while the full one is dumped
 
 	// tagdb
 	int32_t m_tagdbMaxLostPositivesPercentage;
@@ -165,6 +178,11 @@ class Conf {
 	int32_t  m_linkdbMaxTreeMem;
 	int32_t  m_linkdbMinFilesToMerge;
 
+	// anchordb keeps the link text of the linkdb records so Msg25 does
+	// not have to send a Msg20 to each inlinker
+	int32_t  m_anchordbMaxTreeMem;
+	bool     m_useAnchordb;
+
 	// are we doing a command line thing like 'gb 0 dump s ....' in
 	// which case we do not want to log certain things
 	bool m_doingCommandLine;
@@ -177,8 +195,21 @@ class Conf {
 	int32_t  m_maxFileMetaThreads;
 	int32_t  m_maxMergeThreads;
 
+	// build the meta lists of spidered docs in spider_index jobs
+	bool     m_indexDocsInThreads;
+
 	int32_t  m_maxJobCleanupTime;
 
+	// disk i/o scheduling. Rates are in MB/s, 0=unlimited
+	int32_t  m_ioQueryMaxRate;
+	int32_t  m_ioSpiderReadMaxRate;
+	int32_t  m_ioMergeMaxRate;
+	int32_t  m_ioDumpMaxRate;
+	int32_t  m_ioRepairMaxRate;
+	int32_t  m_ioQueryReadDeadline;     //milliseconds
+	int32_t  m_ioQueryLatencyTarget;    //p95 in milliseconds, 0=no automatic throttling
+	int32_t  m_ioThrottledMinRate;      //merge/repair are never throttled below this rate
+
 	char    m_vagusClusterId[128];
 	int32_t m_vagusPort;
 	int32_t m_vagusKeepaliveSendInterval; //milliseconds
@@ -194,6 +225,10 @@ class Conf {
 	int64_t  m_msg3a_msg39_network_overhead; //additional latency/overhead of sending reqeust+response over network.
 
 	bool	m_useHighFrequencyTermCache;
+	bool	m_useFrequentPhrases;
+
+	int32_t m_maxDocIdsPerSite;          //site clustering: max results per site from each shard
+	bool    m_siteClusterWhileScoring;   //site clustering in the TopTree using Docid2FlagsAndSiteMap
 
 	bool  m_spideringEnabled;
 	bool  m_injectionsEnabled;
@@ -232,6 +267,9 @@ class Conf {
 	// a search results cache (for Msg40)
 	int64_t m_docSummaryWithDescriptionMaxCacheAge; //cache timeout for document summaries for documents with a meta-tag with description, in milliseconds
 
+	// make titles and summaries from the pre-tokenized copy in the titlerec
+	bool m_useSummaryStore;
+
 	// for Weights.cpp
 	int32_t   m_sliderParm;
 
@@ -295,14 +333,29 @@ class Conf {
 	// then you can set this to false to add all indexdb keys.
 	//bool   m_onlyAddUnchangedTermIds;
 	bool   m_doIncrementalUpdating;
+	bool   m_skipUnchangedTitleRecs;
 
 	int64_t m_stableSummaryCacheSize;
 	int64_t m_stableSummaryCacheMaxAge;
 	int64_t m_unstableSummaryCacheSize;
 	int64_t m_unstableSummaryCacheMaxAge;
+	int32_t m_queryPlanCacheSize;
+	int64_t m_queryPlanCacheMaxAge;
+	int64_t m_truncatedTermlistsMaxMemory;
+	int32_t m_truncatedTermlistsMinListSize;
+	int32_t m_truncatedTermlistsMaxDocIds;
+	int32_t m_bulkSearchMaxConcurrentQueries;
+	int32_t m_bulkSearchTermlistCacheMem;
+	int32_t m_searchCursorMaxItems;
+	int64_t m_searchCursorMaxAge;
+	int32_t m_searchCursorPages;
+
+	int32_t m_serpBufferPoolSize;
+	int32_t m_serpBufferMaxSize;
 
 	bool   m_useShotgun;
 	bool   m_testMem;
+	int32_t m_memSampleRate;
 	bool   m_doConsistencyTesting;
 
 	int32_t m_titleRecVersion;
@@ -470,6 +523,18 @@ class Conf {
 	bool m_useCompressionProxy;
 	bool m_gzipDownloads;
 
+	// reuse connections to web servers between spider downloads
+	bool    m_spiderKeepAlive;
+	int32_t m_spiderKeepAliveIdleTimeout; // ms
+	int32_t m_spiderKeepAliveMaxPerHost;
+
+	// recrawls of unchanged pages only get a new spider reply
+	bool    m_spiderIfModifiedSince;
+	bool    m_skipUnchangedRecrawls;
+
+	// how many doledb urls to look up ip, robots.txt and tagrec for ahead
+	int32_t m_spiderPrefetchMaxUrls;
+
 	// used by proxy to make proxy point to the temp cluster while
 	// the original cluster is updated
 	bool m_useTmpCluster;
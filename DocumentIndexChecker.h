@@ -6,21 +6,45 @@
 //Thin wrapper around RdbIndexQuery so PosdbTable doesn't have to know about indexes and file numbers
 class DocumentIndexChecker : public RdbIndexQuery {
 	int32_t fileNum;
+	//docids of the file, walked along with the docids asked for. see exists()
+	docidsetconst_ptr_t fileDocIds;
+	mutable RdbIndexDocIdSet::Iterator fileDocIdsIt;
+	mutable uint64_t prevDocId;
 public:
 	DocumentIndexChecker(RdbBase *base)
 	  : RdbIndexQuery(base),
-	    fileNum(-1)
+	    fileNum(-1),
+	    fileDocIds(new RdbIndexDocIdSet),
+	    fileDocIdsIt(fileDocIds->begin()),
+	    prevDocId(0)
 	  {}
 	
 	void setFileNum(int32_t fileNum) {
 		this->fileNum = fileNum;
+		fileDocIds = getFileIndex(fileNum);
+		if(fileDocIds)
+			fileDocIdsIt = fileDocIds->begin();
+		prevDocId = 0;
 	}
 
 	int32_t getFileNum() const {
 		return fileNum;
 	}
 	
+	//PosdbTable asks for the docids of the termlists in ascending order, so the
+	//docids of the file are iterated along with them and a docid that is not in
+	//the file is rejected without a lookup in the global index. A docid in the
+	//file still has to be checked against the newer files
 	bool exists(int64_t docId) const {
+		if(fileDocIds) {
+			if((uint64_t)docId < prevDocId)
+				fileDocIdsIt = fileDocIds->begin(docId);
+			else
+				fileDocIdsIt.skipTo(docId);
+			prevDocId = docId;
+			if(fileDocIdsIt.isExhausted() || fileDocIdsIt.getDocId()!=(uint64_t)docId)
+				return false;
+		}
 		return documentIsInFile(docId,fileNum);
 	}
 };
@@ -0,0 +1,95 @@
+#include "FrequentPhrases.h"
+#include "hash.h"
+#include "utf8_fast.h"
+#include "Log.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+
+// Format of the file:
+// One phrase per line, words separated by spaces or punctuation. Empty lines
+// and lines starting with '#' are ignored. Phrases shorter than
+// FREQUENTPHRASES_MIN_WORDS words have bigram termlists already and are
+// skipped, phrases longer than FREQUENTPHRASES_MAX_WORDS are skipped too.
+//
+// Changing the file only affects documents indexed after the change, so
+// Conf::m_useFrequentPhrases should only be enabled once the documents have
+// been reindexed.
+
+FrequentPhrases g_frequentPhrases;
+
+static const char filename[] = "frequent_phrases.txt";
+
+
+uint64_t FrequentPhrases::hashWord(uint64_t h, const char *word, int32_t wordLen, int32_t *pos) {
+	if(*pos==0) {
+		//like Phrases::setPhrase() the position after the first word is its length
+		*pos = wordLen;
+		return hash64Lower_utf8(word, wordLen);
+	}
+	return hash64Lower_utf8_cont(word, wordLen, h, pos);
+}
+
+
+bool FrequentPhrases::load() {
+	return load(filename);
+}
+
+
+bool FrequentPhrases::load(const char *filename_) {
+	log(LOG_DEBUG, "Loading %s", filename_);
+
+	FILE *fp = fopen(filename_,"r");
+	if(!fp) {
+		log(LOG_INFO,"Couldn't open %s, errno=%d (%s)", filename_, errno, strerror(errno));
+		return false;
+	}
+
+	std::unordered_set<uint64_t> new_phrase_ids;
+	int32_t new_max_words = 0;
+
+	char line[1024];
+	while(fgets(line,sizeof(line),fp)) {
+		if(line[0]=='#')
+			continue;
+
+		const char *p = line;
+		const char *end = line+strlen(line);
+		uint64_t h = 0;
+		int32_t pos = 0;
+		int32_t numWords = 0;
+		while(p<end) {
+			//skip to the start of the next word
+			if(!is_alnum_utf8(p)) {
+				p += getUtf8CharSize(p);
+				continue;
+			}
+			const char *word = p;
+			while(p<end && is_alnum_utf8(p))
+				p += getUtf8CharSize(p);
+			h = hashWord(h, word, p-word, &pos);
+			numWords++;
+		}
+
+		if(numWords<FREQUENTPHRASES_MIN_WORDS || numWords>FREQUENTPHRASES_MAX_WORDS)
+			continue;
+
+		new_phrase_ids.insert(h);
+		if(numWords>new_max_words)
+			new_max_words = numWords;
+	}
+	fclose(fp);
+
+	phrase_ids.swap(new_phrase_ids);
+	max_words = new_max_words;
+
+	log(LOG_DEBUG, "%s loaded (%lu phrases)", filename_, (unsigned long)phrase_ids.size());
+	return true;
+}
+
+
+void FrequentPhrases::unload() {
+	phrase_ids.clear();
+	max_words = 0;
+}
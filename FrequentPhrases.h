@@ -0,0 +1,49 @@
+#ifndef GB_FREQUENTPHRASES_H
+#define GB_FREQUENTPHRASES_H
+
+#include <inttypes.h>
+#include <unordered_set>
+
+#define FREQUENTPHRASES_MIN_WORDS 3
+#define FREQUENTPHRASES_MAX_WORDS 8
+
+//A list of frequently searched phrases, eg. "to be or not to be", that get
+//a posdb termlist of their own.
+//Posdb has bigram termlists, but a query made entirely of common words still
+//has to intersect several huge bigram lists. When indexing, XmlDoc adds a
+//posdb key for every occurrence of a listed phrase, and Query uses the
+//(much shorter) phrase termlist in place of the bigram lists it covers.
+//
+//The phrase id continues the bigram id Phrases makes for its first two
+//words with the following words, so "to be or" is the "to be" bigram id
+//continued with "or".
+class FrequentPhrases {
+	FrequentPhrases(const FrequentPhrases&);
+	FrequentPhrases& operator=(const FrequentPhrases&);
+
+	std::unordered_set<uint64_t> phrase_ids;
+	int32_t max_words;
+public:
+	FrequentPhrases() : phrase_ids(), max_words(0) {}
+
+	bool load();
+	bool load(const char *filename);
+	void unload();
+
+	bool empty() const { return phrase_ids.empty(); }
+
+	//the longest phrase we have, in words
+	int32_t getMaxWords() const { return max_words; }
+
+	bool isFrequentPhrase(uint64_t phrase_id) const {
+		return phrase_ids.find(phrase_id)!=phrase_ids.end();
+	}
+
+	//hash the next word of a phrase into "h". "pos" carries the position
+	//between calls and must be 0 for the first word
+	static uint64_t hashWord(uint64_t h, const char *word, int32_t wordLen, int32_t *pos);
+};
+
+extern FrequentPhrases g_frequentPhrases;
+
+#endif // GB_FREQUENTPHRASES_H
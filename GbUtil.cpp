@@ -15,7 +15,8 @@ bool cdataEncode(SafeBuf *dstBuf, const char *src, size_t len) {
 		return false;
 	const char *endptr = src+len;
 	const char *early_endptr = endptr-2;
-	for(const char *s = src; s<early_endptr; ) {
+	const char *s = src;
+	while(s<early_endptr) {
 		bool b;
 		if(s[0]!=']' || s[1]!=']' || s[2]!='>') {
 			b = dstBuf->pushChar(*s);
@@ -32,8 +33,8 @@ bool cdataEncode(SafeBuf *dstBuf, const char *src, size_t len) {
 		}
 		if(!b) return false;
 	}
-	//handle 2-byte tail
-	for(const char *s=early_endptr; s<endptr; s++)
+	//handle the tail, 2 bytes or less if the string ended with ]]>
+	for( ; s<endptr; s++)
 		if(!dstBuf->pushChar(*s))
 			return false;
 	return true;
@@ -4,6 +4,7 @@
 #include "Rebalance.h"
 #include "Repair.h"
 #include "DailyMerge.h"
+#include "Warmup.h"
 
 
 bool g_recoveryMode = false;
@@ -22,6 +23,7 @@ int getOurHostFlags() {
 	if ( g_rebalance.m_isScanning         ) flags |= PFLAG_REBALANCING;
 	if ( g_recoveryMode                   ) flags |= PFLAG_RECOVERYMODE;
 	if ( g_rebalance.m_numForeignRecs     ) flags |= PFLAG_FOREIGNRECS;
+	if ( g_warmup.isWarmingUp()           ) flags |= PFLAG_WARMINGUP;
 	if ( g_dailyMerge.m_mergeMode    == 0 ) flags |= PFLAG_MERGEMODE0;
 	if ( g_dailyMerge.m_mergeMode ==0 || g_dailyMerge.m_mergeMode == 6 )
 		flags |= PFLAG_MERGEMODE0OR6;
@@ -12,6 +12,8 @@
 #define PFLAG_REBALANCING    0x20
 #define PFLAG_FOREIGNRECS    0x40
 #define PFLAG_RECOVERYMODE   0x80
+// restarted and still warming up its caches, twins should get the queries
+#define PFLAG_WARMINGUP      0x100
 
 
 int getOurHostFlags();
@@ -1238,14 +1238,36 @@ Host *Hostdb::getHostWithQueryingEnabled(uint32_t shardNum) {
 }
 
 
-bool Hostdb::mayWeSendRequestToHost(const Host *host, msg_type_t /*msgType*/) {
+bool Hostdb::mayWeSendRequestToHost(const Host *host, msg_type_t msgType) {
 	if(!getMyHost()->m_spiderEnabled && host->m_spiderEnabled && !g_conf.m_queryHostToSpiderHostFallbackAllowed)
 		return false;
 	if(!getMyHost()->m_queryEnabled && host->m_queryEnabled && !g_conf.m_spiderHostToQueryHostFallbackAllowed)
 		return false;
+	// a host still warming up its caches after a restart only gets queries if none of its twins can take them
+	if(msgType==msg_type_39 && isWarmingUp(host) && hasReadyQueryTwin(host))
+		return false;
 	return true;
 }
 
+bool Hostdb::isWarmingUp(const Host *host) const {
+	ScopedLock sl(m_mtxPinginfo);
+	return host->m_runtimeInformation.m_valid && (host->m_runtimeInformation.m_flags & PFLAG_WARMINGUP);
+}
+
+bool Hostdb::hasReadyQueryTwin(const Host *host) const {
+	const Host *shard = getShard(host->m_shardNum);
+	ScopedLock sl(m_mtxPinginfo);
+	for(int32_t i = 0; i < m_numHostsPerShard; i++) {
+		const Host *hh = &shard[i];
+		if(hh == host || !hh->m_queryEnabled || isDead_unlocked(hh))
+			continue;
+		if(hh->m_runtimeInformation.m_valid && (hh->m_runtimeInformation.m_flags & PFLAG_WARMINGUP))
+			continue;
+		return true;
+	}
+	return false;
+}
+
 // if niceness 0 can't pick noquery host/ must pick query host.
 // if niceness 1 can't pick nospider host/ must pick spider host.
 // Used to select based on PingInfo::m_udpSlotsInUseIncoming but that information is not exchanged often enough to
@@ -1537,6 +1559,10 @@ uint32_t Hostdb::getShardNum(rdbid_t rdbId, const void *k) const {
 			// sharded by part of linkee sitehash32
 			return m_map [(*(uint16_t *)((char *)k + 26))>>3];
 
+		case RDB_ANCHORDB:
+			// the same part of the linkee sitehash32 as linkdb
+			return m_map [(*(uint16_t *)((char *)k + 14))>>3];
+
 		case RDB_TITLEDB:
 		case RDB2_TITLEDB2: {
 			uint64_t d = Titledb::getDocId ( (key96_t *)k );
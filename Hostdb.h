@@ -216,6 +216,8 @@ class Hostdb {
 	Host *getHostWithSpideringEnabled ( uint32_t shardNum );
 	Host *getHostWithQueryingEnabled(uint32_t shardNum);
 	bool mayWeSendRequestToHost(const Host *host, msg_type_t msgType); //spider/query split: send requests between classes of hosts?
+	bool isWarmingUp(const Host *host) const;
+	bool hasReadyQueryTwin(const Host *host) const;
 
 	// in the entire cluster. return host #0 if its alive, otherwise
 	// host #1, etc.
@@ -189,7 +189,8 @@ bool HttpRequest::set (char *url,int32_t offset,int32_t size,time_t ifModifiedSi
 		       // are we sending the request through an http proxy?
 		       // if so this will be non-zero
 		       int32_t proxyIp ,
-		       const char *proxyUsernamePwd ) {
+		       const char *proxyUsernamePwd ,
+		       bool keepAlive ) {
 
 	m_reqBufValid = false;
 
@@ -232,31 +233,19 @@ bool HttpRequest::set (char *url,int32_t offset,int32_t size,time_t ifModifiedSi
 		sprintf ( host + hlen , ":%" PRIu32 , (uint32_t)port );
 		hlen += strlen ( host + hlen );
 	}
-	// the if-modified-since field
+	// . the if-modified-since field
+	// . XmlDoc only passes a time in for recrawls where it knows what to
+	//   do with a 304, see XmlDoc::canShortCircuitUnchanged()
 	const char *ims = "";
-#if 0
 	char  ibuf[64];
-	if ( ifModifiedSince ) {
+	if ( ifModifiedSince && g_conf.m_spiderIfModifiedSince ) {
 		struct tm tm_buf;
-		char buf[64];
-		// NOTE: ctime appends a \n 
-		snprintf(ibuf, sizeof(ibuf), "If-Modified-Since: %s UTC",
-			asctime_r(gmtime_r(&ifModifiedSince,&tm_buf),buf));
-		// get the length
-		int32_t ilen = strlen(ibuf);
-		if( ilen && ilen < (int32_t)sizeof(ibuf)-1 ) {
-			// hack off \n from ctime - replace with \r\n\0
-			ibuf [ ilen - 1 ] = '\r';
-			ibuf [ ilen     ] = '\n';
-			ibuf [ ilen + 1 ] = '\0';
-			// set ims to this string
-			ims = ibuf;
-		}
+		// Wed, 20 Mar 2002 16:47:30 GMT
+		strftime ( ibuf , sizeof(ibuf) ,
+			   "If-Modified-Since: %a, %d %b %Y %T GMT\r\n" ,
+			   gmtime_r(&ifModifiedSince,&tm_buf) );
+		ims = ibuf;
 	}
-	// . until we fix if-modified-since, take it out
-	// . seems like we are being called with it as true when should not be
-	ims="";
-#endif
 
 	// . use one in conf file if caller did not provide
 	// . this is usually Gigabot/1.0
@@ -273,6 +262,11 @@ bool HttpRequest::set (char *url,int32_t offset,int32_t size,time_t ifModifiedSi
 	// note Connection: Close\r\n when making requests
 	//proto = "HTTP/1.1";
 
+	// . HTTP/1.0 with keep-alive so servers still do not send us chunked
+	//   replies. TcpServer only reuses the connection if the reply had a
+	//   Content-Length and did not say close
+	const char *connection = keepAlive ? "keep-alive" : "Close";
+
 	SafeBuf tmp;
 	const char *up = "";
 	if ( proxyUsernamePwd && proxyUsernamePwd[0] ) {
@@ -307,7 +301,7 @@ bool HttpRequest::set (char *url,int32_t offset,int32_t size,time_t ifModifiedSi
 				 "Host: %s\r\n"
 				 "%s"
 				 "User-Agent: %s\r\n"
-				 "Connection: Close\r\n"
+				 "Connection: %s\r\n"
 				 "Accept-Language: %s\r\n"
 				 "Accept: %s\r\n"
 				 "%s",
@@ -315,6 +309,7 @@ bool HttpRequest::set (char *url,int32_t offset,int32_t size,time_t ifModifiedSi
 				 host,
 				 ims,
 				 userAgent,
+				 connection,
 				 acceptLanguages.c_str(),
 				 accept,
 				 up);
@@ -324,7 +319,7 @@ bool HttpRequest::set (char *url,int32_t offset,int32_t size,time_t ifModifiedSi
 				 "Host: %s\r\n"
 				 "%s"
 				 "User-Agent: %s\r\n"
-				 "Connection: Close\r\n"
+				 "Connection: %s\r\n"
 				 "Accept-Language: %s\r\n"
 				 "Accept: %s\r\n"
 				 "Range: bytes=%" PRId32"-%" PRId32"\r\n"
@@ -335,6 +330,7 @@ bool HttpRequest::set (char *url,int32_t offset,int32_t size,time_t ifModifiedSi
 				 host,
 				 ims,
 				 userAgent,
+				 connection,
 				 acceptLanguages.c_str(),
 				 accept,
 				 offset,
@@ -346,7 +342,7 @@ bool HttpRequest::set (char *url,int32_t offset,int32_t size,time_t ifModifiedSi
 				 "Host: %s\r\n"
 				 "%s"
 				 "User-Agent: %s\r\n"
-				 "Connection: Close\r\n"
+				 "Connection: %s\r\n"
 				 "Accept-Language: %s\r\n"
 				 "Accept: %s\r\n"
 				 "Range: bytes=%" PRId32"-\r\n"
@@ -357,6 +353,7 @@ bool HttpRequest::set (char *url,int32_t offset,int32_t size,time_t ifModifiedSi
 				 host,
 				 ims,
 				 userAgent,
+				 connection,
 				 acceptLanguages.c_str(),
 				 accept,
 				 offset,
@@ -368,7 +365,7 @@ bool HttpRequest::set (char *url,int32_t offset,int32_t size,time_t ifModifiedSi
 				 "Accept: */*\r\n"
 				 "Host: %s\r\n"
 				 "%s"
-				 "Connection: Close\r\n"
+				 "Connection: %s\r\n"
 				 "Accept-Language: %s\r\n"
 				 "%s"
 				 "%s",
@@ -378,6 +375,7 @@ bool HttpRequest::set (char *url,int32_t offset,int32_t size,time_t ifModifiedSi
 				 userAgent,
 				 host,
 				 ims,
+				 connection,
 				 acceptLanguages.c_str(),
 				 acceptEncoding,
 				 up);
@@ -136,7 +136,8 @@ bool HttpServer::getDoc ( char   *url      ,
 			  const char    *additionalHeader ,
 			  const char    *fullRequest ,
 			  const char    *postContent ,
-			  const char    *proxyUsernamePwdAuth ) {
+			  const char    *proxyUsernamePwdAuth ,
+			  bool           keepAlive ) {
 	// sanity
 	if ( ip == -1 ) {
 		log(LOG_WARN, "http: you probably didn't mean to set ip=-1 did you? try setting to 0.");
@@ -201,6 +202,14 @@ bool HttpServer::getDoc ( char   *url      ,
 	// send the actual encrypted http stuff.
 	bool useHttpTunnel = ( proxyIp && urlIsHttps );
 
+	// . only plain GETs we form ourselves straight to the server can be
+	//   kept alive
+	// . a tunneled connection is bound to the host of the CONNECT, and a
+	//   connection to a proxy is shared by every host behind it
+	if ( fullRequest || doPost || proxyIp || size != -1 ) {
+		keepAlive = false;
+	}
+
 	int32_t  hostLen ;
 	int32_t  port = defPort;
 
@@ -216,7 +225,7 @@ bool HttpServer::getDoc ( char   *url      ,
 			       // say "GET http://www.xyz.com/" the full
 			       // url, not just a relative path.
 			       additionalHeader , pcLen , proxyIp ,
-			       proxyUsernamePwdAuth ) ) {
+			       proxyUsernamePwdAuth , keepAlive ) ) {
 			log(LOG_WARN, "http: http req error: %s",mstrerror(g_errno));
 			// TODO: ensure we close the socket on this error!
 			return true;
@@ -331,7 +340,7 @@ bool HttpServer::getDoc ( char   *url      ,
 	// . if using an http proxy, then ip should be valid here...
 	if ( ip ) {
 		if ( !tcp->sendMsg( host, hostLen, ip, port, req, reqSize, reqSize, reqSize, (void *)(intptr_t)n, gotDocWrapper,
-							timeout, maxTextDocLen, maxOtherDocLen, useHttpTunnel ) ) {
+							timeout, maxTextDocLen, maxOtherDocLen, useHttpTunnel, keepAlive ) ) {
 			return false;
 		}
 
@@ -1620,6 +1629,47 @@ static int32_t getMsgPiece ( TcpSocket *s ) {
 //   one alloc() and forget about having to do more...
 // . up to 128 bytes of the reply can be stored in a static buffer
 //   contained in TcpSocket, until we need to alloc...
+// . returns true if the reply mime lets us reuse the connection
+// . the reply must be delimited by Content-Length (or have no body) and the
+//   server must not have said close. HTTP/1.0 replies need an explicit
+//   "Connection: keep-alive"
+static bool allowsKeepAlive ( const char *mime , int32_t mimeLen , bool *noBody ) {
+	*noBody = false;
+	if ( mimeLen < 12 || strncmp ( mime , "HTTP/1." , 7 ) != 0 ) return false;
+	bool is11 = ( mime[7] == '1' );
+	// status code follows the first space
+	const char *p    = mime + 8;
+	const char *pend = mime + mimeLen;
+	while ( p < pend && *p == ' ' ) p++;
+	if ( p + 3 > pend || ! is_digit(p[0]) ) return false;
+	int32_t status = atol2 ( p , 3 );
+	if ( status < 200 || status == 204 || status == 304 ) *noBody = true;
+
+	bool hasLen    = false;
+	bool keepAlive = false;
+	for ( ; p < pend ; p++ ) {
+		// only look at the start of header lines
+		if ( p[-1] != '\n' ) continue;
+		if ( p + 16 < pend && strncasecmp ( p , "Content-Length:" , 15 ) == 0 ) {
+			hasLen = true;
+			continue;
+		}
+		if ( p + 18 < pend && strncasecmp ( p , "Transfer-Encoding:" , 18 ) == 0 )
+			return false;
+		if ( p + 11 >= pend || strncasecmp ( p , "Connection:" , 11 ) != 0 )
+			continue;
+		const char *e = p + 11;
+		while ( e < pend && *e != '\r' && *e != '\n' ) e++;
+		for ( const char *v = p + 11 ; v + 5 <= e ; v++ ) {
+			if ( strncasecmp ( v , "close" , 5 ) == 0 ) return false;
+			if ( v + 10 <= e && strncasecmp ( v , "keep-alive" , 10 ) == 0 )
+				keepAlive = true;
+		}
+	}
+	if ( ! hasLen && ! *noBody ) return false;
+	return is11 || keepAlive;
+}
+
 int32_t getMsgSize(const char *buf, int32_t bufSize, TcpSocket *s) {
 #ifdef _VALGRIND_
 	VALGRIND_CHECK_MEM_IS_DEFINED(buf,bufSize);
@@ -1719,6 +1769,17 @@ int32_t getMsgSize(const char *buf, int32_t bufSize, TcpSocket *s) {
 	// if has no content then it must end  in \n\r\n\r or \r\n\r\n
 	if ( ! hasContent ) return bufSize;
 
+	// . we asked for keep-alive on this download. check the server agreed
+	//   and that we can tell where the reply ends without a close
+	if ( s->m_keepAlive && ! isPost ) {
+		bool noBody = false;
+		if ( ! allowsKeepAlive ( buf , i , &noBody ) )
+			s->m_keepAlive = false;
+		// 304s and friends end with the mime
+		else if ( noBody )
+			return mimeSize;
+	}
+
 	// look for a Content-Type: field because we now limit how much
 	// we read based on this
 	const char *p          = buf;
@@ -82,7 +82,9 @@ class HttpServer {
 		      // specify your own mime and post data here...
 		      const char *fullRequest = NULL ,
 		      const char *postContent = NULL ,
-		      const char *proxyUsernamePwdAuth = NULL );
+		      const char *proxyUsernamePwdAuth = NULL ,
+		      // keep the connection open for the next download
+		      bool keepAlive = false );
 
 	bool gotDoc ( int32_t n , TcpSocket *s );
 
@@ -2,6 +2,7 @@
 #include "ScopedLock.h"
 #include "BigFile.h" //for FileState definition
 #include "Errno.h"
+#include "Conf.h"
 #include <pthread.h>
 #include <vector>
 #include <list>
@@ -38,6 +39,8 @@ struct JobEntry {
 	uint64_t          start_deadline;     //latest time when this job must be started
 	bool              is_io_write_job;    //valid for I/O jobs: mostly read or mostly write?
 	int               initial_priority;   //priority when queued
+	io_class_t        io_class;           //valid for I/O jobs: rate-limiting class
+	int64_t           io_bytes;           //valid for I/O jobs: bytes to read/write
 	
 	//for statistics:
 	thread_type_t     thread_type;
@@ -51,16 +54,279 @@ struct JobEntry {
 
 
 
+//Rate-limiting and ordering of I/O jobs. Each I/O class has a token bucket
+//(bytes) which is refilled according to the configured rate. Query reads are
+//dispatched first in earliest-deadline order, other classes by priority as
+//long as their bucket is not empty. When the query read latency rises above
+//the target the merge/repair rates are reduced automatically.
+//All members are protected by the scheduler mutex.
+class IoThrottle {
+public:
+	IoThrottle();
+	
+	//find the next job to run. Returns false if all queued jobs are throttled
+	//in which case *wait_ms is set to when a job can be expected to be runnable
+	bool select(const std::vector<JobEntry> &jobs, uint64_t now, size_t *idx, unsigned *wait_ms);
+	void job_dispatched(const JobEntry &e);
+	void job_finished(const JobEntry &e);
+	
+	void get_statistics(IoSchedulerStatistics *stats) const;
+	
+private:
+	struct Bucket {
+		double   tokens;
+		uint64_t window_bytes;          //dispatched in current window
+		uint64_t observed_rate;         //bytes/second in last window
+		uint64_t base_rate;             //rate when automatic throttling started
+		uint64_t bytes_done;
+		uint64_t job_count;
+		uint64_t throttle_count;
+	};
+	Bucket bucket[io_class_end];
+	uint64_t last_refill;
+	uint64_t window_start;
+	
+	static const unsigned max_latency_samples = 256;
+	static const unsigned latency_recalc_interval = 32;
+	unsigned query_latency[max_latency_samples];
+	unsigned query_latency_count;
+	unsigned query_latency_pos;
+	unsigned query_latency_p95;
+	uint64_t last_query_finish;
+	double   background_factor;
+	
+	static bool is_background_class(io_class_t io_class) {
+		return io_class==io_class_merge || io_class==io_class_repair;
+	}
+	static uint64_t configured_rate(io_class_t io_class);
+	uint64_t effective_rate(io_class_t io_class) const;
+	void refill(uint64_t now);
+	void update_background_factor();
+};
+
+
+IoThrottle::IoThrottle()
+  : last_refill(0),
+    window_start(0),
+    query_latency_count(0),
+    query_latency_pos(0),
+    query_latency_p95(0),
+    last_query_finish(0),
+    background_factor(1.0)
+{
+	memset(bucket,0,sizeof(bucket));
+	memset(query_latency,0,sizeof(query_latency));
+}
+
+
+uint64_t IoThrottle::configured_rate(io_class_t io_class) {
+	int32_t mb_per_second;
+	switch(io_class) {
+		case io_class_query:       mb_per_second = g_conf.m_ioQueryMaxRate; break;
+		case io_class_spider_read: mb_per_second = g_conf.m_ioSpiderReadMaxRate; break;
+		case io_class_merge:       mb_per_second = g_conf.m_ioMergeMaxRate; break;
+		case io_class_dump:        mb_per_second = g_conf.m_ioDumpMaxRate; break;
+		case io_class_repair:      mb_per_second = g_conf.m_ioRepairMaxRate; break;
+		default:                   mb_per_second = 0;
+	}
+	if(mb_per_second<=0)
+		return 0;
+	return (uint64_t)mb_per_second*1024*1024;
+}
+
+
+uint64_t IoThrottle::effective_rate(io_class_t io_class) const {
+	uint64_t rate = configured_rate(io_class);
+	if(background_factor<1.0 && is_background_class(io_class)) {
+		uint64_t min_rate = (uint64_t)std::max(g_conf.m_ioThrottledMinRate,(int32_t)1)*1024*1024;
+		uint64_t base_rate = bucket[io_class].base_rate;
+		if(base_rate==0)
+			base_rate = rate;
+		uint64_t throttled_rate = (uint64_t)(base_rate*background_factor);
+		if(throttled_rate<min_rate)
+			throttled_rate = min_rate;
+		if(rate==0 || throttled_rate<rate)
+			rate = throttled_rate;
+	}
+	return rate;
+}
+
+
+void IoThrottle::refill(uint64_t now) {
+	if(last_refill==0) {
+		//start with full buckets
+		for(int c=0; c<io_class_end; c++)
+			bucket[c].tokens = (double)effective_rate((io_class_t)c);
+		last_refill = now;
+		window_start = now;
+	}
+	
+	if(now>=window_start+1000) {
+		for(int c=0; c<io_class_end; c++) {
+			bucket[c].observed_rate = bucket[c].window_bytes*1000/(now-window_start);
+			bucket[c].window_bytes = 0;
+		}
+		window_start = now;
+	}
+	
+	//no queries for a while, so there is nothing to protect
+	if(background_factor<1.0 && now>last_query_finish+5000)
+		background_factor = 1.0;
+	
+	if(now<=last_refill)
+		return;
+	uint64_t elapsed = now - last_refill;
+	last_refill = now;
+	for(int c=0; c<io_class_end; c++) {
+		uint64_t rate = effective_rate((io_class_t)c);
+		if(rate==0) {
+			bucket[c].tokens = 0;
+			continue;
+		}
+		//allow bursts of up to one second worth of i/o
+		bucket[c].tokens += (double)rate*elapsed/1000.0;
+		if(bucket[c].tokens>(double)rate)
+			bucket[c].tokens = (double)rate;
+	}
+}
+
+
+bool IoThrottle::select(const std::vector<JobEntry> &jobs, uint64_t now, size_t *idx, unsigned *wait_ms) {
+	refill(now);
+	
+	const uint64_t query_deadline = g_conf.m_ioQueryReadDeadline>0 ? g_conf.m_ioQueryReadDeadline : 0;
+	bool throttled[io_class_end];
+	for(int c=0; c<io_class_end; c++)
+		throttled[c] = effective_rate((io_class_t)c)!=0 && bucket[c].tokens<=0;
+	
+	size_t best_query = jobs.size();
+	uint64_t best_query_deadline = 0;
+	size_t best_other = jobs.size();
+	bool any_throttled[io_class_end] = {};
+	for(size_t i=0; i<jobs.size(); i++) {
+		const JobEntry &e = jobs[i];
+		if(throttled[e.io_class]) {
+			any_throttled[e.io_class] = true;
+			continue;
+		}
+		if(e.io_class==io_class_query) {
+			uint64_t deadline = e.start_deadline ? e.start_deadline : e.queue_enter_time+query_deadline;
+			if(best_query==jobs.size() || deadline<best_query_deadline) {
+				best_query = i;
+				best_query_deadline = deadline;
+			}
+		} else if(best_other==jobs.size() ||
+		          e.initial_priority<jobs[best_other].initial_priority ||
+		          (e.initial_priority==jobs[best_other].initial_priority && e.queue_enter_time<jobs[best_other].queue_enter_time))
+			best_other = i;
+	}
+	
+	if(best_query!=jobs.size()) {
+		*idx = best_query;
+		return true;
+	}
+	if(best_other!=jobs.size()) {
+		*idx = best_other;
+		return true;
+	}
+	
+	//everything is throttled. Figure out when the first bucket becomes non-empty
+	unsigned min_wait = 1000;
+	for(int c=0; c<io_class_end; c++) {
+		if(!any_throttled[c])
+			continue;
+		bucket[c].throttle_count++;
+		uint64_t rate = effective_rate((io_class_t)c);
+		unsigned w = (unsigned)(-bucket[c].tokens*1000.0/rate) + 1;
+		if(w<min_wait)
+			min_wait = w;
+	}
+	*wait_ms = min_wait;
+	return false;
+}
+
+
+void IoThrottle::job_dispatched(const JobEntry &e) {
+	Bucket &b = bucket[e.io_class];
+	b.window_bytes += e.io_bytes;
+	if(effective_rate(e.io_class)!=0)
+		b.tokens -= e.io_bytes;
+}
+
+
+void IoThrottle::job_finished(const JobEntry &e) {
+	Bucket &b = bucket[e.io_class];
+	b.bytes_done += e.io_bytes;
+	b.job_count++;
+	
+	if(e.io_class!=io_class_query)
+		return;
+	
+	last_query_finish = e.stop_time;
+	query_latency[query_latency_pos] = (unsigned)(e.stop_time - e.queue_enter_time);
+	query_latency_pos = (query_latency_pos+1)%max_latency_samples;
+	query_latency_count++;
+	if(query_latency_count%latency_recalc_interval==0)
+		update_background_factor();
+}
+
+
+void IoThrottle::update_background_factor() {
+	unsigned n = query_latency_count<max_latency_samples ? query_latency_count : max_latency_samples;
+	std::vector<unsigned> v(query_latency,query_latency+n);
+	std::vector<unsigned>::iterator p95 = v.begin() + (n*95)/100;
+	std::nth_element(v.begin(),p95,v.end());
+	query_latency_p95 = *p95;
+	
+	if(g_conf.m_ioQueryLatencyTarget<=0) {
+		background_factor = 1.0;
+		return;
+	}
+	unsigned target = (unsigned)g_conf.m_ioQueryLatencyTarget;
+	if(query_latency_p95>target) {
+		if(background_factor>=1.0) {
+			//start throttling from the current rate
+			for(int c=0; c<io_class_end; c++) {
+				if(!is_background_class((io_class_t)c))
+					continue;
+				uint64_t rate = configured_rate((io_class_t)c);
+				if(rate==0 || bucket[c].observed_rate<rate)
+					rate = bucket[c].observed_rate;
+				bucket[c].base_rate = rate;
+			}
+		}
+		background_factor = std::max(background_factor/2, 1.0/64);
+	} else if(query_latency_p95<target*3/4 && background_factor<1.0)
+		background_factor = std::min(background_factor*1.25, 1.0);
+}
+
+
+void IoThrottle::get_statistics(IoSchedulerStatistics *stats) const {
+	for(int c=0; c<io_class_end; c++) {
+		stats->io_class[c].rate_limit = effective_rate((io_class_t)c);
+		stats->io_class[c].observed_rate = bucket[c].observed_rate;
+		stats->io_class[c].bytes_done = bucket[c].bytes_done;
+		stats->io_class[c].job_count = bucket[c].job_count;
+		stats->io_class[c].throttle_count = bucket[c].throttle_count;
+	}
+	stats->query_latency_p95 = query_latency_p95;
+	stats->background_factor = background_factor;
+}
+
+
+
 //a set of jobs, prioritized
 class JobQueue : public std::vector<JobEntry> {
 public:
 	pthread_cond_t cond_not_empty;
 	unsigned potential_worker_threads;
+	IoThrottle *io_throttle;               //only set for the I/O queue
 
 	JobQueue()
 	  : vector(),
 	    cond_not_empty PTHREAD_COND_INITIALIZER,
-	    potential_worker_threads(0)
+	    potential_worker_threads(0),
+	    io_throttle(NULL)
 	{
 	}
 	
@@ -74,6 +340,7 @@ public:
 	}
 	
 	JobEntry pop_top_priority();
+	bool pop_runnable(JobEntry *e, unsigned *wait_ms);
 	
 	
 };
@@ -95,6 +362,23 @@ JobEntry JobQueue::pop_top_priority()
 }
 
 
+//take the next job that isn't rate-limited
+bool JobQueue::pop_runnable(JobEntry *e, unsigned *wait_ms)
+{
+	if(!io_throttle) {
+		*e = pop_top_priority();
+		return true;
+	}
+	size_t idx;
+	if(!io_throttle->select(*this,now_ms(),&idx,wait_ms))
+		return false;
+	*e = (*this)[idx];
+	erase(begin()+idx);
+	io_throttle->job_dispatched(*e);
+	return true;
+}
+
+
 
 typedef std::vector<std::pair<JobEntry,job_exit_t>> ExitSet;
 typedef std::list<JobEntry> RunningSet;
@@ -125,7 +409,22 @@ static void *job_pool_thread_function(void *pv) {
 			continue;
 		
 		//take the top-priority job and move it into the running set
-		RunningSet::iterator iter = ptp->running_set->insert(ptp->running_set->begin(),ptp->job_queue->pop_top_priority());
+		JobEntry e;
+		unsigned wait_ms;
+		if(!ptp->job_queue->pop_runnable(&e,&wait_ms)) {
+			//everything is rate-limited. Sleep until a bucket has been refilled or a new job arrives
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME,&ts);
+			ts.tv_sec += wait_ms/1000;
+			ts.tv_nsec += (wait_ms%1000)*1000000;
+			if(ts.tv_nsec>=1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&ptp->job_queue->cond_not_empty,ptp->mtx,&ts);
+			continue;
+		}
+		RunningSet::iterator iter = ptp->running_set->insert(ptp->running_set->begin(),e);
 		if(iter->is_io_job && iter->is_io_write_job)
 			++*(ptp->num_io_write_jobs_running);
 		pthread_mutex_unlock(ptp->mtx);
@@ -146,6 +445,8 @@ static void *job_pool_thread_function(void *pv) {
 		pthread_mutex_lock(ptp->mtx);
 		if(iter->is_io_job && iter->is_io_write_job)
 			--*(ptp->num_io_write_jobs_running);
+		if(iter->is_io_job && ptp->job_queue->io_throttle && job_exit==job_exit_normal)
+			ptp->job_queue->io_throttle->job_finished(*iter);
 		//copy+delete it into the exit queue
 		ptp->exit_set->push_back(std::make_pair(*iter,job_exit));
 		ptp->running_set->erase(iter);
@@ -255,6 +556,8 @@ class JobScheduler_impl {
 	
 	unsigned   num_io_write_jobs_running;
 	
+	IoThrottle io_throttle;
+	
 	ThreadPool coordinator_thread_pool;
 	ThreadPool cpu_thread_pool;
 	ThreadPool summary_thread_pool;
@@ -284,6 +587,7 @@ public:
 	    running_set(),
 	    exit_set(),
 	    num_io_write_jobs_running(0),
+	    io_throttle(),
 	    coordinator_thread_pool("coord",num_coordinator_threads,&coordinator_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,job_done_notify),
 	    cpu_thread_pool("cpu",num_cpu_threads,&cpu_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,job_done_notify),
 	    summary_thread_pool("summary",num_summary_threads,&summary_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,job_done_notify),
@@ -294,6 +598,7 @@ public:
 	    no_threads(num_cpu_threads==0 && num_summary_threads==0 && num_io_threads==0 && num_external_threads==0 && num_file_meta_threads==0),
 	    new_jobs_allowed(true)
 	{
+		io_job_queue.io_throttle = &io_throttle;
 	}
 	
 	~JobScheduler_impl();
@@ -334,6 +639,7 @@ public:
 	
 	std::vector<JobDigest> query_job_digests() const;
 	std::map<thread_type_t,JobTypeStatistics> query_job_statistics(bool clear);
+	IoSchedulerStatistics query_io_statistics() const;
 };
 
 
@@ -422,6 +728,7 @@ bool JobScheduler_impl::submit(thread_type_t thread_type, JobEntry &e)
 			case thread_type_file_meta_data:     job_queue = &file_meta_job_queue;break;
 			case thread_type_index_merge:        job_queue = &cpu_job_queue;      break;
 			case thread_type_index_generate:     job_queue = &merge_job_queue;    break;
+			case thread_type_dump_index:         job_queue = &cpu_job_queue;      break;
 			case thread_type_verify_data:        job_queue = &cpu_job_queue;      break;
 			case thread_type_statistics:         job_queue = &cpu_job_queue;      break;
 			case thread_type_unspecified_io:     job_queue = &cpu_job_queue;      break;
@@ -490,6 +797,16 @@ bool JobScheduler_impl::submit_io(start_routine_t   start_routine,
 	e.start_deadline = start_deadline;
 	e.is_io_write_job = is_write_job;
 	e.initial_priority = priority;
+	e.io_class = fstate->m_ioClass;
+	if(e.io_class==io_class_unspecified) {
+		if(is_write_job)
+			e.io_class = io_class_dump;
+		else if(priority<=0)
+			e.io_class = io_class_query;
+		else
+			e.io_class = io_class_spider_read;
+	}
+	e.io_bytes = fstate->m_bytesToGo;
 	return submit(thread_type,e);
 }
 
@@ -641,6 +958,15 @@ std::map<thread_type_t,JobTypeStatistics> JobScheduler_impl::query_job_statistic
 }
 
 
+IoSchedulerStatistics JobScheduler_impl::query_io_statistics() const
+{
+	IoSchedulerStatistics stats;
+	ScopedLock sl(mtx);
+	io_throttle.get_statistics(&stats);
+	return stats;
+}
+
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -792,6 +1118,18 @@ std::map<thread_type_t,JobTypeStatistics> JobScheduler::query_job_statistics(boo
 }
 
 
+IoSchedulerStatistics JobScheduler::query_io_statistics() const
+{
+	if(impl)
+		return impl->query_io_statistics();
+	else {
+		IoSchedulerStatistics stats;
+		memset(&stats,0,sizeof(stats));
+		return stats;
+	}
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // The global one-and-only scheduler
 
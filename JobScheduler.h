@@ -41,6 +41,7 @@ enum thread_type_t {
 	thread_type_file_meta_data,     //unlink/rename
 	thread_type_index_merge,
 	thread_type_index_generate,
+	thread_type_dump_index,         //index of a list being dumped. the dump thread waits for it
 	thread_type_verify_data,        //mostly CPU
 	thread_type_statistics,         //mostly i/o
 	thread_type_unspecified_io,     //until we can be more specific
@@ -50,6 +51,20 @@ enum thread_type_t {
 };
 
 
+//Class of a disk I/O job. Used for rate-limiting and ordering the I/O queue.
+//Unspecified I/O is classified by the scheduler based on niceness and
+//read/write (niceness 0 reads are query reads, other reads are spider
+//reads, writes are dumps)
+enum io_class_t {
+	io_class_unspecified=0,
+	io_class_query,
+	io_class_spider_read,
+	io_class_merge,
+	io_class_dump,
+	io_class_repair,
+	io_class_end
+};
+
 
 //A digest of a job in the scheduler. For statistics and display purposes
 struct JobDigest {
@@ -78,6 +93,22 @@ struct JobTypeStatistics {
 };
 
 
+//statistics for the I/O classes
+struct IoClassStatistics {
+	uint64_t rate_limit;            //current effective limit in bytes/second, 0=unlimited
+	uint64_t observed_rate;         //bytes/second dispatched during the last second
+	uint64_t bytes_done;            //bytes read/written by finished jobs
+	uint64_t job_count;             //finished jobs
+	uint64_t throttle_count;        //number of times the class held back a worker thread
+};
+
+struct IoSchedulerStatistics {
+	IoClassStatistics io_class[io_class_end];
+	unsigned query_latency_p95;     //milliseconds from enqueue to finish of query reads
+	double   background_factor;     //current automatic throttling of merge/repair bandwidth (1.0=none)
+};
+
+
 class JobScheduler_impl;
 
 typedef void (*job_done_notify_t)();
@@ -122,6 +153,7 @@ public:
 	
 	std::vector<JobDigest> query_job_digests() const;
 	std::map<thread_type_t,JobTypeStatistics> query_job_statistics(bool clear=true);
+	IoSchedulerStatistics query_io_statistics() const;
 
 private:
 	JobScheduler_impl *impl;
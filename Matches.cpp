@@ -8,6 +8,7 @@
 #include "Sections.h"
 #include "Linkdb.h"
 #include "Xml.h"
+#include "SummaryStore.h"
 #include "BitOperations.h"
 #include "Process.h"
 #include "Mem.h"
@@ -241,12 +242,25 @@ void Matches::setQuery(const Query *q) {
 	}
 }
 
+mf_t Matches::getMetaTagFlags(const char *tag, int32_t tagLen) {
+	if (tagLen== 7&&strncasecmp(tag,"keyword"    , 7)== 0)
+		return MF_METAKEYW;
+	if (tagLen== 7&&strncasecmp(tag,"summary"    , 7)== 0)
+		return MF_METASUMM;
+	if (tagLen== 8&&strncasecmp(tag,"keywords"   , 8)== 0)
+		return MF_METAKEYW;
+	if (tagLen==11&&strncasecmp(tag,"description",11)== 0)
+		return MF_METADESC;
+	return 0;
+}
+
 // . this was in Summary.cpp, but is more useful here
 // . we can also use this to replace the proximity algo setup where it
 //   fills in the matrix for title, link text, etc.
 // . returns false and sets g_errno on error
 bool Matches::set(const TokenizerResult *bodyTr, Phrases *bodyPhrases, const Sections *bodySections, const Bits *bodyBits,
-		  const Pos *bodyPos, Xml *bodyXml, const Title *tt, const Url *firstUrl, LinkInfo *linkInfo ) {
+		  const Pos *bodyPos, Xml *bodyXml, const Title *tt, const Url *firstUrl, LinkInfo *linkInfo,
+		  const SummaryStore *summaryStore ) {
 	// don't reset query info!
 	reset2();
 
@@ -282,34 +296,42 @@ bool Matches::set(const TokenizerResult *bodyTr, Phrases *bodyPhrases, const Sec
 	}
 
 	// now add in the meta tags
-	int32_t n = bodyXml->getNumNodes();
-	XmlNode *nodes = bodyXml->getNodes();
-
-	// find the first meta summary node
-	for ( int32_t i = 0 ; i < n ; i++ ) {
-		// continue if not a meta tag
-		if ( nodes[i].m_nodeId != TAG_META ) continue;
-		// only get content for <meta name=..> not <meta http-equiv=..>
-		int32_t tagLen;
-		char *tag = bodyXml->getString ( i , "name" , &tagLen );
-		// is it an accepted meta tag?
-		int32_t flag = 0;
-		if (tagLen== 7&&strncasecmp(tag,"keyword"    , 7)== 0)
-			flag = MF_METAKEYW;
-		if (tagLen== 7&&strncasecmp(tag,"summary"    , 7)== 0)
-			flag = MF_METASUMM;
-		if (tagLen== 8&&strncasecmp(tag,"keywords"   , 8)== 0)
-			flag = MF_METAKEYW;
-		if (tagLen==11&&strncasecmp(tag,"description",11)== 0)
-			flag = MF_METADESC;
-		if ( ! flag ) continue;
-		// get the content
-		int32_t len;
-		char *s = bodyXml->getString ( i , "content" , &len );
-		if ( ! s || len <= 0 ) continue;
-		// wordify
-		if ( !addMatches( s, len, flag ) ) {
-			return false;
+	if ( summaryStore ) {
+		for ( int32_t i = 0 ; i < summaryStore->getNumMetaTags() ; i++ ) {
+			const char *tag;
+			int32_t tagLen;
+			const char *s;
+			int32_t len;
+			summaryStore->getMetaTag ( i , &tag , &tagLen , &s , &len );
+			mf_t flag = getMetaTagFlags ( tag , tagLen );
+			if ( ! flag ) continue;
+			// wordify
+			if ( !addMatches( s, len, flag ) ) {
+				return false;
+			}
+		}
+	} else {
+		int32_t n = bodyXml->getNumNodes();
+		XmlNode *nodes = bodyXml->getNodes();
+
+		// find the first meta summary node
+		for ( int32_t i = 0 ; i < n ; i++ ) {
+			// continue if not a meta tag
+			if ( nodes[i].m_nodeId != TAG_META ) continue;
+			// only get content for <meta name=..> not <meta http-equiv=..>
+			int32_t tagLen;
+			char *tag = bodyXml->getString ( i , "name" , &tagLen );
+			// is it an accepted meta tag?
+			mf_t flag = getMetaTagFlags ( tag , tagLen );
+			if ( ! flag ) continue;
+			// get the content
+			int32_t len;
+			char *s = bodyXml->getString ( i , "content" , &len );
+			if ( ! s || len <= 0 ) continue;
+			// wordify
+			if ( !addMatches( s, len, flag ) ) {
+				return false;
+			}
 		}
 	}
 
@@ -35,6 +35,7 @@ typedef int32_t mf_t;
 #define MF_URL                        0x4000  // in url
 
 class Xml;
+class SummaryStore;
 class Sections;
 class Url;
 class LinkInfo;
@@ -76,9 +77,15 @@ class Matches {
 
 	void setQuery(const Query *q);
 
+	// . the meta tags are taken from "summaryStore" if set, then "xml" is
+	//   not used and can be NULL
 	bool set(const TokenizerResult *bodyTr, Phrases *bodyPhrases,
 		 const Sections *bodySections, const Bits *bodyBits, const Pos *bodyPos, Xml *xml,
-		 const Title *tt, const Url *firstUrl, LinkInfo *linkInfo);
+		 const Title *tt, const Url *firstUrl, LinkInfo *linkInfo,
+		 const SummaryStore *summaryStore = NULL);
+
+	// match group of the content of <meta name=...>, 0 if we do not use it
+	static mf_t getMetaTagFlags(const char *name, int32_t nameLen);
 
 	bool addMatches(const char *s, int32_t slen, mf_t flags );
 
@@ -10,9 +10,13 @@
 #include "Errno.h"
 #include "hash.h"
 #include "Sanity.h"
+#include "MemCounters.h"
 #include <string.h>            //for strlen()
 #include <stdlib.h>
 #include <errno.h>
+#include <algorithm>
+#include <vector>
+#include <execinfo.h>
 
 
 // only Mem.cpp should call ::malloc, everyone else must call mmalloc() so
@@ -30,8 +34,32 @@
 // there because it will hit a different PAGE, to be more sure we could
 // make UNDERPAD and OVERPAD PAGE bytes, although the overrun could still write
 // to another allocated area of memory and we can never catch it.
+#ifdef LIGHT_MEM_ACCOUNTING
+// . without the allocation table the size and label of an allocation are
+//   kept in a header in front of it, including those made with new. it
+//   takes the place of the padding
+// . the header magic catches some underruns and double frees
+#define UNDERPAD 16
+#define OVERPAD  0
+
+struct MemHeader {
+	uint32_t m_magic;
+	uint16_t m_labelId;
+	uint8_t  m_isnew;
+	uint8_t  m_sampled;
+	uint64_t m_size;
+};
+static_assert(sizeof(MemHeader) == UNDERPAD, "MemHeader must fill UNDERPAD");
+
+static const uint32_t s_headerMagic = 0xda7a4d45;
+
+static MemHeader *getMemHeader(void *mem) {
+	return (MemHeader *)((char *)mem - UNDERPAD);
+}
+#else
 #define UNDERPAD 4
 #define OVERPAD  4
+#endif
 
 static const char MAGICCHAR = (char)0xda;
 
@@ -120,8 +148,19 @@ void operator delete[] ( void *ptr, size_t ) throw () {
 
 void Mem::addnew ( void *ptr , size_t size , const char *note ) {
 	logTrace( g_conf.m_logTraceMem, "ptr=%p size=%zu note=%s", ptr, size, note );
+#ifdef LIGHT_MEM_ACCOUNTING
+	// move it from TMPMEM to the real label. ptr may not be what operator
+	// new returned (arrays with a cookie) in which case it stays TMPMEM
+	MemHeader *hdr = getMemHeader(ptr);
+	if ( hdr->m_magic != s_headerMagic || hdr->m_size != size || ! hdr->m_isnew ) return;
+	uint16_t labelId = MemCounters::getLabelId(note);
+	MemCounters::rmAlloc(hdr->m_labelId, size);
+	MemCounters::addAlloc(labelId, size);
+	hdr->m_labelId = labelId;
+#else
 	// 1 --> isnew
 	addMem ( ptr , size , note , 1 );
+#endif
 }
 
 void Mem::delnew ( void *ptr , size_t size , const char *note ) {
@@ -166,7 +205,13 @@ void * operator new (size_t size) throw (std::bad_alloc) {
 		throw std::bad_alloc();
 	}
 
+#ifdef LIGHT_MEM_ACCOUNTING
+	// room for the header
+	void *mem = sysmalloc ( size + UNDERPAD );
+	if ( mem ) mem = (char *)mem + UNDERPAD;
+#else
 	void *mem = sysmalloc ( size );
+#endif
 
 	if ( ! mem && size > 0 ) {
 		g_mem.incrementOOMCount();
@@ -198,8 +243,13 @@ void * operator new [] (size_t size) throw (std::bad_alloc) {
 		//throw 1;
 	}
 
+#ifdef LIGHT_MEM_ACCOUNTING
+	// room for the header
+	void *mem = sysmalloc ( size + UNDERPAD );
+	if ( mem ) mem = (char *)mem + UNDERPAD;
+#else
 	void *mem = sysmalloc ( size );
-
+#endif
 
 	if ( ! mem && size > 0 ) {
 		g_errno = errno;
@@ -236,8 +286,60 @@ Mem::~Mem() {
 
 
 size_t Mem::getUsedMem () const {
+#ifdef LIGHT_MEM_ACCOUNTING
+	int64_t used = MemCounters::getUsedEstimate();
+	return used > 0 ? (size_t)used : 0;
+#else
 	ScopedLock sl(s_lock);
 	return m_used;
+#endif
+}
+
+size_t Mem::getMaxAllocated() const {
+#ifdef LIGHT_MEM_ACCOUNTING
+	int64_t maxUsed = MemCounters::getMaxUsedEstimate();
+	return maxUsed > 0 ? (size_t)maxUsed : 0;
+#else
+	return m_maxAllocated;
+#endif
+}
+
+size_t Mem::getMaxAlloc() const {
+#ifdef LIGHT_MEM_ACCOUNTING
+	return MemCounters::getMaxAlloc();
+#else
+	return m_maxAlloc;
+#endif
+}
+
+const char *Mem::getMaxAllocBy() const {
+#ifdef LIGHT_MEM_ACCOUNTING
+	static thread_local char s_maxAllocBy[MemCounters::s_maxLabelLen + 1];
+	MemCounters::getLabel(MemCounters::getMaxAllocLabelId(), s_maxAllocBy);
+	return s_maxAllocBy;
+#else
+	return m_maxAllocBy;
+#endif
+}
+
+int32_t Mem::getNumAllocated() const {
+#ifdef LIGHT_MEM_ACCOUNTING
+	int64_t numAllocated;
+	MemCounters::getTotals(NULL, &numAllocated, NULL);
+	return (int32_t)numAllocated;
+#else
+	return m_numAllocated;
+#endif
+}
+
+int64_t Mem::getNumTotalAllocated() const {
+#ifdef LIGHT_MEM_ACCOUNTING
+	int64_t numTotalAllocated;
+	MemCounters::getTotals(NULL, NULL, &numTotalAllocated);
+	return numTotalAllocated;
+#else
+	return m_numTotalAllocated;
+#endif
 }
 
 
@@ -247,21 +349,22 @@ size_t Mem::getMaxMem() const {
 
 
 float Mem::getUsedMemPercentage() const {
-	ScopedLock sl(s_lock);
-	int64_t used_mem = m_used;
+	int64_t used_mem = getUsedMem();
 	int64_t max_mem = g_conf.m_maxMem;
-	sl.unlock();
 	return ((float)used_mem) * 100.0 / ((float)max_mem);
 }
 
 int64_t Mem::getFreeMem() const {
-	ScopedLock sl(s_lock);
-	return g_conf.m_maxMem - m_used;
+	return g_conf.m_maxMem - (int64_t)getUsedMem();
 }
 
 bool Mem::init  ( ) {
+#ifdef LIGHT_MEM_ACCOUNTING
+	log(LOG_INIT,"mem: Using per-label counters instead of the allocation table.");
+#else
 	if ( g_conf.m_detectMemLeaks )
 		log(LOG_INIT,"mem: Memory leak checking is enabled.");
+#endif
 
 	// reset this, our max mem used over time ever because we don't
 	// want the mem test we did above to count towards it
@@ -273,6 +376,10 @@ bool Mem::init  ( ) {
 
 // this is called after a memory block has been allocated and needs to be registered
 void Mem::addMem ( void *mem , size_t size , const char *note , char isnew ) {
+#ifdef LIGHT_MEM_ACCOUNTING
+	addMemLight ( mem , size , note , isnew );
+	return;
+#endif
 	if(!s_lock.working) return;
 
 	ScopedLock sl(s_lock);
@@ -438,6 +545,214 @@ void Mem::addMem ( void *mem , size_t size , const char *note , char isnew ) {
 
 #define PRINT_TOP 40
 
+#ifdef LIGHT_MEM_ACCOUNTING
+// . fill in the header of the allocation and count it under its label
+// . no locks unless the allocation is sampled
+void Mem::addMemLight ( void *mem , size_t size , const char *note , char isnew ) {
+	logTrace( g_conf.m_logTraceMem, "mem=%p size=%zu note='%s' is_new=%d", mem, size, note, isnew );
+
+	uint16_t labelId = MemCounters::getLabelId(note);
+
+	MemHeader *hdr = getMemHeader(mem);
+	hdr->m_magic   = s_headerMagic;
+	hdr->m_labelId = labelId;
+	hdr->m_isnew   = isnew;
+	hdr->m_sampled = false;
+	hdr->m_size    = size;
+
+	MemCounters::addAlloc(labelId, size);
+	MemCounters::updateMaxAlloc(size, labelId);
+
+	if ( MemCounters::shouldSample(g_conf.m_memSampleRate) )
+		hdr->m_sampled = MemCounters::addSample(mem, size, labelId);
+
+	if ( (size > MINMEM && g_conf.m_logDebugMemUsage) || size>=100000000 )
+		log(LOG_INFO,"mem: addMem(%zu): %s. ptr=0x%" PTRFMT" used=%zu",
+		    size,note,(PTRTYPE)mem,getUsedMem());
+}
+
+bool Mem::rmMemLight ( void *mem , size_t size , const char *note , bool checksize ) {
+	logTrace( g_conf.m_logTraceMem, "mem=%p size=%zu note='%s'", mem, size, note );
+
+	// don't free 0 bytes
+	if ( checksize && size == 0 ) {
+		return true;
+	}
+
+	MemHeader *hdr = getMemHeader(mem);
+	if ( hdr->m_magic != s_headerMagic ) {
+		log( LOG_LOGIC, "mem: rmMem: Bad header. Unbalanced free or underrun. note=%s size=%zu.", note, size );
+		return false;
+	}
+
+	if ( checksize ) {
+		if ( hdr->m_size != size ) {
+			log( LOG_ERROR, "mem: rmMem: Freeing %zu should be %zu. (%s)", size, (size_t)hdr->m_size, note );
+			gbshutdownAbort(true);
+		}
+	} else
+		size = hdr->m_size;
+
+	if ( (size > MINMEM && g_conf.m_logDebugMemUsage) || size>=100000000 )
+		log(LOG_INFO,"mem: rmMem (%zu): ptr=0x%" PTRFMT" %s.",size,(PTRTYPE)mem,note);
+
+	if ( hdr->m_sampled )
+		MemCounters::rmSample(mem);
+
+	MemCounters::rmAlloc(hdr->m_labelId, size);
+
+	// so a double free is caught
+	hdr->m_magic = 0;
+
+	return true;
+}
+
+int Mem::printMemLight ( ) {
+	MemCounters::LabelStats *stats = (MemCounters::LabelStats *)sysmalloc ( sizeof(MemCounters::LabelStats) * MemCounters::s_maxLabels );
+	if ( ! stats ) return 0;
+
+	int32_t n = MemCounters::getLabelStats(stats, MemCounters::s_maxLabels);
+	for ( int32_t i = 0 ; i < n ; i++ )
+		log(LOG_INFO,"mem: %05" PRId32") %" PRId64" bytes in %" PRId64" allocs %s",
+		    i, stats[i].m_allocated, stats[i].m_numAllocs, stats[i].m_label);
+	sysfree ( stats );
+
+	int64_t used, numAllocated, numTotalAllocated;
+	MemCounters::getTotals(&used, &numAllocated, &numTotalAllocated);
+	log(LOG_INFO,"mem: Memory allocated now: %" PRId64".\n", used );
+	log(LOG_INFO,"mem: Num allocs %" PRId64".\n", numAllocated );
+	return 1;
+}
+
+static bool cmpLabelStats(const MemCounters::LabelStats &a, const MemCounters::LabelStats &b) {
+	return a.m_allocated > b.m_allocated;
+}
+
+static bool cmpSampleStack(const MemCounters::Sample &a, const MemCounters::Sample &b) {
+	if ( a.m_numFrames != b.m_numFrames ) return a.m_numFrames < b.m_numFrames;
+	return memcmp(a.m_frames, b.m_frames, a.m_numFrames * sizeof(void*)) < 0;
+}
+
+static bool sameSampleStack(const MemCounters::Sample &a, const MemCounters::Sample &b) {
+	return a.m_numFrames == b.m_numFrames &&
+	       memcmp(a.m_frames, b.m_frames, a.m_numFrames * sizeof(void*)) == 0;
+}
+
+// . print the label counters, then the sampled allocations grouped by
+//   call stack
+static bool printMemBreakdownTableLight(SafeBuf *sb) {
+	MemCounters::LabelStats *stats = (MemCounters::LabelStats *)mmalloc ( sizeof(MemCounters::LabelStats) * MemCounters::s_maxLabels, "Mem" );
+	if ( ! stats ) {
+		log(LOG_WARN, "admin: Could not alloc mem for mem table.");
+		return false;
+	}
+
+	int32_t n = MemCounters::getLabelStats(stats, MemCounters::s_maxLabels);
+	std::sort(stats, stats + n, cmpLabelStats);
+
+	for ( int32_t i = 0 ; i < n && i < PRINT_TOP ; i++ )
+		sb->safePrintf (
+			       "<tr bgcolor=%s>"
+			       "<td>%s</td>"
+			       "<td>%" PRId64"</td>"
+			       "<td>%" PRId64"</td>"
+			       "</tr>\n",
+			       LIGHT_BLUE,
+			       stats[i].m_label,
+			       stats[i].m_numAllocs,
+			       stats[i].m_allocated);
+
+	sb->safePrintf ( "</table>\n");
+
+	mfree ( stats , sizeof(MemCounters::LabelStats) * MemCounters::s_maxLabels , "Mem" );
+
+	int32_t rate = g_conf.m_memSampleRate;
+	int32_t numSamples = MemCounters::getNumSamples();
+	if ( rate <= 0 || numSamples <= 0 ) {
+		return true;
+	}
+
+	// a few may have been added since we asked
+	numSamples += 100;
+	MemCounters::Sample *samples = (MemCounters::Sample *)mmalloc ( sizeof(MemCounters::Sample) * numSamples, "Mem" );
+	if ( ! samples ) {
+		log(LOG_WARN, "admin: Could not alloc mem for sampled allocations.");
+		return false;
+	}
+	int32_t allocSamples = numSamples;
+	numSamples = MemCounters::getSamples(samples, numSamples);
+
+	// group by call stack, biggest first. the first one of each group
+	// gets the totals
+	std::sort(samples, samples + numSamples, cmpSampleStack);
+	struct StackTotal {
+		int32_t m_first;
+		int32_t m_count;
+		int64_t m_size;
+	};
+	std::vector<StackTotal> totals;
+	for ( int32_t i = 0 ; i < numSamples ; i++ ) {
+		if ( totals.empty() || ! sameSampleStack(samples[totals.back().m_first], samples[i]) ) {
+			StackTotal total = { i, 0, 0 };
+			totals.push_back(total);
+		}
+		totals.back().m_count++;
+		totals.back().m_size += samples[i].m_size;
+	}
+	std::sort(totals.begin(), totals.end(), [](const StackTotal &a, const StackTotal &b) { return a.m_size > b.m_size; });
+
+	sb->safePrintf (
+		       "<br>"
+		       "<table %s>"
+		       "<tr>"
+		       "<td colspan=4 bgcolor=#%s>"
+		       "<center><b>Sampled Allocations (1 in %" PRId32")</b></td></tr>\n"
+
+		       "<tr bgcolor=#%s>"
+		       "<td><b>allocator</b></td>"
+		       "<td><b>est. num allocs</b></td>"
+		       "<td><b>est. allocated</b></td>"
+		       "<td><b>stack</b></td>"
+		       "</tr>" ,
+		       TABLE_STYLE, DARK_BLUE, rate, DARK_BLUE );
+
+	for ( int32_t i = 0 ; i < (int32_t)totals.size() && i < PRINT_TOP ; i++ ) {
+		const MemCounters::Sample &sample = samples[totals[i].m_first];
+		char label[MemCounters::s_maxLabelLen + 1];
+		MemCounters::getLabel(sample.m_labelId, label);
+
+		sb->safePrintf (
+			       "<tr bgcolor=%s>"
+			       "<td>%s</td>"
+			       "<td>%" PRId64"</td>"
+			       "<td>%" PRId64"</td>"
+			       "<td>",
+			       LIGHT_BLUE,
+			       label,
+			       (int64_t)totals[i].m_count * rate,
+			       totals[i].m_size * rate);
+
+		// backtrace_symbols() uses the system malloc
+		char **symbols = backtrace_symbols ( sample.m_frames , sample.m_numFrames );
+		for ( int32_t j = 0 ; j < sample.m_numFrames ; j++ ) {
+			if ( symbols ) sb->htmlEncode ( symbols[j] );
+			else           sb->safePrintf ( "%p", sample.m_frames[j] );
+			sb->safePrintf ( "<br>" );
+		}
+		if ( symbols ) sysfree ( symbols );
+
+		sb->safePrintf ( "</td></tr>\n" );
+	}
+
+	sb->safePrintf ( "</table>\n");
+
+	mfree ( samples , sizeof(MemCounters::Sample) * allocSamples , "Mem" );
+
+	return true;
+}
+#endif
+
+
 class MemEntry {
 public:
 	int32_t  m_hash;
@@ -465,6 +780,10 @@ bool Mem::printMemBreakdownTable(SafeBuf *sb) {
 		       "</tr>" ,
 		       TABLE_STYLE, DARK_BLUE, DARK_BLUE );
 
+#ifdef LIGHT_MEM_ACCOUNTING
+	return printMemBreakdownTableLight(sb);
+#endif
+
 	int32_t n = m_numAllocated * 2;
 	MemEntry *e = (MemEntry *)mcalloc ( sizeof(MemEntry) * n , "Mem" );
 	if ( ! e ) {
@@ -624,6 +943,9 @@ bool Mem::lblMem( void *mem, size_t size, const char *note ) {
 
 // this is called just before a memory block is freed and needs to be deregistered
 bool Mem::rmMem(void *mem, size_t size, const char *note, bool checksize) {
+#ifdef LIGHT_MEM_ACCOUNTING
+	return rmMemLight ( mem , size , note , checksize );
+#endif
 	if(!s_lock.working) return true;
 	ScopedLock sl(s_lock);
 	logTrace( g_conf.m_logTraceMem, "mem=%p size=%zu note='%s'", mem, size, note );
@@ -875,6 +1197,7 @@ int Mem::printBreeches() {
 }
 
 int Mem::printBreeches_unlocked() {
+	// no table in LIGHT_MEM_ACCOUNTING builds
 	if ( ! s_mptrs ) return 0;
 	// do not bother if no padding at all
 	if ( (int32_t)UNDERPAD == 0 && (int32_t)OVERPAD == 0 ) return 0;
@@ -890,6 +1213,9 @@ int Mem::printBreeches_unlocked() {
 
 
 int Mem::printMem ( ) {
+#ifdef LIGHT_MEM_ACCOUNTING
+	return printMemLight();
+#endif
 	// has anyone breeched their buffer?
 	printBreeches_unlocked();
 
@@ -954,7 +1280,7 @@ void *Mem::gbmalloc ( size_t size , const char *note ) {
 		static int64_t s_lastTime;
 		static int32_t s_missed = 0;
 		int64_t now = gettimeofdayInMilliseconds();
-		int64_t avail = (int64_t)g_conf.m_maxMem - (int64_t)m_used;
+		int64_t avail = (int64_t)g_conf.m_maxMem - (int64_t)getUsedMem();
 		if ( now - s_lastTime >= 1000LL ) {
 			log(LOG_WARN, "mem: system malloc(%zu,%s) availShouldBe=%" PRId64": "
 			    "%s (%s) (ooms suppressed since last log msg = %" PRId32")",
@@ -1026,11 +1352,13 @@ void *Mem::gbrealloc ( void *ptr , size_t oldSize , size_t newSize , const char
 	if ( mem ) {
 		addMem ( (char *)mem + UNDERPAD , newSize , note , 0 );
 		char *returnMem = mem + UNDERPAD;
+#ifndef LIGHT_MEM_ACCOUNTING
 		// set magic char bytes for mem
 		for ( int32_t i = 0 ; i < UNDERPAD ; i++ )
 			returnMem[0-i-1] = MAGICCHAR;
 		for ( int32_t i = 0 ; i < OVERPAD ; i++ )
 			returnMem[0+newSize+i] = MAGICCHAR;
+#endif
 		return returnMem;
 	}
 
@@ -1067,7 +1395,9 @@ void *Mem::dup ( const void *data , size_t dataSize , const char *note ) {
 }
 
 void Mem::gbfree ( void *ptr , const char *note, size_t size , bool checksize ) {
+#ifndef LIGHT_MEM_ACCOUNTING
 	if(!s_lock.working) return;
+#endif
 
 	logTrace( g_conf.m_logTraceMem, "ptr=%p size=%zu note='%s'", ptr, size, note );
 
@@ -1075,6 +1405,13 @@ void Mem::gbfree ( void *ptr , const char *note, size_t size , bool checksize )
 		return;
 	}
 
+#ifdef LIGHT_MEM_ACCOUNTING
+	// new'd memory has the header too
+	if ( rmMemLight ( ptr , size , note , checksize ) )
+		sysfree ( (char *)ptr - UNDERPAD );
+	return;
+#endif
+
 	// . get how much it was from the mem table
 	// . this is used for alloc/free wrappers for zlib because it does
 	//   not give us a size to free when it calls our mfree(), so we use -1
@@ -5,6 +5,11 @@
 // . also calls mlockall() on construction to avoid swapping out any mem
 // . TODO: primealloc(int slotSize,int numSlots) :
 //         pre-allocs a table of these slots for faster mmalloc'ing
+// . by default every allocation is kept in a table so buffer breaches and
+//   leaks can be found. builds with LIGHT_MEM_ACCOUNTING ("make light_mem=1")
+//   instead keep lock free per-label counters (see MemCounters.h) and
+//   optionally samples 1 in "memory allocation sample rate" allocations
+//   with their call stack
 
 #ifndef GB_MEM_H
 #define GB_MEM_H
@@ -35,15 +40,15 @@ class Mem {
 	// this one does not include new/delete mem, only *alloc()/free() mem
 	size_t getUsedMem() const;
 	// the max mem ever allocated
-	size_t getMaxAllocated() const { return m_maxAllocated; }
-	size_t getMaxAlloc  () const { return m_maxAlloc; }
-	const char *getMaxAllocBy() const { return m_maxAllocBy; }
+	size_t getMaxAllocated() const;
+	size_t getMaxAlloc  () const;
+	const char *getMaxAllocBy() const;
 	// the max mem we can use!
 	size_t getMaxMem() const;
 
-	int32_t getNumAllocated() const { return m_numAllocated; }
+	int32_t getNumAllocated() const;
 
-	int64_t getNumTotalAllocated() const { return m_numTotalAllocated; }
+	int64_t getNumTotalAllocated() const;
 	
 	float getUsedMemPercentage() const;
 	int32_t getOOMCount() const { return m_outOfMems; }
@@ -87,6 +92,11 @@ private:
 
 	int printBreeches_unlocked();
 	int printBreech(int32_t i);
+
+	// LIGHT_MEM_ACCOUNTING versions
+	void addMemLight(void *mem, size_t size, const char *note, char isnew);
+	bool rmMemLight(void *mem, size_t size, const char *note, bool checksize);
+	int printMemLight();
 };
 
 extern class Mem g_mem;
@@ -0,0 +1,339 @@
+#include "MemCounters.h"
+#include <atomic>
+#include <pthread.h>
+#include <string.h>
+#include <stdint.h>
+#include <execinfo.h>
+
+
+using namespace MemCounters;
+
+static const int32_t s_numShards = 64;
+static const int32_t s_labelHashSize = 4 * s_maxLabels;
+static const int32_t s_labelCacheSize = 256;
+// a shard adds its pending used bytes to the estimate once they reach this
+static const int64_t s_flushBytes = 256 * 1024;
+static const int32_t s_maxSamples = 16384;
+
+// . all of these are zero-initialized statics. Mem is used by static
+//   constructors so nothing here may need a constructor to run first
+struct alignas(64) Shard {
+	std::atomic<int64_t> m_allocated[s_maxLabels];
+	std::atomic<int64_t> m_numAllocs[s_maxLabels];
+	std::atomic<int64_t> m_numTotalAllocs;
+	std::atomic<int64_t> m_pendingUsed;
+};
+
+static Shard s_shards[s_numShards];
+static std::atomic<int32_t> s_nextShard;
+static thread_local int32_t s_shard = -1;
+
+static std::atomic<int64_t> s_usedEstimate;
+static std::atomic<int64_t> s_maxUsedEstimate;
+static std::atomic<size_t> s_maxAlloc;
+static std::atomic<uint16_t> s_maxAllocLabelId;
+
+// label registry. s_labelHash holds label id + 1, 0 is empty
+static char s_labels[s_maxLabels][s_maxLabelLen + 1];
+static int32_t s_numLabels;
+static int16_t s_labelHash[s_labelHashSize];
+static pthread_mutex_t s_labelMtx = PTHREAD_MUTEX_INITIALIZER;
+
+struct LabelCacheEntry {
+	const char *m_note;
+	uint16_t    m_labelId;
+};
+static thread_local LabelCacheEntry s_labelCache[s_labelCacheSize];
+
+// sampled allocations. open addressed on the pointer, m_ptr NULL is empty
+static Sample s_samples[s_maxSamples];
+static int32_t s_numSamples;
+static pthread_mutex_t s_sampleMtx = PTHREAD_MUTEX_INITIALIZER;
+static thread_local int32_t s_sampleCount;
+
+
+static uint32_t hashLabel(const char *label) {
+	// fnv-1a. hash.cpp's tables may not be initialized yet
+	uint32_t h = 2166136261U;
+	for (const char *p = label; *p; p++) {
+		h ^= (unsigned char)*p;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static uint16_t lookupLabel(const char *note) {
+	char label[s_maxLabelLen + 1];
+	strncpy(label, note, s_maxLabelLen);
+	label[s_maxLabelLen] = '\0';
+
+	uint32_t h = hashLabel(label) % s_labelHashSize;
+
+	pthread_mutex_lock(&s_labelMtx);
+	while (s_labelHash[h]) {
+		int32_t labelId = s_labelHash[h] - 1;
+		if (strcmp(s_labels[labelId], label) == 0) {
+			pthread_mutex_unlock(&s_labelMtx);
+			return labelId;
+		}
+		if (++h == (uint32_t)s_labelHashSize) {
+			h = 0;
+		}
+	}
+
+	int32_t labelId;
+	if (s_numLabels < s_maxLabels - 1) {
+		labelId = s_numLabels++;
+		memcpy(s_labels[labelId], label, sizeof(label));
+		s_labelHash[h] = labelId + 1;
+	} else {
+		// out of labels. the rest is lumped together
+		labelId = s_maxLabels - 1;
+		if (s_numLabels < s_maxLabels) {
+			strcpy(s_labels[labelId], "other");
+			s_numLabels = s_maxLabels;
+		}
+	}
+	pthread_mutex_unlock(&s_labelMtx);
+
+	return labelId;
+}
+
+uint16_t MemCounters::getLabelId(const char *note) {
+	if (!note) {
+		note = "";
+	}
+
+	LabelCacheEntry *ce = &s_labelCache[((uintptr_t)note >> 3) % s_labelCacheSize];
+	// compare the text too as the note may be in a reused buffer
+	if (ce->m_note == note && strncmp(s_labels[ce->m_labelId], note, s_maxLabelLen) == 0) {
+		return ce->m_labelId;
+	}
+
+	uint16_t labelId = lookupLabel(note);
+	ce->m_note = note;
+	ce->m_labelId = labelId;
+	return labelId;
+}
+
+void MemCounters::getLabel(uint16_t labelId, char *buf) {
+	pthread_mutex_lock(&s_labelMtx);
+	memcpy(buf, s_labels[labelId % s_maxLabels], s_maxLabelLen + 1);
+	pthread_mutex_unlock(&s_labelMtx);
+}
+
+
+static Shard *getShard() {
+	if (s_shard < 0) {
+		s_shard = s_nextShard.fetch_add(1, std::memory_order_relaxed) % s_numShards;
+	}
+	return &s_shards[s_shard];
+}
+
+static void addUsed(Shard *shard, int64_t delta) {
+	int64_t pending = shard->m_pendingUsed.fetch_add(delta, std::memory_order_relaxed) + delta;
+	if (pending < s_flushBytes && pending > -s_flushBytes) {
+		return;
+	}
+
+	pending = shard->m_pendingUsed.exchange(0, std::memory_order_relaxed);
+	int64_t used = s_usedEstimate.fetch_add(pending, std::memory_order_relaxed) + pending;
+
+	int64_t maxUsed = s_maxUsedEstimate.load(std::memory_order_relaxed);
+	while (used > maxUsed && !s_maxUsedEstimate.compare_exchange_weak(maxUsed, used, std::memory_order_relaxed)) {
+	}
+}
+
+void MemCounters::addAlloc(uint16_t labelId, size_t size) {
+	Shard *shard = getShard();
+	shard->m_allocated[labelId].fetch_add(size, std::memory_order_relaxed);
+	shard->m_numAllocs[labelId].fetch_add(1, std::memory_order_relaxed);
+	shard->m_numTotalAllocs.fetch_add(1, std::memory_order_relaxed);
+	addUsed(shard, size);
+}
+
+void MemCounters::rmAlloc(uint16_t labelId, size_t size) {
+	// may be another shard than the one it was added to. only the sums
+	// over all shards are meaningful
+	Shard *shard = getShard();
+	shard->m_allocated[labelId].fetch_sub(size, std::memory_order_relaxed);
+	shard->m_numAllocs[labelId].fetch_sub(1, std::memory_order_relaxed);
+	addUsed(shard, -(int64_t)size);
+}
+
+int64_t MemCounters::getUsedEstimate() {
+	return s_usedEstimate.load(std::memory_order_relaxed);
+}
+
+int64_t MemCounters::getMaxUsedEstimate() {
+	return s_maxUsedEstimate.load(std::memory_order_relaxed);
+}
+
+void MemCounters::getTotals(int64_t *used, int64_t *numAllocated, int64_t *numTotalAllocated) {
+	int64_t pending = 0;
+	int64_t allocs = 0;
+	int64_t totalAllocs = 0;
+	for (int32_t i = 0; i < s_numShards; i++) {
+		const Shard &shard = s_shards[i];
+		pending += shard.m_pendingUsed.load(std::memory_order_relaxed);
+		totalAllocs += shard.m_numTotalAllocs.load(std::memory_order_relaxed);
+		for (int32_t j = 0; j < s_maxLabels; j++) {
+			allocs += shard.m_numAllocs[j].load(std::memory_order_relaxed);
+		}
+	}
+
+	if (used) *used = s_usedEstimate.load(std::memory_order_relaxed) + pending;
+	if (numAllocated) *numAllocated = allocs;
+	if (numTotalAllocated) *numTotalAllocated = totalAllocs;
+}
+
+void MemCounters::updateMaxAlloc(size_t size, uint16_t labelId) {
+	size_t maxAlloc = s_maxAlloc.load(std::memory_order_relaxed);
+	while (size > maxAlloc) {
+		if (s_maxAlloc.compare_exchange_weak(maxAlloc, size, std::memory_order_relaxed)) {
+			s_maxAllocLabelId.store(labelId, std::memory_order_relaxed);
+			break;
+		}
+	}
+}
+
+size_t MemCounters::getMaxAlloc() {
+	return s_maxAlloc.load(std::memory_order_relaxed);
+}
+
+uint16_t MemCounters::getMaxAllocLabelId() {
+	return s_maxAllocLabelId.load(std::memory_order_relaxed);
+}
+
+int32_t MemCounters::getLabelStats(LabelStats *stats, int32_t maxStats) {
+	pthread_mutex_lock(&s_labelMtx);
+	int32_t numLabels = s_numLabels;
+	pthread_mutex_unlock(&s_labelMtx);
+
+	int32_t n = 0;
+	for (int32_t j = 0; j < numLabels && n < maxStats; j++) {
+		int64_t allocated = 0;
+		int64_t numAllocs = 0;
+		for (int32_t i = 0; i < s_numShards; i++) {
+			allocated += s_shards[i].m_allocated[j].load(std::memory_order_relaxed);
+			numAllocs += s_shards[i].m_numAllocs[j].load(std::memory_order_relaxed);
+		}
+		if (numAllocs == 0 && allocated == 0) {
+			continue;
+		}
+		getLabel(j, stats[n].m_label);
+		stats[n].m_allocated = allocated;
+		stats[n].m_numAllocs = numAllocs;
+		n++;
+	}
+	return n;
+}
+
+
+static uint32_t getSampleSlot(const void *ptr) {
+	return (uint32_t)((((uintptr_t)ptr >> 4) * 0x9e3779b97f4a7c15ULL) >> 32) % s_maxSamples;
+}
+
+bool MemCounters::shouldSample(int32_t rate) {
+	if (rate <= 0) {
+		return false;
+	}
+	if (++s_sampleCount < rate) {
+		return false;
+	}
+	s_sampleCount = 0;
+	return true;
+}
+
+bool MemCounters::addSample(void *ptr, size_t size, uint16_t labelId) {
+	// skip ourselves and Mem::addMem()
+	void *frames[s_maxFrames + 2];
+	int numFrames = backtrace(frames, s_maxFrames + 2);
+	numFrames = numFrames > 2 ? numFrames - 2 : 0;
+
+	pthread_mutex_lock(&s_sampleMtx);
+	// keep the table sparse so chains stay short
+	if (s_numSamples >= s_maxSamples * 3 / 4) {
+		pthread_mutex_unlock(&s_sampleMtx);
+		return false;
+	}
+
+	uint32_t h = getSampleSlot(ptr);
+	while (s_samples[h].m_ptr) {
+		if (++h == (uint32_t)s_maxSamples) {
+			h = 0;
+		}
+	}
+
+	Sample *sample = &s_samples[h];
+	sample->m_ptr = ptr;
+	sample->m_size = size;
+	sample->m_labelId = labelId;
+	sample->m_numFrames = numFrames;
+	memcpy(sample->m_frames, frames + 2, numFrames * sizeof(void*));
+	s_numSamples++;
+	pthread_mutex_unlock(&s_sampleMtx);
+
+	return true;
+}
+
+void MemCounters::rmSample(void *ptr) {
+	pthread_mutex_lock(&s_sampleMtx);
+
+	uint32_t h = getSampleSlot(ptr);
+	while (s_samples[h].m_ptr && s_samples[h].m_ptr != ptr) {
+		if (++h == (uint32_t)s_maxSamples) {
+			h = 0;
+		}
+	}
+
+	if (!s_samples[h].m_ptr) {
+		pthread_mutex_unlock(&s_sampleMtx);
+		return;
+	}
+
+	s_samples[h].m_ptr = NULL;
+	s_numSamples--;
+
+	// move back the ones after us that may have chained over us
+	if (++h == (uint32_t)s_maxSamples) {
+		h = 0;
+	}
+	while (s_samples[h].m_ptr) {
+		uint32_t k = getSampleSlot(s_samples[h].m_ptr);
+		if (k != h) {
+			Sample sample = s_samples[h];
+			s_samples[h].m_ptr = NULL;
+			while (s_samples[k].m_ptr) {
+				if (++k == (uint32_t)s_maxSamples) {
+					k = 0;
+				}
+			}
+			s_samples[k] = sample;
+		}
+		if (++h == (uint32_t)s_maxSamples) {
+			h = 0;
+		}
+	}
+
+	pthread_mutex_unlock(&s_sampleMtx);
+}
+
+int32_t MemCounters::getSamples(Sample *samples, int32_t maxSamples) {
+	int32_t n = 0;
+	pthread_mutex_lock(&s_sampleMtx);
+	for (int32_t i = 0; i < s_maxSamples && n < maxSamples; i++) {
+		if (s_samples[i].m_ptr) {
+			samples[n++] = s_samples[i];
+		}
+	}
+	pthread_mutex_unlock(&s_sampleMtx);
+	return n;
+}
+
+int32_t MemCounters::getNumSamples() {
+	pthread_mutex_lock(&s_sampleMtx);
+	int32_t n = s_numSamples;
+	pthread_mutex_unlock(&s_sampleMtx);
+	return n;
+}
@@ -0,0 +1,69 @@
+#ifndef GB_MEMCOUNTERS_H
+#define GB_MEMCOUNTERS_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+// . memory accounting without the global allocation table of Mem
+// . counters are kept per allocation label in shards. each thread updates
+//   its own shard with relaxed atomics so allocating threads do not contend
+//   on a lock or a shared cache line
+// . optionally 1 in N allocations are sampled with their call stack
+// . used by Mem when built with LIGHT_MEM_ACCOUNTING (make light_mem=1). must
+//   not allocate through Mem itself
+namespace MemCounters {
+	// labels past this share the last id
+	static const int32_t s_maxLabels = 1024;
+	static const int32_t s_maxLabelLen = 15;
+	static const int32_t s_maxFrames = 8;
+
+	struct LabelStats {
+		char    m_label[s_maxLabelLen + 1];
+		int64_t m_allocated;
+		int64_t m_numAllocs;
+	};
+
+	struct Sample {
+		void    *m_ptr;
+		size_t   m_size;
+		uint16_t m_labelId;
+		int32_t  m_numFrames;
+		void    *m_frames[s_maxFrames];
+	};
+
+	// . id of the label "note". only the first s_maxLabelLen chars count
+	// . cached per thread so it is normally lock free
+	uint16_t getLabelId(const char *note);
+	// copy label into "buf" which must hold s_maxLabelLen+1 bytes
+	void getLabel(uint16_t labelId, char *buf);
+
+	void addAlloc(uint16_t labelId, size_t size);
+	void rmAlloc(uint16_t labelId, size_t size);
+
+	// . bytes in use. lags the real value by up to 256k per thread
+	// . cheap enough to be called for every allocation
+	int64_t getUsedEstimate();
+	int64_t getMaxUsedEstimate();
+
+	// exact totals, summed over the shards
+	void getTotals(int64_t *used, int64_t *numAllocated, int64_t *numTotalAllocated);
+
+	void updateMaxAlloc(size_t size, uint16_t labelId);
+	size_t getMaxAlloc();
+	uint16_t getMaxAllocLabelId();
+
+	// . fills "stats" with the labels that have memory allocated
+	// . returns the number of entries filled
+	int32_t getLabelStats(LabelStats *stats, int32_t maxStats);
+
+	// true for every "rate"th allocation of this thread. 0 disables
+	bool shouldSample(int32_t rate);
+	// . returns false if the sample table is full
+	bool addSample(void *ptr, size_t size, uint16_t labelId);
+	void rmSample(void *ptr);
+	// copy the live samples. returns the number copied
+	int32_t getSamples(Sample *samples, int32_t maxSamples);
+	int32_t getNumSamples();
+}
+
+#endif // GB_MEMCOUNTERS_H
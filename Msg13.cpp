@@ -923,6 +923,11 @@ void downloadTheDocForReals3b ( Msg13Request *r ) {
 	if ( maxDocLen2 < 0 || maxDocLen2 > MAX_ABSDOCLEN )
 		maxDocLen2 = MAX_ABSDOCLEN;
 
+	// . keep the connection to the webserver open if the hammer queue
+	//   will let the next download from this ip start before it idles out
+	bool keepAlive = ( g_conf.m_spiderKeepAlive &&
+			   r->m_crawlDelayMS < g_conf.m_spiderKeepAliveIdleTimeout );
+
 	// . download it
 	// . if m_proxyIp is non-zero it will make requests like:
 	//   GET http://xyz.com/abc
@@ -946,7 +951,8 @@ void downloadTheDocForReals3b ( Msg13Request *r ) {
 				     exactRequest , // our own mime!
 				     NULL , // postContent
 				     // this is NULL or '\0' if not there
-				     r->m_proxyUsernamePwdAuth ) ) {
+				     r->m_proxyUsernamePwdAuth ,
+				     keepAlive ) ) {
 		// return false if blocked
 		return;
 	}
@@ -1839,8 +1845,10 @@ void gotHttpReply2 ( void *state ,
 		g_stats.m_compressAllBytesOut += replySize;
 	}
 
-	// store reply in the cache (might be compressed)
-	if (r->m_maxCacheAge > 0) {
+	// . store reply in the cache (might be compressed)
+	// . a conditional GET may have gotten a 304 that only means something
+	//   to this requester
+	if (r->m_maxCacheAge > 0 && !r->m_ifModifiedSince) {
 		// get the cache
 		RdbCache *c = r->m_isRobotsTxt ? &s_httpCacheRobots : &s_httpCacheOthers;
 
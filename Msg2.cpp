@@ -5,6 +5,8 @@
 #include "Posdb.h" // getTermId()
 #include "Msg3a.h" // DEFAULT_POSDB_READ_SIZE
 #include "HighFrequencyTermShortcuts.h"
+#include "TruncatedTermlists.h"
+#include "RdbCache.h"
 #include "Sanity.h"
 #include "Conf.h"
 #include "ScopedLock.h"
@@ -22,6 +24,90 @@ static const int signature_init = 0x7e8a32f9;
 #define DEFAULT_POSDB_READSIZE 90000000
 
 
+RdbCache g_sharedTermlistCache;
+
+bool initSharedTermlistCache() {
+	int32_t maxMem = g_conf.m_bulkSearchTermlistCacheMem;
+	// also called when the parm changes, with bulk searches running
+	RdbCacheLock rcl(g_sharedTermlistCache);
+	if ( maxMem <= 0 ) {
+		g_sharedTermlistCache.reset();
+		return true;
+	}
+	// the lists are large, assume 10KB on average
+	int32_t maxNodes = maxMem / 10000 + 1;
+	if ( ! g_sharedTermlistCache.init ( maxMem   ,
+					   -1       , // variable data size
+					   maxNodes ,
+					   "sharedtermlists",
+					   false    , // load from disk?
+					   sizeof(key96_t),
+					   -1 ) ) {   // numPtrsMax
+		log("query: failed to init shared termlist cache: %s", mstrerror(g_errno));
+		g_errno = 0;
+		return false;
+	}
+	return true;
+}
+
+
+// the collection is part of the cache key already
+static key96_t makeSharedTermlistKey(int32_t fileId, int64_t termId, int64_t docIdStart, int64_t docIdEnd) {
+	key96_t k;
+	k.n1 = hash64(termId, hash64(docIdStart, docIdEnd));
+	k.n0 = (uint32_t)fileId;
+	return k;
+}
+
+
+// a record is the start and end key of the list followed by its data
+bool getSharedTermlist(collnum_t collnum, int32_t fileId, int64_t termId, int64_t docIdStart, int64_t docIdEnd,
+		       RdbList *list) {
+	key96_t k = makeSharedTermlistKey(fileId, termId, docIdStart, docIdEnd);
+	const int32_t ks = sizeof(posdbkey_t);
+
+	char *rec;
+	int32_t recSize;
+	{
+		RdbCacheLock rcl(g_sharedTermlistCache);
+		if ( ! g_sharedTermlistCache.getRecord(collnum, k, &rec, &recSize, true, -1, true) )
+			return false;
+	}
+	if ( recSize < 2*ks ) {
+		if ( rec ) mfree(rec, recSize, "RdbCache3");
+		return false;
+	}
+
+	list->set(rec + 2*ks,                 //list
+	          recSize - 2*ks,             //listSize
+	          rec,                        //alloc
+	          recSize,                    //allocSize
+	          rec,                        //startkey
+	          rec + ks,                   //endkey
+	          Posdb::getFixedDataSize(),
+	          true,                       //owndata
+	          Posdb::getUseHalfKeys(),
+	          Posdb::getKeySize());
+	return true;
+}
+
+
+void addSharedTermlist(collnum_t collnum, int32_t fileId, int64_t termId, int64_t docIdStart, int64_t docIdEnd,
+		       RdbList *list) {
+	key96_t k = makeSharedTermlistKey(fileId, termId, docIdStart, docIdEnd);
+	const int32_t ks = sizeof(posdbkey_t);
+	char keys[2*ks];
+	memcpy(keys, list->getStartKey(), ks);
+	memcpy(keys + ks, list->getEndKey(), ks);
+
+	RdbCacheLock rcl(g_sharedTermlistCache);
+	g_sharedTermlistCache.addRecord(collnum, (const char *)&k,
+	                                keys, sizeof(keys),
+	                                list->getList(), list->getListSize(),
+	                                0);
+}
+
+
 static int countWhitelistItems(const char *whitelist) {
 	if(!whitelist)
 		return 0;
@@ -49,6 +135,7 @@ Msg2::Msg2()
     m_numWhitelists(0),
     m_msg5(0),
     m_avail(0),
+    m_readFromFile(NULL),
     m_errno(0),
     m_lists(NULL),
     m_qterms(NULL),
@@ -57,6 +144,12 @@ Msg2::Msg2()
     m_addToCache(false),
     m_collnum(0),
     m_allowHighFrequencyTermCache(false),
+    m_allowTruncatedTermlists(false),
+    m_usedTruncatedTermlists(false),
+    m_maxDroppedSiteRank(-1),
+    m_droppedPostings(NULL),
+    m_shareTermlists(false),
+    m_fileId(-1),
     m_numReplies(0),
     m_numRequests(0),
     m_requestsBeingSubmitted(false),
@@ -90,6 +183,10 @@ void Msg2::reset ( ) {
 	m_msg5 = 0;
 	delete[] m_avail;
 	m_avail = 0;
+	delete[] m_readFromFile;
+	m_readFromFile = NULL;
+	delete[] m_droppedPostings;
+	m_droppedPostings = NULL;
 	m_lists = 0;
 	delete[] m_whiteLists;
 	m_whiteLists = NULL;
@@ -138,6 +235,8 @@ bool Msg2::getLists ( collnum_t collnum , // char    *coll        ,
 		      void    *state       ,
 		      void   (* callback)(void *state ) ,
 		      bool allowHighFrequencyTermCache,
+		      bool allowTruncatedTermlists,
+		      bool shareTermlists,
 		      int32_t     niceness    ,
 		      bool     isDebug ) {
 #ifdef _VALGRIND_
@@ -161,6 +260,16 @@ bool Msg2::getLists ( collnum_t collnum , // char    *coll        ,
 	m_docIdStart = docIdStart;
 	m_docIdEnd   = docIdEnd;
 	m_allowHighFrequencyTermCache = allowHighFrequencyTermCache;
+	m_allowTruncatedTermlists = allowTruncatedTermlists;
+	m_usedTruncatedTermlists = false;
+	m_maxDroppedSiteRank = -1;
+	m_shareTermlists = shareTermlists && g_sharedTermlistCache.isInitialized();
+	m_fileId = -1;
+	if ( m_fileNum >= 0 && (g_conf.m_truncatedTermlistsMaxMemory > 0 || m_shareTermlists) ) {
+		RdbBase *base = getRdbBase(RDB_POSDB, collnum);
+		if ( base )
+			m_fileId = base->getFileId(m_fileNum);
+	}
 	m_qterms              = qterms;
 	m_getComponents       = false;
 	m_addToCache          = addToCache;
@@ -179,6 +288,10 @@ bool Msg2::getLists ( collnum_t collnum , // char    *coll        ,
 	m_whiteLists = new RdbList[m_numWhitelists];
 	for ( int32_t i = 0; i < m_numLists+m_numWhitelists; i++ )
 		m_avail[i] = true;
+	m_readFromFile = new bool[m_numLists];
+	for ( int32_t i = 0; i < m_numLists; i++ )
+		m_readFromFile[i] = false;
+	m_droppedPostings = new PostingsSummary[m_numLists];
 		
 	if ( m_isDebug ) {
 		if ( m_getComponents ) log ("query: Getting components.");
@@ -284,6 +397,37 @@ bool Msg2::getLists ( ) {
 			continue;
 		}
 
+		// . if we truncated the list of a required term in this file
+		//   already then use that. it only has the best docids but
+		//   Msg39 reads the full lists if it does not get enough results
+		// . the other terms only contribute to the score so they are
+		//   always read in full
+		int32_t maxDroppedSiteRank;
+		if ( m_allowTruncatedTermlists &&
+		     qt->m_isRequired &&
+		     canUseTruncatedTermlists() &&
+		     g_truncatedTermlists.lookup(m_collnum, m_fileId, qt->m_termId, &m_lists[m_i], &maxDroppedSiteRank, &m_droppedPostings[m_i]) )
+		{
+			if ( m_isDebug )
+				log("query: using truncated termlist for termId=%" PRId64" from posdb file #%d "
+				    "maxDroppedSiteRank=%" PRId32,
+				    qt->m_termId, m_fileNum, maxDroppedSiteRank);
+			m_usedTruncatedTermlists = true;
+			if ( maxDroppedSiteRank > m_maxDroppedSiteRank )
+				m_maxDroppedSiteRank = maxDroppedSiteRank;
+			continue;
+		}
+
+		// another query of the bulk search read it already
+		if ( m_shareTermlists && m_fileId >= 0 &&
+		     getSharedTermlist(m_collnum, m_fileId, qt->m_termId, m_docIdStart, m_docIdEnd, &m_lists[m_i]) )
+		{
+			if ( m_isDebug )
+				log("query: using shared termlist for termId=%" PRId64" from posdb file #%d size=%" PRId32,
+				    qt->m_termId, m_fileNum, m_lists[m_i].getListSize());
+			continue;
+		}
+
 		Msg5 *msg5 = getAvailMsg5();
 		if(!msg5) gbshutdownLogicError();
 
@@ -294,6 +438,7 @@ bool Msg2::getLists ( ) {
 		// . this is really only used to get IndexLists
 		// . we now always compress the list for 2x faster transmits
 		if(m_fileNum>=0) {
+			m_readFromFile[m_i] = true;
 			incrementRequestCount();
 			if ( ! msg5->getSingleUnmergedList ( RDB_POSDB,
 							m_collnum,
@@ -511,6 +656,8 @@ void Msg2::gotListWrapper( Msg5 *msg5 ) {
 	bool done = incrementReplyCount();
 	if(!done)
 		return; //still more to go
+	addTruncatedTermlists();
+	addSharedTermlists();
 	// set g_errno if any one list read had error
 	if ( m_errno ) g_errno = m_errno;
 	// now call callback, we're done
@@ -558,9 +705,69 @@ bool Msg2::gotList() {
 		    i,m_lists[i].getListSize(),DEFAULT_POSDB_READSIZE);
 	}
 
+	addTruncatedTermlists();
+	addSharedTermlists();
+
 	// set this i guess
 	g_errno = m_errno;
 
 	// all done
 	return true;
 }
+
+
+const PostingsSummary *Msg2::getDroppedPostings(int32_t i) const {
+	return &m_droppedPostings[i];
+}
+
+
+// truncated lists are per posdb file and for the whole docid range
+bool Msg2::canUseTruncatedTermlists() const {
+	return m_fileId >= 0 &&
+	       m_docIdStart == 0 &&
+	       m_docIdEnd >= MAX_DOCID;
+}
+
+
+// . truncate the long lists of required terms we read in full so the next
+//   query with them can use the truncated ones
+// . the truncation walks the whole list so it is done in a job thread on a
+//   copy of the list, once per term and file
+void Msg2::addTruncatedTermlists() {
+	if ( m_errno || !canUseTruncatedTermlists() )
+		return;
+
+	for ( int32_t i = 0 ; i < m_numLists ; i++ ) {
+		const QueryTerm *qt = &m_qterms[i];
+		if ( qt->m_ignored || !qt->m_isRequired )
+			continue;
+		if ( m_lists[i].getListSize() < g_conf.m_truncatedTermlistsMinListSize )
+			continue;
+		// list came from the high-frequency term shortcuts or is a truncated one already
+		if ( g_hfts.is_registered_term(qt->m_termId) )
+			continue;
+		if ( g_truncatedTermlists.is_registered(m_collnum, m_fileId, qt->m_termId) )
+			continue;
+
+		log(LOG_DEBUG, "query: truncating termlist of termId=%" PRId64" size=%" PRId32" from posdb file #%d",
+		    qt->m_termId, m_lists[i].getListSize(), m_fileNum);
+		g_truncatedTermlists.insert_in_background(m_collnum, m_fileId, qt->m_termId, &m_lists[i],
+		                                          g_conf.m_truncatedTermlistsMaxDocIds);
+	}
+}
+
+
+// . keep the lists we read from the file for the next queries of the bulk
+//   search
+// . the tree changes all the time so its lists are not kept
+void Msg2::addSharedTermlists() {
+	if ( m_errno || !m_shareTermlists || m_fileId < 0 )
+		return;
+
+	for ( int32_t i = 0 ; i < m_numLists ; i++ ) {
+		if ( ! m_readFromFile[i] )
+			continue;
+		const QueryTerm *qt = &m_qterms[i];
+		addSharedTermlist(m_collnum, m_fileId, qt->m_termId, m_docIdStart, m_docIdEnd, &m_lists[i]);
+	}
+}
@@ -14,6 +14,8 @@
 
 
 class QueryTerm;
+class RdbCache;
+struct PostingsSummary;
 
 
 /**
@@ -61,6 +63,8 @@ public:
 			void *state,
 			void (*callback)(void *state),
 			bool allowHighFrequencyTermCache,
+			bool allowTruncatedTermlists,
+			bool shareTermlists,
 			int32_t niceness = MAX_NICENESS,
 			bool isDebug = false);
 
@@ -77,6 +81,14 @@ public:
 	int64_t docIdStart() const { return m_docIdStart; }
 	int64_t docIdEnd() const { return m_docIdEnd; }
 
+	// true if some of the lists are truncated ones from g_truncatedTermlists
+	bool usedTruncatedTermlists() const { return m_usedTruncatedTermlists; }
+	// highest siterank of the docids left out of those lists, -1 if none
+	int32_t getMaxDroppedSiteRank() const { return m_maxDroppedSiteRank; }
+	// what the postings left out of list "i" have, empty if it is not a
+	// truncated list
+	const PostingsSummary *getDroppedPostings(int32_t i) const;
+
 	int32_t getNumWhiteLists() const { return m_w; }
 	RdbList *getWhiteList(int32_t i) { return &(m_whiteLists[i]); }
 
@@ -100,9 +112,15 @@ private:
 
 	bool gotList();
 
+	bool canUseTruncatedTermlists() const;
+	void addTruncatedTermlists();
+
+	void addSharedTermlists();
+
 	// we can get up to MAX_QUERY_TERMS term frequencies at the same time
 	Msg5 *m_msg5;
 	bool *m_avail; // which msg5s are available?
+	bool *m_readFromFile; // which lists were read from posdb file m_fileNum?
 	GbMutex m_mtxMsg5;
 
 	int32_t m_errno;
@@ -116,6 +134,15 @@ private:
 	collnum_t m_collnum;
 
 	bool m_allowHighFrequencyTermCache;
+	bool m_allowTruncatedTermlists;
+	bool m_usedTruncatedTermlists;
+	int32_t m_maxDroppedSiteRank;
+	PostingsSummary *m_droppedPostings;
+	// keep the lists we read in g_sharedTermlistCache for the other
+	// queries of a bulk search, and use theirs
+	bool m_shareTermlists;
+	// id of posdb file m_fileNum
+	int32_t m_fileId;
 
 	int32_t m_numReplies;
 	int32_t m_numRequests;
@@ -139,4 +166,21 @@ private:
 	int64_t m_startTime;
 };
 
+
+// . the termlists bulk searches (PageBulkSearch.cpp) read from the posdb
+//   files, so the next queries of the batch with the same terms do not
+//   read them again
+// . keyed by posdb file id, termid and docid range
+extern RdbCache g_sharedTermlistCache;
+
+bool initSharedTermlistCache();
+
+// . set "list" to the list of "termId" in the docid range of posdb file
+//   "fileId" if a query read it already
+// . returns false if it is not in the cache
+bool getSharedTermlist(collnum_t collnum, int32_t fileId, int64_t termId, int64_t docIdStart, int64_t docIdEnd,
+		       RdbList *list);
+void addSharedTermlist(collnum_t collnum, int32_t fileId, int64_t termId, int64_t docIdStart, int64_t docIdEnd,
+		       RdbList *list);
+
 #endif // GB_MSG2_H
@@ -73,6 +73,17 @@ void Msg20::freeReply() {
 	m_r = NULL;
 }
 
+void Msg20::setReply(Msg20Reply *r, int32_t replyMaxSize) {
+	freeReply();
+
+	m_r            = r;
+	m_replySize    = replyMaxSize;
+	m_replyMaxSize = replyMaxSize;
+	m_ownReply     = true;
+	m_gotReply     = true;
+	m_errno        = 0;
+}
+
 void Msg20::reset() {
 	// not allowed to reset one in progress
 	if ( m_inProgress ) { 
@@ -152,6 +152,7 @@ public:
 	int32_t m_indexCode;
 	int32_t       m_contentLen          ; // was m_docLen
 	int32_t       m_contentHash32       ;  // for deduping diffbot json objects streaming
+	uint64_t      m_contentSimHash64    ;  // for deduping near-dups, 0 if unknown
 	int32_t       m_pageNumInlinks      ;
 	int32_t       m_pageNumGoodInlinks  ;
 	int32_t       m_pageNumUniqueIps    ; // includes our own inlinks
@@ -285,6 +286,11 @@ public:
 	// copy "src" to ourselves
 	void moveFrom(Msg20 *src);
 
+	// . use a reply made without sending a request, like Msg25 does
+	//   from anchordb
+	// . we mfree() it with "replyMaxSize" unless taken from m_r
+	void setReply ( Msg20Reply *r , int32_t replyMaxSize );
+
 	void gotReply ( class UdpSlot *slot );
 
 	// general purpose routines
@@ -20,6 +20,8 @@
 #include "ip.h"
 #include "Errno.h"
 #include "gbmemcpy.h"
+#include "Anchordb.h"
+#include <new>
 
 #ifdef _VALGRIND_
 #include <valgrind/memcheck.h>
@@ -45,8 +47,6 @@ static LinkInfo *makeLinkInfo(int32_t       ip,
 			      Msg25        *msg25,
 			      SafeBuf      *linkInfoBuf);
 
-static int32_t getNumWords(const char *s, int32_t len);
-
 
 // 1MB read size for now
 #define READSIZE 1000000
@@ -54,6 +54,7 @@ static int32_t getNumWords(const char *s, int32_t len);
 #define MAX_INTERNAL_INLINKS 10 
 
 static void gotListWrapper(void *state, RdbList *list, Msg5 *msg5);
+static void gotAnchorListWrapper(void *state, RdbList *list, Msg5 *msg5);
 static bool gotLinkTextWrapper(void *state);
 
 
@@ -86,6 +87,7 @@ Msg25::Msg25() {
 	m_top = 0;
 	m_midDomHash = 0;
 	m_gettingList = false;
+	m_gotAnchorList = false;
 	m_k = NULL;
 	m_maxNumLinkers = 0;
 	memset(&m_replyPtrs, 0, sizeof(m_replyPtrs));
@@ -145,6 +147,10 @@ void Msg25::reset() {
 	m_fullIpTable.reset();
 	m_firstIpTable.reset();
 	m_docIdTable.reset();
+
+	m_anchorList.freeList();
+	m_anchorTable.reset();
+	m_gotAnchorList = false;
 }
 
 
@@ -763,6 +769,15 @@ bool Msg25::doReadLoop() {
 		gbshutdownLogicError();
 	}
 
+	// . read the anchor text of our inlinkers first so sendRequests()
+	//   does not need a msg20 for those in anchordb
+	// . returns false if blocked
+	if (m_mode == MODE_PAGELINKINFO && m_round == 0 && !m_gotAnchorList && g_conf.m_useAnchordb) {
+		if (!getAnchorList()) {
+			return false;
+		}
+	}
+
 	// . get the top X results from this termlist
 	// . but skip link: terms with a 1 (no link text) for a score
 	// . these keys are ordered from lowest to highest
@@ -902,6 +917,111 @@ static void gotListWrapper(void *state, RdbList *list, Msg5 *msg5) {
 }
 
 
+// . read the anchordb records of our url
+// . returns false if blocked, true otherwise
+bool Msg25::getAnchorList() {
+	key128_t startKey = Anchordb::makeStartKey(hash32n(m_site), m_linkHash64);
+	key128_t endKey = Anchordb::makeEndKey(hash32n(m_site), m_linkHash64);
+
+	logDebug(g_conf.m_logDebugLinkInfo, "msg25: reading anchordb list site=%s url=%s docid=%" PRId64,
+	         m_site, m_url, m_docId);
+
+	m_gettingList = true;
+
+	// . same as the linkdb read in doReadLoop()
+	// . we only use what fits in READSIZE, the rest get a msg20
+	if (!m_msg5.getList(RDB_ANCHORDB,
+	                    m_collnum,
+	                    &m_anchorList,
+	                    (char *)&startKey,
+	                    (char *)&endKey,
+	                    READSIZE,
+	                    !m_req25->m_isInjecting, // includeTree
+	                    0,          // startFileNum
+	                    -1,         // numFiles
+	                    this,
+	                    gotAnchorListWrapper,
+	                    m_niceness,
+	                    true,       // error correct?
+	                    -1,         //maxRetries
+	                    false)) {   //isRealMerge
+		return false;
+	}
+
+	gotAnchorList();
+	return true;
+}
+
+
+static void gotAnchorListWrapper(void *state, RdbList *list, Msg5 *msg5) {
+	Msg25 *THIS = (Msg25 *) state;
+
+	THIS->gotAnchorList();
+
+	// . now read linkdb, same as gotListWrapper() from here on
+	if ( ! THIS->doReadLoop() )
+		return;
+
+	if ( THIS->m_numRequests > THIS->m_numReplies )
+		return;
+
+	if ( THIS->m_gettingList )
+		return;
+
+	THIS->m_callback ( THIS->m_state );
+}
+
+
+// . index the anchordb list by linker docid
+// . an error just means we use msg20s for every inlinker
+void Msg25::gotAnchorList() {
+	m_gettingList = false;
+	m_gotAnchorList = true;
+
+	if (g_errno) {
+		log(LOG_WARN, "build: Had error getting anchordb list of url %s : %s.", m_url, mstrerror(g_errno));
+		g_errno = 0;
+		m_anchorList.reset();
+		return;
+	}
+
+	if (m_anchorList.isEmpty()) {
+		return;
+	}
+
+	if (!m_anchorTable.set(8, 4, 256, NULL, 0, false, "msg25anch")) {
+		log(LOG_WARN, "build: could not allocate anchordb table of url %s", m_url);
+		g_errno = 0;
+		return;
+	}
+
+	for (m_anchorList.resetListPtr(); !m_anchorList.isExhausted(); m_anchorList.skipCurrentRecord()) {
+		// deletes are annihilated by msg5 but be safe
+		if (KEYNEG(m_anchorList.getCurrentRec())) {
+			continue;
+		}
+
+		const char *data = m_anchorList.getCurrentData();
+		int32_t dataSize = m_anchorList.getCurrentDataSize();
+		if (!AnchorRec::isValid(data, dataSize)) {
+			continue;
+		}
+
+		key128_t key;
+		m_anchorList.getCurrentKey(&key);
+		int64_t docId = Anchordb::getLinkerDocId(&key);
+		int32_t offset = (int32_t)(data - m_anchorList.getList());
+		if (!m_anchorTable.addKey(&docId, &offset)) {
+			g_errno = 0;
+			break;
+		}
+	}
+
+	logDebug(g_conf.m_logDebugLinkInfo, "msg25: got %" PRId32" anchordb recs for url=%s",
+	         m_anchorTable.getNumUsedSlots(), m_url);
+}
+
+
 // . this returns false if blocked, true otherwise
 // . sets g_errno on error
 bool Msg25::gotList() {
@@ -1323,6 +1443,32 @@ bool Msg25::sendRequests() {
 			continue;
 		}
 
+		// . use the anchordb record of the inlinker if we have one
+		// . same issues as the recycled ones above
+		const int32_t *anchorOffset = m_anchorTable.isEmpty() ? NULL : (const int32_t *)m_anchorTable.getValue(&docId);
+		if (anchorOffset) {
+			Msg20Reply *rep = (Msg20Reply *)mmalloc(sizeof(Msg20Reply), "msg25anch");
+			if (rep) {
+				new (rep) Msg20Reply();
+				const AnchorRec *ar = (const AnchorRec *)(m_anchorList.getList() + *anchorOffset);
+				ar->setMsg20Reply(rep, docId, m_doLinkSpamCheck);
+				m_msg20s[j].setReply(rep, sizeof(Msg20Reply));
+
+				logDebug(g_conf.m_logDebugLinkInfo, "msg25: using anchordb rec site=%s url=%s docid=%" PRId64,
+				         m_site, m_url, docId);
+
+				// . this returns true if we are done
+				// . g_errno is set on error, and true is returned
+				if (gotLinkText(r)) {
+					return true;
+				}
+
+				continue;
+			}
+			// fall back to a msg20
+			g_errno = 0;
+		}
+
 		logDebug(g_conf.m_logDebugLinkInfo, "msg25: getting single link mode=%s site=%s url=%s docid=%" PRId64" request=%" PRId32,
 		         m_mode == MODE_SITELINKINFO ? "site" : "page", m_site, m_url, docId, m_numRequests - 1);
 
@@ -2852,7 +2998,7 @@ static LinkInfo *makeLinkInfo(int32_t         ip,
 		// get approx # of words in link text
 		int32_t nw = 0;
 		if ( txtLen > 0 )
-			nw = getNumWords(txt,txtLen);
+			nw = getLinkTextNumWords(txt,txtLen);
 		// store it
 		r->m_linkTextNumWords = nw;
 		
@@ -3463,25 +3609,17 @@ bool Links::set(bool useRelNoFollow,
 	// get the <base href=> tag if any (12)
 	if ( baseUrl ) m_baseUrl = baseUrl;
 
-	// visit each node in the xml tree. a node can be a tag or a non-tag.
-	for ( int32_t i=0; i < m_numNodes ; i++ ) {
-		// . continue if this tag ain't an <a href> tag
-		// . atom feeds have a <link href=""> field in them
+	// . visit each node in the xml tree that may hold a link. Xml::set()
+	//   made the list: <a href>, <area>, atom feed <link href="">, ...
+	const int32_t *linkNodes = xml->getLinkNodes();
+	int32_t numLinkNodes = xml->getNumLinkNodes();
+	for ( int32_t k = 0; k < numLinkNodes ; k++ ) {
+		int32_t i = linkNodes[k];
 		int32_t id = xml->getNodeId ( i );
 
 		// reset
 		linkflags_t flags = 0;
 
-		if ( id != TAG_A         &&
-		     id != TAG_LINK      && // rss feed url
-		     id != TAG_LOC       && // sitemap.xml url
-		     id != TAG_AREA      &&
-		     id != TAG_ENCLOSURE &&
-		     id != TAG_WEBLOG    &&
-		     id != TAG_URLFROM   && //  <UrlFrom> for ahrefs.com
-		     id != TAG_FBORIGLINK )
-			continue;
-
 		const char *urlattr = "href";
 		if (id == TAG_WEBLOG) {
 			urlattr ="url";
@@ -5100,7 +5238,7 @@ int32_t getSiteRank(int32_t sni) {
 
 
 // . get the # of words in this string
-static int32_t getNumWords(const char *s, int32_t len) {
+int32_t getLinkTextNumWords(const char *s, int32_t len) {
 
 	int32_t wordCount = 0;
 	bool inWord   = false;
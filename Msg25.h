@@ -18,6 +18,9 @@ class UdpSlot;
 
 void  handleRequest25(UdpSlot *slot, int32_t netnice);
 
+// . the approximate # of words in a link text, Msg20Reply::m_linkTextNumWords
+int32_t getLinkTextNumWords(const char *s, int32_t len);
+
 
 // . get the inlinkers to this SITE (any page on this site)
 // . use that to compute a site quality
@@ -177,6 +180,8 @@ class Msg25 {
 	bool sendRequests();
 	bool gotLinkText(class Msg20Request *req);
 	bool doReadLoop();
+	bool getAnchorList();
+	void gotAnchorList();
 
 	// input vars
 	const char *m_url;
@@ -216,6 +221,13 @@ class Msg25 {
 	Msg5 m_msg5;
 	RdbList m_list;
 
+	// . the anchordb records of our url, read before the linkdb list
+	// . m_anchorTable maps a linker docid to the offset of its AnchorRec
+	//   in m_anchorList
+	RdbList      m_anchorList;
+	HashTableX   m_anchorTable;
+	bool         m_gotAnchorList;
+
 	Inlink *m_k;
 
 	int32_t      m_maxNumLinkers;
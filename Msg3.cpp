@@ -8,6 +8,7 @@
 #include "Sanity.h"
 #include "Conf.h"
 #include "Mem.h"
+#include "Warmup.h"
 #include "Errno.h"
 #include <new>
 
@@ -32,7 +33,8 @@ Msg3::Msg3()
   : m_scan(NULL),
     m_numScansStarted(0),
     m_numScansCompleted(0),
-    m_scansBeingSubmitted(false)
+    m_scansBeingSubmitted(false),
+    m_ioClass(io_class_unspecified)
 {
 //	log(LOG_TRACE,"Msg3(%p)::Msg3()",this);
 	set_signature();
@@ -381,6 +383,10 @@ bool Msg3::readList  ( rdbid_t           rdbId,
 	// Msg5 likes to get the endkey for getting the list from the tree
 	if ( justGetEndKey ) return true;
 
+	// remember what queries read so we can warm up with it after a restart
+	if ( m_niceness == 0 && ( m_rdbId == RDB_POSDB || m_rdbId == RDB_TITLEDB ) )
+		g_warmup.recordRead(m_rdbId, m_collnum, m_startKey, m_endKeyOrig, m_minRecSizesOrig);
+
 	Rdb *rdb = getRdbFromId(m_rdbId);
 	{
 		ScopedLock sl(m_mtxScanCounters);
@@ -583,6 +589,7 @@ bool Msg3::readList  ( rdbid_t           rdbId,
 		// . do the scan/read of file #i
 		// . this returns false if blocked, true otherwise
 		// . this will set g_errno on error
+		m_scan[i].m_scan.setIoClass(m_ioClass);
 		bool done = m_scan[i].m_scan.setRead(ff, base->getFixedDataSize(), offset, bytesToRead,
 		                                     startKey2, endKey2, m_ks, &m_scan[i].m_list,
 		                                     callback ? this : NULL,
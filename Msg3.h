@@ -71,6 +71,9 @@ class Msg3 {
 	int32_t         getNumLists() const { return m_numScansCompleted; }
 	bool            areAllScansCompleted() const;
 
+	// class of the disk reads for the job scheduler. Not cleared by reset()
+	void setIoClass(io_class_t ioClass) { m_ioClass = ioClass; }
+
 	bool isListChecked() const { return m_listsChecked; }
 	bool listHadCorruption() const { return m_hadCorruption; }
 	int32_t getFileNums() const { return m_numFileNums; }
@@ -154,6 +157,7 @@ private:
 	int32_t      m_minRecSizesOrig;
 
 	int32_t      m_niceness;
+	io_class_t   m_ioClass;
 
 	// last error received from doing all reads
 	int       m_errno;
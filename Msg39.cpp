@@ -14,7 +14,10 @@
 #include "Mem.h"
 #include "Errno.h"
 #include "GbSignature.h"
+#include "QueryPlanCache.h"
+#include "hash.h"
 #include <new>
+#include <algorithm>
 #include "ScopedLock.h"
 #include <pthread.h>
 #include <assert.h>
@@ -104,6 +107,7 @@ void Msg39Request::reset() {
 	m_collnum                 = -1;
 	m_useQueryStopWords       = true;
 	m_doMaxScoreAlgo          = true;
+	m_shareTermlists          = false;
 	m_modifyQuery             = false; //solution until we get msg39 to carry the whole query information
 	m_baseScoringParameters.clear();
 	ptr_query                 = NULL; // in utf8?
@@ -138,7 +142,9 @@ bool Msg39::registerHandler ( ) {
 
 
 Msg39::Msg39 ()
-  : m_lists(NULL),
+  : m_query(NULL),
+    m_queryPlanKey(0),
+    m_lists(NULL),
     m_clusterBuf(NULL)
 {
 	m_inUse = false;
@@ -154,8 +160,21 @@ Msg39::~Msg39 () {
 void Msg39::reset() {
 	if ( m_inUse ) gbshutdownLogicError();
 	//m_numDocIdSplits = 1;
-	m_query.reset();
+	if ( m_query ) {
+		if ( m_queryPlanKey ) {
+			g_queryPlanCache.checkin(m_queryPlanKey, m_query);
+		} else {
+			mdelete(m_query, sizeof(Query), "queryplan");
+			delete m_query;
+		}
+		m_query = NULL;
+		m_queryPlanKey = 0;
+	}
 	m_numTotalHits = 0;
+	m_allowTruncatedTermlists = true;
+	m_usedTruncatedTermlists = false;
+	m_maxDroppedSiteRank = -1;
+	m_maxTermMatchScore = 0.0;
 	m_gotClusterRecs = 0;
 	reset2();
 	if(m_clusterBuf) {
@@ -298,6 +317,37 @@ void Msg39::getDocIds ( UdpSlot *slot ) {
 }
 
 
+// . hash of everything Query::set() and Query::modifyQuery() look at, so a
+//   Query from g_queryPlanCache with this key is what we would have made
+// . the query string itself is compared by the cache
+static int64_t getQueryPlanKey(const Msg39Request *req, const CollectionRec *cr) {
+	float bigramWeight  = req->m_baseScoringParameters.m_bigramWeight;
+	float synonymWeight = req->m_baseScoringParameters.m_synonymWeight;
+	char flags[5];
+	flags[0] = req->m_useQueryStopWords;
+	flags[1] = req->m_allowHighFrequencyTermCache;
+	flags[2] = req->m_modifyQuery;
+	flags[3] = req->m_modifyQuery && cr->m_modifyDomainLikeSearches;
+	flags[3] |= (req->m_modifyQuery && cr->m_modifyAPILikeSearches) << 1;
+	// master parms, can be toggled while the plans are cached. the
+	// frequent phrases and high-frequency terms themselves are only
+	// loaded at startup
+	flags[4] = g_conf.m_useFrequentPhrases;
+	flags[4] |= g_conf.m_useHighFrequencyTermCache << 1;
+
+	uint64_t h = hash64n(req->ptr_query);
+	h = hash64((const char *)&req->m_language, sizeof(req->m_language), h);
+	h = hash64((const char *)&bigramWeight, sizeof(bigramWeight), h);
+	h = hash64((const char *)&synonymWeight, sizeof(synonymWeight), h);
+	h = hash64((const char *)&req->m_word_variations_config, sizeof(req->m_word_variations_config), h);
+	h = hash64((const char *)&req->m_maxQueryTerms, sizeof(req->m_maxQueryTerms), h);
+	h = hash64(flags, sizeof(flags), h);
+	// 0 means do not cache
+	if ( h == 0 ) h = 1;
+	return (int64_t)h;
+}
+
+
 void Msg39::coordinatorThreadFunc(void *state) {
 	Msg39 *that = static_cast<Msg39*>(state);
 	log(LOG_DEBUG, "query: msg39: in coordinatorThreadFunc: this=%p", that);
@@ -330,45 +380,68 @@ void Msg39::getDocIds2() {
 		return ; 
 	}
 
-	// . set our m_query instance
-	if ( !m_query.set(m_msg39req->ptr_query,
-	                  (lang_t)m_msg39req->m_language,
-	                  m_msg39req->m_baseScoringParameters.m_bigramWeight,
-	                  m_msg39req->m_baseScoringParameters.m_synonymWeight,
-	                  &m_msg39req->m_word_variations_config,
-	                  m_msg39req->m_useQueryStopWords,
-	                  m_msg39req->m_allowHighFrequencyTermCache,
-	                  m_msg39req->m_maxQueryTerms) ) {
-		log("query: msg39: setQuery: %s." , 
-		    mstrerror(g_errno) );
-		sendReply ( m_slot , this , NULL , 0 , 0 , true );
-		return ; 
-	}
-	if(m_debug)
-		m_query.dumpToLog();
+	int64_t queryPlanKey = getQueryPlanKey(m_msg39req, cr);
 
-	// wtf?
-	if ( g_errno ) gbshutdownLogicError();
-	
-	if(m_msg39req->m_modifyQuery) {
-		bool dont_care; //artifact because queries are parsed both at sender and on each shard.
-		DerivedScoringWeights dsw;
-		dsw.init(m_msg39req->m_baseScoringParameters);
-		m_query.modifyQuery(&dsw, *cr, &dont_care);
+	// . reuse the query terms, synonyms and word variations of the last
+	//   request for the same query if we still have them
+	m_query = g_queryPlanCache.checkout(queryPlanKey, m_msg39req->ptr_query);
+	if ( m_query ) {
+		if ( m_debug )
+			logf(LOG_DEBUG,"query: msg39: [%p] got cached query plan for q=%s", this, m_query->originalQuery());
+		m_queryPlanKey = queryPlanKey;
+	} else {
+		try {
+			m_query = new Query();
+		} catch(std::bad_alloc&) {
+			g_errno = ENOMEM;
+			log("query: msg39: new(%" PRId32"): %s", (int32_t)sizeof(Query), mstrerror(g_errno));
+			sendReply ( m_slot , this , NULL , 0 , 0 , true );
+			return ;
+		}
+		mnew(m_query, sizeof(Query), "queryplan");
+
+		// . set our m_query instance
+		if ( !m_query->set(m_msg39req->ptr_query,
+		                   (lang_t)m_msg39req->m_language,
+		                   m_msg39req->m_baseScoringParameters.m_bigramWeight,
+		                   m_msg39req->m_baseScoringParameters.m_synonymWeight,
+		                   &m_msg39req->m_word_variations_config,
+		                   m_msg39req->m_useQueryStopWords,
+		                   m_msg39req->m_allowHighFrequencyTermCache,
+		                   m_msg39req->m_maxQueryTerms) ) {
+			log("query: msg39: setQuery: %s." , 
+			    mstrerror(g_errno) );
+			sendReply ( m_slot , this , NULL , 0 , 0 , true );
+			return ; 
+		}
+
+		// wtf?
+		if ( g_errno ) gbshutdownLogicError();
+
+		if(m_msg39req->m_modifyQuery) {
+			bool dont_care; //artifact because queries are parsed both at sender and on each shard.
+			DerivedScoringWeights dsw;
+			dsw.init(m_msg39req->m_baseScoringParameters);
+			m_query->modifyQuery(&dsw, *cr, &dont_care);
+		}
+
+		m_queryPlanKey = queryPlanKey;
 	}
+	if(m_debug)
+		m_query->dumpToLog();
 
 	// set m_errno
-	if ( m_query.m_truncated ) m_errno = EQUERYTRUNCATED;
+	if ( m_query->m_truncated ) m_errno = EQUERYTRUNCATED;
 	// ensure matches with the msg3a sending us this request
-	if ( m_query.getNumTerms() != m_msg39req->m_nqt ) {
+	if ( m_query->getNumTerms() != m_msg39req->m_nqt ) {
 		g_errno = EBADENGINEER;
 		log(LOG_ERROR, "query: Query parsing inconsistency for q='%s'. %i != %i. "
 		    "langid=%d. Check langids and m_queryExpansion parms "
 		    "which are the only parms that could be different in "
 		    "Query::set2(). You probably have different mysynoyms.txt "
 		    "files on two different hosts! check that!!"
-		    ,m_query.originalQuery()
-		    ,(int)m_query.getNumTerms()
+		    ,m_query->originalQuery()
+		    ,(int)m_query->getNumTerms()
 		    ,(int)m_msg39req->m_nqt
 		    ,(int)m_msg39req->m_language
 		    );
@@ -377,13 +450,13 @@ void Msg39::getDocIds2() {
 	}
 
 	//set term frequencyweights based on msg39req
-	for(int i=0; i<m_query.getNumTerms(); i++)
-		m_query.m_qterms[i].m_termFreqWeight = ((float *)m_msg39req->ptr_termFreqWeights)[i];
+	for(int i=0; i<m_query->getNumTerms(); i++)
+		m_query->m_qterms[i].m_termFreqWeight = ((float *)m_msg39req->ptr_termFreqWeights)[i];
 
 	// debug
 	if ( m_debug )
 		logf(LOG_DEBUG,"query: msg39: [%p] Got request "
-		     "for q=%s", this,m_query.originalQuery());
+		     "for q=%s", this,m_query->originalQuery());
 
 	// reset this
 	m_toptree.reset();
@@ -419,6 +492,7 @@ void Msg39::controlLoop ( ) {
 	if(g_errno) //ugly logic due to C++ prohibited jump over local variable initialization
 		goto hadError;
 
+searchFiles:
 	for(int fileNum = 0; fileNum<numFiles+1; fileNum++) {
 		if(fileNum<numFiles && !base->isReadable(fileNum)) {
 			log(LOG_DEBUG,"posdb file #%d is not currently readable. Skipping", fileNum);
@@ -478,6 +552,11 @@ void Msg39::controlLoop ( ) {
 				log(LOG_ERROR,"Msg39::controlLoop: got error %d after intersectLists()", g_errno);
 				goto hadError;
 			}
+			if(m_msg2.usedTruncatedTermlists()) {
+				m_usedTruncatedTermlists = true;
+				m_maxDroppedSiteRank = std::max(m_maxDroppedSiteRank, m_msg2.getMaxDroppedSiteRank());
+			}
+			m_maxTermMatchScore = std::max(m_maxTermMatchScore, m_posdbTable.getMaxTermMatchScore());
 			
 			// Sum up stats
 			if ( m_posdbTable.m_t1 ) {
@@ -495,6 +574,20 @@ void Msg39::controlLoop ( ) {
 	}
 skipRest:
 
+	// the truncated termlists only have the best docids of each term. if
+	// that was not enough then start over with the full lists
+	if(m_usedTruncatedTermlists && !truncatedTermlistsAreEnough()) {
+		log(LOG_DEBUG,"query: msg39: truncated termlists are not enough. Reading full termlists");
+		m_allowTruncatedTermlists = false;
+		m_usedTruncatedTermlists = false;
+		m_maxDroppedSiteRank = -1;
+		m_maxTermMatchScore = 0.0;
+		m_toptree.reset();
+		m_numTotalHits = 0;
+		chunksSearched = 0;
+		goto searchFiles;
+	}
+
 	if(m_debug) {
 		log(LOG_DEBUG,"msg39::controlloop: dumping %d top nodes (before clustering)", m_toptree.getNumUsedNodes());
 		for(int ti = m_toptree.getHighNode(); ti >= 0; ti = m_toptree.getPrev(ti)) {
@@ -533,6 +626,36 @@ hadError:
 
 
 
+// . the truncated termlists only have the docids with the best static rank
+//   of each term, the ones left out have a siterank of at most
+//   m_maxDroppedSiteRank
+// . we stop early if those could not beat the last result we want even with
+//   the best term matches the postings left out of the lists allow, see
+//   PosdbTable::getMaxTermMatchScore()
+bool Msg39::truncatedTermlistsAreEnough() {
+	// . fewer results than wanted means some docid we left out could
+	//   have been one, so this is only a first check
+	// . having enough results does not prove they are the best ones, that
+	//   takes the score bound below
+	int32_t docsToGet = m_msg39req->m_docsToGet;
+	if(m_toptree.getNumUsedNodes() < docsToGet)
+		return false;
+	if(m_maxDroppedSiteRank < 0)
+		return true; //nothing was left out
+
+	float minScore = 0.0;
+	int32_t n = 0;
+	for(int32_t ti = m_toptree.getHighNode(); ti >= 0 && n < docsToGet; ti = m_toptree.getPrev(ti), n++)
+		minScore = m_toptree.getNode(ti)->m_score;
+
+	float maxDroppedScore = m_posdbTable.getMaxScoreForSiteRank(m_maxDroppedSiteRank, m_maxTermMatchScore);
+	log(LOG_DEBUG,"query: msg39: truncated termlists: score of result #%" PRId32"=%f, max score of left out docids=%f (siterank<=%" PRId32")",
+	    docsToGet, minScore, maxDroppedScore, m_maxDroppedSiteRank);
+	return maxDroppedScore < minScore;
+}
+
+
+
 // . returns false if blocked, true otherwise
 // . sets g_errno on error
 // . called either from 
@@ -547,7 +670,7 @@ void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
 
 	// . restrict to this docid?
 	// . will really make gbdocid:| searches much faster!
-	int64_t dr = m_query.m_docIdRestriction;
+	int64_t dr = m_query->m_docIdRestriction;
 	if ( dr ) {
 		docIdStart = dr;
 		docIdEnd   = dr + 1;
@@ -578,9 +701,9 @@ void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
 	//
 	// set startkey/endkey for each term/termlist
 	//
-	for ( int32_t i = 0 ; i < m_query.getNumTerms() ; i++ ) {
+	for ( int32_t i = 0 ; i < m_query->getNumTerms() ; i++ ) {
 		// get the term id
-		int64_t tid = m_query.getTermId(i);
+		int64_t tid = m_query->getTermId(i);
 
 		// debug
 		if ( m_debug )
@@ -591,23 +714,23 @@ void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
 			    , tid
 			    );
 		// store now in qterm
-		Posdb::makeStartKey ( m_query.m_qterms[i].m_startKey, tid, docIdStart );
-		Posdb::makeEndKey   ( m_query.m_qterms[i].m_endKey,   tid, docIdEnd   );
+		Posdb::makeStartKey ( m_query->m_qterms[i].m_startKey, tid, docIdStart );
+		Posdb::makeEndKey   ( m_query->m_qterms[i].m_endKey,   tid, docIdEnd   );
 	}
 
 	// debug msg
 	if ( m_debug || g_conf.m_logDebugQuery ) {
-		for ( int32_t i = 0 ; i < m_query.getNumTerms() ; i++ ) {
+		for ( int32_t i = 0 ; i < m_query->getNumTerms() ; i++ ) {
 			// get the term in utf8
 			//char bb[256];
-			const QueryTerm *qt = &m_query.m_qterms[i];
+			const QueryTerm *qt = &m_query->m_qterms[i];
 			//utf16ToUtf8(bb, 256, qt->m_term, qt->m_termLen);
 			//char *tpc = qt->m_term + qt->m_termLen;
 			char sign = qt->m_termSign;
 			if ( sign == 0 ) sign = '0';
 			const QueryWord *qw = qt->m_qword;
 			int32_t wikiPhrId = qw->m_wikiPhraseId;
-			if ( m_query.isPhrase(i) ) wikiPhrId = 0;
+			if ( m_query->isPhrase(i) ) wikiPhrId = 0;
 			char leftwikibigram = 0;
 			char rightwikibigram = 0;
 			if ( qt->m_leftPhraseTerm &&
@@ -637,9 +760,9 @@ void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
 			     this ,
 			     i          ,
 			     (int)qt->m_termLen, (int)qt->m_termLen, qt->m_term,
-			     (int32_t)m_query.isPhrase(i) ,
-			     m_query.getTermId(i) ,
-			     m_query.getRawTermId(i) ,
+			     (int32_t)m_query->isPhrase(i) ,
+			     m_query->getTermId(i) ,
+			     m_query->getRawTermId(i) ,
 			     ((float *)m_msg39req->ptr_termFreqWeights)[i] ,
 			     sign , //c
 			     (int32_t)qt->m_isRequired,
@@ -647,11 +770,11 @@ void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
 			     wikiPhrId,
 			     (int32_t)leftwikibigram,
 			     (int32_t)rightwikibigram,
-			     (int32_t)m_query.getTermLen(i) ,
+			     (int32_t)m_query->getTermLen(i) ,
 			     (isSynonym ? "true" : "false"),
-			     (int32_t)m_query.m_langId );
+			     (int32_t)m_query->m_langId );
 			if ( synterm ) {
-				unsigned stnum = (unsigned)(synterm - m_query.m_qterms);
+				unsigned stnum = (unsigned)(synterm - m_query->m_qterms);
 				sb.safePrintf("synofterm#=%u",stnum);
 				//sb.safeMemcpy(st->m_term,st->m_termLen);
 				sb.pushChar(' ');
@@ -668,7 +791,7 @@ void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
 	if ( m_debug ) 
 		log(LOG_DEBUG,"query: msg39: [%p] "
 		    "Getting %" PRId32" index lists ",
-		     this,m_query.getNumTerms());
+		     this,m_query->getNumTerms());
 	// . now get the index lists themselves
 	// . return if it blocked
 	// . not doing a merge (last parm) means that the lists we receive
@@ -682,7 +805,7 @@ void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
 	//   reindex bug
 
 
-	int32_t nqt = m_query.getNumTerms();
+	int32_t nqt = m_query->getNumTerms();
 	try {
 		m_lists = new RdbList[nqt];
 	} catch(std::bad_alloc&) {
@@ -696,8 +819,8 @@ void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
 	// call msg2
 	if ( ! m_msg2.getLists ( m_msg39req->m_collnum,
 				 m_msg39req->m_addToCache,
-				 m_query.m_qterms,
-				 m_query.getNumTerms(),
+				 m_query->m_qterms,
+				 m_query->getNumTerms(),
 				 m_msg39req->ptr_whiteList,
 				 // we need to restrict docid range for
 				 // whitelist as well! this is from
@@ -705,12 +828,14 @@ void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
 				 fileNum,
 				 docIdStart,
 				 docIdEnd,
-				 //m_query.getNumTerms(),
+				 //m_query->getNumTerms(),
 				 // 1-1 with query terms
 				 m_lists                    ,
 				 &jobState,                                 //state
 				 &JobFinishedCallback,                      //callback
 				 m_msg39req->m_allowHighFrequencyTermCache,
+				 m_allowTruncatedTermlists,
+				 m_msg39req->m_shareTermlists,
 				 m_msg39req->m_niceness,
 				 m_debug                      )) {
 		log(LOG_DEBUG,"m_msg2.getLists returned false - waiting for job to finish");
@@ -730,7 +855,7 @@ void Msg39::intersectLists(const DocumentIndexChecker &documentIndexChecker) {
 	if ( m_debug ) {
 		log(LOG_DEBUG,"query: msg39: [%p] "
 		    "Got %" PRId32" lists in %" PRId64" ms"
-		    , this,m_query.getNumTerms(),
+		    , this,m_query->getNumTerms(),
 		     gettimeofdayInMilliseconds() - m_startTime);
 		m_startTime = gettimeofdayInMilliseconds();
 	}
@@ -750,17 +875,17 @@ void Msg39::intersectLists(const DocumentIndexChecker &documentIndexChecker) {
 	// . it should weight them so much so that the summation of scores
 	//   from other query terms cannot make up for a lower date score
 	// . this will actually calculate the top
-	// . this might also change m_query.m_termSigns
+	// . this might also change m_query->m_termSigns
 	// . this won't do anything if it was already called
-	m_posdbTable.init ( &m_query, m_debug, &m_toptree, documentIndexChecker, &m_msg2, m_msg39req);
+	m_posdbTable.init ( m_query, m_debug, &m_toptree, documentIndexChecker, &m_msg2, m_msg39req);
 
 	// if msg2 had ALL empty lists we can cut it short
 	//todo: check if msg2 lists are all null or empty. If so then bail out
 		//estimateHitsAndSendReply ( );
 
 	// print query term bit numbers here
-	for ( int32_t i = 0 ; m_debug && i < m_query.getNumTerms() ; i++ ) {
-		const QueryTerm *qt = &m_query.m_qterms[i];
+	for ( int32_t i = 0 ; m_debug && i < m_query->getNumTerms() ; i++ ) {
+		const QueryTerm *qt = &m_query->m_qterms[i];
 		SafeBuf sb;
 		sb.safePrintf("query: msg39: BITNUM query term #%" PRId32" \"%*.*s\" "
 			      "termid=%" PRId64" bitnum=%" PRId32" ",
@@ -919,7 +1044,7 @@ bool Msg39::gotClusterRecs() {
 	if(!setClusterLevels(m_clusterRecs,
 			     m_clusterDocIds,
 			     m_numClusterDocIds,
-			     2,  // maxdocidsperhostname (todo: configurable)
+			     g_conf.m_maxDocIdsPerSite,
 			     m_msg39req->m_doSiteClustering,
 			     m_msg39req->m_familyFilter,
 			     m_debug,
@@ -976,7 +1101,7 @@ void Msg39::estimateHitsAndSendReply(double pctSearched) {
 		numDocIds = m_msg39req->m_docsToGet;
 
 	// # of QueryTerms in query
-	int32_t nqt = m_query.m_numTerms;
+	int32_t nqt = m_query->m_numTerms;
 
 	// make the reply
 	Msg39Reply mr;
@@ -1043,7 +1168,7 @@ void Msg39::estimateHitsAndSendReply(double pctSearched) {
 
 	// sanity
 	if(nqt!=m_msg2.getNumLists())
-		log("query: nqt mismatch for q=%s",m_query.originalQuery());
+		log("query: nqt mismatch for q=%s",m_query->originalQuery());
 
 	int32_t docCount = 0;
 	// loop over all results in the TopTree
@@ -1095,7 +1220,7 @@ void Msg39::estimateHitsAndSendReply(double pctSearched) {
 		    gettimeofdayInMilliseconds() - m_startTime ,
 		    m_msg39req->m_docsToGet                       ,
 		    numDocIds                         ,
-		    m_query.getQuery());
+		    m_query->getQuery());
 	}
 
 	// now send back the reply
@@ -54,6 +54,7 @@ class Msg39Request {
 	char    m_realMaxTop;
 	bool    m_useQueryStopWords;
 	bool    m_allowHighFrequencyTermCache;
+	bool    m_shareTermlists;
 	bool    m_doMaxScoreAlgo;
 
 	bool    m_modifyQuery;
@@ -154,8 +155,11 @@ private:
 	void intersectLists(const DocumentIndexChecker &documentIndexChecker);
 
 	// . this is used by handler to reconstruct the incoming Query class
-	// . TODO: have a serialize/deserialize for Query class
-	Query       m_query;
+	// . it comes from g_queryPlanCache if we parsed the same query lately
+	//   and goes back there when we are done, m_queryPlanKey is 0 if it
+	//   is not worth keeping
+	Query      *m_query;
+	int64_t     m_queryPlanKey;
 
 	// used to get IndexLists all at once
 	Msg2        m_msg2;
@@ -187,6 +191,14 @@ private:
 
 	int64_t  m_numTotalHits;
 
+	// . we try the truncated termlists first. if they do not give us
+	//   m_docsToGet results, or the docids left out of them could score
+	//   better, we search again with the full lists
+	bool     m_allowTruncatedTermlists;
+	bool     m_usedTruncatedTermlists;
+	int32_t  m_maxDroppedSiteRank;
+	float    m_maxTermMatchScore;
+
 	int32_t        m_clusterBufSize;
 	char       *m_clusterBuf;
 	int64_t  *m_clusterDocIds;
@@ -198,6 +210,7 @@ private:
 	bool        m_gotClusterRecs;
 
 	void        controlLoop();
+	bool        truncatedTermlistsAreEnough();
 	static void intersectListsThreadFunction(void *state);
 
 	void        estimateHitsAndSendReply(double pctSearched);
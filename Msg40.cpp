@@ -4,6 +4,7 @@
 #include "sort.h"
 #include "matches2.h"
 #include "XmlDoc.h" // computeSimilarity()
+#include "SimHash.h"
 #include "Speller.h"
 #include "Wiki.h"
 #include "HttpServer.h"
@@ -19,6 +20,8 @@
 #include "Mem.h"
 #include "ScopedLock.h"
 #include "Errno.h"
+#include "SearchCursors.h"
+#include "hash.h"
 #include <new>
 
 
@@ -82,6 +85,10 @@ Msg40::Msg40()
 	m_num3aRequests = 0;
 	m_num3aReplies = 0;
 	m_firstCollnum = 0;
+	m_wantCursor = false;
+	m_cursorToken = 0;
+	m_servedFromCursor = false;
+	m_firstResultNum = 0;
 }
 
 void Msg40::resetBuf2 ( ) {
@@ -139,6 +146,9 @@ bool Msg40::getResults ( SearchInput *si      ,
 
 	m_lastProcessedi = -1;
 	m_didSummarySkip = false;
+	m_wantCursor = false;
+	m_cursorToken = 0;
+	m_servedFromCursor = false;
 
 	m_si             = si;
 	m_state          = state;
@@ -188,8 +198,32 @@ bool Msg40::getResults ( SearchInput *si      ,
 		log(LOG_DEBUG,"msg40: limiting docs-offset from %d to %d", m_si->m_firstResultNum, g_conf.m_maxFirstResultNum);
 		m_si->m_firstResultNum = g_conf.m_maxFirstResultNum;
 	}
+	m_firstResultNum = m_si->m_firstResultNum;
+
+	// . "&cursor=new" keeps the results for the next pages and
+	//   "&cursor=<token>" gets the page from them, see SearchCursors.h
+	// . not for docids-only queries, they do not get to the clustering
+	// . not when searching several collections at once either
+	if ( m_si->m_cursor && m_si->m_cursor[0] && ! m_si->m_docIdsOnly &&
+	     m_si->m_collnumBuf.length() == (int32_t)sizeof(collnum_t) ) {
+		m_wantCursor = true;
+		// "new" gives 0
+		m_cursorToken = strtoull ( m_si->m_cursor , NULL , 10 );
+		if ( m_cursorToken && getDocIdsFromCursor() )
+			return gotDocIds();
+	}
+
 	// how many docids do we need to get?
 	int32_t get = m_si->m_docsWanted + m_si->m_firstResultNum ;
+	// get a few pages more for the cursor so the next pages can come
+	// from it
+	if ( m_wantCursor ) {
+		int32_t pages = g_conf.m_searchCursorPages;
+		if ( pages < 1 ) pages = 1;
+		int64_t cursorGet = m_si->m_firstResultNum + (int64_t)m_si->m_docsWanted * pages;
+		if ( cursorGet > MAXDOCIDSTOCOMPUTE ) cursorGet = MAXDOCIDSTOCOMPUTE;
+		if ( cursorGet > get ) get = cursorGet;
+	}
 	// we get one extra for so we can set m_moreToFollow so we know
 	// if more docids can be gotten (i.e. show a "Next 10" link)
 	get++;
@@ -337,6 +371,7 @@ bool Msg40::federatedLoop ( ) {
 	mr.m_word_variations_config    = m_si->m_word_variations_config;
 	mr.m_familyFilter              = m_si->m_familyFilter        ;
 	mr.m_allowHighFrequencyTermCache = m_si->m_allowHighFrequencyTermCache;
+	mr.m_shareTermlists            = m_si->m_shareTermlists;
 	mr.m_language                  = (unsigned char)m_si->m_queryLangId;
 	mr.ptr_query                   = const_cast<char*>(m_si->m_q.originalQuery());
 	mr.size_query                  = strlen(m_si->m_q.originalQuery())+1;
@@ -482,7 +517,9 @@ bool Msg40::gotDocIds ( ) {
 	if ( ! mergeDocIdsIntoBaseMsg3a() )
 		log("msg40: error: %s",mstrerror(g_errno));
 
-	adjustRankingBasedOnFlags();
+	// a cursor slice was adjusted before it was stored
+	if ( ! m_servedFromCursor )
+		adjustRankingBasedOnFlags();
 
 	// log the time it took for cache lookup
 	int64_t now  = gettimeofdayInMilliseconds();
@@ -625,6 +662,97 @@ bool Msg40::mergeDocIdsIntoBaseMsg3a() {
 }
 
 
+// . fill m_msg3a with the slice of the cursor we want instead of searching
+// . returns false if the cursor cannot give us the page
+bool Msg40::getDocIdsFromCursor() {
+	SearchCursors::Slice slice;
+	// one more to know if more results follow
+	if ( ! g_searchCursors.lookup ( m_cursorToken, m_firstCollnum, m_si->getResultSetHash(),
+					m_si->m_firstResultNum, m_si->m_docsWanted + 1, &slice ) )
+		return false;
+
+	m_msg3a.reset();
+
+	int32_t nd = (int32_t)slice.docids.size();
+	int32_t need = 0;
+	need += nd * 8;
+	need += nd * sizeof(double);
+	need += nd * sizeof(unsigned);
+	need += nd * sizeof(key96_t);
+	need += nd * 1;
+	need += nd * sizeof(collnum_t);
+	if ( need ) {
+		m_msg3a.m_finalBuf = (char *)mmalloc ( need , "Msg3aF" );
+		if ( ! m_msg3a.m_finalBuf ) {
+			// just search
+			g_errno = 0;
+			return false;
+		}
+		m_msg3a.m_finalBufSize = need;
+	}
+	char *p = m_msg3a.m_finalBuf;
+	m_msg3a.m_docIds        = (int64_t *)p; p += nd * 8;
+	m_msg3a.m_scores        = (double    *)p; p += nd * sizeof(double);
+	m_msg3a.m_flags         = (unsigned*)p; p += nd * sizeof(unsigned);
+	m_msg3a.m_clusterRecs   = (key96_t     *)p; p += nd * sizeof(key96_t);
+	m_msg3a.m_clusterLevels = (char      *)p; p += nd * 1;
+	m_msg3a.m_scoreInfos    = NULL;
+	m_msg3a.m_collnums      = (collnum_t *)p; p += nd * sizeof(collnum_t);
+	if ( p - m_msg3a.m_finalBuf != need ) { g_process.shutdownAbort(true); }
+
+	for ( int32_t i = 0 ; i < nd ; i++ ) {
+		m_msg3a.m_docIds[i]        = slice.docids[i];
+		m_msg3a.m_scores[i]        = slice.scores[i];
+		m_msg3a.m_flags[i]         = slice.flags[i];
+		m_msg3a.m_clusterRecs[i].setMin();
+		m_msg3a.m_clusterLevels[i] = CR_OK;
+		m_msg3a.m_collnums[i]      = m_firstCollnum;
+	}
+	m_msg3a.m_numDocIds = nd;
+	m_msg3a.m_numTotalEstimatedHits = slice.num_total_hits;
+	m_msg3a.m_pctSearched = slice.pct_searched;
+	m_msg3a.m_moreDocIdsAvail = false;
+	m_msg3a.m_msg39req.m_collnum = m_firstCollnum;
+
+	// no msg3a to wait for
+	m_num3aRequests = 0;
+	m_num3aReplies = 0;
+
+	// the slice starts at the result # they want
+	m_servedFromCursor = true;
+	m_firstResultNum = 0;
+
+	if ( m_si->m_debug || g_conf.m_logDebugQuery )
+		logf(LOG_DEBUG,"query: msg40: [%p] Got %" PRId32" docids from cursor %" PRIu64,
+		     this, nd, m_cursorToken);
+	return true;
+}
+
+
+// . keep the visible docids we got summaries for under m_cursorToken, or
+//   a new token if we do not have that one
+// . the ones before m_firstResultNum are visible if we skipped their
+//   summaries, like the clipping in gotEnoughSummaries() assumes
+void Msg40::storeCursor() {
+	std::vector<int64_t> docIds;
+	std::vector<double> scores;
+	std::vector<unsigned> flags;
+	int32_t numJudged = m_numReplies;
+	if ( numJudged > m_msg3a.m_numDocIds ) numJudged = m_msg3a.m_numDocIds;
+	for ( int32_t i = 0 ; i < numJudged ; i++ ) {
+		if ( m_msg3a.m_clusterLevels[i] != CR_OK ) continue;
+		docIds.push_back ( m_msg3a.m_docIds[i] );
+		scores.push_back ( m_msg3a.m_scores[i] );
+		flags.push_back ( m_msg3a.m_flags[i] );
+	}
+	bool more = numJudged < m_msg3a.m_numDocIds || m_msg3a.m_moreDocIdsAvail;
+
+	m_cursorToken = g_searchCursors.store ( m_cursorToken, m_firstCollnum, m_si->getResultSetHash(),
+						docIds.data(), scores.data(), flags.data(), (int32_t)docIds.size(),
+						m_msg3a.getNumTotalEstimatedHits(), m_msg3a.m_pctSearched, more );
+}
+
+
 //adjust the order of the results based on the flags of the documents
 void Msg40::adjustRankingBasedOnFlags() {
 	int *rank = (int*)mmalloc(m_msg3a.m_numDocIds * sizeof(int), "ranksort");
@@ -847,17 +975,17 @@ bool Msg40::launchMsg20s(bool recalled) {
 	     ! m_si->m_doSiteClustering &&
 	     m_lastProcessedi == -1 ) {
 		// start getting summaries with the result # they want
-		m_lastProcessedi = m_si->m_firstResultNum-1;
+		m_lastProcessedi = m_firstResultNum-1;
 		// assume we printed the summaries before
-		m_printi = m_si->m_firstResultNum;
-		m_numDisplayed = m_si->m_firstResultNum;
+		m_printi = m_firstResultNum;
+		m_numDisplayed = m_firstResultNum;
 		// fake this so Msg40::gotSummary() can let us finish
 		// because it checks m_numRequests <  m_msg3a.m_numDocIds
-		m_numRequests = m_si->m_firstResultNum;
-		m_numReplies  = m_si->m_firstResultNum;
+		m_numRequests = m_firstResultNum;
+		m_numReplies  = m_firstResultNum;
 		m_didSummarySkip = true;
 		log("query: skipping summary generation of first %" PRId32" docs",
-		    m_si->m_firstResultNum);
+		    m_firstResultNum);
 	}
 
 	// . launch a msg20 getSummary() for each docid
@@ -1224,7 +1352,7 @@ bool Msg40::gotSummaries() {
 	for ( int32_t i = 0 ; i < m_numReplies ; i++ ) {
 		// did we skip the first X summaries because we were
 		// not deduping/siteclustering/gettingGigabits?
-		if ( m_didSummarySkip && i < m_si->m_firstResultNum )
+		if ( m_didSummarySkip && i < m_firstResultNum )
 			continue;
 		// get current cluster level
 		char *level = &m_msg3a.m_clusterLevels[i];
@@ -1325,6 +1453,67 @@ bool Msg40::gotSummaries() {
 	// if the user only requested docids, we have no summaries
 	if ( m_si->m_docIdsOnly ) dedupPercent = 0;
 
+	// . max bits the content simhashes may differ in, -1 means do not
+	//   dedup by simhash
+	// . pairs the simhash did not flag still go through the summary
+	//   comparison below
+	int32_t dedupDistance = -1;
+	if ( m_si->m_doDupContentRemoval && ! m_si->m_includeCachedCopy && ! m_si->m_docIdsOnly )
+		dedupDistance = m_si->m_simHashDedupDistance;
+	if ( dedupDistance > SIMHASH_MAX_DISTANCE )
+		dedupDistance = SIMHASH_MAX_DISTANCE;
+
+	// . filter out near-dup results by simhash
+	// . each result we keep adds its simhash bands to the table, so a
+	//   near-dup of it shares at least one band and we only compare with
+	//   the results in those slots
+	HashTableX bandTable;
+	if ( dedupDistance >= 0 && ! bandTable.set ( 8, 4, m_numReplies * SIMHASH_NUM_BANDS * 2, NULL, 0, true, "simhashbands" ) )
+		dedupDistance = -1;
+	for ( int32_t i = 0 ; dedupDistance >= 0 && i < m_numReplies ; i++ ) {
+		char *level = &m_msg3a.m_clusterLevels[i];
+		// skip if already invisible
+		if ( *level != CR_OK ) continue;
+		// Skip if invalid
+		if ( m_msg20[i]->m_errno ) continue;
+
+		const Msg20Reply *mri = m_msg20[i]->m_r;
+		uint64_t shi = mri->m_contentSimHash64;
+		if ( ! shi ) continue;
+
+		int32_t dupOf = -1;
+		for ( int32_t b = 0 ; b < SIMHASH_NUM_BANDS && dupOf < 0 ; b++ ) {
+			uint64_t bandKey = SimHash::getBandKey ( shi, b );
+			for ( int32_t slot = bandTable.getSlot ( &bandKey ) ; slot >= 0 ; slot = bandTable.getNextSlot ( slot, &bandKey ) ) {
+				int32_t m = *(int32_t *)bandTable.getValueFromSlot ( slot );
+				if ( SimHash::getDistance ( shi, m_msg20[m]->m_r->m_contentSimHash64 ) <= dedupDistance ) {
+					dupOf = m;
+					break;
+				}
+			}
+		}
+
+		if ( dupOf >= 0 ) {
+			if ( m_si->m_debug || g_conf.m_logDebugQuery )
+				logf( LOG_DEBUG, "query: result #%" PRId32" (docid=%" PRId64") is %" PRId32" bits from simhash of #%" PRId32" (docid=%" PRId64")",
+				      i, m_msg3a.m_docIds[i],
+				      SimHash::getDistance ( shi, m_msg20[dupOf]->m_r->m_contentSimHash64 ),
+				      dupOf, m_msg3a.m_docIds[dupOf] );
+			*level = CR_DUP_SUMMARY;
+			continue;
+		}
+
+		for ( int32_t b = 0 ; b < SIMHASH_NUM_BANDS ; b++ ) {
+			uint64_t bandKey = SimHash::getBandKey ( shi, b );
+			if ( ! bandTable.addKey ( &bandKey, &i ) ) {
+				// just fall back to the summaries
+				g_errno = 0;
+				dedupDistance = -1;
+				break;
+			}
+		}
+	}
+
 	// filter out duplicate/similar summaries
 	for ( int32_t i = 0 ; dedupPercent && i < m_numReplies ; i++ ) {
 		// skip if already invisible
@@ -1618,11 +1807,15 @@ bool Msg40::gotEnoughSummaries() {
 
 
 	// set m_moreToCome, if true, we print a "Next 10" link
-	m_moreToCome = (visible > m_si->m_docsWanted+m_si->m_firstResultNum);
+	m_moreToCome = (visible > m_si->m_docsWanted+m_firstResultNum);
 	if ( m_si->m_debug || g_conf.m_logDebugQuery ) {
 		logf( LOG_DEBUG, "query: msg40: more? %d", m_moreToCome );
 	}
 
+	// keep the visible results for the next pages
+	if ( m_wantCursor && ! m_servedFromCursor )
+		storeCursor();
+
 	// alloc m_buf, which should be NULL
 	if ( m_buf ) { g_process.shutdownAbort(true); }
 
@@ -1647,7 +1840,7 @@ bool Msg40::gotEnoughSummaries() {
 	for ( int32_t i = 0 ; i < m_msg3a.m_numDocIds ; i++ ) {
 		// must ahve a cluster level of CR_OK (visible)
 		// v is the visible count
-		if ( ( m_msg3a.m_clusterLevels[i] != CR_OK ) || ( v++ < m_si->m_firstResultNum ) ) {
+		if ( ( m_msg3a.m_clusterLevels[i] != CR_OK ) || ( v++ < m_firstResultNum ) ) {
 			// skip
 			continue;
 		}
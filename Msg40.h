@@ -88,6 +88,9 @@ public:
 	}
 
 	bool  moreResultsFollow() const { return m_moreToCome; }
+
+	// result-set cursor of the query, 0 if none. see SearchCursors.h
+	uint64_t getCursorToken() const { return m_cursorToken; }
 	time_t getCachedTime() const { return m_cachedTime; }
 
 	int32_t m_numMsg20sOut ;
@@ -172,6 +175,16 @@ public:
 	HashTableT<uint64_t, uint64_t> m_urlTable;
 
 private:
+	bool getDocIdsFromCursor();
+	void storeCursor();
+
+	bool         m_wantCursor;
+	uint64_t     m_cursorToken;
+	// m_msg3a only has the slice of the cursor we want
+	bool         m_servedFromCursor;
+	// # of the first result we want in m_msg3a's docids
+	int32_t      m_firstResultNum;
+
 	int64_t      m_deadline; //deadline for providing a result, even if empty. (not completely enforced yet)
 
 	int32_t      m_numRealtimeClassificationsStarted;
@@ -339,7 +339,7 @@ static bool Msg4In::addMetaList(const char *p, UdpSlot *slot) {
 	for (auto const &rdbItem : rdbItems) {
 		if(rdbItem.first!=RDB_SPIDERDB_DEPRECATED && rdbItem.first!=RDB2_SPIDERDB2_DEPRECATED && rdbItem.first!=RDB_SITEDEFAULTPAGETEMPERATURE) {
 			Rdb *rdb = getRdbFromId(rdbItem.first);
-			if (rdb->isDumping()) {
+			if (rdb->isDumpBlockingAdds()) {
 				anyDumping = true;
 			} else if (!rdb->hasRoom(rdbItem.second.m_numRecs, rdbItem.second.m_dataSizes)) {
 				rdb->submitRdbDumpJob(true);
@@ -52,6 +52,7 @@ Msg5::Msg5()
 	m_oldListSize = 0;
 	m_maxRetries = 0;
 	m_isRealMerge = false;
+	m_ioClass = io_class_unspecified;
 	m_ks = 0;
 	m_collnum = 0;
 	m_errno = 0;
@@ -333,6 +334,8 @@ bool Msg5::readList ( ) {
 		if ( niceness > 0  ) niceness = 2;
 		if ( m_isRealMerge ) niceness = 1;
 
+		m_msg3.setIoClass(m_isRealMerge ? io_class_merge : m_ioClass);
+
 		if ( compute ) {
 			m_msg3.readList  ( m_rdbId          ,
 					   m_collnum        ,
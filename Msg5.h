@@ -73,6 +73,10 @@ class Msg5 {
 
 	bool isWaitingForList() const { return m_waitingForList; }
 
+	// . class of the disk reads for the job scheduler
+	// . real merges always read as io_class_merge
+	void setIoClass(io_class_t ioClass) { m_ioClass = ioClass; }
+
 	int32_t minRecSizes() const { return m_minRecSizes; }
 
 	declare_signature
@@ -161,6 +165,7 @@ private:
 	int32_t m_maxRetries;
 
 	bool        m_isRealMerge;
+	io_class_t  m_ioClass;
 
 	char m_ks;
 
@@ -0,0 +1,415 @@
+#include "Pages.h"
+#include "PageResults.h"
+#include "Collectiondb.h"
+#include "HttpServer.h"
+#include "TcpSocket.h"
+#include "SafeBuf.h"
+#include "Json.h"
+#include "Lang.h"
+#include "utf8_fast.h"
+#include "fctypes.h"
+#include "GbUtil.h"
+#include "FxLanguage.h"
+#include "Conf.h"
+#include "Mem.h"
+#include "Errno.h"
+#include "Log.h"
+
+// . run a batch of queries in one request, for offline evaluation and for
+//   replaying query logs: POST to /admin/bulksearch with "queries" holding
+//   one query per line. a line is either the plain query or a json object
+//   like {"id":"42","q":"hello world"}
+// . the other cgi parms (c, n, fx_qlang, ...) apply to every query
+// . the queries go through SearchInput and Msg40 just like in PageResults,
+//   but at most "concurrency" of them run at a time, capped by
+//   g_conf.m_bulkSearchMaxConcurrentQueries, so a replay does not crowd out
+//   the live queries
+// . the reply is a stream of json lines, one per query, sent as the queries
+//   complete. so they are not in input order, use "line" or "id" to match
+//   them up
+
+
+class BulkSearchState;
+
+// Msg40 casts its state to a State0
+class BulkQuery : public State0 {
+public:
+	BulkQuery() : m_bulk(NULL), m_lineNum(0), m_id(), m_query() {}
+
+	BulkSearchState *m_bulk;
+	int32_t m_lineNum;
+	SafeBuf m_id;
+	SafeBuf m_query;
+};
+
+class BulkSearchState {
+public:
+	BulkSearchState()
+		: m_socket(NULL)
+		, m_socketStartTimeHack(0)
+		, m_parms()
+		, m_queries()
+		, m_next(NULL)
+		, m_lineNum(0)
+		, m_maxOut(1)
+		, m_numOut(0)
+		, m_numDone(0)
+		, m_launching(false)
+		, m_sending(false)
+		, m_socketHadError(false)
+		, m_pending() {
+	}
+
+	TcpSocket *m_socket;
+	int64_t m_socketStartTimeHack;
+
+	// the cgi parms shared by all queries, url encoded
+	SafeBuf m_parms;
+
+	SafeBuf m_queries;
+	// next line in m_queries
+	const char *m_next;
+	int32_t m_lineNum;
+
+	int32_t m_maxOut;
+	int32_t m_numOut;
+	int32_t m_numDone;
+	bool m_launching;
+
+	// true while a chunk is on its way to the client
+	bool m_sending;
+	bool m_socketHadError;
+
+	// json lines waiting to be sent
+	SafeBuf m_pending;
+};
+
+
+static void launchQueries(BulkSearchState *bs);
+static void launchQuery(BulkSearchState *bs, const char *line, int32_t lineLen);
+static void gotResultsWrapper(void *state);
+static void gotResults(BulkQuery *bq);
+static void sendPending(BulkSearchState *bs);
+static void doneSendingWrapper(void *state, TcpSocket *sock);
+
+
+bool sendPageBulkSearch ( TcpSocket *s , HttpRequest *hr ) {
+	int32_t queriesLen = 0;
+	const char *queries = hr->getString("queries", &queriesLen, NULL);
+	if ( ! queries || queriesLen <= 0 )
+		return g_httpServer.sendErrorReply(s, 400, "No queries given");
+
+	if ( ! g_conf.m_queryingEnabled )
+		return g_httpServer.sendErrorReply(s, 500, mstrerror(EQUERYINGDISABLED));
+
+	BulkSearchState *bs;
+	try {
+		bs = new BulkSearchState();
+	} catch(std::bad_alloc&) {
+		g_errno = ENOMEM;
+		log(LOG_ERROR, "bulksearch: Could not allocate %" PRId32" bytes.", (int32_t)sizeof(BulkSearchState));
+		return g_httpServer.sendErrorReply(s, 500, mstrerror(g_errno));
+	}
+	mnew(bs, sizeof(BulkSearchState), "BulkSearch");
+
+	bs->m_socket = s;
+	// record timestamp so we know if we got our socket closed and swapped
+	bs->m_socketStartTimeHack = s->m_startTime;
+
+	// the parms every query gets
+	for ( int32_t i = 0; i < hr->getNumFields(); i++ ) {
+		const char *field = hr->getField(i);
+		const char *value = hr->getValue(i);
+		if ( ! value ) continue;
+		if ( strcmp(field, "queries") == 0 ) continue;
+		if ( strcmp(field, "concurrency") == 0 ) continue;
+		if ( strcmp(field, "q") == 0 ) continue;
+		if ( strcmp(field, "format") == 0 ) continue;
+		bs->m_parms.safePrintf("&%s=", field);
+		urlEncode(&bs->m_parms, value);
+	}
+
+	if ( ! bs->m_queries.safeMemcpy(queries, queriesLen) || ! bs->m_queries.nullTerm() ) {
+		mdelete(bs, sizeof(BulkSearchState), "BulkSearch");
+		delete bs;
+		return g_httpServer.sendErrorReply(s, 500, mstrerror(g_errno));
+	}
+	bs->m_next = bs->m_queries.getBufStart();
+
+	int32_t maxOut = g_conf.m_bulkSearchMaxConcurrentQueries;
+	if ( maxOut < 1 ) maxOut = 1;
+	bs->m_maxOut = hr->getLong("concurrency", maxOut);
+	if ( bs->m_maxOut > maxOut ) bs->m_maxOut = maxOut;
+	if ( bs->m_maxOut < 1 ) bs->m_maxOut = 1;
+
+	log(LOG_INFO, "bulksearch: running queries with concurrency %" PRId32, bs->m_maxOut);
+
+	// . no content-length, the client reads until we close the socket
+	// . TcpServer keeps the socket open after each chunk in streaming mode
+	bs->m_pending.safePrintf("HTTP/1.0 200 OK\r\n"
+				 "Content-Type: application/x-ndjson; charset=utf-8\r\n"
+				 "Connection: Close\r\n"
+				 "\r\n");
+	s->m_streamingMode = true;
+
+	launchQueries(bs);
+	sendPending(bs);
+	return false;
+}
+
+
+// did the client close the socket on us and the descriptor got re-used?
+static bool lostSocket(BulkSearchState *bs) {
+	if ( bs->m_socket && bs->m_socket->m_startTime != bs->m_socketStartTimeHack ) {
+		log("bulksearch: lost control of socket. sd=%i", (int)bs->m_socket->m_sd);
+		bs->m_socketHadError = true;
+		bs->m_socket = NULL;
+	}
+	return bs->m_socketHadError;
+}
+
+
+static void launchQueries(BulkSearchState *bs) {
+	bs->m_launching = true;
+
+	while ( bs->m_numOut < bs->m_maxOut && *bs->m_next && ! lostSocket(bs) ) {
+		const char *line = bs->m_next;
+		const char *end = strchr(line, '\n');
+		if ( ! end ) end = line + strlen(line);
+		bs->m_next = *end ? end + 1 : end;
+		bs->m_lineNum++;
+
+		int32_t lineLen = end - line;
+		while ( lineLen > 0 && is_wspace_a(line[lineLen-1]) ) lineLen--;
+		while ( lineLen > 0 && is_wspace_a(*line) ) { line++; lineLen--; }
+		if ( lineLen == 0 ) continue;
+
+		launchQuery(bs, line, lineLen);
+	}
+
+	bs->m_launching = false;
+}
+
+
+static void launchQuery(BulkSearchState *bs, const char *line, int32_t lineLen) {
+	BulkQuery *bq;
+	try {
+		bq = new BulkQuery();
+	} catch(std::bad_alloc&) {
+		log(LOG_ERROR, "bulksearch: Could not allocate %" PRId32" bytes for query.", (int32_t)sizeof(BulkQuery));
+		bs->m_pending.safePrintf("{\"line\":%" PRId32",\"error\":\"%s\"}\n", bs->m_lineNum, mstrerror(ENOMEM));
+		return;
+	}
+	mnew(bq, sizeof(BulkQuery), "BulkQuery");
+
+	bq->m_bulk = bs;
+	bq->m_lineNum = bs->m_lineNum;
+	bs->m_numOut++;
+
+	if ( *line == '{' ) {
+		SafeBuf jsonBuf;
+		jsonBuf.safeMemcpy(line, lineLen);
+		jsonBuf.nullTerm();
+		Json jp;
+		jp.parseJsonStringIntoJsonItems(jsonBuf.getBufStart());
+		JsonItem *ji = jp.getItem((char *)"id");
+		if ( ji ) {
+			int32_t idLen = 0;
+			const char *id = ji->getValueAsString(&idLen);
+			if ( id ) bq->m_id.safeMemcpy(id, idLen);
+		}
+		ji = jp.getItem((char *)"q");
+		if ( ! ji || ji->m_type != JT_STRING ) {
+			bq->m_errno = EBADREQUEST;
+			gotResults(bq);
+			return;
+		}
+		bq->m_query.safeMemcpy(ji->getValue(), ji->getValueLen());
+	} else {
+		bq->m_query.safeMemcpy(line, lineLen);
+	}
+	bq->m_query.nullTerm();
+
+	// the query parms, as if the client had asked /search for it
+	SafeBuf req;
+	req.safePrintf("GET /search?q=");
+	urlEncode(&req, bq->m_query.getBufStart(), bq->m_query.length());
+	req.safeMemcpy(&bs->m_parms);
+	req.safePrintf("&format=json HTTP/1.0\r\n\r\n");
+	if ( g_errno || ! bq->m_hr.set(req.getBufStart(), req.length(), bs->m_socket) ) {
+		bq->m_errno = g_errno ? g_errno : EBADREQUEST;
+		gotResults(bq);
+		return;
+	}
+
+	// . no external language detection server, replaying thousands of
+	//   queries would flood it
+	// . the fx_qlang hint is honoured like in PageResults
+	const char *fx_qlang = bq->m_hr.getString("fx_qlang", NULL, "");
+	if ( getLangIdFromAbbr(fx_qlang) == langUnknown ) fx_qlang = "";
+	const char *fx_country = bq->m_hr.getString("fx_country", NULL, "");
+	bq->m_primaryQueryLanguage = FxLanguage::getLangIdCLD2(true, bq->m_query.getBufStart(), bq->m_query.length(),
+	                                                       fx_qlang, strlen(fx_qlang),
+	                                                       fx_country, strlen(fx_country), true);
+
+	// . the socket is only for the admin checks of SearchInput::set()
+	// . State0::m_socket stays NULL so Msg40 does not stream the results
+	//   on ours
+	if ( ! bq->m_si.set(bs->m_socket, &bq->m_hr, bq->m_primaryQueryLanguage, {}) ) {
+		bq->m_errno = g_errno ? g_errno : EBADENGINEER;
+		gotResults(bq);
+		return;
+	}
+	bq->m_si.m_shareTermlists = true;
+	bq->m_collnum = bq->m_si.m_cr ? bq->m_si.m_cr->m_collnum : -1;
+	bq->m_startTime = gettimeofdayInMilliseconds();
+
+	bq->m_gotResults = bq->m_msg40.getResults(&bq->m_si, false, bq, gotResultsWrapper);
+	bq->m_errno = g_errno;
+	if ( ! bq->m_gotResults ) return;
+	gotResults(bq);
+}
+
+
+static void gotResultsWrapper(void *state) {
+	BulkQuery *bq = (BulkQuery *)state;
+	bq->m_errno = g_errno;
+	bq->m_gotResults = true;
+	gotResults(bq);
+}
+
+
+// print the json line of the query and launch the next one
+static void gotResults(BulkQuery *bq) {
+	BulkSearchState *bs = bq->m_bulk;
+	SafeBuf *sb = &bs->m_pending;
+	Msg40 *msg40 = &bq->m_msg40;
+	SearchInput *si = &bq->m_si;
+
+	bq->m_took = bq->m_startTime ? gettimeofdayInMilliseconds() - bq->m_startTime : 0;
+
+	int32_t err = bq->m_errno;
+	if ( ! err && bq->m_gotResults && ! msg40->m_msg20 && ! si->m_docIdsOnly && msg40->m_errno )
+		err = msg40->m_errno;
+
+	sb->safePrintf("{\"line\":%" PRId32, bq->m_lineNum);
+	if ( bq->m_id.length() ) {
+		sb->safePrintf(",\"id\":\"");
+		sb->jsonEncode(bq->m_id.getBufStart(), bq->m_id.length());
+		sb->safePrintf("\"");
+	}
+	sb->safePrintf(",\"query\":\"");
+	sb->jsonEncode(bq->m_query.getBufStart(), bq->m_query.length());
+	sb->safePrintf("\"");
+
+	if ( err ) {
+		sb->safePrintf(",\"error\":\"");
+		sb->jsonEncode(mstrerror(err));
+		sb->safePrintf("\"}\n");
+	} else {
+		sb->safePrintf(",\"took\":%" PRId64",\"totalHits\":%" PRId64,
+			       bq->m_took, msg40->getNumTotalHits());
+		if ( msg40->m_msg3a.m_skippedShards > 0 )
+			sb->safePrintf(",\"skippedShards\":%" PRId32, msg40->m_msg3a.m_skippedShards);
+		sb->safePrintf(",\"results\":[");
+
+		// don't print more than docsWanted results, like PageResults
+		int32_t numResults = msg40->getNumResults();
+		int32_t count = msg40->getDocsWanted();
+		for ( int32_t i = 0; count > 0 && i < numResults; i++, count-- ) {
+			if ( i > 0 ) sb->pushChar(',');
+			sb->safePrintf("{\"docId\":%" PRId64",\"score\":%f",
+				       msg40->getDocId(i), (float)msg40->getScore(i));
+			const Msg20Reply *mr = ! si->m_docIdsOnly && msg40->m_msg20 ? msg40->m_msg20[i]->m_r : NULL;
+			if ( mr && mr->ptr_ubuf ) {
+				sb->safePrintf(",\"url\":\"");
+				sb->jsonEncode(mr->ptr_ubuf);
+				sb->safePrintf("\"");
+			}
+			if ( mr && mr->ptr_tbuf ) {
+				sb->safePrintf(",\"title\":\"");
+				sb->jsonEncode(mr->ptr_tbuf);
+				sb->safePrintf("\"");
+			}
+			sb->pushChar('}');
+		}
+		sb->safePrintf("]}\n");
+	}
+
+	mdelete(bq, sizeof(BulkQuery), "BulkQuery");
+	delete bq;
+
+	bs->m_numOut--;
+	bs->m_numDone++;
+
+	// when called from launchQueries() it goes on by itself
+	if ( bs->m_launching ) return;
+
+	launchQueries(bs);
+	sendPending(bs);
+}
+
+
+static void sendPending(BulkSearchState *bs) {
+	// wait for the chunk in flight
+	if ( bs->m_sending ) return;
+
+	if ( lostSocket(bs) ) {
+		// wait for the queries still out, they point to us
+		if ( bs->m_numOut > 0 ) return;
+		log("bulksearch: socket error after %" PRId32" queries", bs->m_numDone);
+		mdelete(bs, sizeof(BulkSearchState), "BulkSearch");
+		delete bs;
+		return;
+	}
+
+	bool done = bs->m_numOut == 0 && ! *bs->m_next;
+	if ( ! done && bs->m_pending.length() == 0 ) return;
+
+	TcpSocket *s = bs->m_socket;
+
+	if ( done ) {
+		log(LOG_INFO, "bulksearch: ran %" PRId32" queries", bs->m_numDone);
+		// . the last chunk, TcpServer closes the socket when it is sent
+		// . sendChunk() takes the buffer so we can go away now
+		s->m_streamingMode = false;
+		g_httpServer.m_tcp.sendChunk(s, &bs->m_pending, NULL, NULL);
+		g_errno = 0;
+		mdelete(bs, sizeof(BulkSearchState), "BulkSearch");
+		delete bs;
+		return;
+	}
+
+	// returns false if it blocked
+	if ( ! g_httpServer.m_tcp.sendChunk(s, &bs->m_pending, bs, doneSendingWrapper) ) {
+		bs->m_sending = true;
+		return;
+	}
+
+	// sendMsg() destroyed the socket on a write error
+	if ( g_errno ) {
+		log("bulksearch: got tcp error: %s", mstrerror(g_errno));
+		g_errno = 0;
+		bs->m_socketHadError = true;
+		bs->m_socket = NULL;
+	}
+}
+
+
+static void doneSendingWrapper(void *state, TcpSocket *sock) {
+	BulkSearchState *bs = (BulkSearchState *)state;
+	bs->m_sending = false;
+
+	// client closed the socket midstream? TcpServer does not destroy a
+	// streaming socket, so we do it
+	if ( g_errno ) {
+		log("bulksearch: streaming socket had error: %s", mstrerror(g_errno));
+		g_errno = 0;
+		bs->m_socketHadError = true;
+		bs->m_socket = NULL;
+		sock->m_streamingMode = false;
+		g_httpServer.m_tcp.destroySocket(sock);
+	}
+
+	sendPending(bs);
+}
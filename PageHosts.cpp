@@ -320,6 +320,12 @@ skipReplaceHost:
 			if ( (flags & PFLAG_MERGING) && format != FORMAT_HTML )
 				fb.safePrintf ( "Merging");
 
+			// say "W" if still warming up after a restart
+			if (   (flags & PFLAG_WARMINGUP) && format == FORMAT_HTML )
+				fb.safePrintf ( "<span title=\"Warming up\">W</span>");
+			if (   (flags & PFLAG_WARMINGUP) && format != FORMAT_HTML )
+				fb.safePrintf ( "Warming up");
+
 			// say "D" if dumping
 			if (   (flags & PFLAG_DUMPING) && format == FORMAT_HTML )
 				fb.safePrintf ( "<span title=\"Dumping\">D</span>");
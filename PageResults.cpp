@@ -33,6 +33,7 @@
 #include "QueryLanguage.h"
 #include "FxLanguage.h"
 #include "Errno.h"
+#include "SerpWriter.h"
 #ifdef _VALGRIND_
 #include <valgrind/memcheck.h>
 #endif
@@ -157,12 +158,15 @@ static bool sendReply(State0 *st, const char *reply, int32_t rlen) {
 					     NULL, // cookieptr
 					     charset );
 
-		// free st after sending reply since "st->m_sb" = "reply"
+		// free st after sending reply since "st->m_sb" = "reply".
+		// sendDynamicPage() copied it so the next query can have it
+		g_serpBufferPool.release(&st->m_sb);
 		mdelete(st, sizeof(State0), "PageResults2");
 		delete st;
 		return true;
 	}
 
+	g_serpBufferPool.release(&st->m_sb);
 	mdelete(st, sizeof(State0), "PageResults2");
 	delete st;
 
@@ -520,6 +524,14 @@ static bool gotResults ( void *state ) {
 
 	SafeBuf *sb = &st->m_sb;
 
+	// get the buffer of an earlier query, with room for the whole page up
+	// to serpbuffermaxsize so printing the results does not keep
+	// reallocating it
+	if ( ! g_serpBufferPool.acquire ( sb , 4096 + numResults * ( si->m_docIdsOnly ? 64 : 2048 ) ) ) {
+		log("query: failed to reserve results buffer: %s",mstrerror(g_errno));
+		g_errno = 0;
+	}
+
 	// print logo, search box, results x-y, ... into st->m_sb
 	printSearchResultsHeader ( st );
 
@@ -994,6 +1006,14 @@ static bool printSearchResultsHeader(State0 *st) {
 		sb->safePrintf("\"moreResultsFollow\":%" PRId32",\n",
 				(int32_t)moreFollow);
 
+	// the token for getting the next pages from the same results
+	if ( msg40->getCursorToken() ) {
+		if ( si->m_format == FORMAT_XML )
+			sb->safePrintf("\t<cursor>%" PRIu64"</cursor>\n", msg40->getCursorToken());
+		else if ( st->m_header && si->m_format == FORMAT_JSON )
+			sb->safePrintf("\"cursor\":\"%" PRIu64"\",\n", msg40->getCursorToken());
+	}
+
 	// print individual query term info
 	if ( si->m_format == FORMAT_XML ) {
 		const Query *q = &si->m_q;
@@ -1941,6 +1961,9 @@ static bool printResult(State0 *st, int32_t ix, int32_t *numPrintedSoFar) {
 	if ( si->m_format == FORMAT_XML  ) cursor = sb->length();
 	if ( si->m_format == FORMAT_JSON ) cursor = sb->length();
 
+	// for the xml and json fields
+	SerpWriter sw ( sb , si->m_format );
+
 	if ( si->m_format == FORMAT_XML ) 
 		sb->safePrintf("\t<result>\n" );
 
@@ -1952,17 +1975,8 @@ static bool printResult(State0 *st, int32_t ix, int32_t *numPrintedSoFar) {
 	}
 
 
-	if ( mr->ptr_content && si->m_format == FORMAT_XML ) {
-		sb->safePrintf("\t\t<content><![CDATA[");
-		cdataEncode(sb, mr->ptr_content);
-		sb->safePrintf("]]></content>\n");
-	}
-		
-	if ( mr->ptr_content && si->m_format == FORMAT_JSON ) {
-		sb->safePrintf("\t\t\"content\":\"");
-		sb->jsonEncode(mr->ptr_content);
-		sb->safePrintf("\",\n");
-	}
+	if ( mr->ptr_content && ( si->m_format == FORMAT_XML || si->m_format == FORMAT_JSON ) )
+		sw.stringField ( "content" , mr->ptr_content );
 
 	Highlight hi;
 
@@ -2022,33 +2036,12 @@ static bool printResult(State0 *st, int32_t ix, int32_t *numPrintedSoFar) {
 					   NULL ,
 					   " style=\"margin:10px;\" ",
 					   si->m_format );
-		if ( si->m_format == FORMAT_XML ) {
-			sb->safePrintf("\t\t<imageHeight>%" PRId32"</imageHeight>\n",
-				       ti->m_dy);
-			sb->safePrintf("\t\t<imageWidth>%" PRId32"</imageWidth>\n",
-				       ti->m_dx);
-			sb->safePrintf("\t\t<origImageHeight>%" PRId32
-				       "</origImageHeight>\n",
-				       ti->m_origDY);
-			sb->safePrintf("\t\t<origImageWidth>%" PRId32
-				       "</origImageWidth>\n",
-				       ti->m_origDX);
-			sb->safePrintf("\t\t<imageUrl><![CDATA[");
-			cdataEncode(sb, ti->getUrl());
-			sb->safePrintf("]]></imageUrl>\n");
-		}
-		if ( si->m_format == FORMAT_JSON ) {
-			sb->safePrintf("\t\t\"imageHeight\":%" PRId32",\n",
-				       ti->m_dy);
-			sb->safePrintf("\t\t\"imageWidth\":%" PRId32",\n",
-				       ti->m_dx);
-			sb->safePrintf("\t\t\"origImageHeight\":%" PRId32",\n",
-				       ti->m_origDY);
-			sb->safePrintf("\t\t\"origImageWidth\":%" PRId32",\n",
-				       ti->m_origDX);
-			sb->safePrintf("\t\t\"imageUrl\":\"");
-			sb->jsonEncode(ti->getUrl());
-			sb->safePrintf("\",\n");
+		if ( si->m_format == FORMAT_XML || si->m_format == FORMAT_JSON ) {
+			sw.intField ( "imageHeight" , ti->m_dy );
+			sw.intField ( "imageWidth" , ti->m_dx );
+			sw.intField ( "origImageHeight" , ti->m_origDY );
+			sw.intField ( "origImageWidth" , ti->m_origDX );
+			sw.stringField ( "imageUrl" , ti->getUrl() );
 		}
 	}
 
@@ -2284,21 +2277,8 @@ static bool printResult(State0 *st, int32_t ix, int32_t *numPrintedSoFar) {
 	}
 
 	// close up the title tag
-	if ( si->m_format == FORMAT_XML ) {
-		sb->safePrintf("\t\t<title><![CDATA[");
-		if ( str ) {
-			cdataEncode(sb, str);
-		}
-		sb->safePrintf("]]></title>\n");
-	}
-
-	if ( si->m_format == FORMAT_JSON ) {
-		sb->safePrintf("\t\t\"title\":\"");
-		if ( str ) {
-			sb->jsonEncode(str);
-		}
-		sb->safePrintf("\",\n");
-	}
+	if ( si->m_format == FORMAT_XML || si->m_format == FORMAT_JSON )
+		sw.stringField ( "title" , str );
 
 
 	if ( si->m_format == FORMAT_HTML ) 
@@ -2317,16 +2297,8 @@ static bool printResult(State0 *st, int32_t ix, int32_t *numPrintedSoFar) {
 	char *hp = mr->ptr_htag;
 	char *hpend = hp + mr->size_htag;
 	for ( ; hp && hp < hpend ; ) {
-		if ( si->m_format == FORMAT_XML ) {
-			sb->safePrintf("\t\t<h1Tag><![CDATA[");
-			cdataEncode(sb, hp);
-			sb->safePrintf("]]></h1Tag>\n");
-		}
-		if ( si->m_format == FORMAT_JSON ) {
-			sb->safePrintf("\t\t\"h1Tag\":\"");
-			sb->jsonEncode(hp);
-			sb->safePrintf("\",\n");
-		}
+		if ( si->m_format == FORMAT_XML || si->m_format == FORMAT_JSON )
+			sw.stringField ( "h1Tag" , hp );
 		// it is a \0 separated list of headers generated from XmlDoc::getHeaderTagBuf()
 		hp += strlen(hp) + 1;
 	}
@@ -2350,11 +2322,8 @@ static bool printResult(State0 *st, int32_t ix, int32_t *numPrintedSoFar) {
 	unsigned char ctype = mr->m_contentType;
 	const char *cs = g_contentTypeStrings[ctype];
 
-	if ( si->m_format == FORMAT_XML )
-		sb->safePrintf("\t\t<contentType><![CDATA[%s]]></contentType>\n", cs);
-
-	if ( si->m_format == FORMAT_JSON )
-		sb->safePrintf("\t\t\"contentType\":\"%s\",\n",cs);
+	if ( si->m_format == FORMAT_XML || si->m_format == FORMAT_JSON )
+		sw.verbatimField ( "contentType" , cs );
 
 	if ( si->m_format == FORMAT_HTML && ctype != CT_HTML && ctype != CT_UNKNOWN ) {
 		sb->safePrintf(" <b><font style=color:white;background-color:maroon;>");
@@ -2434,16 +2403,8 @@ static bool printResult(State0 *st, int32_t ix, int32_t *numPrintedSoFar) {
 		sb->safePrintf( "<br>\n" );
 	}
 	else
-	if ( si->m_format == FORMAT_XML ) {
-		sb->safePrintf( "\t\t<sum><![CDATA[" );
-		cdataEncode(sb, str);
-		sb->safePrintf( "]]></sum>\n" );
-	}
-	else
-	if ( si->m_format == FORMAT_JSON ) {
-		sb->safePrintf( "\t\t\"sum\":\"" );
-		sb->jsonEncode( str );
-		sb->safePrintf( "\",\n" );
+	if ( si->m_format == FORMAT_XML || si->m_format == FORMAT_JSON ) {
+		sw.stringField ( "sum" , str );
 	}
 
 	/////////
@@ -2514,16 +2475,8 @@ static bool printResult(State0 *st, int32_t ix, int32_t *numPrintedSoFar) {
 	}
 
 
-	if ( si->m_format == FORMAT_XML ) {
-		sb->safePrintf("\t\t<url><![CDATA[");
-		sb->safeMemcpy ( displayUrl , displayUrlLen );
-		sb->safePrintf("]]></url>\n");
-	}
-	if ( si->m_format == FORMAT_JSON ) {
-		sb->safePrintf("\t\t\"url\":\"");
-		sb->jsonEncode ( displayUrl , displayUrlLen );
-		sb->safePrintf("\",\n");
-	}
+	if ( si->m_format == FORMAT_XML || si->m_format == FORMAT_JSON )
+		sw.stringField ( "url" , displayUrl , displayUrlLen );
 
 	// now the last spidered date of the document
 	time_t ts = mr->m_lastSpidered;
@@ -2545,56 +2498,21 @@ static bool printResult(State0 *st, int32_t ix, int32_t *numPrintedSoFar) {
 	//
 	// more xml stuff
 	//
-	if ( si->m_format == FORMAT_XML ) {
-		// doc size in Kilobytes
-		sb->safePrintf ("\t\t<size><![CDATA[%4.0fk]]></size>\n", (float)mr->m_contentLen/1024.0);
-		sb->safePrintf ( "\t\t<sizeInBytes>%" PRId32"</sizeInBytes>\n", mr->m_contentLen);
-		// . docId for possible cached link
-		// . might have merged a bunch together
-		sb->safePrintf("\t\t<docId>%" PRId64"</docId>\n",mr->m_docId );
-		sb->safePrintf("\t\t<docScore>%f</docScore>\n",docScore);
-
-		// . show the site root
-		// . for hompages.com/users/fred/mypage.html this will be
-		//   homepages.com/users/fred/
-		// . for www.xyz.edu/~foo/burp/ this will be
-		//   www.xyz.edu/~foo/ etc.
-		// seems like this isn't the way to do it, cuz Tagdb.cpp
-		// adds the "site" tag itself and we do not always have it
-		// in the XmlDoc::ptr_tagRec... so do it this way:
-		const char *site    = mr->ptr_site;
-		int32_t siteLen = mr->size_site-1;
-		//char *site=uu.getSite( &siteLen , si->m_coll, false, tagRec);
-		sb->safePrintf("\t\t<site><![CDATA[");
-		if ( site && siteLen > 0 ) sb->safeMemcpy ( site , siteLen );
-		sb->safePrintf("]]></site>\n");
-		//int32_t sh = hash32 ( site , siteLen );
-		//sb->safePrintf ("\t\t<siteHash32>%" PRIu32"</siteHash32>\n",sh);
-		//int32_t dh = uu.getDomainHash32 ();
-		//sb->safePrintf ("\t\t<domainHash32>%" PRIu32"</domainHash32>\n",dh);
-		// spider date
-		sb->safePrintf ( "\t\t<spidered>%" PRIu32"</spidered>\n", (uint32_t)mr->m_lastSpidered);
-		// backwards compatibility for buzz
-		sb->safePrintf ( "\t\t<firstIndexedDateUTC>%" PRIu32 "</firstIndexedDateUTC>\n", (uint32_t)mr->m_firstIndexedDate);
-		sb->safePrintf( "\t\t<contentHash32>%" PRIu32 "</contentHash32>\n", (uint32_t)mr->m_contentHash32);
-		// pub date
-		int32_t datedbDate = mr->m_datedbDate;
-		// show the datedb date as "<pubDate>" for now
-		if ( datedbDate != -1 )
-			sb->safePrintf ( "\t\t<pubdate>%" PRIu32"</pubdate>\n", (uint32_t)datedbDate);
-	}
-
-	if ( si->m_format == FORMAT_JSON ) {
+	if ( si->m_format == FORMAT_XML || si->m_format == FORMAT_JSON ) {
 		// doc size in Kilobytes
-		sb->safePrintf ( "\t\t\"size\":\"%4.0fk\",\n", (float)mr->m_contentLen/1024.0);
-		sb->safePrintf ( "\t\t\"sizeInBytes\":%" PRId32 ",\n", mr->m_contentLen);
+		char sizeBuf[32];
+		snprintf ( sizeBuf , sizeof(sizeBuf) , "%4.0fk" , (float)mr->m_contentLen/1024.0 );
+		sw.verbatimField ( "size" , sizeBuf );
+		sw.intField ( "sizeInBytes" , mr->m_contentLen );
 		// . docId for possible cached link
 		// . might have merged a bunch together
-		sb->safePrintf("\t\t\"docId\":%" PRId64",\n", mr->m_docId );
-		sb->safePrintf("\t\t\"docScore\":%f,\n", docScore);
-		sb->safePrintf("\t\t\"flags\":%u,\n", docFlags);
-		sb->safePrintf("\t\t\"cacheAvailable\":%s,\n", printCached?"true":"false");
-		sb->safePrintf("\t\t\"isAdult\":%s,\n", mr->m_isAdult?"true":"false");
+		sw.intField ( "docId" , mr->m_docId );
+		sw.floatField ( "docScore" , docScore );
+		if ( si->m_format == FORMAT_JSON ) {
+			sw.intField ( "flags" , docFlags );
+			sw.boolField ( "cacheAvailable" , printCached );
+			sw.boolField ( "isAdult" , mr->m_isAdult );
+		}
 
 		// . show the site root
 		// . for hompages.com/users/fred/mypage.html this will be
@@ -2604,22 +2522,17 @@ static bool printResult(State0 *st, int32_t ix, int32_t *numPrintedSoFar) {
 		// seems like this isn't the way to do it, cuz Tagdb.cpp
 		// adds the "site" tag itself and we do not always have it
 		// in the XmlDoc::ptr_tagRec... so do it this way:
-		const char *site = mr->ptr_site;
-		int32_t siteLen = mr->size_site-1;
-		//char *site=uu.getSite( &siteLen , si->m_coll, false, tagRec);
-		sb->safePrintf("\t\t\"site\":\"");
-		if ( site && siteLen > 0 ) sb->safeMemcpy ( site , siteLen );
-		sb->safePrintf("\",\n");
+		sw.verbatimField ( "site" , mr->ptr_site , mr->size_site - 1 );
 		// spider date
-		sb->safePrintf ( "\t\t\"spidered\":%" PRIu32 ",\n", (uint32_t)mr->m_lastSpidered);
+		sw.intField ( "spidered" , (uint32_t)mr->m_lastSpidered );
 		// backwards compatibility for buzz
-		sb->safePrintf ( "\t\t\"firstIndexedDateUTC\":%" PRIu32 ",\n", (uint32_t) mr->m_firstIndexedDate);
-		sb->safePrintf( "\t\t\"contentHash32\":%" PRIu32 ",\n", (uint32_t)mr->m_contentHash32);
+		sw.intField ( "firstIndexedDateUTC" , (uint32_t)mr->m_firstIndexedDate );
+		sw.intField ( "contentHash32" , (uint32_t)mr->m_contentHash32 );
 		// pub date
 		int32_t datedbDate = mr->m_datedbDate;
 		// show the datedb date as "<pubDate>" for now
 		if ( datedbDate != -1 )
-			sb->safePrintf ( "\t\t\"pubdate\":%" PRIu32 ",\n", (uint32_t)datedbDate);
+			sw.intField ( "pubdate" , (uint32_t)datedbDate );
 	}
 
 
@@ -2642,16 +2555,10 @@ static bool printResult(State0 *st, int32_t ix, int32_t *numPrintedSoFar) {
 			(int32_t)k->m_firstIndexedDate ,
 			(int32_t)k->m_datedbDate );
 
-	if ( si->m_format == FORMAT_XML ) {
-		// result
-		sb->safePrintf("\t\t<language><![CDATA[%s]]></language>\n", getLanguageString(mr->m_language));
-		sb->safePrintf("\t\t<langAbbr>%s</langAbbr>\n", getLanguageAbbr(mr->m_language));
-	}
-
-	if ( si->m_format == FORMAT_JSON ) {
+	if ( si->m_format == FORMAT_XML || si->m_format == FORMAT_JSON ) {
 		// result
-		sb->safePrintf("\t\t\"language\":\"%s\",\n", getLanguageString(mr->m_language));
-		sb->safePrintf("\t\t\"langAbbr\":\"%s\",\n", getLanguageAbbr(mr->m_language));
+		sw.verbatimField ( "language" , getLanguageString(mr->m_language) );
+		sw.tokenField ( "langAbbr" , getLanguageAbbr(mr->m_language) );
 	}
 
 	//
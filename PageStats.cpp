@@ -5,6 +5,7 @@
 #include "Tagdb.h"
 #include "Clusterdb.h"
 #include "Linkdb.h"
+#include "Anchordb.h"
 #include "Posdb.h"
 #include "Dns.h"
 #include "TcpServer.h"
@@ -1412,6 +1413,7 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 		g_tagdb.getRdb(),
 		g_clusterdb.getRdb(),
 		g_linkdb.getRdb(),
+		g_anchordb.getRdb(),
 	};
 	int32_t nr = sizeof(rdbs) / sizeof(Rdb *);
 	//TODO: sqlite: show statistics for sqlite database(s)
@@ -26,6 +26,7 @@ static const char *thread_type_name(thread_type_t tt) {
 		case thread_type_file_meta_data:     return "file-meta-data";
 		case thread_type_index_merge:        return "index-merge";
 		case thread_type_index_generate:     return "index-generate";
+		case thread_type_dump_index:         return "dump-index";
 		case thread_type_verify_data:        return "verify-data";
 		case thread_type_statistics:         return "statistics";
 		case thread_type_unspecified_io:     return "unspecified IO";
@@ -37,6 +38,19 @@ static const char *thread_type_name(thread_type_t tt) {
 }
 
 
+static const char *io_class_name(io_class_t io_class) {
+	switch(io_class) {
+		case io_class_unspecified:  return "unspecified";
+		case io_class_query:        return "query";
+		case io_class_spider_read:  return "spider-read";
+		case io_class_merge:        return "merge";
+		case io_class_dump:         return "dump";
+		case io_class_repair:       return "repair";
+		default: return "?";
+	}
+}
+
+
 bool sendPageThreads ( TcpSocket *s , HttpRequest *r ) {
 	StackBuf<64*1024> p;
 	g_pages.printAdminTop ( &p , s , r );
@@ -168,6 +182,39 @@ bool sendPageThreads ( TcpSocket *s , HttpRequest *r ) {
 		}
 		p.safePrintf("   </tr>\n");
 	}
+	
+	p.safePrintf("</table><br><br>");
+
+	//print i/o scheduling statistics per i/o class
+	IoSchedulerStatistics io_stats = g_jobScheduler.query_io_statistics();
+	p.safePrintf("<table %s>", TABLE_STYLE);
+	p.safePrintf("  <tr class=hdrow>\n");
+	p.safePrintf("    <td colspan=\"6\"><b>I/O scheduling. Query read p95: %u ms. Merge throttling: %.0f%%</b></td>\n",
+	             io_stats.query_latency_p95, (1.0-io_stats.background_factor)*100.0);
+	p.safePrintf("  </tr>\n");
+	p.safePrintf("  <tr class=hdrow>\n");
+	p.safePrintf("    <td><b>I/O class</b></td>\n");
+	p.safePrintf("    <td><b>Rate limit (KB/s)</b></td>\n");
+	p.safePrintf("    <td><b>Current rate (KB/s)</b></td>\n");
+	p.safePrintf("    <td><b>Jobs</b></td>\n");
+	p.safePrintf("    <td><b>MB</b></td>\n");
+	p.safePrintf("    <td><b>Throttled</b></td>\n");
+	p.safePrintf("   </tr>\n");
+	for(int io_class=io_class_query; io_class<io_class_end; io_class++) {
+		const IoClassStatistics &ios = io_stats.io_class[io_class];
+		p.safePrintf("  <tr bgcolor=#%s>\n",LIGHT_BLUE);
+		p.safePrintf("    <td>%s</td>", io_class_name((io_class_t)io_class));
+		if(ios.rate_limit)
+			p.safePrintf("    <td>%" PRIu64"</td>", ios.rate_limit/1024);
+		else
+			p.safePrintf("    <td>-</td>");
+		p.safePrintf("    <td>%" PRIu64"</td>", ios.observed_rate/1024);
+		p.safePrintf("    <td>%" PRIu64"</td>", ios.job_count);
+		p.safePrintf("    <td>%" PRIu64"</td>", ios.bytes_done/(1024*1024));
+		p.safePrintf("    <td>%" PRIu64"</td>", ios.throttle_count);
+		p.safePrintf("   </tr>\n");
+	}
+	p.safePrintf("</table><br><br>");
 
 	return g_httpServer.sendDynamicPage ( s , (char*) p.getBufStart() ,
 						p.length() );
@@ -254,6 +254,11 @@ static WebPage s_pages[] = {
 	  sendPageHealthCheck,
 	  PG_NOAPI|PG_ACTIVE},
 
+	{ PAGE_BULKSEARCH, "admin/bulksearch", 0 , "Bulk search" , page_method_t::page_method_post_url,
+	  "run a batch of queries and stream the results as json lines",
+	  sendPageBulkSearch,
+	  PG_NOAPI|PG_MASTERADMIN|PG_ACTIVE},
+
 };
 static const int32_t s_numPages = sizeof(s_pages) / sizeof(WebPage);
 
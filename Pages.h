@@ -70,6 +70,7 @@ bool sendPageThreads    ( TcpSocket *s , HttpRequest *r );
 bool sendPageAPI        ( TcpSocket *s , HttpRequest *r );
 bool sendPageHelp       ( TcpSocket *s , HttpRequest *r );
 bool sendPageHealthCheck ( TcpSocket *sock , HttpRequest *hr ) ;
+bool sendPageBulkSearch ( TcpSocket *s , HttpRequest *r );
 bool sendPageDefaultCss(TcpSocket *s, HttpRequest *r);
 bool sendPageDocProcess(TcpSocket *s, HttpRequest *r);
 
@@ -220,6 +221,7 @@ enum {
 	PAGE_DOCPROCESS  ,
 	PAGE_SITEDB      ,
 	PAGE_HEALTHCHECK ,
+	PAGE_BULKSEARCH  ,
 	PAGE_NONE     	};
 	
 
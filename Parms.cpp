@@ -31,6 +31,7 @@
 #include "Spider.h"
 #include "Tagdb.h"
 #include "Clusterdb.h"
+#include "Anchordb.h"
 #include "Collectiondb.h"
 #include "Doledb.h"
 #include "GbDns.h"
@@ -38,10 +39,13 @@
 #include "QueryLanguage.h"
 #include "SiteNumInlinks.h"
 #include "SiteMedianPageTemperature.h"
+#include "SerpWriter.h"
+#include "Msg2.h"
 #include "Errno.h"
 #include <set>
 #include <fstream>
 #include "gbmemcpy.h"
+#include "SimHash.h"
 
 
 class WaitEntry {
@@ -744,6 +748,7 @@ static bool CommandDiskDump(const char *rec) {
 	g_posdb.getRdb()->submitRdbDumpJob(true);
 	g_titledb.getRdb()->submitRdbDumpJob(true);
 	g_linkdb.getRdb()->submitRdbDumpJob(true);
+	g_anchordb.getRdb()->submitRdbDumpJob(true);
 	//g_doledb is a tree-only dbs so cannot be dumped
 	g_errno = 0;
 	return true;
@@ -3521,6 +3526,22 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_RESULTS;
 	m++;
 
+	m->m_title = "simhash dedup distance";
+	m->m_desc  = "If the content simhash of a document differs in at "
+		"most this many bits from that of a document above it, then "
+		"remove it from the search results. Results without a "
+		"simhash use the summary deduping above. -1 means no "
+		"simhash deduping. You must also supply dr=1 for this to work.";
+	m->m_cgi   = "sdd";
+	simple_m_set(SearchInput,m_simHashDedupDistance);
+	m->m_defOff= offsetof(CollectionRec,m_simHashDedupDistance);
+	m->m_group = false;
+	m->m_smin  = -1;
+	m->m_smax  = SIMHASH_MAX_DISTANCE;
+	m->m_flags = PF_API;
+	m->m_page  = PAGE_RESULTS;
+	m++;
+
 
 	m->m_title = "dedup URLs";
 	m->m_desc  = "Should we dedup URLs with case insensitivity? This is "
@@ -4636,6 +4657,20 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_RESULTS;
 	m++;
 
+	m->m_title = "result cursor";
+	m->m_desc  = "Use \"new\" to keep the results of the query for the next "
+		"pages. The reply has a cursor token; pass it with the same query "
+		"and a higher s to get the next pages without running the query "
+		"again.";
+	m->m_off   = offsetof(SearchInput,m_cursor);
+	m->m_type  = TYPE_CHARPTR;
+	m->m_def   = NULL;
+	m->m_cgi   = "cursor";
+	m->m_page  = PAGE_RESULTS;
+	m->m_obj   = OBJ_SI;
+	m->m_flags = PF_API;
+	m++;
+
 	m->m_title = "restrict search to this url";
 	m->m_desc  = "Does a url: query.";
 	m->m_off   = offsetof(SearchInput,m_url);
@@ -5364,6 +5399,72 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "keep-alive connections when downloading";
+	m->m_desc  = "If this is true, gb will ask web servers to keep the "
+		"connection open after a download and reuse it for the next "
+		"download from the same ip. Only done for plain GETs that do "
+		"not go through a proxy, and only when the crawl delay "
+		"of the ip is shorter than the keep-alive idle timeout.";
+	m->m_cgi   = "spka";
+	simple_m_set(Conf,m_spiderKeepAlive);
+	m->m_def   = "0";
+	m->m_page  = PAGE_MASTER;
+	m++;
+
+	m->m_title = "keep-alive idle timeout";
+	m->m_desc  = "Close a kept-alive download connection after it has "
+		"been idle this long. Keep it below the keep-alive timeout "
+		"of most web servers (5 seconds for apache).";
+	m->m_cgi   = "spkait";
+	simple_m_set(Conf,m_spiderKeepAliveIdleTimeout);
+	m->m_def   = "4000";
+	m->m_units = "milliseconds";
+	m->m_page  = PAGE_MASTER;
+	m++;
+
+	m->m_title = "max keep-alive connections per ip";
+	m->m_desc  = "How many idle kept-alive download connections to keep "
+		"open to a single ip and port.";
+	m->m_cgi   = "spkamph";
+	simple_m_set(Conf,m_spiderKeepAliveMaxPerHost);
+	m->m_def   = "2";
+	m->m_page  = PAGE_MASTER;
+	m++;
+
+	m->m_title = "send if-modified-since when recrawling";
+	m->m_desc  = "If this is true, gb will send If-Modified-Since with the "
+		"time of the last spider when recrawling an indexed page. A "
+		"304 Not Modified reply then just updates the spider reply. Not "
+		"sent when the inlink text of the page changed.";
+	m->m_cgi   = "sims";
+	simple_m_set(Conf,m_spiderIfModifiedSince);
+	m->m_def   = "0";
+	m->m_page  = PAGE_MASTER;
+	m++;
+
+	m->m_title = "skip unchanged recrawls";
+	m->m_desc  = "If this is true, a recrawled page whose content hashes "
+		"the same as the indexed version, and whose inlink text did not "
+		"change either, is not parsed or reindexed. Only a new spider "
+		"reply is added.";
+	m->m_cgi   = "sur";
+	simple_m_set(Conf,m_skipUnchangedRecrawls);
+	m->m_def   = "0";
+	m->m_page  = PAGE_MASTER;
+	m++;
+
+	m->m_title = "spider prefetch max urls";
+	m->m_desc  = "When all spiders are busy, look up the ip, robots.txt "
+		"and tagdb record of up to this many of the urls waiting in "
+		"doledb, so they are cached by the time the urls are spidered. "
+		"A url whose lookups are still out waits up to a few seconds "
+		"while the urls that are ready go first. Use 0 to disable.";
+	m->m_cgi   = "sppmu";
+	simple_m_set(Conf,m_spiderPrefetchMaxUrls);
+	m->m_def   = "0";
+	m->m_page  = PAGE_MASTER;
+	m++;
+
 	m->m_title = "document summary (w/desc) cache max age";
 	m->m_desc = "How many milliseconds should we cache document summaries";
 	m->m_cgi  = "dswdmca";
@@ -5373,6 +5474,19 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "use summary store";
+	m->m_desc  = "If enabled then titles and summaries of docs indexed "
+		"with a pre-tokenized summary store in their titlerec are made "
+		"from that instead of parsing the html of the doc again. Docs "
+		"indexed before it existed are always parsed.";
+	m->m_cgi   = "usesummarystore";
+	simple_m_set(Conf,m_useSummaryStore);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "Vagus cluster id";
 	m->m_desc  = "Which cluster name to use in Vagus. The default empty string means to use 'gb-'$USER which works fine in most scenarios";
 	m->m_cgi   = "vagus_cluster_id";
@@ -5470,6 +5584,16 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "skip unchanged titlerecs";
+	m->m_desc  = "When re-indexing a document, do not write its titlerec "
+		"again if it is the same as the one already in titledb. The "
+		"spidered time of the document is then not updated.";
+	m->m_cgi   = "sutr";
+	simple_m_set(Conf,m_skipUnchangedTitleRecs);
+	m->m_def   = "0";
+	m->m_page  = PAGE_MASTER;
+	m++;
+
 	m->m_title = "use etc hosts";
 	m->m_desc  = "Use /etc/hosts file to resolve hostnames? the "
 		"/etc/host file is reloaded every minute, so if you make "
@@ -5492,6 +5616,18 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "memory allocation sample rate";
+	m->m_desc  = "Record the call stack of 1 in this many memory "
+		"allocations and show the biggest on the stats page. 0 "
+		"disables. Only used by builds with light memory accounting "
+		"which do not keep track of every allocation.";
+	m->m_cgi   = "memsamplerate";
+	simple_m_set(Conf,m_memSampleRate);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m++;
+
 	m->m_title = "do consistency testing";
 	m->m_desc  = "When enabled Gigablast will make sure it reparses "
 		"the document exactly the same way. It does this every "
@@ -5779,6 +5915,160 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "query plan cache size";
+	m->m_desc  = "How many parsed queries with their query terms, synonyms and word variations to keep, so a "
+		     "shard does not have to parse a query it got lately again. 0 disables it.";
+	m->m_cgi   = "queryplancachesize";
+	m->m_xml   = "QueryPlanCacheSize";
+	simple_m_set(Conf,m_queryPlanCacheSize);
+	m->m_def   = "100";
+	m->m_units = "queries";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "query plan cache max age";
+	m->m_desc  = "How long to keep parsed queries. Changes to synonyms and word variations take this long to "
+		     "be noticed for cached queries.";
+	m->m_cgi   = "queryplancacheage";
+	m->m_xml   = "QueryPlanCacheAge";
+	simple_m_set(Conf,m_queryPlanCacheMaxAge);
+	m->m_def   = "600000";
+	m->m_units = "milliseconds";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "truncated termlists memory";
+	m->m_desc  = "How much memory to use for truncated termlists. Long termlists of a posdb file are "
+		     "truncated to the docids with the best siterank and page temperature, and queries "
+		     "try those first. The total hit count is only an estimate for such queries. 0 disables it.";
+	m->m_cgi   = "truncatedtermlistsmem";
+	m->m_xml   = "TruncatedTermlistsMemory";
+	simple_m_set(Conf,m_truncatedTermlistsMaxMemory);
+	m->m_def   = "0";
+	m->m_units = "bytes";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "truncated termlists min list size";
+	m->m_desc  = "Only truncate termlists of at least this size.";
+	m->m_cgi   = "truncatedtermlistsminsize";
+	m->m_xml   = "TruncatedTermlistsMinListSize";
+	simple_m_set(Conf,m_truncatedTermlistsMinListSize);
+	m->m_def   = "1000000";
+	m->m_units = "bytes";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "truncated termlists max docids";
+	m->m_desc  = "How many docids a truncated termlist keeps.";
+	m->m_cgi   = "truncatedtermlistsmaxdocids";
+	m->m_xml   = "TruncatedTermlistsMaxDocIds";
+	simple_m_set(Conf,m_truncatedTermlistsMaxDocIds);
+	m->m_def   = "20000";
+	m->m_units = "docids";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "bulk search max concurrent queries";
+	m->m_desc  = "How many queries of a bulk search (admin/bulksearch) may run at the same time. Keep it "
+		     "low so replaying a query log does not slow down the live queries.";
+	m->m_cgi   = "bulksearchmaxconcurrent";
+	m->m_xml   = "BulkSearchMaxConcurrentQueries";
+	simple_m_set(Conf,m_bulkSearchMaxConcurrentQueries);
+	m->m_def   = "4";
+	m->m_units = "queries";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "bulk search termlist cache memory";
+	m->m_desc  = "How much memory to use for the termlists read by bulk searches, so the other queries of "
+		     "a bulk search with the same terms do not read them from disk again. Live queries do not "
+		     "use it. 0 disables it.";
+	m->m_cgi   = "bulksearchtermlistcachemem";
+	m->m_xml   = "BulkSearchTermlistCacheMemory";
+	simple_m_set(Conf,m_bulkSearchTermlistCacheMem);
+	m->m_def   = "0";
+	m->m_units = "bytes";
+	m->m_flags = PF_REBUILDSHAREDTERMLISTCACHE;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "result cursors";
+	m->m_desc  = "How many result-set cursors (&cursor=new) to keep. A cursor holds the results of a "
+		     "query so the next pages do not have to run it again. 0 disables them.";
+	m->m_cgi   = "searchcursors";
+	m->m_xml   = "SearchCursorMaxItems";
+	simple_m_set(Conf,m_searchCursorMaxItems);
+	m->m_def   = "1000";
+	m->m_units = "cursors";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "result cursor max age";
+	m->m_desc  = "How long to keep a result-set cursor that is not used.";
+	m->m_cgi   = "searchcursorage";
+	m->m_xml   = "SearchCursorMaxAge";
+	simple_m_set(Conf,m_searchCursorMaxAge);
+	m->m_def   = "300000";
+	m->m_units = "milliseconds";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "result cursor pages";
+	m->m_desc  = "How many pages of results to get when making a result-set cursor, so the next "
+		     "pages can come from it.";
+	m->m_cgi   = "searchcursorpages";
+	m->m_xml   = "SearchCursorPages";
+	simple_m_set(Conf,m_searchCursorPages);
+	m->m_def   = "5";
+	m->m_units = "pages";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "results buffer pool size";
+	m->m_desc  = "How many buffers of rendered results pages to keep for reuse by the next queries.";
+	m->m_cgi   = "serpbufferpool";
+	m->m_xml   = "SerpBufferPoolSize";
+	simple_m_set(Conf,m_serpBufferPoolSize);
+	m->m_def   = "32";
+	m->m_units = "buffers";
+	m->m_flags = PF_REBUILDSERPBUFFERSETTINGS;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "results buffer max size";
+	m->m_desc  = "Buffers of rendered results pages bigger than this are freed instead of kept for reuse. "
+		     "A results page never gets more than this reserved up front.";
+	m->m_cgi   = "serpbuffermaxsize";
+	m->m_xml   = "SerpBufferMaxSize";
+	simple_m_set(Conf,m_serpBufferMaxSize);
+	m->m_def   = "1048576";
+	m->m_units = "bytes";
+	m->m_flags = PF_REBUILDSERPBUFFERSETTINGS;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "redirect non-raw traffic";
 	m->m_desc = "If this is non empty, http traffic will be redirected "
 				"to the specified address.";
@@ -6157,6 +6447,19 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "index docs in threads";
+	m->m_desc  = "If enabled then parsing, tokenizing and hashing of spidered "
+		"documents is done in spider-index threads instead of the main "
+		"thread once the document and its related records have been "
+		"fetched. Big documents then no longer stall queries.";
+	m->m_cgi   = "indexdocsinthreads";
+	simple_m_set(Conf,m_indexDocsInThreads);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "max job cleanup time";
 	m->m_desc  = "Maximum number of milliseconds the main thread is allow to spend on cleanup up finished jobs. "
 		"Disable with =0. If enabled the main thraed will abort the process if it detects a job cleanup taking too long.";
@@ -6170,6 +6473,104 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "max query read rate";
+	m->m_desc  = "Maximum disk read bandwidth used by queries. 0 means unlimited.";
+	m->m_cgi   = "io_query_max_rate";
+	simple_m_set(Conf,m_ioQueryMaxRate);
+	m->m_def   = "0";
+	m->m_units = "MB/s";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = true;
+	m++;
+
+	m->m_title = "max spider read rate";
+	m->m_desc  = "Maximum disk read bandwidth used by spidering. 0 means unlimited.";
+	m->m_cgi   = "io_spider_read_max_rate";
+	simple_m_set(Conf,m_ioSpiderReadMaxRate);
+	m->m_def   = "0";
+	m->m_units = "MB/s";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "max merge io rate";
+	m->m_desc  = "Maximum disk bandwidth used by merges (reads and writes). 0 means unlimited.";
+	m->m_cgi   = "io_merge_max_rate";
+	simple_m_set(Conf,m_ioMergeMaxRate);
+	m->m_def   = "0";
+	m->m_units = "MB/s";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "max dump write rate";
+	m->m_desc  = "Maximum disk write bandwidth used when dumping in-memory trees to disk. 0 means unlimited.";
+	m->m_cgi   = "io_dump_max_rate";
+	simple_m_set(Conf,m_ioDumpMaxRate);
+	m->m_def   = "0";
+	m->m_units = "MB/s";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "max repair read rate";
+	m->m_desc  = "Maximum disk read bandwidth used by repair/rebuild. 0 means unlimited.";
+	m->m_cgi   = "io_repair_max_rate";
+	simple_m_set(Conf,m_ioRepairMaxRate);
+	m->m_def   = "0";
+	m->m_units = "MB/s";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "query read deadline";
+	m->m_desc  = "Query disk reads are dispatched in deadline order. "
+		"This is the deadline of a query read relative to when it was queued.";
+	m->m_cgi   = "io_query_read_deadline";
+	simple_m_set(Conf,m_ioQueryReadDeadline);
+	m->m_def   = "100";
+	m->m_units = "milliseconds";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "query read latency target";
+	m->m_desc  = "If the 95th percentile of query disk read latency exceeds this then merge and repair "
+		"bandwidth is automatically throttled until the latency is back below the target. 0 disables automatic throttling.";
+	m->m_cgi   = "io_query_latency_target";
+	simple_m_set(Conf,m_ioQueryLatencyTarget);
+	m->m_def   = "0";
+	m->m_units = "milliseconds";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "min throttled merge rate";
+	m->m_desc  = "Automatic throttling never reduces merge and repair bandwidth below this.";
+	m->m_cgi   = "io_throttled_min_rate";
+	simple_m_set(Conf,m_ioThrottledMinRate);
+	m->m_def   = "4";
+	m->m_units = "MB/s";
+	m->m_min   = 1;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 
 	m->m_title = "flush disk writes";
 	m->m_desc  = "If enabled then all writes will be flushed to disk. "
@@ -7148,6 +7549,21 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_SEARCH;
 	m++;
 
+	m->m_title = "simhash dedup distance default value";
+	m->m_desc  = "If the content simhash of a document differs in at "
+		"most this many bits from that of a document above it, then "
+		"remove it from the search results. -1 means no simhash "
+		"deduping.";
+	m->m_cgi   = "sddd";
+	simple_m_set(CollectionRec,m_simHashDedupDistance);
+	m->m_def   = "3";
+	m->m_group = false;
+	m->m_smin  = -1;
+	m->m_smax  = SIMHASH_MAX_DISTANCE;
+	m->m_flags = PF_API | PF_CLONE;
+	m->m_page  = PAGE_SEARCH;
+	m++;
+
 	m->m_title = "sort language preference default";
 	m->m_desc  = "Default language to use for ranking results. "
 		//"This should only be used on limited collections. "
@@ -7480,6 +7896,42 @@ void Parms::init ( ) {
 	m->m_flags = 0;
 	m++;
 
+	m->m_title = "use frequent phrase termlists";
+	m->m_desc  = "If enabled, queries containing a phrase from frequent_phrases.txt read the "
+		"termlist of the whole phrase instead of the bigram termlists it consists of. "
+		"Only enable this after the documents have been indexed with the phrase list.";
+	m->m_cgi   = "frequentphrases";
+	simple_m_set(Conf,m_useFrequentPhrases);
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m++;
+
+	m->m_title = "max results per site per shard";
+	m->m_desc  = "When site clustering, each shard hides all but this many "
+		"results from the same site before returning its top docids.";
+	m->m_cgi   = "maxdocidspersite";
+	simple_m_set(Conf,m_maxDocIdsPerSite);
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "2";
+	m->m_min   = 1;
+	m->m_flags = 0;
+	m++;
+
+	m->m_title = "site cluster while scoring";
+	m->m_desc  = "If enabled, and the docid to site map is loaded, each "
+		"shard limits the results per site while scoring instead of "
+		"after, so the results of one site do not crowd out the "
+		"results of other sites and fewer re-queries are needed. "
+		"Off by default because it changes which results a shard "
+		"returns.";
+	m->m_cgi   = "siteclusterscoring";
+	simple_m_set(Conf,m_siteClusterWhileScoring);
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m++;
+
 	m->m_title = "Results validity time";
 	m->m_desc  = "Default validity time of a a search result. Currently static but will be more dynamic in the future.";
 	m->m_cgi   = "qresultsvaliditytime";
@@ -7750,6 +8202,39 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	////////////////////
+	// anchordb settings
+	////////////////////
+
+	m->m_title = "use anchordb";
+	m->m_desc  = "Store the link text of each outlink in anchordb when "
+	             "indexing and have the link info of a page read it from "
+	             "there instead of loading the title record of every "
+	             "inlinker. Inlinkers not in anchordb yet are still "
+	             "looked up. Anchordb fills up as pages are respidered. "
+	             "When turned off the records of respidered pages are "
+	             "still deleted so anchordb never holds stale link text.";
+	m->m_cgi   = "uadb";
+	simple_m_set(Conf,m_useAnchordb);
+	m->m_def   = "0";
+	m->m_page  = PAGE_RDB;
+	m->m_group = true;
+	m++;
+
+	m->m_title = "anchordb max tree mem";
+	m->m_desc  = "";
+	m->m_cgi   = "mamt";
+	simple_m_set(Conf,m_anchordbMaxTreeMem);
+#ifndef PRIVACORE_TEST_VERSION
+	m->m_def   = "40000000";
+#else
+	m->m_def   = "4000000";
+#endif
+	m->m_flags = PF_NOSYNC|PF_NOAPI;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
 	////////////////////
 	// posdb settings
 	////////////////////
@@ -7804,6 +8289,19 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "posdb copy-on-write dumps";
+	m->m_desc  = "If enabled then a full posdb memtable is swapped out and dumped "
+	             "while new records go into a fresh one, so adds are not held back "
+	             "for the duration of the dump. Posdb memory can use up to twice "
+	             "the max tree mem while dumping.";
+	m->m_cgi   = "pdsnap";
+	simple_m_set(Conf,m_posdbDumpSnapshot);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
 	////////////////////
 	// spiderdb settings
 	////////////////////
@@ -8023,6 +8521,87 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "memory-map rdb map files";
+	m->m_desc  = "If enabled then the page maps of data files are memory-mapped "
+	             "when a collection is loaded instead of being read into RAM, so "
+	             "map pages are only paged in when a lookup touches them and the "
+	             "kernel can evict cold ones. Takes effect for maps loaded after "
+	             "the change.";
+	m->m_cgi   = "mmaprdbmaps";
+	simple_m_set(Conf,m_mmapRdbMaps);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "memory-map rdb index files";
+	m->m_desc  = "If enabled then the docid sets of index files are memory-mapped "
+	             "when a collection is loaded instead of being read into RAM. "
+	             "Takes effect for index files loaded after the change.";
+	m->m_cgi   = "mmaprdbindexes";
+	simple_m_set(Conf,m_mmapRdbIndexes);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "warm up caches on start";
+	m->m_desc  = "If enabled then the posdb termlists and titledb records read "
+	             "by queries are remembered in hotset.dat. On start they are "
+	             "read ahead and the termfreq and disk page caches refilled "
+	             "before this host takes queries from its twins.";
+	m->m_cgi   = "warmupenabled";
+	simple_m_set(Conf,m_warmupEnabled);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "warm-up max ranges";
+	m->m_desc  = "Maximum number of hot key ranges to remember.";
+	m->m_cgi   = "warmupmaxranges";
+	simple_m_set(Conf,m_warmupMaxRanges);
+	m->m_def   = "100000";
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "warm-up max bytes";
+	m->m_desc  = "Maximum number of bytes of rdb files to read ahead on start.";
+	m->m_cgi   = "warmupmaxbytes";
+	simple_m_set(Conf,m_warmupMaxBytes);
+	m->m_def   = "2000000000";
+	m->m_units = "bytes";
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "warm-up max replays";
+	m->m_desc  = "Number of the hottest ranges read into the disk page cache on start.";
+	m->m_cgi   = "warmupmaxreplays";
+	simple_m_set(Conf,m_warmupMaxReplays);
+	m->m_def   = "2000";
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "warm-up max time";
+	m->m_desc  = "Take queries after this long even if the warm-up has not finished.";
+	m->m_cgi   = "warmupmaxtime";
+	simple_m_set(Conf,m_warmupMaxTime);
+	m->m_def   = "300";
+	m->m_units = "seconds";
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "Doledb nuke interval";
 	m->m_desc  = "Sometimes spiderrecords get stuck due to plain bugs or due to priority inversion."
 		"Nuking doledb periodically masks this. 0=disabled";
@@ -8340,6 +8919,20 @@ void Parms::init ( ) {
 	m->m_flags = PF_CLONE;
 	m++;
 
+	m->m_title = "near-duplicate deduping enabled";
+	m->m_desc  = "When enabled along with deduping, the spider will "
+		"also discard web pages whose words have the same simhash "
+		"as a web page already in the index, so copies with "
+		"different markup or a few changed words are caught too. "
+		"It does one more lookup per page.";
+	m->m_cgi   = "dnd";
+	simple_m_set(CollectionRec,m_nearDupDedupingEnabled);
+	m->m_def   = "0";
+	m->m_group = false;
+	m->m_page  = PAGE_SPIDER;
+	m->m_flags = PF_CLONE;
+	m++;
+
 	m->m_title = "deduping enabled for www";
 	m->m_desc  = "When enabled, the spider will "
 		"discard web pages which, when a www is prepended to the "
@@ -10978,6 +11571,8 @@ void Parms::handleRequest3fLoop(void *weArg) {
 	bool rebuildQueryLanguageSettings = false;
 	bool rebuildSiteNumInlinksSettings = false;
 	bool rebuildSiteMedianPageTemperatureSettings = false;
+	bool rebuildSerpBufferSettings = false;
+	bool rebuildSharedTermlistCache = false;
 
 	// process them
 	const char *p = we->m_parmPtr;
@@ -11086,6 +11681,14 @@ void Parms::handleRequest3fLoop(void *weArg) {
 			if (parm->m_flags & PF_REBUILDSITEMEDIANPAGETEMPSETTINGS) {
 				rebuildSiteMedianPageTemperatureSettings = true;
 			}
+
+			if (parm->m_flags & PF_REBUILDSERPBUFFERSETTINGS) {
+				rebuildSerpBufferSettings = true;
+			}
+
+			if (parm->m_flags & PF_REBUILDSHAREDTERMLISTCACHE) {
+				rebuildSharedTermlistCache = true;
+			}
 		}
 
 		// do the next parm
@@ -11163,6 +11766,16 @@ void Parms::handleRequest3fLoop(void *weArg) {
 		g_siteMedianPageTemperature.reinitializeSettings();
 	}
 
+	if (rebuildSerpBufferSettings) {
+		log("parms: rebuild serp buffer settings");
+		g_serpBufferPool.configure(g_conf.m_serpBufferPoolSize, g_conf.m_serpBufferMaxSize);
+	}
+
+	if (rebuildSharedTermlistCache) {
+		log("parms: rebuild shared termlist cache");
+		initSharedTermlistCache();
+	}
+
 	// note it
 	if ( ! we->m_sentReply )
 		log("parms: sending parm update reply");
@@ -10,9 +10,10 @@
 #include "fctypes.h"
 #include "utf8_fast.h"
 #include "hash.h"
+#include "Arena.h"
 
 
-Phrases::Phrases() : m_buf(NULL) {
+Phrases::Phrases() : m_buf(NULL), m_arena(NULL) {
 
 	memset(m_localBuf, 0, sizeof(m_localBuf));
 
@@ -30,7 +31,7 @@ Phrases::~Phrases ( ) {
 }
 
 void Phrases::reset() {
-	if ( m_buf && m_buf != m_localBuf ) {
+	if ( m_buf && m_buf != m_localBuf && !m_arena ) {
 		mfree ( m_buf , m_bufSize , "Phrases" );
 	}
 	m_buf = NULL;
@@ -51,7 +52,7 @@ bool Phrases::set(const TokenizerResult &tr, const Bits &bits) {
 
 	// alloc if we need to
 	if ( (unsigned)need > sizeof(m_localBuf) )
-		m_buf = (char *)mmalloc ( need , "Phrases" );
+		m_buf = (char *)(m_arena ? m_arena->alloc(need) : mmalloc(need, "Phrases"));
 	else
 		m_buf = m_localBuf;
 
@@ -14,6 +14,7 @@
 
 class TokenizerResult;
 class Bits;
+class Arena;
 
 
 class Phrases {
@@ -23,6 +24,9 @@ public:
 	~Phrases();
 	void reset() ;
 
+	// take the buffer from "arena" instead of Mem. call before set()
+	void setArena(Arena *arena) { m_arena = arena; }
+
 	// . set the hashes (m_phraseIds) of the phrases for these words
 	// . "bits" describes the words in a phrasing context
 	bool set(const TokenizerResult &tr, const Bits &bits);
@@ -49,6 +53,8 @@ private:
 	char *m_buf;
 	int32_t  m_bufSize;
 
+	Arena *m_arena;
+
 	// the two word hash
 	int64_t *m_phraseIds2;
 
@@ -8,6 +8,7 @@
 #include "Errno.h"
 #include "Log.h"
 #include "utf8_fast.h"
+#include "Arena.h"
 
 
 Pos::Pos() {
@@ -15,6 +16,7 @@ Pos::Pos() {
 	m_needsFree = false;
 	m_pos = NULL;
 	m_bufSize = 0;
+	m_arena = NULL;
 	memset(m_localBuf, 0, sizeof(m_localBuf));
 }
 
@@ -558,8 +560,13 @@ bool Pos::set(const TokenizerResult *tr, int32_t a, int32_t b) {
 
 	m_buf = m_localBuf;
 	if ( need > POS_LOCALBUFSIZE ) {
-		m_buf = (char *)mmalloc(need,"Pos");
-		m_needsFree = true;
+		if ( m_arena ) {
+			// freed with the arena
+			m_buf = (char *)m_arena->alloc(need);
+		} else {
+			m_buf = (char *)mmalloc(need,"Pos");
+			m_needsFree = true;
+		}
 	}
 
 	// bail on error
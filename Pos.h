@@ -13,6 +13,7 @@
 #define POS_LOCALBUFSIZE 20
 
 class TokenizerResult;
+class Arena;
 
 class Pos {
 
@@ -22,6 +23,9 @@ class Pos {
 	~Pos();
 	void reset();
 
+	// take the buffer from "arena" instead of Mem. call before set()
+	void setArena(Arena *arena) { m_arena = arena; }
+
 	bool set(const TokenizerResult *tr, int32_t a = 0, int32_t b = -1);
 
 	// . filter out xml words [a,b] into plain text, stores into "f"
@@ -42,6 +46,8 @@ private:
 	int32_t  m_bufSize;
 
 	bool  m_needsFree;
+
+	Arena *m_arena;
 };
 
 #endif // GB_POS_H
@@ -129,6 +129,7 @@ void PosdbTable::reset() {
 	m_docIdVoteBuf.reset();
 	m_filtered = 0;
 	m_queryTermInfos.clear();
+	m_lowSiteRankPostings.clear();
 	// assume no-op
 	m_t1 = 0LL;
 	m_whiteListTable.reset();
@@ -3461,6 +3462,8 @@ void PosdbTable::intersectLists() {
 void PosdbTable::intersectLists_real() {
 	logTrace(g_conf.m_logTracePosdb, "BEGIN. numTerms: %" PRId32, m_q->m_numTerms);
 
+	m_lowSiteRankPostings.clear();
+
 	if(m_topTree->getNumNodes()==0 && !allocateTopTree()) {
 		logTrace(g_conf.m_logTracePosdb, "END. could not allocate toptree");
 		g_errno = ENOMEM;
@@ -3504,6 +3507,8 @@ void PosdbTable::intersectLists_real() {
 		return;
 	}
 
+	summarizeLowSiteRankPostings();
+
 	//
 	// The vote buffer now contains the matching docids and each term sublist 
 	// has been adjusted to only contain these docids as well. Let the fun begin.
@@ -4022,6 +4027,14 @@ void PosdbTable::intersectLists_real() {
 				t->m_score = score;
 				t->m_docId = m_docId;
 				t->m_flags = flags;
+				// for limiting the docids per site in the top tree
+				t->m_siteHash32 = 0;
+				if( m_topTree->getMaxDocIdsPerSite() > 0 ) {
+					uint32_t sitehash32;
+					if( g_d2fasm.lookupSiteHash(m_docId, &sitehash32) ) {
+						t->m_siteHash32 = sitehash32;
+					}
+				}
 				logTrace(g_conf.m_logTracePosdb, "docid=%15ld score=%f", m_docId, score);
 
 				//
@@ -4261,6 +4274,179 @@ float PosdbTable::getMaxPossibleScore(const QueryTermInfo *qti) {
 }
 
 
+// . a document left out of the truncated list of a term either has all its
+//   postings of the term left out of the lists we read, or it is in the
+//   other lists of the term with a siterank of at most the highest one
+//   left out
+// . so its single term score sum for the term is bounded by the postings
+//   left out and m_lowSiteRankPostings, and its term match score, the
+//   minScore in intersectLists_real(), by that sum
+float PosdbTable::getMaxTermMatchScore() const {
+	if( m_q->m_isBoolean || m_numQueryTermInfos == 0 ) {
+		return FLT_MAX;
+	}
+	if( !m_msg2 || m_msg2->getMaxDroppedSiteRank() < 0 ) {
+		return 0.0;
+	}
+
+	// the boost for a bigram hit next to an ignored term
+	float maxBigramBoost = 1.0;
+	for( int32_t i = 0; i < m_q->m_numTerms; i++ ) {
+		maxBigramBoost = std::max(maxBigramBoost, m_q->m_qterms[i].m_termWeight);
+	}
+	float maxWikiBigramWeight = std::max((float)WIKI_BIGRAM_WEIGHT, 1.0f);
+
+	float maxScore = 0.0;
+	for( int32_t i = 0; i < m_numQueryTermInfos; i++ ) {
+		const QueryTermInfo *qti = &m_queryTermInfos[i];
+		PostingsSummary postings;
+		float maxTermWeight = 0.0;
+		for( int32_t k = 0; k < qti->m_numSubLists; k++ ) {
+			const QueryTerm *qt = qti->m_subList[k].m_qt;
+			postings.add(*m_msg2->getDroppedPostings(qt - m_q->m_qterms));
+			float termWeight = qt->m_userWeight;
+			termWeight *= qt->m_termFreqWeight * qt->m_termFreqWeight;
+			termWeight *= qt->m_termWeight * qt->m_termWeight;
+			maxTermWeight = std::max(maxTermWeight, termWeight);
+		}
+		// nothing of this term was left out
+		if( postings.empty() ) {
+			continue;
+		}
+		if( i < (int32_t)m_lowSiteRankPostings.size() ) {
+			postings.add(m_lowSiteRankPostings[i]);
+		}
+
+		float score = getMaxSingleTermScore(postings, m_derivedScoringWeights, m_realMaxTop);
+		score *= maxTermWeight;
+		score *= maxBigramBoost * maxBigramBoost;
+		score *= maxWikiBigramWeight * maxWikiBigramWeight;
+		maxScore = std::max(maxScore, score);
+	}
+
+	// the docid flag multipliers
+	for( int32_t i = 0; i < 26; i++ ) {
+		if( m_baseScoringParameters.m_flagScoreMultiplier[i] > 1.0 ) {
+			maxScore *= m_baseScoringParameters.m_flagScoreMultiplier[i];
+		}
+	}
+	return maxScore;
+}
+
+
+// . getBestScoreSumForSingleTerm() adds up to m_realMaxTop hits but only
+//   one per hashgroup (body ones count as one), except for inlink text
+// . each hit is at most 100 times the square of the best hashgroup,
+//   density and spam weights of the postings
+float PosdbTable::getMaxSingleTermScore(const PostingsSummary &postings, const DerivedScoringWeights &derivedScoringWeights, int32_t realMaxTop) {
+	initWeights();
+
+	float maxHashGroupWeight = 0.0;
+	uint32_t hashGroups = 0;
+	int32_t numHashGroups = 0;
+	for( int32_t hg = 0; hg < HASHGROUP_END; hg++ ) {
+		if( !(postings.hash_groups & (1U<<hg)) ) {
+			continue;
+		}
+		int32_t mhg = s_inBody[hg] ? HASHGROUP_BODY : hg;
+		if( !(hashGroups & (1U<<mhg)) ) {
+			hashGroups |= 1U<<mhg;
+			numHashGroups++;
+		}
+		maxHashGroupWeight = std::max(maxHashGroupWeight, derivedScoringWeights.m_hashGroupWeights[mhg]);
+	}
+	float maxDensityWeight = 0.0;
+	for( int32_t i = 0; i <= MAXDENSITYRANK; i++ ) {
+		if( postings.density_ranks & (1U<<i) ) {
+			maxDensityWeight = std::max(maxDensityWeight, derivedScoringWeights.m_densityWeights[i]);
+		}
+	}
+	float maxSpamWeight = 0.0;
+	for( int32_t i = 0; i <= MAXWORDSPAMRANK; i++ ) {
+		if( postings.word_spam_ranks & (1U<<i) ) {
+			maxSpamWeight = std::max(maxSpamWeight, derivedScoringWeights.m_wordSpamWeights[i]);
+		}
+		if( postings.linker_site_ranks & (1U<<i) ) {
+			maxSpamWeight = std::max(maxSpamWeight, derivedScoringWeights.m_linkerWeights[i]);
+		}
+	}
+
+	int32_t maxHits = realMaxTop;
+	if( !(postings.hash_groups & (1U<<HASHGROUP_INLINKTEXT)) ) {
+		maxHits = std::min(maxHits, numHashGroups);
+	}
+
+	float maxHitScore = 100.0;
+	maxHitScore *= maxHashGroupWeight * maxHashGroupWeight;
+	maxHitScore *= maxDensityWeight * maxDensityWeight;
+	maxHitScore *= maxSpamWeight * maxSpamWeight;
+	return maxHits * maxHitScore;
+}
+
+
+// . the final score is the term match score times the siterank, language
+//   and page temperature factors of intersectLists_real(). use the largest
+//   each of them can be
+float PosdbTable::getMaxScoreForSiteRank(int32_t siteRank, float termMatchScore) const {
+	return getMaxScoreForSiteRank(m_baseScoringParameters, siteRank, termMatchScore);
+}
+
+
+float PosdbTable::getMaxScoreForSiteRank(const BaseScoringParameters &baseScoringParameters, int32_t siteRank, float termMatchScore) {
+	// a better inlinking site raises the siterank by up to a third of the difference
+	float adjustedSiteRank = siteRank + (MAXSITERANK-siteRank) / 3.0;
+	float score = termMatchScore * (adjustedSiteRank*baseScoringParameters.m_siteRankMultiplier+1.0);
+
+	float maxLanguageWeight = 0.0;
+	for( int32_t i = 0; i < MAX_LANGUAGES; i++ ) {
+		maxLanguageWeight = std::max(maxLanguageWeight, baseScoringParameters.m_languageWeights[i]);
+	}
+	score *= maxLanguageWeight;
+
+	if( baseScoringParameters.m_usePageTemperatureForRanking ) {
+		score *= baseScoringParameters.m_pageTemperatureWeightMax;
+	}
+	return score;
+}
+
+
+// . the postings of the matching docids with a siterank of at most the
+//   highest one left out of the truncated lists, for
+//   getMaxTermMatchScore()
+// . a docid left out of a truncated list but found in the other lists of
+//   the term only got scored for the postings in those
+// . the sublists are shrunk to the matching docids by now, 12 byte keys
+//   followed by the 6 byte keys of the same docid
+void PosdbTable::summarizeLowSiteRankPostings() {
+	m_lowSiteRankPostings.assign(m_numQueryTermInfos, PostingsSummary());
+	int32_t maxSiteRank = m_msg2 ? m_msg2->getMaxDroppedSiteRank() : -1;
+	if( maxSiteRank < 0 ) {
+		return;
+	}
+
+	for( int32_t i = 0; i < m_numQueryTermInfos; i++ ) {
+		const QueryTermInfo *qti = &m_queryTermInfos[i];
+		for( int32_t j = 0; j < qti->m_numMatchingSubLists; j++ ) {
+			int32_t siteRank = 0;
+			for( const char *p = qti->m_matchingSublist[j].m_start; p < qti->m_matchingSublist[j].m_end; ) {
+				if( p[0] & 0x04 ) {
+					if( siteRank <= maxSiteRank ) {
+						m_lowSiteRankPostings[i].add(p);
+					}
+					p += 6;
+				} else {
+					siteRank = Posdb::getSiteRank(p);
+					if( siteRank <= maxSiteRank ) {
+						m_lowSiteRankPostings[i].add(p);
+					}
+					p += 12;
+				}
+			}
+		}
+	}
+}
+
+
 float PosdbTable::modifyMaxScoreByDistance(float score,
 					   int32_t bestDist,
 					   int32_t qdist,
@@ -4460,8 +4646,15 @@ bool PosdbTable::allocateTopTree() {
 		docsWanted = m_msg39req->m_docsToGet * 2;
 	}
 
+	// . limit the docids per site while scoring if we can get the site of
+	//   a docid cheaply
+	// . Msg39 clusters the rest with clusterdb afterwards
+	int32_t maxDocIdsPerSite = 0;
+	if(g_conf.m_siteClusterWhileScoring && !g_d2fasm.empty())
+		maxDocIdsPerSite = g_conf.m_maxDocIdsPerSite;
+
 	// this actually sets the # of nodes to MORE than nn!!!
-	if(!m_topTree->setNumNodes(docsWanted, m_msg39req->m_doSiteClustering)) {
+	if(!m_topTree->setNumNodes(docsWanted, m_msg39req->m_doSiteClustering, maxDocIdsPerSite)) {
 		log("toptree: toptree: error allocating nodes: %s",
 		    mstrerror(g_errno));
 		return false;
@@ -5,6 +5,7 @@
 #include "HashTableX.h"
 #include "ScoringWeights.h"
 #include "BaseScoringParameters.h"
+#include "TruncatedTermlists.h"
 #include "Lang.h"
 #include <vector>
 
@@ -97,6 +98,23 @@ public:
 	int64_t getTotalHits() const { return m_docIdVoteBuf.length() / 6; }
 	int32_t getFilteredCount() const { return m_filtered; }
 
+	// . upper bound of the term match score a document left out of the
+	//   truncated termlists of Msg2 can get for this query, that is before
+	//   siterank, language and page temperature are applied
+	// . 0 if they left out nothing, FLT_MAX if we can not tell
+	float getMaxTermMatchScore() const;
+
+	// . upper bound of the score of a document with a siterank of at most
+	//   "siteRank" and a term match score of at most "termMatchScore"
+	// . Msg39 uses it to tell if documents left out of the truncated
+	//   termlists could make it into the results
+	float getMaxScoreForSiteRank(int32_t siteRank, float termMatchScore) const;
+	static float getMaxScoreForSiteRank(const BaseScoringParameters &baseScoringParameters, int32_t siteRank, float termMatchScore);
+
+	// upper bound of the single term score sum of a document with only
+	// the postings in "postings", for a term weight of 1
+	static float getMaxSingleTermScore(const PostingsSummary &postings, const DerivedScoringWeights &derivedScoringWeights, int32_t realMaxTop);
+
 	// how long to add the last batch of lists
 	int64_t       m_addListsTime;
 	int64_t       m_t1 ;
@@ -173,6 +191,7 @@ private:
 	float getTermPairScoreForAny(const MiniMergeBuffer *miniMergeBuffer, int i, int j, const std::vector<const char *> &bestMinTermPairWindowPtrs, DocIdScore *pdcs);
 
 	void delNonMatchingDocIdsFromSubLists();
+	void summarizeLowSiteRankPostings();
 
 	// for intersecting docids
 	void addDocIdVotes( const QueryTermInfo *qti , int32_t listGroupNum );
@@ -198,6 +217,9 @@ private:
 	int32_t                 m_minTermListIdx;
 	// intersect docids from each QueryTermInfo into here
 	SafeBuf              m_docIdVoteBuf;
+	// per QueryTermInfo, the postings of the matching docids with a
+	// siterank a docid left out of a truncated list can have
+	std::vector<PostingsSummary> m_lowSiteRankPostings;
 
 	int32_t m_filtered;
 
@@ -4,7 +4,9 @@
 #include "Collectiondb.h"
 #include "Hostdb.h"
 #include "Tagdb.h"
+#include "Anchordb.h"
 #include "Posdb.h"
+#include "Msg2.h"
 #include "Titledb.h"
 #include "utf8_convert.h"
 #include "Sections.h"
@@ -50,6 +52,7 @@
 #include "QueryLanguage.h"
 #include "SiteNumInlinks.h"
 #include "SiteMedianPageTemperature.h"
+#include "Warmup.h"
 #include "Errno.h"
 #include <sys/statvfs.h>
 #include <pthread.h>
@@ -291,6 +294,7 @@ bool Process::init ( ) {
 	m_rdbs[m_numRdbs++] = g_clusterdb2.getRdb  ();
 	m_rdbs[m_numRdbs++] = g_linkdb2.getRdb     ();
 	m_rdbs[m_numRdbs++] = g_tagdb2.getRdb      ();
+	m_rdbs[m_numRdbs++] = g_anchordb.getRdb    ();
 	/////////////////
 	// CAUTION!!!
 	/////////////////
@@ -961,6 +965,9 @@ bool Process::saveBlockingFiles1 ( ) {
 	// save stats on spider proxies if any
 	saveSpiderProxyStats();
 
+	// save the hot ranges for warming up after a restart
+	g_warmup.save();
+
 	// . save the add state from Msg4.cpp
 	// . these are records in the middle of being added to rdbs across
 	//   the cluster
@@ -1021,6 +1028,9 @@ void Process::resetAll ( ) {
 	g_termFreqCache.reset();
 	g_termListSize.reset();
 
+	// bulk search termlists in Msg2.cpp
+	g_sharedTermlistCache.reset();
+
 	g_wiktionary.reset();
 
 	g_countryCode.reset();
@@ -12,6 +12,7 @@
 #include "HashTableX.h"
 #include "Synonyms.h"
 #include "HighFrequencyTermShortcuts.h"
+#include "FrequentPhrases.h"
 #include "Wiki.h"
 #include "ScoringWeights.h"
 #include "RdbList.h"
@@ -1393,6 +1394,9 @@ bool Query::setQTerms() {
 		// special flag
 		qt->m_isWikiHalfStopBigram = true;
 	}
+
+	if(g_conf.m_useFrequentPhrases && !g_frequentPhrases.empty() && !m_isBoolean)
+		substituteFrequentPhrases();
 	
 	if(g_conf.m_logTraceQuery)
 		traceTermsToLog("final query-terms");
@@ -3535,6 +3539,88 @@ int64_t Query::getQueryHash() const {
 	return qh;
 }
 
+//Use the termlist of frequent phrases (see FrequentPhrases.h) in the query instead of the
+//bigram termlists they consist of. For "to be or not to be" that is one short list instead of
+//four long ones. The first bigram term of the phrase gets the phrase termid, which is found at
+//the same word position in posdb, and the other bigram terms of the phrase are not read.
+void Query::substituteFrequentPhrases() {
+	int32_t maxWords = g_frequentPhrases.getMaxWords();
+	for(int32_t i=0; i<m_numWords; i++) {
+		const QueryWord *qw = &m_qwords[i];
+		if(!m_tr[i].is_alfanum)
+			continue;
+		QueryTerm *first = qw->m_queryPhraseTerm;
+		if(!first || !first->m_isPhrase || first->m_termSign=='-')
+			continue;
+
+		//walk the words as long as each one starts a bigram ending with the next word
+		int32_t wordNums[FREQUENTPHRASES_MAX_WORDS];
+		int32_t numWords = 0;
+		int32_t bestNumWords = 0;
+		uint64_t bestPhraseId = 0;
+		uint64_t h = 0;
+		int32_t pos = 0;
+		for(int32_t j=i; ; ) {
+			const QueryWord *w = &m_qwords[j];
+			h = FrequentPhrases::hashWord(h, w->m_word, w->m_wordLen, &pos);
+			wordNums[numWords++] = j;
+			if(numWords>=FREQUENTPHRASES_MIN_WORDS && g_frequentPhrases.isFrequentPhrase(h)) {
+				bestNumWords = numWords;
+				bestPhraseId = h;
+			}
+			if(numWords>=maxWords || numWords>=FREQUENTPHRASES_MAX_WORDS)
+				break;
+			//fielded words have prefixed termids which we do not index phrases for
+			if(!w->m_bigramId || w->m_prefixHash)
+				break;
+			int32_t k = j+1;
+			while(k<m_numWords && !m_tr[k].is_alfanum)
+				k++;
+			if(k>=m_numWords)
+				break;
+			if(m_qwords[k].m_word + m_qwords[k].m_wordLen != w->m_word + w->m_bigramLen)
+				break;
+			j = k;
+		}
+		if(bestNumWords==0)
+			continue;
+
+		const QueryWord *last = &m_qwords[wordNums[bestNumWords-1]];
+		logTrace(g_conf.m_logTraceQuery, "using frequent phrase termlist for '%.*s'", (int)(last->m_word + last->m_wordLen - qw->m_word), qw->m_word);
+
+		first->m_termId  = bestPhraseId & TERMID_MASK;
+		first->m_termLen = last->m_word + last->m_wordLen - first->m_term;
+
+		//the bigrams inside the phrase are covered by it
+		for(int32_t n=1; n+1<bestNumWords; n++) {
+			QueryTerm *qt = m_qwords[wordNums[n]].m_queryPhraseTerm;
+			if(!qt || qt==first)
+				continue;
+			if(qt->m_isRequired)
+				first->m_isRequired = true;
+			qt->m_isRequired = false;
+			qt->m_ignored = true;
+		}
+
+		//and the single words should not look for their lists
+		for(int32_t n=0; n<m_numTerms; n++) {
+			QueryTerm *qt = &m_qterms[n];
+			if(qt->m_leftPhraseTerm && qt->m_leftPhraseTerm->m_ignored) {
+				qt->m_leftPhraseTermNum = -1;
+				qt->m_leftPhraseTerm    = NULL;
+			}
+			if(qt->m_rightPhraseTerm && qt->m_rightPhraseTerm->m_ignored) {
+				qt->m_rightPhraseTermNum = -1;
+				qt->m_rightPhraseTerm    = NULL;
+			}
+		}
+
+		//a phrase can start with the last word of this one
+		i = wordNums[bestNumWords-1] - 1;
+	}
+}
+
+
 void QueryWord::constructor () {
 	m_synWordBuf.constructor();
 }
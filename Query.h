@@ -426,6 +426,9 @@ private:
 	// sets m_qterms[] array from the m_qwords[] array
 	bool setQTerms();
 
+	// use the termlists of phrases in g_frequentPhrases
+	void substituteFrequentPhrases();
+
 	// helper funcs for parsing query into m_qwords[]
 	bool        isConnection(unsigned i) const;
 
@@ -0,0 +1,133 @@
+#include "QueryPlanCache.h"
+#include "Query.h"
+#include "Mem.h"
+#include "fctypes.h"
+#include "ScopedLock.h"
+
+QueryPlanCache g_queryPlanCache;
+
+
+static const char memory_note[] = "queryplan";
+
+
+QueryPlanCache::QueryPlanCache()
+  : m(),
+    purge_iter(m.begin()),
+    max_age(600000), //10 minutes
+    max_items(100),
+    mtx()
+{
+}
+
+
+void QueryPlanCache::configure(int64_t max_age_, size_t max_items_)
+{
+	ScopedLock sl(mtx);
+	max_age = max_age_;
+	max_items = max_items_;
+}
+
+
+void QueryPlanCache::clear()
+{
+	ScopedLock sl(mtx);
+	for(std::map<int64_t,Item>::iterator iter = m.begin();
+	    iter!=m.end();
+	    ++iter)
+		deleteQuery(iter->second.query);
+	m.clear();
+	purge_iter = m.begin();
+}
+
+
+Query *QueryPlanCache::checkout(int64_t key, const char *query)
+{
+	ScopedLock sl(mtx);
+
+	purge_step();
+	std::map<int64_t,Item>::iterator iter = m.find(key);
+	if(iter==m.end())
+		return NULL;
+
+	Query *q = iter->second.query;
+	bool expired = iter->second.timestamp+max_age<gettimeofdayInMilliseconds();
+	bool sameQuery = strcmp(q->originalQuery(),query)==0;
+
+	if(purge_iter==iter)
+		++purge_iter;
+	m.erase(iter);
+
+	if(expired || !sameQuery) {
+		deleteQuery(q);
+		return NULL;
+	}
+	return q;
+}
+
+
+void QueryPlanCache::checkin(int64_t key, Query *q)
+{
+	ScopedLock sl(mtx);
+
+	purge_step();
+
+	if(max_age==0 || max_items==0 || m.find(key)!=m.end()) {
+		//cache disabled, or another msg39 with the same query got there first
+		deleteQuery(q);
+		return;
+	}
+
+	//forget what the last request read
+	for(int32_t i=0; i<q->m_numTerms; i++)
+		q->m_qterms[i].m_posdbListPtr = NULL;
+
+	Item item;
+	item.timestamp = gettimeofdayInMilliseconds();
+	item.query = q;
+	m.insert(std::make_pair(key,item));
+
+	while(m.size()>max_items)
+		forced_purge_step();
+}
+
+
+size_t QueryPlanCache::size()
+{
+	ScopedLock sl(mtx);
+	return m.size();
+}
+
+
+void QueryPlanCache::purge_step()
+{
+	if(purge_iter==m.end())
+		purge_iter = m.begin();
+	else {
+		int64_t now = gettimeofdayInMilliseconds();
+		if(purge_iter->second.timestamp+max_age<now) {
+			std::map<int64_t,Item>::iterator iter = purge_iter;
+			++purge_iter;
+			deleteQuery(iter->second.query);
+			m.erase(iter);
+		} else
+			++purge_iter;
+	}
+}
+
+
+void QueryPlanCache::forced_purge_step()
+{
+	if(purge_iter==m.end())
+		purge_iter = m.begin();
+	std::map<int64_t,Item>::iterator iter = purge_iter;
+	++purge_iter;
+	deleteQuery(iter->second.query);
+	m.erase(iter);
+}
+
+
+void QueryPlanCache::deleteQuery(Query *q)
+{
+	mdelete(q, sizeof(Query), memory_note);
+	delete q;
+}
@@ -0,0 +1,62 @@
+#ifndef GB_QUERYPLANCACHE_H
+#define GB_QUERYPLANCACHE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <map>
+#include "GbMutex.h"
+
+class Query;
+
+// . keeps the Query instances of finished Msg39 requests around so the next
+//   request for the same query on this shard does not have to tokenize it,
+//   look up synonyms and word variations and build the query terms again
+// . a Query points into itself all over the place, so instead of copying it
+//   we hand the instance itself to one Msg39 at a time: checkout() removes
+//   it from the cache and checkin() gives it back when the Msg39 is done
+// . the key is a hash of everything that went into Query::set() and
+//   Query::modifyQuery(), see Msg39.cpp
+class QueryPlanCache {
+	QueryPlanCache(const QueryPlanCache&);
+	QueryPlanCache& operator=(const QueryPlanCache&);
+
+	struct Item {
+		int64_t timestamp;
+		Query *query;
+	};
+	std::map<int64_t,Item> m;
+	std::map<int64_t,Item>::iterator purge_iter;
+	int64_t max_age;
+	size_t max_items;
+	GbMutex mtx;
+
+public:
+	QueryPlanCache();
+	~QueryPlanCache() { clear(); }
+
+	void configure(int64_t max_age, size_t max_items);
+
+	void clear();
+
+	// . take the query for "key" out of the cache, NULL if we do not have it
+	// . "query" must match the original query string it was set from
+	Query *checkout(int64_t key, const char *query);
+
+	// . give a query back, or add a new one. we own it from now on and
+	//   delete it if it is not wanted
+	// . it must have been allocated with new and registered with
+	//   mnew(q,sizeof(Query),"queryplan")
+	void checkin(int64_t key, Query *q);
+
+	size_t size();
+
+private:
+	void purge_step();
+	void forced_purge_step();
+	void deleteQuery(Query *q);
+};
+
+
+extern QueryPlanCache g_queryPlanCache;
+
+#endif
@@ -12,6 +12,7 @@
 #include "SpiderColl.h"
 #include "Doledb.h"
 #include "Linkdb.h"
+#include "Anchordb.h"
 #include "Collectiondb.h"
 #include "hash.h"
 #include "Stats.h"
@@ -47,6 +48,7 @@ Rdb::Rdb ( ) {
 	m_useHalfKeys = false;
 	m_niceness = false;
 	m_isDumping = false;
+	m_isSnapshotDump = false;
 	m_rdbId = RDB_NONE;
 	m_ks = 0;
 	m_pageSize = 0;
@@ -62,6 +64,7 @@ void Rdb::reset ( ) {
 	// reset tree and cache
 	m_tree.reset();
 	m_buckets.reset();
+	m_dumpBuckets.reset();
 	m_mem.reset();
 }
 
@@ -118,6 +121,7 @@ bool Rdb::init(const char *dbname,
 	m_ks               = keySize;
 	m_useIndexFile     = useIndexFile;
 	m_isDumping       = false;
+	m_isSnapshotDump  = false;
 
 	// set our id
 	m_rdbId = getIdFromRdb(this);
@@ -142,6 +146,7 @@ bool Rdb::init(const char *dbname,
 		case RDB2_SPIDERDB2_DEPRECATED:
 		case RDB_LINKDB:
 		case RDB2_LINKDB2:
+		case RDB_ANCHORDB:
 			m_pageSize = GB_INDEXDB_PAGE_SIZE;
 			break;
 		// Not a real rdb: case RDB_SPIDERDB_SQLITE:
@@ -171,6 +176,12 @@ bool Rdb::init(const char *dbname,
 			log( LOG_ERROR, "db: Failed to set buckets." );
 			return false;
 		}
+
+		// holds the full buckets while they are being dumped (see submitRdbDumpJob)
+		if (!m_dumpBuckets.set(fixedDataSize, maxTreeMem, m_treeAllocName, m_rdbId, m_dbname, m_ks)) {
+			log( LOG_ERROR, "db: Failed to set dump buckets." );
+			return false;
+		}
 	}
 
 	// now get how much mem the tree is using (not including stored recs)
@@ -337,7 +348,10 @@ bool Rdb::updateToRebuildFiles ( Rdb *rdb2 , char *coll ) {
 
 	// clean out tree, newly rebuilt rdb does not have any data in tree
 	if ( m_useTree ) m_tree.delColl ( collnum );
-	else m_buckets.delColl(collnum);
+	else {
+		m_buckets.delColl(collnum);
+		m_dumpBuckets.delColl(collnum);
+	}
 	// reset our cache
 	//m_cache.clear ( collnum );
 
@@ -439,7 +453,10 @@ bool Rdb::deleteAllRecs ( collnum_t collnum ) {
 
 	// remove from tree
 	if(m_useTree) m_tree.delColl    ( collnum );
-	else m_buckets.delColl(collnum);
+	else {
+		m_buckets.delColl(collnum);
+		m_dumpBuckets.delColl(collnum);
+	}
 
 	// only for doledb now, because we unlink we do not move the files
 	// into the trash subdir and doledb is easily regenerated. i don't
@@ -500,6 +517,7 @@ bool Rdb::deleteColl( collnum_t collnum, collnum_t newCollnum) {
 	}
 	else {
 		m_buckets.delColl(collnum);
+		m_dumpBuckets.delColl(collnum);
 	}
 
 	// . close all files, set m_numFiles to 0 in RdbBase
@@ -591,6 +609,13 @@ bool Rdb::saveTree(bool useThread, void *state, void (*callback)(void *state)) {
 	// . sets g_errno on error
 	if (m_useTree) {
 		result = m_tree.fastSave(getDir(), useThread, state, callback);
+	} else if (m_isSnapshotDump || !restorePendingSnapshot()) {
+		// . the saved file would lack the records being dumped from the snapshot,
+		//   and loading it after a crash would lose them for good
+		// . so do not save until the dump is done. the records added since the
+		//   last save are only in memory until then
+		log(LOG_INFO, "db: Not saving %s buckets while dumping a snapshot of them.", m_dbname);
+		result = true;
 	} else {
 		result = m_buckets.fastSave(getDir(), useThread, state, callback);
 	}
@@ -748,6 +773,18 @@ void Rdb::submitRdbDumpJob(bool forceDump) {
 		return;
 	}
 
+	// . buckets without record data can be swapped out so adds go into a fresh
+	//   memtable while the full one is dumped. tree rdbs keep their data in m_mem
+	//   so they still have to stop adding until the dump is done
+	// . a snapshot left over from a failed dump is dumped again as is
+	if (!m_useTree && m_fixedDataSize == 0 && g_conf.m_posdbDumpSnapshot) {
+		ScopedLock sl(m_dumpBucketsMtx);
+		if (m_dumpBuckets.getNumKeys() == 0) {
+			m_buckets.swap(&m_dumpBuckets);
+		}
+		m_isSnapshotDump = true;
+	}
+
 	s_rdbDumpThreadQueue.addItem(this);
 
 	log(LOG_INFO, "db: Submitted job %p to dump tree for %s", this, getDbname());
@@ -848,8 +885,10 @@ bool Rdb::dumpTree() {
 }
 
 bool Rdb::dumpColl(RdbBase *base) {
+	RdbBuckets *buckets = m_isSnapshotDump ? &m_dumpBuckets : getBuckets();
+
 	// before we create the file, see if tree has anything for this coll
-	if (!getTreeCollExist(base->getCollnum())) {
+	if (m_isSnapshotDump ? !m_dumpBuckets.collExists(base->getCollnum()) : !getTreeCollExist(base->getCollnum())) {
 		return true;
 	}
 
@@ -911,7 +950,7 @@ bool Rdb::dumpColl(RdbBase *base) {
 	// . but we only return false on error here
 	if (!m_dump.set(base->getCollnum(),
 	                base->getFile(fn),
-	                getBuckets(),
+	                buckets,
 	                getTree(),
 	                base->getMap(fn),
 	                base->getIndex(fn),
@@ -963,7 +1002,10 @@ void Rdb::doneDumping ( ) {
 	if ( ! m_dumpErrno ) {
 		if(m_useTree)
 			m_tree.clear();
-		else
+		else if(m_isSnapshotDump) {
+			ScopedLock sl(m_dumpBucketsMtx);
+			m_dumpBuckets.clear();
+		} else
 			m_buckets.clear();
 		m_mem.clear();
 		
@@ -972,6 +1014,10 @@ void Rdb::doneDumping ( ) {
 			if (base) {
 				if (isUseIndexFile()) {
 					base->clearTreeIndex();
+					if (m_isSnapshotDump) {
+						// records added while dumping are still in memory
+						addBucketsToTreeIndex(base);
+					}
 					base->submitGlobalIndexJob(true, base->getDumpingFileId());
 				} else {
 					base->markNewFileReadable();
@@ -986,8 +1032,20 @@ void Rdb::doneDumping ( ) {
 		else
 			log(LOG_ERROR,"db: Error encountered while dumping %s tree to file: %s",
 			    m_dbname, mstrerror(m_dumpErrno));
+
+		// put the snapshot back so it gets saved with the rest. if there is no room
+		// for it, it stays around and is dumped again next time
+		if (m_isSnapshotDump) {
+			ScopedLock sl(m_dumpBucketsMtx);
+			if (!m_dumpBuckets.restoreSnapshot(&m_buckets)) {
+				log(LOG_ERROR, "db: Keeping %" PRId32" %s records from failed dump in memory until next dump.",
+				    m_dumpBuckets.getNumKeys(), m_dbname);
+			}
+		}
 	}
 
+	m_isSnapshotDump = false;
+
 	// . tell RdbDump it is done
 	// . we have to set this here otherwise RdbMem's memory ring buffer
 	//   will think the dumping is no longer going on and use the primary
@@ -1066,6 +1124,7 @@ void attemptMergeAll() {
 			RDB_LINKDB,
 			RDB_SPIDERDB_DEPRECATED,
 			RDB_CLUSTERDB,
+			RDB_ANCHORDB,
 			// also try to merge on rdbs being rebuilt
 			RDB2_POSDB2,
 			RDB2_TITLEDB2,
@@ -1212,6 +1271,18 @@ bool Rdb::addList(collnum_t collnum, RdbList *list, bool checkForRoom) {
 }
 
 
+// . delete the opposite of a key being added from the active buckets
+// . returns true if it was deleted and the key being added can be dropped
+// . the snapshot being dumped is never modified, RdbDump may have written the
+//   opposite key to disk already. while there is a snapshot the key being added
+//   is always kept so it annihilates the opposite key in reads and merges
+bool Rdb::deleteBucketsNode(collnum_t collnum, const char *key) {
+	bool deleted = m_buckets.deleteNode(collnum, key);
+	ScopedLock sl(m_dumpBucketsMtx);
+	return deleted && m_dumpBuckets.getNumKeys() == 0;
+}
+
+
 //delete node and data in tree. Currently only called by SpiderLoop
 bool Rdb::deleteTreeNode(collnum_t collnum, const char *key) {
 	if(!m_useTree)
@@ -1341,7 +1412,7 @@ bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_
 	}
 
 	// we must not get into this state (we must not insert while dumping; and vice versa)
-	if (isDumping()) {
+	if (isDumpBlockingAdds()) {
 		gbshutdownLogicError();
 	}
 
@@ -1426,7 +1497,7 @@ bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_
 				// if it's a positive key, we need to delete the existing delete doc key that could be present in tree/bucket
 				if (!isShardedByTermIdSameHost && !KEYNEG(key)) {
 					Posdb::makeDeleteDocKey(specialOppKey, Posdb::getDocId(key), false);
-					(void)(m_useTree ? m_tree.deleteNode(collnum, oppKey, true) : m_buckets.deleteNode(collnum, oppKey));
+					(void)(m_useTree ? m_tree.deleteNode(collnum, oppKey, true) : deleteBucketsNode(collnum, oppKey));
 				}
 			}
 		} else {
@@ -1440,7 +1511,7 @@ bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_
 
 		// we only need to delete opposing key when it's a negative key, or it's a special key (even if it's positive)
 		if (KEYNEG(key) || isSpecialKey) {
-			bool deleted = m_useTree ? m_tree.deleteNode(collnum, oppKey, true) : m_buckets.deleteNode(collnum, oppKey);
+			bool deleted = m_useTree ? m_tree.deleteNode(collnum, oppKey, true) : deleteBucketsNode(collnum, oppKey);
 
 			// only return if we don't need to add special deleteDoc key for shardByTermId
 			if (deleted && (!isShardedByTermId || (isShardedByTermId && isShardedByTermIdSameHost))) {
@@ -1455,8 +1526,8 @@ bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_
 
 		// if we have no files on disk for this db, don't bother preserving a a negative rec, it just wastes tree space
 		if (KEYNEG(key)) {
-			// return if all data is in the tree
-			if (getBase(collnum)->getNumFiles() == 0) {
+			// return if all data is in the tree (and not in a snapshot about to become a file)
+			if (getBase(collnum)->getNumFiles() == 0 && m_dumpBuckets.getNumKeys() == 0) {
 				logTrace(g_conf.m_logTraceRdb, "END. %s: Negative key with all data in tree. Returning true", m_dbname);
 				return true;
 			}
@@ -1617,7 +1688,17 @@ bool Rdb::getTreeList(RdbList *result,
 		*memUsedByTree = m_tree.getMemOccupiedForList();
 		*numUsedNodes = m_tree.getNumUsedNodes();
 	} else {
-		if(!m_buckets.getList(collnum,
+		ScopedLock sl(m_dumpBucketsMtx);
+		if(m_dumpBuckets.getNumKeys() > 0) {
+			if(!getSnapshotBucketsList(result,
+						   collnum,
+						   static_cast<const char*>(startKey),
+						   static_cast<const char*>(endKey),
+						   minRecSizes,
+						   numPositiveRecs,
+						   numNegativeRecs))
+				return true;
+		} else if(!m_buckets.getList(collnum,
 				      static_cast<const char*>(startKey),
 				      static_cast<const char*>(endKey),
 				      minRecSizes,
@@ -1642,6 +1723,138 @@ bool Rdb::getTreeList(RdbList *result,
 	
 }
 
+// . get a list from both the buckets snapshot being dumped and the active buckets
+// . for equal keys the record from the active buckets wins, it is the newest
+// . caller must hold m_dumpBucketsMtx
+bool Rdb::getSnapshotBucketsList(RdbList *result, collnum_t collnum, const char *startKey, const char *endKey,
+				 int32_t minRecSizes, int32_t *numPositiveRecs, int32_t *numNegativeRecs) {
+	RdbList snapshotList;
+	RdbList activeList;
+	int32_t dummyPos = 0;
+	int32_t dummyNeg = 0;
+
+	if (!m_dumpBuckets.getList(collnum, startKey, endKey, minRecSizes, &snapshotList, &dummyPos, &dummyNeg, false) ||
+	    !m_buckets.getList(collnum, startKey, endKey, minRecSizes, &activeList, &dummyPos, &dummyNeg, false)) {
+		return false;
+	}
+
+	// a list truncated by minRecSizes is only complete up to its end key
+	char mergeEndKey[MAX_KEY_BYTES];
+	KEYSET(mergeEndKey, endKey, m_ks);
+	if (KEYCMP(snapshotList.getEndKey(), mergeEndKey, m_ks) < 0) {
+		KEYSET(mergeEndKey, snapshotList.getEndKey(), m_ks);
+	}
+	if (KEYCMP(activeList.getEndKey(), mergeEndKey, m_ks) < 0) {
+		KEYSET(mergeEndKey, activeList.getEndKey(), m_ks);
+	}
+
+	result->reset();
+	result->setKeySize(m_ks);
+	result->set(startKey, mergeEndKey);
+	result->setFixedDataSize(m_fixedDataSize);
+	result->setUseHalfKeys(useHalfKeys());
+
+	if (!result->growList(snapshotList.getListSize() + activeList.getListSize())) {
+		return false;
+	}
+
+	*numPositiveRecs = 0;
+	*numNegativeRecs = 0;
+
+	char snapshotKey[MAX_KEY_BYTES];
+	char activeKey[MAX_KEY_BYTES];
+	char lastKey[MAX_KEY_BYTES];
+	bool haveLastKey = false;
+
+	snapshotList.resetListPtr();
+	activeList.resetListPtr();
+
+	while (!snapshotList.isExhausted() || !activeList.isExhausted()) {
+		RdbList *src;
+		const char *key;
+
+		if (activeList.isExhausted()) {
+			snapshotList.getCurrentKey(snapshotKey);
+			src = &snapshotList;
+			key = snapshotKey;
+		} else if (snapshotList.isExhausted()) {
+			activeList.getCurrentKey(activeKey);
+			src = &activeList;
+			key = activeKey;
+		} else {
+			snapshotList.getCurrentKey(snapshotKey);
+			activeList.getCurrentKey(activeKey);
+
+			// ignore the delbit so a newer negative key annihilates an older positive one
+			char cmp = KEYCMPNEGEQ(snapshotKey, activeKey, m_ks);
+			if (cmp < 0) {
+				src = &snapshotList;
+				key = snapshotKey;
+			} else {
+				if (cmp == 0) {
+					snapshotList.skipCurrentRecord();
+				}
+				src = &activeList;
+				key = activeKey;
+			}
+		}
+
+		if (KEYCMP(key, mergeEndKey, m_ks) > 0) {
+			break;
+		}
+
+		if (!result->addRecord(key, 0, NULL)) {
+			return false;
+		}
+
+		if (KEYNEG(key)) {
+			++*numNegativeRecs;
+		} else {
+			++*numPositiveRecs;
+		}
+
+		KEYSET(lastKey, key, m_ks);
+		haveLastKey = true;
+
+		src->skipCurrentRecord();
+	}
+
+	if (haveLastKey) {
+		result->setLastKey(lastKey);
+	}
+
+	return true;
+}
+
+// . put a snapshot left over from a failed dump back into the buckets
+// . returns false if it is still there
+bool Rdb::restorePendingSnapshot() {
+	ScopedLock sl(m_dumpBucketsMtx);
+	if (m_isSnapshotDump || m_dumpBuckets.getNumKeys() == 0) {
+		return !m_isSnapshotDump;
+	}
+	return m_dumpBuckets.restoreSnapshot(&m_buckets);
+}
+
+// re-add the docids of records that are still in the buckets after a snapshot dump
+void Rdb::addBucketsToTreeIndex(RdbBase *base) {
+	RdbIndex *index = base->getTreeIndex();
+	if (!index) {
+		return;
+	}
+
+	RdbList list;
+	int32_t numPosRecs = 0;
+	int32_t numNegRecs = 0;
+	if (!m_buckets.getList(base->getCollnum(), KEYMIN(), KEYMAX(), -1, &list, &numPosRecs, &numNegRecs, useHalfKeys())) {
+		log(LOG_WARN, "db: Could not re-add in-memory %s records to tree index: %s", m_dbname, mstrerror(g_errno));
+		return;
+	}
+
+	list.resetListPtr();
+	index->addList(&list);
+}
+
 
 // . return number of positive records - negative records
 int64_t Rdb::getNumTotalRecs(bool useCache) const {
@@ -1769,6 +1982,7 @@ Rdb *getRdbFromId ( rdbid_t rdbId ) {
 		case RDB_DOLEDB: return g_doledb.getRdb();
 		case RDB_CLUSTERDB: return g_clusterdb.getRdb();
 		case RDB_LINKDB: return g_linkdb.getRdb();
+		case RDB_ANCHORDB: return g_anchordb.getRdb();
 
 		case RDB2_POSDB2: return g_posdb2.getRdb();
 		case RDB2_TITLEDB2: return g_titledb2.getRdb();
@@ -1790,6 +2004,7 @@ rdbid_t getIdFromRdb ( Rdb *rdb ) {
 	if ( rdb == g_doledb.getRdb    () ) return RDB_DOLEDB;
 	if ( rdb == g_clusterdb.getRdb () ) return RDB_CLUSTERDB;
 	if ( rdb == g_linkdb.getRdb    () ) return RDB_LINKDB;
+	if ( rdb == g_anchordb.getRdb  () ) return RDB_ANCHORDB;
 	if ( rdb == g_posdb2.getRdb   () ) return RDB2_POSDB2;
 	if ( rdb == g_tagdb2.getRdb     () ) return RDB2_TAGDB2;
 	if ( rdb == g_titledb2.getRdb   () ) return RDB2_TITLEDB2;
@@ -1823,6 +2038,7 @@ char getKeySizeFromRdbId(rdbid_t rdbId) {
 		case RDB2_SPIDERDB2_DEPRECATED:
 		case RDB_TAGDB:
 		case RDB2_TAGDB2:
+		case RDB_ANCHORDB:
 			return sizeof(key128_t); // 16
 		case RDB_POSDB:
 		case RDB2_POSDB2:
@@ -1867,7 +2083,8 @@ int32_t getDataSizeFromRdbId ( rdbid_t rdbId ) {
 				  i == RDB_TAGDB   ||
 				  i == RDB_SPIDERDB_DEPRECATED ||
 				  i == RDB_SPIDERDB_SQLITE ||
-				  i == RDB_DOLEDB )
+				  i == RDB_DOLEDB ||
+				  i == RDB_ANCHORDB )
 				ds = -1;
 			else if ( i == RDB2_POSDB2 ||
 				  i == RDB2_CLUSTERDB2 ||
@@ -1934,6 +2151,10 @@ bool initialiseAllPrimaryRdbs() {
 		log( LOG_ERROR, "db: Linkdb init failed." );
 		return false;
 	}
+	if(!g_anchordb.init()) {
+		log( LOG_ERROR, "db: Anchordb init failed." );
+		return false;
+	}
 	return true;
 }
 
@@ -11,6 +11,7 @@
 #include "RdbDump.h"
 #include "RdbBuckets.h"
 #include "RdbIndex.h"
+#include "GbMutex.h"
 #include "Hostdb.h"
 #include "rdbid_t.h"
 #include <atomic>
@@ -196,6 +197,10 @@ public:
 
 	bool isDumping() const { return m_isDumping; }
 
+	// true if adds have to wait for the dump to finish. copy-on-write dumps of
+	// buckets let adds continue into a fresh memtable
+	bool isDumpBlockingAdds() const { return m_isDumping && !m_isSnapshotDump; }
+
 	bool isUseIndexFile() const { return m_useIndexFile; }
 
 	// . you'll lose your data in this class if you call this
@@ -252,6 +257,12 @@ private:
 	// . called when we've dumped the tree to disk w/ keys ordered
 	void doneDumping ( );
 
+	bool getSnapshotBucketsList(RdbList *result, collnum_t collnum, const char *startKey, const char *endKey,
+				    int32_t minRecSizes, int32_t *numPositiveRecs, int32_t *numNegativeRecs);
+	void addBucketsToTreeIndex(RdbBase *base);
+	bool deleteBucketsNode(collnum_t collnum, const char *key);
+	bool restorePendingSnapshot();
+
 	int32_t reclaimMemFromDeletedTreeNodes();
 	int32_t m_lastReclaim;
 
@@ -266,6 +277,11 @@ private:
 	RdbTree    m_tree;  
 	RdbBuckets m_buckets;
 
+	// full buckets being dumped while new records go into m_buckets.
+	// m_dumpBucketsMtx protects swapping them against readers of both
+	RdbBuckets m_dumpBuckets;
+	mutable GbMutex m_dumpBucketsMtx;
+
 	bool       m_useTree;
 
 	// for dumping a table to an rdb file
@@ -314,6 +330,7 @@ private:
 	// set to true when dumping tree so RdbMem does not use the memory
 	// being dumped to hold newly added records
 	std::atomic<bool> m_isDumping;
+	std::atomic<bool> m_isSnapshotDump;
 
 	rdbid_t m_rdbId;
 
@@ -5,6 +5,9 @@
 #include "Tagdb.h"
 #include "Posdb.h"
 #include "Titledb.h"
+#include "TruncatedTermlists.h"
+#include "Msg2.h"
+#include "RdbCache.h"
 #include "Sections.h"
 #include "Spider.h"
 #include "Linkdb.h"
@@ -1048,7 +1051,7 @@ int32_t RdbBase::addFile ( bool isNew, int32_t fileId, int32_t fileId2, int32_t
 
 		if (!isNew) {
 			log(LOG_DEBUG, "db: Added %s for collnum=%" PRId32" docId count=%" PRIu64,
-			    indexName, (int32_t)m_collnum, in->getDocIds()->size());
+			    indexName, (int32_t)m_collnum, (uint64_t)in->getDocIdSet()->size());
 		}
 	}
 
@@ -1254,6 +1257,7 @@ static int32_t getMaxLostPositivesPercentage(rdbid_t rdbId) {
 			return g_conf.m_spiderdbMaxLostPositivesPercentage;
 		case RDB_LINKDB:
 		case RDB2_LINKDB2:
+		case RDB_ANCHORDB:
 			return g_conf.m_linkdbMaxLostPositivesPercentage;
 		case RDB_NONE:
 		case RDB_END:
@@ -1443,6 +1447,16 @@ void RdbBase::incorporateMerge2() {
 		submitGlobalIndexJob_unlocked(false, -1);
 	}
 
+	// the truncated and shared termlists of the merged files are gone
+	// with them and their file ids may be reused
+	if ( m_rdb->getRdbId() == RDB_POSDB ) {
+		g_truncatedTermlists.clear(m_collnum);
+		if ( g_sharedTermlistCache.isInitialized() ) {
+			RdbCacheLock rcl(g_sharedTermlistCache);
+			g_sharedTermlistCache.clear(m_collnum);
+		}
+	}
+
 	{
 		ScopedLock sl(m_mtxJobCount);
 		m_submittingJobs = true;
@@ -2644,13 +2658,13 @@ void RdbBase::finalizeGlobalIndexThread() {
 	m_globalIndexThreadQueue.finalize();
 }
 
-std::vector<std::pair<int32_t, docidsconst_ptr_t>> RdbBase::prepareGlobalIndexJob(bool markFileReadable, int32_t fileId) {
+std::vector<std::pair<int32_t, docidsetconst_ptr_t>> RdbBase::prepareGlobalIndexJob(bool markFileReadable, int32_t fileId) {
 	ScopedLock sl(m_mtxFileInfo);
 	return prepareGlobalIndexJob_unlocked(markFileReadable, fileId);
 }
 
-std::vector<std::pair<int32_t, docidsconst_ptr_t>> RdbBase::prepareGlobalIndexJob_unlocked(bool markFileReadable, int32_t fileId) {
-	std::vector<std::pair<int32_t, docidsconst_ptr_t>> docIdFileIndexes;
+std::vector<std::pair<int32_t, docidsetconst_ptr_t>> RdbBase::prepareGlobalIndexJob_unlocked(bool markFileReadable, int32_t fileId) {
+	std::vector<std::pair<int32_t, docidsetconst_ptr_t>> docIdFileIndexes;
 
 	// global index does not include RdbIndex from tree/buckets
 	for (int32_t i = 0; i < m_numFiles; i++) {
@@ -2659,7 +2673,7 @@ std::vector<std::pair<int32_t, docidsconst_ptr_t>> RdbBase::prepareGlobalIndexJo
 		}
 
 		if(m_fileInfo[i].m_allowReads || m_fileInfo[i].m_pendingGenerateIndex) {
-			docIdFileIndexes.emplace_back(i, m_fileInfo[i].m_index->getDocIds());
+			docIdFileIndexes.emplace_back(i, m_fileInfo[i].m_index->getDocIdSet());
 		}
 	}
 
@@ -2707,10 +2721,10 @@ void RdbBase::generateGlobalIndex(void *item) {
 		const auto &docIds = it->second;
 
 		tmpDocIdFileIndex->reserve(tmpDocIdFileIndex->size() + docIds->size());
-		std::transform(docIds->begin(), docIds->end(), std::back_inserter(*tmpDocIdFileIndex),
-		               [i](uint64_t docId) {
-		                   return ((docId << s_docIdFileIndex_docIdOffset) | i); // docId has delete key
-		               });
+		for (RdbIndexDocIdSet::Iterator docIdIt = docIds->begin(); !docIdIt.isExhausted(); docIdIt.next()) {
+			// docId has delete key
+			tmpDocIdFileIndex->push_back((docIdIt.getEntry() << s_docIdFileIndex_docIdOffset) | i);
+		}
 	}
 
 	std::stable_sort(tmpDocIdFileIndex->begin(), tmpDocIdFileIndex->end(),
@@ -2765,12 +2779,12 @@ void RdbBase::generateGlobalIndex() {
 			continue;
 		}
 
-		auto docIds = m_fileInfo[i].m_index->getDocIds();
+		auto docIds = m_fileInfo[i].m_index->getDocIdSet();
 		tmpDocIdFileIndex->reserve(tmpDocIdFileIndex->size() + docIds->size());
-		std::transform(docIds->begin(), docIds->end(), std::back_inserter(*tmpDocIdFileIndex),
-		               [i](uint64_t docId) {
-			               return ((docId << s_docIdFileIndex_docIdOffset) | i); // docId has delete key
-		               });
+		for (RdbIndexDocIdSet::Iterator docIdIt = docIds->begin(); !docIdIt.isExhausted(); docIdIt.next()) {
+			// docId has delete key
+			tmpDocIdFileIndex->push_back((docIdIt.getEntry() << s_docIdFileIndex_docIdOffset) | i);
+		}
 	}
 	sl.unlock();
 
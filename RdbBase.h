@@ -217,6 +217,9 @@ private:
 	// dddddddd dddddddd dddddddd dddddddd  d = docId
 	// dddddd.Z ........ ffffffff ffffffff  Z = delBit
 	//                                      f = fileIndex
+	// . still a plain vector. the per-file RdbIndexDocIdSets are what a query
+	//   walks first, see DocumentIndexChecker, this is only looked up for
+	//   docIds that are in the file
 	docids_ptr_t m_docIdFileIndex;
 	GbMutex m_docIdFileIndexMtx;
 
@@ -226,7 +229,7 @@ public:
 	static void generateGlobalIndex(void *item);
 
 	struct ThreadQueueItem {
-		ThreadQueueItem(RdbBase *base, std::vector<std::pair<int32_t, docidsconst_ptr_t>> docIdFileIndexes, bool markFileReadable, int32_t fileId)
+		ThreadQueueItem(RdbBase *base, std::vector<std::pair<int32_t, docidsetconst_ptr_t>> docIdFileIndexes, bool markFileReadable, int32_t fileId)
 			: m_base(base)
 			, m_docIdFileIndexes(docIdFileIndexes)
 			, m_markFileReadable(markFileReadable)
@@ -234,7 +237,7 @@ public:
 		}
 
 		RdbBase *m_base;
-		std::vector<std::pair<int32_t, docidsconst_ptr_t>> m_docIdFileIndexes;
+		std::vector<std::pair<int32_t, docidsetconst_ptr_t>> m_docIdFileIndexes;
 		bool m_markFileReadable;
 		int32_t m_fileId;
 	};
@@ -254,8 +257,8 @@ public:
 	static const uint64_t s_docIdFileIndex_filePosMask  = 0x000000000000ffffULL;
 
 private:
-	std::vector<std::pair<int32_t, docidsconst_ptr_t>> prepareGlobalIndexJob(bool markFileReadable, int32_t fileId);
-	std::vector<std::pair<int32_t, docidsconst_ptr_t>> prepareGlobalIndexJob_unlocked(bool markFileReadable, int32_t fileId);
+	std::vector<std::pair<int32_t, docidsetconst_ptr_t>> prepareGlobalIndexJob(bool markFileReadable, int32_t fileId);
+	std::vector<std::pair<int32_t, docidsetconst_ptr_t>> prepareGlobalIndexJob_unlocked(bool markFileReadable, int32_t fileId);
 
 	void selectFilesToMerge(int32_t mergeNum, int32_t numFiles, int32_t *p_mini);
 
@@ -11,6 +11,7 @@
 #include "ScopedLock.h"
 #include "Errno.h"
 #include <fcntl.h>
+#include <algorithm>
 #include "Posdb.h"
 #include "gbmemcpy.h"
 #include "Errno.h"
@@ -42,6 +43,7 @@ public:
 	bool set(RdbBuckets *parent, char *newbuf);
 	void reset();
 	void reBuf(char *newbuf);
+	void setParent(RdbBuckets *parent) { m_parent = parent; }
 
 	const char *getFirstKey();
 	const char *getFirstKey() const { return const_cast<RdbBucket *>(this)->getFirstKey(); }
@@ -741,6 +743,11 @@ void RdbBuckets::reset_unlocked() {
 
 void RdbBuckets::clear() {
 	ScopedLock sl(m_mtx);
+	clear_unlocked();
+}
+
+void RdbBuckets::clear_unlocked() {
+	m_mtx.verify_is_locked();
 
 	for (int32_t j = 0; j < m_numBuckets; j++) {
 		m_buckets[j]->reset();
@@ -754,6 +761,94 @@ void RdbBuckets::clear() {
 	m_needsSave = true;
 }
 
+void RdbBuckets::swap(RdbBuckets *other) {
+	if (other == this) {
+		return;
+	}
+
+	// always lock in the same order so two swaps can't deadlock
+	RdbBuckets *first = (this < other) ? this : other;
+	RdbBuckets *second = (this < other) ? other : this;
+	ScopedLock sl(first->m_mtx);
+	ScopedLock sl2(second->m_mtx);
+
+	swap_unlocked(other);
+}
+
+void RdbBuckets::swap_unlocked(RdbBuckets *other) {
+	m_mtx.verify_is_locked();
+	other->m_mtx.verify_is_locked();
+
+	if (m_ks != other->m_ks || m_recSize != other->m_recSize || m_sortBufSize != other->m_sortBufSize) {
+		gbshutdownLogicError();
+	}
+
+	std::swap(m_buckets, other->m_buckets);
+	std::swap(m_bucketsSpace, other->m_bucketsSpace);
+	std::swap(m_masterPtr, other->m_masterPtr);
+	std::swap(m_masterSize, other->m_masterSize);
+	std::swap(m_firstOpenSlot, other->m_firstOpenSlot);
+	std::swap(m_numBuckets, other->m_numBuckets);
+	std::swap(m_maxBuckets, other->m_maxBuckets);
+	std::swap(m_numKeysApprox, other->m_numKeysApprox);
+	std::swap(m_numNegKeys, other->m_numNegKeys);
+	std::swap(m_dataMemOccupied, other->m_dataMemOccupied);
+	std::swap(m_swapBuf, other->m_swapBuf);
+	std::swap(m_sortBuf, other->m_sortBuf);
+	std::swap(m_needsSave, other->m_needsSave);
+
+	// each bucket points back to its owner
+	for (int32_t i = 0; i < m_maxBuckets; i++) {
+		m_bucketsSpace[i].setParent(this);
+	}
+
+	for (int32_t i = 0; i < other->m_maxBuckets; i++) {
+		other->m_bucketsSpace[i].setParent(other);
+	}
+}
+
+bool RdbBuckets::restoreSnapshot(RdbBuckets *active) {
+	if (active == this) {
+		return true;
+	}
+
+	RdbBuckets *first = (this < active) ? this : active;
+	RdbBuckets *second = (this < active) ? active : this;
+	ScopedLock sl(first->m_mtx);
+	ScopedLock sl2(second->m_mtx);
+
+	// records in the active buckets are newer so they must win. add them in
+	// the order they were added so dups in unsorted bucket tails resolve the same way
+	for (int32_t i = 0; i < active->m_numBuckets; i++) {
+		const RdbBucket *b = active->m_buckets[i];
+		const char *rec = b->getKeys();
+
+		for (int32_t j = 0; j < b->getNumKeys(); j++, rec += m_recSize) {
+			const char *data = NULL;
+			int32_t dataSize = 0;
+
+			if (m_fixedDataSize != 0 && !KEYNEG(rec)) {
+				data = *(const char **)(rec + m_ks);
+				dataSize = (m_fixedDataSize == -1) ? *(const int32_t *)(rec + m_ks + sizeof(char *)) : m_fixedDataSize;
+			}
+
+			if (!addNode_unlocked(b->getCollnum(), rec, data, dataSize)) {
+				log(LOG_WARN, "db: Could not restore %s buckets snapshot: %s", m_dbname, mstrerror(g_errno));
+				return false;
+			}
+		}
+	}
+
+	swap_unlocked(active);
+
+	// we now hold the old active records which are all in "active" as well
+	clear_unlocked();
+	m_needsSave = false;
+	active->m_needsSave = true;
+
+	return true;
+}
+
 RdbBucket* RdbBuckets::bucketFactory_unlocked() {
 	m_mtx.verify_is_locked();
 
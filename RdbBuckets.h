@@ -95,6 +95,16 @@ public:
 
 	bool testAndRepair();
 
+	// . exchange contents with another RdbBuckets set up with the same parameters
+	// . used for copy-on-write dumps: the full buckets become a read-only
+	//   snapshot for RdbDump while new records go into the (empty) other one
+	void swap(RdbBuckets *other);
+
+	// . called on a snapshot that could not be dumped. puts the newer records
+	//   from "active" on top of ours, then moves everything back into "active"
+	// . returns false and sets g_errno if we ran out of room
+	bool restoreSnapshot(RdbBuckets *active);
+
 	//Save/Load/Dump
 	bool fastSave(const char *dir, bool useThread, void *state, void (*callback)(void *state));
 	bool loadBuckets(const char *dbname);
@@ -106,6 +116,8 @@ private:
 	static void saveDoneWrapper(void *state, job_exit_t exit_type);
 
 	void reset_unlocked();
+	void clear_unlocked();
+	void swap_unlocked(RdbBuckets *other);
 
 	bool resizeTable_unlocked(int32_t numNeeded);
 	bool selfTest_unlocked(bool thorough, bool core);
@@ -5,7 +5,60 @@
 #include "Conf.h"
 #include "Mem.h"
 #include "Errno.h"
+#include "ScopedLock.h"
 #include <fcntl.h>
+#include <pthread.h>
+
+
+namespace {
+
+// the index for a dumped list is built in a job while the dump thread adds the list to the map
+class IndexListJob {
+public:
+	RdbIndex *m_index;
+	RdbList m_list; // shares the data of the list being dumped
+	bool m_done;
+	pthread_mutex_t m_mtx;
+	pthread_cond_t m_cond;
+
+	explicit IndexListJob(RdbIndex *index)
+	  : m_index(index),
+	    m_done(false) {
+		pthread_mutex_init(&m_mtx, NULL);
+		pthread_cond_init(&m_cond, NULL);
+	}
+
+	~IndexListJob() {
+		pthread_mutex_destroy(&m_mtx);
+		pthread_cond_destroy(&m_cond);
+	}
+
+	void wait_for_finish() {
+		ScopedLock sl(m_mtx);
+		while (!m_done) {
+			pthread_cond_wait(&m_cond, &m_mtx);
+		}
+	}
+
+	static void addList(void *state) {
+		IndexListJob *job = static_cast<IndexListJob*>(state);
+
+		int64_t t1 = gettimeofdayInMilliseconds();
+		job->m_index->addList(&job->m_list);
+		int64_t took = gettimeofdayInMilliseconds() - t1;
+		if (took > g_conf.m_logRdbIndexAddListTimeThreshold) {
+			log(LOG_WARN, "db: adding to index took %" PRIu64" ms", took);
+		} else {
+			log(LOG_TIMING, "db: adding to index took %" PRIu64" ms", took);
+		}
+
+		ScopedLock sl(job->m_mtx);
+		job->m_done = true;
+		pthread_cond_signal(&job->m_cond);
+	}
+};
+
+} // anonymous namespace
 
 
 RdbDump::RdbDump() {
@@ -546,6 +599,8 @@ bool RdbDump::dumpList2(bool recall) {
 	// . otherwise, use doneWritingWrapper() which will call dumpTree()
 	// . BigFile::write() return 0 if blocked,-1 on error,>0 on completion
 	// . it also sets g_errno on error
+	// merges write through us too, but they dump a list and not a tree
+	m_fstate.m_ioClass = (m_tree || m_buckets) ? io_class_dump : io_class_merge;
 	bool isDone = m_file->write(m_buf, m_bytesToWrite, offset, &m_fstate, m_callback ? this : NULL,
 	                            m_callback ? &doneWritingWrapper : NULL, m_niceness);
 
@@ -638,6 +693,22 @@ void RdbDump::addListToRdbMapRdbIndex(void *state) {
 	const char *savedListPtrHi = that->m_list->getListPtrHi();
 	const char *savedListPtrLo = that->m_list->getListPtrLo();
 
+	// . when dumping a tree we run in the dump thread, so build the index in a job
+	//   while we add to the map instead of one after the other
+	// . the index job gets its own view of the list because adding to the map moves
+	//   the list pointers
+	IndexListJob indexJob(that->m_index);
+	bool indexInParallel = false;
+	if (that->m_index && that->m_map && !that->m_callback) {
+		RdbList *list = that->m_list;
+		indexJob.m_list.set(list->getList(), list->getListSize(), NULL, 0, list->getStartKey(), list->getEndKey(),
+		                    list->getFixedDataSize(), false, list->getUseHalfKeys(), list->getKeySize());
+		indexJob.m_list.setListPtrHi(savedListPtrHi);
+		indexJob.m_list.setListPtrLo(savedListPtrLo);
+		// not thread_type_file_merge, the dump would wait behind merges
+		indexInParallel = g_jobScheduler.submit(IndexListJob::addList, NULL, &indexJob, thread_type_dump_index, 0);
+	}
+
 	// . register this with the map now
 	// . only register AFTER it's ALL on disk so we don't get partial
 	//   record reads and we don't read stuff on disk that's also in tree
@@ -690,7 +761,9 @@ void RdbDump::addListToRdbMapRdbIndex(void *state) {
 		}
 	}
 
-	if (that->m_index) {
+	if (indexInParallel) {
+		indexJob.wait_for_finish();
+	} else if (that->m_index) {
 		// restore hi/lo ptr which was reset after generating map
 		that->m_list->setListPtrHi(savedListPtrHi);
 		that->m_list->setListPtrLo(savedListPtrLo);
@@ -15,6 +15,8 @@
 #include "Errno.h"
 #include "fctypes.h"
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include <iterator>
 
@@ -27,7 +29,12 @@ static const uint32_t s_defaultReserveSize = 3000000;
 static const uint32_t s_generateMaxPendingSize = 10000000;
 static const uint32_t s_generateReserveSize = 11000000;
 
-static const int64_t s_rdbIndexCurrentVersion = 0;
+// . version 0 files are a plain array of docIds
+// . version 1 files are a serialized RdbIndexDocIdSet with fixed size partitions
+// . version 2 files are a serialized RdbIndexDocIdSet
+static const int64_t s_rdbIndexLegacyVersion = 0;
+static const int64_t s_rdbIndexFixedPartitionsVersion = 1;
+static const int64_t s_rdbIndexCurrentVersion = 2;
 
 RdbIndex::RdbIndex()
 	: m_file()
@@ -36,14 +43,14 @@ RdbIndex::RdbIndex()
 	, m_ks(0)
 	, m_rdbId(RDB_NONE)
 	, m_version(s_rdbIndexCurrentVersion)
-	, m_docIds(new docids_t)
-	, m_docIdsMtx()
+	, m_docIds(new RdbIndexDocIdSet)
 	, m_pendingMergeMtx()
 	, m_pendingMergeCond(PTHREAD_COND_INITIALIZER)
 	, m_pendingMerge(false)
 	, m_pendingDocIdsMtx()
 	, m_pendingDocIds(new docids_t)
 	, m_prevPendingDocId(MAX_DOCID + 1)
+	, m_numPendingDocIds(0)
 	, m_lastMergeTime(gettimeofdayInMilliseconds())
 	, m_needToWrite(false)
 	, m_registeredCallback(false)
@@ -66,7 +73,7 @@ void RdbIndex::reset(bool isStatic) {
 	m_file.reset();
 
 	/// @todo ALC do we need to lock here?
-	m_docIds.reset(new docids_t);
+	swapDocIds(docidsetconst_ptr_t(new RdbIndexDocIdSet));
 
 	m_pendingDocIds.reset(new docids_t);
 	if (!isStatic) {
@@ -74,6 +81,7 @@ void RdbIndex::reset(bool isStatic) {
 	}
 
 	m_prevPendingDocId = MAX_DOCID + 1;
+	m_numPendingDocIds = 0;
 	m_lastMergeTime = gettimeofdayInMilliseconds();
 
 	m_needToWrite = false;
@@ -82,11 +90,12 @@ void RdbIndex::reset(bool isStatic) {
 void RdbIndex::clear() {
 	ScopedLock sl(m_pendingDocIdsMtx);
 
-	m_docIds.reset(new docids_t);
+	swapDocIds(docidsetconst_ptr_t(new RdbIndexDocIdSet));
 	m_pendingDocIds.reset(new docids_t);
 	m_pendingDocIds->reserve(m_generatingIndex ? s_generateReserveSize : s_defaultReserveSize);
 
 	m_prevPendingDocId = MAX_DOCID + 1;
+	m_numPendingDocIds = 0;
 	m_lastMergeTime = gettimeofdayInMilliseconds();
 
 	m_needToWrite = false;
@@ -178,6 +187,18 @@ bool RdbIndex::writeIndex(bool finalWrite) {
 
 	log(LOG_INFO, "db: Saving %s", m_file.getFilename());
 
+	// . a set using the memory-mapped file may still be referenced, so
+	//   unlink it instead of truncating it under the mapping
+	if (getDocIdSet()->isMapped()) {
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/%s", m_file.getDir(), m_file.getFilename());
+		if (::unlink(path) != 0 && errno != ENOENT) {
+			g_errno = errno;
+			logError("END. Could not unlink %s: %s. Returning false.", path, mstrerror(g_errno));
+			return false;
+		}
+	}
+
 	// open a new file
 	if (!m_file.open(O_RDWR | O_CREAT | O_TRUNC)) {
 		logError("END. Could not open %s for writing: %s. Returning false.", m_file.getFilename(), mstrerror(g_errno));
@@ -207,11 +228,12 @@ bool RdbIndex::writeIndex2(bool finalWrite) {
 	// make sure we always write the newest tree
 	// remove const as m_file.write does not accept const buffer
 	ScopedLock sl(m_pendingDocIdsMtx);
-	docids_ptr_t tmpDocIds = std::const_pointer_cast<docids_t>(mergePendingDocIds_unlocked(finalWrite));
+	docidsetconst_ptr_t tmpDocIds = mergePendingDocIds_unlocked(finalWrite);
 	m_needToWrite = false;
 	sl.unlock();
 
 	// first 8 bytes is the index version
+	m_version = s_rdbIndexCurrentVersion;
 	m_file.write(&m_version, sizeof(m_version), offset);
 	if (g_errno) {
 		logError("Failed to write to %s (m_version): %s", m_file.getFilename(), mstrerror(g_errno));
@@ -230,8 +252,19 @@ bool RdbIndex::writeIndex2(bool finalWrite) {
 
 	offset += sizeof(docid_count);
 
-	if (docid_count) {
-		m_file.write(&(*tmpDocIds)[0], docid_count * sizeof((*tmpDocIds)[0]), offset);
+	// then the number of partitions and the size of the serialized set
+	uint64_t header[2] = { tmpDocIds->getNumPartitions(), tmpDocIds->getDataSize() };
+	m_file.write(header, sizeof(header), offset);
+	if (g_errno) {
+		logError("Failed to write to %s (set header): %s", m_file.getFilename(), mstrerror(g_errno));
+		return false;
+	}
+
+	offset += sizeof(header);
+
+	if (tmpDocIds->getDataSize()) {
+		// remove const as m_file.write does not accept const buffer
+		m_file.write(const_cast<char*>(tmpDocIds->getData()), tmpDocIds->getDataSize(), offset);
 		if (g_errno) {
 			logError("Failed to write to %s (docids): %s", m_file.getFilename(), mstrerror(g_errno));
 			return false;
@@ -299,6 +332,20 @@ bool RdbIndex::readIndex2() {
 	}
 	offset += sizeof(docid_count);
 
+	if (m_version == s_rdbIndexLegacyVersion) {
+		return readIndexLegacy(offset, docid_count);
+	}
+
+	if (m_version != s_rdbIndexCurrentVersion && m_version != s_rdbIndexFixedPartitionsVersion) {
+		// verifyIndex() will reject it
+		logTrace(g_conf.m_logTraceRdbIndex, "END. Unknown version %" PRId64, m_version);
+		return true;
+	}
+
+	return readIndexSet(offset, docid_count);
+}
+
+bool RdbIndex::readIndexLegacy(int64_t offset, size_t docid_count) {
 	docids_ptr_t tmpDocIds(new docids_t);
 	int64_t readSize = docid_count * sizeof((*tmpDocIds)[0]);
 
@@ -317,6 +364,80 @@ bool RdbIndex::readIndex2() {
 
 	logTrace(g_conf.m_logTraceRdbIndex, "END. Returning true with %zu docIds loaded", tmpDocIds->size());
 
+	// replace with new index
+	swapDocIds(docidsetconst_ptr_t(new RdbIndexDocIdSet(*tmpDocIds)));
+
+	return true;
+}
+
+bool RdbIndex::readIndexSet(int64_t offset, size_t docid_count) {
+	uint64_t header[2];
+	m_file.read(header, sizeof(header), offset);
+	if (g_errno) {
+		logError("Had error reading offset=%" PRId64" from %s: %s", offset, m_file.getFilename(), mstrerror(g_errno));
+		return false;
+	}
+	offset += sizeof(header);
+
+	uint64_t numPartitions = header[0];
+	int64_t readSize = header[1];
+
+	int64_t expectedFileSize = offset + readSize;
+	if (expectedFileSize != m_file.getFileSize()) {
+		logError("Index file size[%" PRId64"] differs from expected size[%" PRId64"]", m_file.getFileSize(), expectedFileSize);
+		return false;
+	}
+
+	std::shared_ptr<RdbIndexDocIdSet> tmpDocIds(new RdbIndexDocIdSet);
+
+	bool mapped = false;
+	if (g_conf.m_mmapRdbIndexes && readSize > 0 && m_version == s_rdbIndexCurrentVersion) {
+		// . use the file directly. it is only replaced by writeIndex()
+		//   which unlinks it first
+		// . the header is 32 bytes so the partition table stays aligned
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/%s", m_file.getDir(), m_file.getFilename());
+		int fd = ::open(path, O_RDONLY);
+		if (fd >= 0) {
+			void *p = mmap(NULL, expectedFileSize, PROT_READ, MAP_SHARED, fd, 0);
+			::close(fd);
+			if (p != MAP_FAILED) {
+				// exist() is a b-search so readahead would mostly be wasted
+				madvise(p, expectedFileSize, MADV_RANDOM);
+				if (!tmpDocIds->set(docid_count, numPartitions, (char *)p + offset, readSize, p, expectedFileSize)) {
+					logError("Index file %s is corrupt", m_file.getFilename());
+					return false;
+				}
+				mapped = true;
+			}
+		}
+
+		if (!mapped) {
+			log(LOG_WARN, "db: mmap of %s failed: %s. Reading it instead.", path, mstrerror(errno));
+		}
+	}
+
+	if (!mapped) {
+		std::vector<char> buf(readSize);
+		if (readSize > 0) {
+			m_file.read(&buf[0], readSize, offset);
+			if (g_errno) {
+				logError("Had error reading offset=%" PRId64" from %s: %s", offset, m_file.getFilename(), mstrerror(g_errno));
+				return false;
+			}
+		}
+
+		// version 1 files are converted in memory
+		bool status = (m_version == s_rdbIndexCurrentVersion) ? tmpDocIds->set(docid_count, numPartitions, buf.empty() ? NULL : &buf[0], readSize)
+		                                                      : tmpDocIds->setFixedPartitions(docid_count, numPartitions, buf.empty() ? NULL : &buf[0], readSize);
+		if (!status) {
+			logError("Index file %s is corrupt", m_file.getFilename());
+			return false;
+		}
+	}
+
+	logTrace(g_conf.m_logTraceRdbIndex, "END. Returning true with %zu docIds loaded%s", tmpDocIds->size(), mapped ? " (mapped)" : "");
+
 	// replace with new index
 	swapDocIds(tmpDocIds);
 
@@ -326,7 +447,7 @@ bool RdbIndex::readIndex2() {
 bool RdbIndex::verifyIndex() {
 	logTrace(g_conf.m_logTraceRdbIndex, "BEGIN. filename [%s]", m_file.getFilename());
 
-	if (m_version != s_rdbIndexCurrentVersion) {
+	if (m_version != s_rdbIndexCurrentVersion && m_version != s_rdbIndexFixedPartitionsVersion && m_version != s_rdbIndexLegacyVersion) {
 		logTrace(g_conf.m_logTraceRdbIndex, "END. Index format have changed m_version=%" PRId64" currentVersion=%" PRId64". Returning false",
 		         m_version, s_rdbIndexCurrentVersion);
 		return false;
@@ -336,19 +457,19 @@ bool RdbIndex::verifyIndex() {
 	return true;
 }
 
-docidsconst_ptr_t RdbIndex::mergePendingDocIds(bool finalWrite) {
+docidsetconst_ptr_t RdbIndex::mergePendingDocIds(bool finalWrite) {
 	ScopedLock sl(m_pendingDocIdsMtx);
 	return mergePendingDocIds_unlocked(finalWrite);
 }
 
-docidsconst_ptr_t RdbIndex::mergePendingDocIds_unlocked(bool finalWrite) {
+docidsetconst_ptr_t RdbIndex::mergePendingDocIds_unlocked(bool finalWrite) {
 	logTrace(g_conf.m_logTraceRdbIndex, "BEGIN %s[%p] finalWrite=%s", m_file.getFilename(), this, finalWrite ? "true" : "false");
 
 	// don't need to merge when there are no pending docIds
 	// except when it's forWrite then we need to free memory from vector
 	if (!finalWrite && m_pendingDocIds->empty()) {
 		logTrace(g_conf.m_logTraceRdbIndex, "END %s[%p]", m_file.getFilename(), this);
-		return getDocIds();
+		return getDocIdSet();
 	}
 
 	m_lastMergeTime = gettimeofdayInMilliseconds();
@@ -361,25 +482,21 @@ docidsconst_ptr_t RdbIndex::mergePendingDocIds_unlocked(bool finalWrite) {
 		return (a & s_docIdMask) == (b & s_docIdMask);
 	};
 
-	// merge pending docIds into docIds
 	std::stable_sort(m_pendingDocIds->begin(), m_pendingDocIds->end(), cmplt_fn);
 
-	docids_ptr_t tmpDocIds(new docids_t);
-	auto docIds = getDocIds();
-	std::merge(docIds->begin(), docIds->end(), m_pendingDocIds->begin(), m_pendingDocIds->end(), std::back_inserter(*tmpDocIds), cmplt_fn);
-
 	// in reverse because we want to keep the newest entry
-	auto it = std::unique(tmpDocIds->rbegin(), tmpDocIds->rend(), cmpeq_fn);
-	tmpDocIds->erase(tmpDocIds->begin(), it.base());
+	auto it = std::unique(m_pendingDocIds->rbegin(), m_pendingDocIds->rend(), cmpeq_fn);
+	m_pendingDocIds->erase(m_pendingDocIds->begin(), it.base());
 
-	if (finalWrite) {
-		// shrink memory usage
-		tmpDocIds->shrink_to_fit();
+	// . merge pending docIds into docIds. they replace existing entries
+	//   (could change from positive to negative key)
+	// . only the partitions of the set the pending docIds fall into are re-encoded
+	docidsetconst_ptr_t newDocIdSet = getDocIdSet();
+	if (!m_pendingDocIds->empty()) {
+		newDocIdSet.reset(RdbIndexDocIdSet::merge(*newDocIdSet, *m_pendingDocIds));
+		swapDocIds(newDocIdSet);
 	}
 
-	// replace existing even if size doesn't change (could change from positive to negative key)
-	swapDocIds(tmpDocIds);
-
 	if (finalWrite) {
 		// make sure memory is freed
 		m_pendingDocIds.reset(new docids_t);
@@ -388,8 +505,11 @@ docidsconst_ptr_t RdbIndex::mergePendingDocIds_unlocked(bool finalWrite) {
 		m_pendingDocIds->reserve(m_generatingIndex ? s_generateReserveSize : s_defaultReserveSize);
 	}
 
+	// only after the new set is visible, see exist()
+	m_numPendingDocIds = 0;
+
 	logTrace(g_conf.m_logTraceRdbIndex, "END %s[%p]", m_file.getFilename(), this);
-	return getDocIds();
+	return newDocIdSet;
 }
 
 void RdbIndex::addRecord(const char *key) {
@@ -408,6 +528,7 @@ void RdbIndex::addRecord_unlocked(const char *key) {
 			if (doc_id != m_prevPendingDocId) {
 				m_pendingDocIds->push_back(doc_id);
 				m_prevPendingDocId = doc_id;
+				m_numPendingDocIds = m_pendingDocIds->size();
 			}
 		}
 	} else {
@@ -421,9 +542,9 @@ void RdbIndex::addRecord_unlocked(const char *key) {
 }
 
 void RdbIndex::printIndex() {
-	auto docIds = getDocIds();
-	for (auto it = docIds->begin(); it != docIds->end(); ++it) {
-		logf(LOG_DEBUG, "inindex: docId=%" PRIu64" isDel=%d", (*it >> s_docIdOffset), ((*it & s_delBitMask) == 0));
+	auto docIds = getDocIdSet();
+	for (RdbIndexDocIdSet::Iterator it = docIds->begin(); !it.isExhausted(); it.next()) {
+		logf(LOG_DEBUG, "inindex: docId=%" PRIu64" isDel=%d", it.getDocId(), it.isDelete());
 	}
 
 	ScopedLock sl(m_pendingDocIdsMtx);
@@ -724,31 +845,39 @@ bool RdbIndex::generateIndex(BigFile *f) {
 }
 
 docidsconst_ptr_t RdbIndex::getDocIds() {
-	ScopedLock sl(m_docIdsMtx);
-	return m_docIds;
+	docids_ptr_t docIds(new docids_t);
+	getDocIdSet()->getDocIds(docIds.get());
+	return docIds;
 }
 
-bool RdbIndex::exist(uint64_t docId) {
-	ScopedLock sl(m_pendingDocIdsMtx);
+docidsetconst_ptr_t RdbIndex::getDocIdSet() const {
+	return std::atomic_load(&m_docIds);
+}
 
-	auto docIds = getDocIds();
-	auto it = std::lower_bound(docIds->cbegin(), docIds->cend(), docId << RdbIndex::s_docIdOffset);
-	if (it != docIds->cend() && ((*it >> RdbIndex::s_docIdOffset) == docId)) {
-		return true;
+bool RdbIndex::exist(uint64_t docId) {
+	// . check the pending docIds first. a merge swaps in the new set
+	//   before it clears them, so we can't miss a docId moving between
+	//   them
+	// . files that are not added to never have pending docIds
+	if (m_numPendingDocIds > 0) {
+		ScopedLock sl(m_pendingDocIdsMtx);
+
+		auto cmplt_fn = [](uint64_t a, uint64_t b) {
+			return (a & s_docIdMask) < (b & s_docIdMask);
+		};
+
+		// std::lower_bound works on sorted list
+		std::stable_sort(m_pendingDocIds->begin(), m_pendingDocIds->end(), cmplt_fn);
+
+		auto it = std::lower_bound(m_pendingDocIds->cbegin(), m_pendingDocIds->cend(), docId << RdbIndex::s_docIdOffset);
+		if (it != m_pendingDocIds->cend() && ((*it >> RdbIndex::s_docIdOffset) == docId)) {
+			return true;
+		}
 	}
 
-	auto cmplt_fn = [](uint64_t a, uint64_t b) {
-		return (a & s_docIdMask) < (b & s_docIdMask);
-	};
-
-	// std::lower_bound works on sorted list
-	std::stable_sort(m_pendingDocIds->begin(), m_pendingDocIds->end(), cmplt_fn);
-
-	it = std::lower_bound(m_pendingDocIds->cbegin(), m_pendingDocIds->cend(), docId << RdbIndex::s_docIdOffset);
-	return (it != m_pendingDocIds->cend() && ((*it >> RdbIndex::s_docIdOffset) == docId));
+	return getDocIdSet()->exist(docId);
 }
 
-void RdbIndex::swapDocIds(docidsconst_ptr_t docIds) {
-	ScopedLock sl(m_docIdsMtx);
-	m_docIds.swap(docIds);
+void RdbIndex::swapDocIds(docidsetconst_ptr_t docIds) {
+	std::atomic_store(&m_docIds, docIds);
 }
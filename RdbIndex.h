@@ -6,6 +6,7 @@
 #include "collnum_t.h"
 #include "Sanity.h"
 #include "GbMutex.h"
+#include "RdbIndexDocIdSet.h"
 #include <vector>
 #include <memory>
 #include <atomic>
@@ -14,10 +15,6 @@ class RdbTree;
 class RdbBuckets;
 class RdbList;
 
-typedef std::vector<uint64_t> docids_t;
-typedef std::shared_ptr<docids_t> docids_ptr_t;
-typedef std::shared_ptr<const docids_t> docidsconst_ptr_t;
-
 class RdbIndex {
 public:
 	RdbIndex();
@@ -75,8 +72,13 @@ public:
 	// key format
 	// ........ ........ ........ dddddddd  d = docId
 	// dddddddd dddddddd dddddddd dddddd.Z  Z = delBit
+	// . decodes the whole set, use getDocIdSet() where possible
 	docidsconst_ptr_t getDocIds();
 
+	// merged docIds without the pending ones. does not lock
+	docidsetconst_ptr_t getDocIdSet() const;
+
+	// does not lock when there are no pending docIds (static files)
 	bool exist(uint64_t docId);
 
 	void printIndex();
@@ -90,11 +92,13 @@ private:
 
 	bool writeIndex2(bool finalWrite);
 	bool readIndex2();
+	bool readIndexLegacy(int64_t offset, size_t docid_count);
+	bool readIndexSet(int64_t offset, size_t docid_count);
 
-	docidsconst_ptr_t mergePendingDocIds(bool finalWrite = false);
-	docidsconst_ptr_t mergePendingDocIds_unlocked(bool finalWrite = false);
+	docidsetconst_ptr_t mergePendingDocIds(bool finalWrite = false);
+	docidsetconst_ptr_t mergePendingDocIds_unlocked(bool finalWrite = false);
 
-	void swapDocIds(docidsconst_ptr_t docIds);
+	void swapDocIds(docidsetconst_ptr_t docIds);
 
 	// the index file
 	BigFile m_file;
@@ -107,9 +111,9 @@ private:
 	// verification
 	int64_t m_version;
 
-	// always sorted
-	docidsconst_ptr_t m_docIds;
-	GbMutex m_docIdsMtx;
+	// . always sorted
+	// . replaced as a whole with std::atomic_store so readers don't lock
+	docidsetconst_ptr_t m_docIds;
 
 	GbMutex m_pendingMergeMtx;
 	pthread_cond_t m_pendingMergeCond;
@@ -119,6 +123,7 @@ private:
 	GbMutex m_pendingDocIdsMtx;
 	docids_ptr_t m_pendingDocIds;
 	uint64_t m_prevPendingDocId;
+	std::atomic<size_t> m_numPendingDocIds;
 
 	int64_t m_lastMergeTime;
 
@@ -0,0 +1,359 @@
+#include "RdbIndexDocIdSet.h"
+#include "RdbIndex.h"
+#include <string.h>
+#include <algorithm>
+#include <sys/mman.h>
+
+static void appendVarint(std::vector<char> *buf, uint64_t value) {
+	while (value >= 0x80) {
+		buf->push_back(static_cast<char>((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+	buf->push_back(static_cast<char>(value));
+}
+
+static inline uint64_t readVarint(const unsigned char **p) {
+	const unsigned char *s = *p;
+	uint64_t value = *s & 0x7f;
+	for (int shift = 7; *s++ & 0x80; shift += 7) {
+		value |= (uint64_t)(*s & 0x7f) << shift;
+	}
+	*p = s;
+	return value;
+}
+
+RdbIndexDocIdSet::RdbIndexDocIdSet()
+	: m_size(0)
+	, m_numPartitions(0)
+	, m_data(NULL)
+	, m_dataSize(0)
+	, m_table(NULL)
+	, m_deltas(NULL)
+	, m_storage()
+	, m_mapping(NULL)
+	, m_mappingSize(0) {
+}
+
+RdbIndexDocIdSet::RdbIndexDocIdSet(const docids_t &docIds)
+	: RdbIndexDocIdSet() {
+	std::vector<uint64_t> table;
+	std::vector<char> deltas;
+
+	// most deltas fit in 3 bytes
+	table.reserve(((docIds.size() + s_partitionSize - 1) / s_partitionSize) * 3);
+	deltas.reserve(docIds.size() * 3);
+
+	if (!docIds.empty()) {
+		appendPartitions(&table, &deltas, &docIds[0], docIds.size(), 0);
+	}
+
+	m_size = docIds.size();
+	setStorage(table, deltas);
+}
+
+void RdbIndexDocIdSet::appendPartitions(std::vector<uint64_t> *table, std::vector<char> *deltas, const uint64_t *entries, uint64_t count, uint64_t pos) {
+	if (count == 0) {
+		return;
+	}
+
+	uint64_t numPartitions = (count + s_partitionSize - 1) / s_partitionSize;
+	uint64_t partitionSize = count / numPartitions;
+	uint64_t numLarger = count % numPartitions;
+
+	uint64_t i = 0;
+	for (uint64_t partition = 0; partition < numPartitions; ++partition) {
+		uint64_t end = i + partitionSize + (partition < numLarger ? 1 : 0);
+
+		table->push_back(entries[i]);
+		table->push_back(deltas->size());
+		table->push_back(pos + i);
+
+		for (++i; i < end; ++i) {
+			appendVarint(deltas, entries[i] - entries[i - 1]);
+		}
+	}
+}
+
+void RdbIndexDocIdSet::setStorage(const std::vector<uint64_t> &table, const std::vector<char> &deltas) {
+	m_numPartitions = table.size() / 3;
+
+	// table first, deltas are appended after it
+	size_t tableSize = m_numPartitions * s_partitionEntrySize;
+	m_storage.resize(tableSize + deltas.size());
+	if (tableSize) {
+		memcpy(&m_storage[0], &table[0], tableSize);
+	}
+	if (!deltas.empty()) {
+		memcpy(&m_storage[tableSize], &deltas[0], deltas.size());
+	}
+
+	m_data = m_storage.empty() ? NULL : &m_storage[0];
+	m_dataSize = m_storage.size();
+	setPointers();
+}
+
+RdbIndexDocIdSet *RdbIndexDocIdSet::merge(const RdbIndexDocIdSet &set, const docids_t &entries) {
+	auto cmplt_fn = [](uint64_t entry, uint64_t docId) {
+		return (entry >> RdbIndex::s_docIdOffset) < docId;
+	};
+
+	uint64_t deltasSize = set.m_dataSize - set.m_numPartitions * s_partitionEntrySize;
+
+	std::vector<uint64_t> table;
+	std::vector<char> deltas;
+	table.reserve((set.m_numPartitions + entries.size() / s_partitionSize + 1) * 3);
+	deltas.reserve(deltasSize + entries.size() * 3);
+
+	uint64_t pos = 0;
+	docids_t tmpDocIds;
+	auto entryIt = entries.cbegin();
+	for (uint64_t partition = 0; partition < set.m_numPartitions; ++partition) {
+		// new entries before the first docId of the next partition go into this one
+		auto entryEnd = entries.cend();
+		if (partition + 1 < set.m_numPartitions) {
+			entryEnd = std::lower_bound(entryIt, entries.cend(), set.getPartitionEntry(partition + 1) >> RdbIndex::s_docIdOffset, cmplt_fn);
+		}
+
+		uint64_t partitionSize = set.getPartitionEnd(partition) - set.getPartitionPos(partition);
+
+		if (entryIt == entryEnd) {
+			// untouched partition. copy it as it is
+			uint64_t begin = set.getPartitionDeltaOffset(partition);
+			uint64_t end = (partition + 1 < set.m_numPartitions) ? set.getPartitionDeltaOffset(partition + 1) : deltasSize;
+
+			table.push_back(set.getPartitionEntry(partition));
+			table.push_back(deltas.size());
+			table.push_back(pos);
+			deltas.insert(deltas.end(), set.m_deltas + begin, set.m_deltas + end);
+
+			pos += partitionSize;
+			continue;
+		}
+
+		// decode the partition and merge the new entries into it
+		tmpDocIds.clear();
+		uint64_t cur = set.getPartitionEntry(partition);
+		const unsigned char *p = set.getPartitionDeltas(partition);
+		for (uint64_t i = 0; i < partitionSize; ++i) {
+			if (i > 0) {
+				cur += readVarint(&p);
+			}
+
+			uint64_t curDocId = cur >> RdbIndex::s_docIdOffset;
+			for (; entryIt != entryEnd && cmplt_fn(*entryIt, curDocId); ++entryIt) {
+				tmpDocIds.push_back(*entryIt);
+			}
+
+			if (entryIt != entryEnd && (*entryIt >> RdbIndex::s_docIdOffset) == curDocId) {
+				tmpDocIds.push_back(*entryIt);
+				++entryIt;
+			} else {
+				tmpDocIds.push_back(cur);
+			}
+		}
+		tmpDocIds.insert(tmpDocIds.end(), entryIt, entryEnd);
+		entryIt = entryEnd;
+
+		appendPartitions(&table, &deltas, &tmpDocIds[0], tmpDocIds.size(), pos);
+		pos += tmpDocIds.size();
+	}
+
+	// empty set
+	if (entryIt != entries.cend()) {
+		appendPartitions(&table, &deltas, &*entryIt, entries.cend() - entryIt, pos);
+		pos += entries.cend() - entryIt;
+	}
+
+	RdbIndexDocIdSet *newSet = new RdbIndexDocIdSet;
+	newSet->m_size = pos;
+	newSet->setStorage(table, deltas);
+	return newSet;
+}
+
+RdbIndexDocIdSet::~RdbIndexDocIdSet() {
+	if (m_mapping) {
+		munmap(m_mapping, m_mappingSize);
+	}
+}
+
+bool RdbIndexDocIdSet::set(uint64_t size, uint64_t numPartitions, const char *data, size_t dataSize, void *mapping, size_t mappingSize) {
+	if (numPartitions > size ||
+	    numPartitions * s_partitionSize < size ||
+	    dataSize < numPartitions * s_partitionEntrySize) {
+		if (mapping) {
+			munmap(mapping, mappingSize);
+		}
+		return false;
+	}
+
+	// partitions must follow each other and not be too large
+	const uint64_t *table = reinterpret_cast<const uint64_t*>(data);
+	uint64_t deltasSize = dataSize - numPartitions * s_partitionEntrySize;
+	for (uint64_t partition = 0; partition < numPartitions; ++partition) {
+		uint64_t pos = table[partition * 3 + 2];
+		uint64_t end = (partition + 1 < numPartitions) ? table[(partition + 1) * 3 + 2] : size;
+		uint64_t deltaOffset = table[partition * 3 + 1];
+		if ((partition == 0 && pos != 0) || end <= pos || end - pos > s_partitionSize || deltaOffset > deltasSize ||
+		    (partition > 0 && deltaOffset < table[(partition - 1) * 3 + 1])) {
+			if (mapping) {
+				munmap(mapping, mappingSize);
+			}
+			return false;
+		}
+	}
+
+	m_size = size;
+	m_numPartitions = numPartitions;
+
+	if (mapping) {
+		m_mapping = mapping;
+		m_mappingSize = mappingSize;
+		m_data = data;
+	} else {
+		m_storage.assign(data, data + dataSize);
+		m_data = m_storage.empty() ? NULL : &m_storage[0];
+	}
+	m_dataSize = dataSize;
+
+	setPointers();
+	return true;
+}
+
+bool RdbIndexDocIdSet::setFixedPartitions(uint64_t size, uint64_t numPartitions, const char *data, size_t dataSize) {
+	static const size_t s_fixedPartitionEntrySize = 2 * sizeof(uint64_t);
+
+	if (numPartitions != (size + s_partitionSize - 1) / s_partitionSize ||
+	    dataSize < numPartitions * s_fixedPartitionEntrySize) {
+		return false;
+	}
+
+	// add the positions to the partition table, the deltas stay the same
+	std::vector<uint64_t> table(numPartitions * 3);
+	for (uint64_t partition = 0; partition < numPartitions; ++partition) {
+		memcpy(&table[partition * 3], data + partition * s_fixedPartitionEntrySize, s_fixedPartitionEntrySize);
+		table[partition * 3 + 2] = partition * s_partitionSize;
+	}
+
+	size_t tableSize = numPartitions * s_fixedPartitionEntrySize;
+	std::vector<char> deltas(data + tableSize, data + dataSize);
+
+	m_size = size;
+	setStorage(table, deltas);
+	return true;
+}
+
+void RdbIndexDocIdSet::setPointers() {
+	m_table = reinterpret_cast<const uint64_t*>(m_data);
+	m_deltas = reinterpret_cast<const unsigned char*>(m_data) + m_numPartitions * s_partitionEntrySize;
+}
+
+int64_t RdbIndexDocIdSet::findPartition(uint64_t docId) const {
+	int64_t lo = 0;
+	int64_t hi = static_cast<int64_t>(m_numPartitions) - 1;
+	int64_t partition = -1;
+	while (lo <= hi) {
+		int64_t mid = (lo + hi) / 2;
+		if ((getPartitionEntry(mid) >> RdbIndex::s_docIdOffset) <= docId) {
+			partition = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	return partition;
+}
+
+bool RdbIndexDocIdSet::find(uint64_t docId, uint64_t *entry) const {
+	int64_t partition = findPartition(docId);
+	if (partition < 0) {
+		return false;
+	}
+
+	uint64_t cur = getPartitionEntry(partition);
+	const unsigned char *p = getPartitionDeltas(partition);
+	uint64_t end = getPartitionEnd(partition);
+	for (uint64_t i = getPartitionPos(partition); ; ) {
+		uint64_t curDocId = cur >> RdbIndex::s_docIdOffset;
+		if (curDocId == docId) {
+			if (entry) {
+				*entry = cur;
+			}
+			return true;
+		}
+
+		if (curDocId > docId || ++i >= end) {
+			return false;
+		}
+
+		cur += readVarint(&p);
+	}
+}
+
+void RdbIndexDocIdSet::getDocIds(docids_t *docIds) const {
+	docIds->reserve(docIds->size() + m_size);
+	for (Iterator it(this); !it.isExhausted(); it.next()) {
+		docIds->push_back(it.getEntry());
+	}
+}
+
+
+RdbIndexDocIdSet::Iterator::Iterator(const RdbIndexDocIdSet *set, uint64_t startDocId)
+	: m_set(set)
+	, m_partition(0)
+	, m_partitionEnd(0)
+	, m_pos(set->m_size)
+	, m_entry(0)
+	, m_delta(NULL) {
+	if (m_set->m_size == 0) {
+		return;
+	}
+
+	seekPartition(0);
+	if (startDocId > 0) {
+		skipTo(startDocId);
+	}
+}
+
+uint64_t RdbIndexDocIdSet::Iterator::getDocId() const {
+	return m_entry >> RdbIndex::s_docIdOffset;
+}
+
+bool RdbIndexDocIdSet::Iterator::isDelete() const {
+	return (m_entry & RdbIndex::s_delBitMask) == 0;
+}
+
+void RdbIndexDocIdSet::Iterator::seekPartition(uint64_t partition) {
+	m_partition = partition;
+	m_partitionEnd = m_set->getPartitionEnd(partition);
+	m_pos = m_set->getPartitionPos(partition);
+	m_entry = m_set->getPartitionEntry(partition);
+	m_delta = m_set->getPartitionDeltas(partition);
+}
+
+void RdbIndexDocIdSet::Iterator::next() {
+	if (++m_pos >= m_set->m_size) {
+		return;
+	}
+
+	if (m_pos == m_partitionEnd) {
+		seekPartition(m_partition + 1);
+	} else {
+		m_entry += readVarint(&m_delta);
+	}
+}
+
+void RdbIndexDocIdSet::Iterator::skipTo(uint64_t docId) {
+	if (isExhausted() || getDocId() >= docId) {
+		return;
+	}
+
+	// jump over whole partitions first
+	int64_t partition = m_set->findPartition(docId);
+	if (partition > static_cast<int64_t>(m_partition)) {
+		seekPartition(partition);
+	}
+
+	while (!isExhausted() && getDocId() < docId) {
+		next();
+	}
+}
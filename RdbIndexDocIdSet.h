@@ -0,0 +1,154 @@
+#ifndef GB_RDBINDEXDOCIDSET_H
+#define GB_RDBINDEXDOCIDSET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <memory>
+
+typedef std::vector<uint64_t> docids_t;
+typedef std::shared_ptr<docids_t> docids_ptr_t;
+typedef std::shared_ptr<const docids_t> docidsconst_ptr_t;
+
+class RdbIndexDocIdSet;
+typedef std::shared_ptr<const RdbIndexDocIdSet> docidsetconst_ptr_t;
+
+// . immutable, compressed set of RdbIndex entries (docId << 2 | delBit)
+//   sorted by docId
+// . entries are split into partitions of at most s_partitionSize. the first
+//   entry of each partition is kept verbatim in a partition table and the
+//   rest are stored as varint deltas, so a lookup is a b-search over the table
+//   and decoding of at most one partition
+// . partitions are not of a fixed size so merge() only has to re-encode the
+//   partitions new entries fall into and copies the others as they are
+// . the serialized form (table followed by deltas) is what is stored in the
+//   index file, so a set can use a memory-mapped file directly
+// . never modified after it is built so it can be shared between threads
+//   without locking
+class RdbIndexDocIdSet {
+public:
+	static const uint32_t s_partitionSize = 128;
+
+	// size of a partition table entry (first entry, offset into deltas,
+	// position of the first entry)
+	static const size_t s_partitionEntrySize = 3 * sizeof(uint64_t);
+
+	RdbIndexDocIdSet();
+	~RdbIndexDocIdSet();
+
+	// build from entries sorted by docId with no duplicate docIds
+	explicit RdbIndexDocIdSet(const docids_t &docIds);
+
+	// . use serialized data of a set with "size" entries
+	// . data is copied unless mapping is set, then data must point into
+	//   mapping and the set will munmap it when destroyed
+	// . returns false if the data is inconsistent
+	bool set(uint64_t size, uint64_t numPartitions, const char *data, size_t dataSize, void *mapping = NULL, size_t mappingSize = 0);
+
+	// . use serialized data of the format with partitions of exactly
+	//   s_partitionSize entries and no positions in the partition table
+	//   (index file version 1). always copied
+	bool setFixedPartitions(uint64_t size, uint64_t numPartitions, const char *data, size_t dataSize);
+
+	// . new set with the entries of "set" and "entries"
+	// . entries must be sorted by docId with no duplicate docIds, and replace
+	//   the entries of "set" with the same docId
+	// . only partitions that entries fall into are decoded and re-encoded
+	static RdbIndexDocIdSet *merge(const RdbIndexDocIdSet &set, const docids_t &entries);
+
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	uint64_t getNumPartitions() const { return m_numPartitions; }
+
+	// serialized form
+	const char *getData() const { return m_data; }
+	size_t getDataSize() const { return m_dataSize; }
+
+	bool isMapped() const { return m_mapping != NULL; }
+
+	// heap memory used (mapped sets are paged in and out by the kernel)
+	size_t getMemAllocated() const { return m_storage.capacity(); }
+
+	bool exist(uint64_t docId) const { return find(docId, NULL); }
+
+	// . find the entry for docId
+	// . returns false if docId is not in the set
+	bool find(uint64_t docId, uint64_t *entry) const;
+
+	// append all entries to docIds
+	void getDocIds(docids_t *docIds) const;
+
+	// . iterates over the entries with docId >= startDocId in docId order
+	// . use skipTo() to intersect with another sorted docId list without
+	//   decoding the partitions in between
+	class Iterator {
+	public:
+		Iterator(const RdbIndexDocIdSet *set, uint64_t startDocId = 0);
+
+		bool isExhausted() const { return m_pos >= m_set->m_size; }
+
+		uint64_t getEntry() const { return m_entry; }
+		uint64_t getDocId() const;
+		bool isDelete() const;
+
+		void next();
+
+		// advance to the first entry with docId >= docId
+		void skipTo(uint64_t docId);
+
+	private:
+		void seekPartition(uint64_t partition);
+
+		const RdbIndexDocIdSet *m_set;
+		uint64_t m_partition;
+		uint64_t m_partitionEnd;
+		uint64_t m_pos;
+		uint64_t m_entry;
+		const unsigned char *m_delta;
+	};
+
+	Iterator begin(uint64_t startDocId = 0) const { return Iterator(this, startDocId); }
+
+private:
+	RdbIndexDocIdSet(const RdbIndexDocIdSet&);
+	RdbIndexDocIdSet& operator=(const RdbIndexDocIdSet&);
+
+	void setPointers();
+
+	// encode "count" entries starting at "entries" as partitions of at most
+	// s_partitionSize entries of about the same size
+	static void appendPartitions(std::vector<uint64_t> *table, std::vector<char> *deltas, const uint64_t *entries, uint64_t count, uint64_t pos);
+
+	void setStorage(const std::vector<uint64_t> &table, const std::vector<char> &deltas);
+
+	// last partition whose first docId is <= docId, or -1 if there is none
+	int64_t findPartition(uint64_t docId) const;
+
+	uint64_t getPartitionEntry(uint64_t partition) const { return m_table[partition * 3]; }
+	uint64_t getPartitionDeltaOffset(uint64_t partition) const { return m_table[partition * 3 + 1]; }
+	const unsigned char *getPartitionDeltas(uint64_t partition) const { return m_deltas + getPartitionDeltaOffset(partition); }
+	uint64_t getPartitionPos(uint64_t partition) const { return m_table[partition * 3 + 2]; }
+
+	// position after the last entry of the partition
+	uint64_t getPartitionEnd(uint64_t partition) const {
+		return (partition + 1 < m_numPartitions) ? getPartitionPos(partition + 1) : m_size;
+	}
+
+	uint64_t m_size;
+	uint64_t m_numPartitions;
+
+	// serialized set: partition table followed by deltas
+	const char *m_data;
+	size_t m_dataSize;
+
+	const uint64_t *m_table;
+	const unsigned char *m_deltas;
+
+	std::vector<char> m_storage;
+
+	void *m_mapping;
+	size_t m_mappingSize;
+};
+
+#endif // GB_RDBINDEXDOCIDSET_H
@@ -4,12 +4,16 @@
 
 RdbIndexQuery::RdbIndexQuery(RdbBase *base)
 	: RdbIndexQuery(base ? (base->getGlobalIndex() ? base->getGlobalIndex() : docidsconst_ptr_t()) : docidsconst_ptr_t(),
-	                base ? (base->getTreeIndex() ? base->getTreeIndex()->getDocIds() : docidsconst_ptr_t()) : docidsconst_ptr_t(),
+	                base ? (base->getTreeIndex() ? base->getTreeIndex()->getDocIdSet() : docidsetconst_ptr_t()) : docidsetconst_ptr_t(),
 	                base ? base->getNumFiles() : 0,
 	                base ? base->hasPendingGlobalIndexJob() : false) {
+	for (int32_t fileNum = 0; fileNum < m_numFiles; ++fileNum) {
+		RdbIndex *index = base->getIndex(fileNum);
+		m_fileIndexData.push_back(index ? index->getDocIdSet() : docidsetconst_ptr_t());
+	}
 }
 
-RdbIndexQuery::RdbIndexQuery(docidsconst_ptr_t globalIndexData, docidsconst_ptr_t treeIndexData, int32_t numFiles, bool hasPendingGlobalIndexJob)
+RdbIndexQuery::RdbIndexQuery(docidsconst_ptr_t globalIndexData, docidsetconst_ptr_t treeIndexData, int32_t numFiles, bool hasPendingGlobalIndexJob)
 	: m_globalIndexData(globalIndexData)
 	, m_treeIndexData(treeIndexData)
 	, m_numFiles(numFiles)
@@ -19,12 +23,21 @@ RdbIndexQuery::RdbIndexQuery(docidsconst_ptr_t globalIndexData, docidsconst_ptr_
 RdbIndexQuery::~RdbIndexQuery() {
 }
 
+docidsetconst_ptr_t RdbIndexQuery::getFileIndex(int32_t fileNum) const {
+	if (fileNum == m_numFiles) {
+		return m_treeIndexData;
+	}
+
+	if (fileNum < 0 || fileNum >= static_cast<int32_t>(m_fileIndexData.size())) {
+		return docidsetconst_ptr_t();
+	}
+
+	return m_fileIndexData[fileNum];
+}
+
 int32_t RdbIndexQuery::getFilePos(uint64_t docId, bool isMerging) const {
-	if (m_treeIndexData.get()) {
-		auto it = std::lower_bound(m_treeIndexData->cbegin(), m_treeIndexData->cend(), docId << RdbIndex::s_docIdOffset);
-		if (it != m_treeIndexData->cend() && ((*it >> RdbIndex::s_docIdOffset) == docId)) {
-			return m_numFiles;
-		}
+	if (m_treeIndexData.get() && m_treeIndexData->exist(docId)) {
+		return m_numFiles;
 	}
 
 	auto it = std::lower_bound(m_globalIndexData->cbegin(), m_globalIndexData->cend(), docId << RdbBase::s_docIdFileIndex_docIdDelKeyOffset);
@@ -44,11 +57,8 @@ int32_t RdbIndexQuery::getFilePos(uint64_t docId, bool isMerging) const {
 }
 
 bool RdbIndexQuery::documentIsInFile(uint64_t docId, int32_t fileNum) const {
-	if (m_treeIndexData.get()) {
-		auto it = std::lower_bound(m_treeIndexData->cbegin(), m_treeIndexData->cend(), docId << RdbIndex::s_docIdOffset);
-		if (it != m_treeIndexData->cend() && ((*it >> RdbIndex::s_docIdOffset) == docId)) {
-			return (fileNum == m_numFiles);
-		}
+	if (m_treeIndexData.get() && m_treeIndexData->exist(docId)) {
+		return (fileNum == m_numFiles);
 	}
 
 
@@ -62,11 +72,11 @@ bool RdbIndexQuery::documentIsInFile(uint64_t docId, int32_t fileNum) const {
 
 void RdbIndexQuery::printIndex() const {
 	if (m_treeIndexData.get()) {
-		for (auto key : *m_treeIndexData) {
+		for (RdbIndexDocIdSet::Iterator it = m_treeIndexData->begin(); !it.isExhausted(); it.next()) {
 			logf(LOG_TRACE, "db: docId=%" PRId64" index=%" PRId32" isDel=%d",
-			     key >> RdbIndex::s_docIdOffset,
+			     it.getDocId(),
 			     m_numFiles,
-			     ((key & RdbIndex::s_delBitMask) == 0));
+			     it.isDelete());
 		}
 	}
 
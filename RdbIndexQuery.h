@@ -3,6 +3,7 @@
 
 #include "RdbIndex.h"
 #include <stdint.h>
+#include <vector>
 
 class RdbBase;
 
@@ -15,6 +16,9 @@ public:
 	bool documentIsInFile(uint64_t docId, int32_t filenum) const;
 
 	int32_t getNumFiles() const { return m_numFiles; }
+
+	// docIds of file "filenum", or of the tree for getNumFiles(). NULL if unknown
+	docidsetconst_ptr_t getFileIndex(int32_t fileNum) const;
 	bool hasPendingGlobalIndexJob() const { return m_hasPendingGlobalIndexJob; }
 
 	void printIndex() const;
@@ -24,10 +28,11 @@ private:
 	RdbIndexQuery(const RdbIndexQuery&);
 	RdbIndexQuery& operator=(const RdbIndexQuery&);
 
-	RdbIndexQuery(docidsconst_ptr_t globalIndexData, docidsconst_ptr_t treeIndexData, int32_t numFiles, bool hasPendingGlobalIndexJob);
+	RdbIndexQuery(docidsconst_ptr_t globalIndexData, docidsetconst_ptr_t treeIndexData, int32_t numFiles, bool hasPendingGlobalIndexJob);
 
 	docidsconst_ptr_t m_globalIndexData;
-	docidsconst_ptr_t m_treeIndexData;
+	docidsetconst_ptr_t m_treeIndexData;
+	std::vector<docidsetconst_ptr_t> m_fileIndexData;
 	int32_t m_numFiles;
 	bool m_hasPendingGlobalIndexJob;
 };
@@ -9,6 +9,7 @@
 #include "hash.h"
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
 
 
 RdbMap::RdbMap() {
@@ -18,6 +19,9 @@ RdbMap::RdbMap() {
 	m_newPagesPerSegment = 0;
 	m_keys = NULL;
 	m_offsets = NULL;
+	m_segmentKeys = NULL;
+	m_mapping = NULL;
+	m_mappingSize = 0;
 
 	// Coverity	
 	m_fixedDataSize = 0;
@@ -95,17 +99,30 @@ void RdbMap::reset ( ) {
 	}
 
 	for ( int32_t i = 0 ; i < m_numSegments; i++ ) {
-		mfree(m_keys[i],m_ks *pps,"RdbMap");
-		mfree(m_offsets[i], 2*pps,"RdbMap");
+		// memory-mapped segments go away with the mapping
+		if ( ! isMappedSegment ( i ) ) {
+			mfree(m_keys[i],m_ks *pps,"RdbMap");
+			mfree(m_offsets[i], 2*pps,"RdbMap");
+		}
 		// set to NULL so we know if accessed illegally
 		m_keys   [i] = NULL;
 		m_offsets[i] = NULL;
 	}
 
+	if ( m_mapping ) {
+		munmap ( m_mapping , m_mappingSize );
+		m_mapping = NULL;
+		m_mappingSize = 0;
+	}
+
 	// the ptrs themselves are now a dynamic array to save mem
 	// when we have thousands of collections
 	mfree(m_keys,m_numSegmentPtrs*sizeof(char *),"MapPtrs1");
 	mfree(m_offsets,m_numSegmentOffs*sizeof(int16_t *),"MapPtrs2");
+	mfree(m_segmentKeys,m_numSegmentPtrs*m_ks,"MapPtrs3");
+	m_keys = NULL;
+	m_offsets = NULL;
+	m_segmentKeys = NULL;
 	m_numSegmentPtrs = 0;
 	m_numSegmentOffs = 0;
 
@@ -148,6 +165,13 @@ bool RdbMap::writeMap ( bool allDone ) {
 
 	log(LOG_INFO, "db: Saving %s", m_file.getFilename());
 
+	// the map file is truncated below, so stop referencing it first
+	if ( m_mapping && ! unmapSegments ( ) ) {
+		log(LOG_ERROR, "%s:%s: END. Could not unmap %s: %s. Returning false.",
+		    __FILE__, __func__, m_file.getFilename(), mstrerror(g_errno));
+		return false;
+	}
+
 	// open a new file
 	if ( ! m_file.open ( O_RDWR | O_CREAT | O_TRUNC ) ) {
 		log(LOG_ERROR, "%s:%s: END. Could not open %s for writing: %s. Returning false.",
@@ -175,11 +199,69 @@ bool RdbMap::writeMap ( bool allDone ) {
 }
 
 
+namespace {
+
+// collects the map header and segments so the map file is written in a few
+// large sequential writes instead of two small writes per segment
+class MapFileWriter {
+public:
+	MapFileWriter(BigFile *file, char *buf, int32_t bufSize)
+	  : m_file(file), m_buf(buf), m_bufSize(bufSize), m_bufUsed(0), m_offset(0) {
+	}
+
+	bool append(const void *data, int32_t size) {
+		if (m_bufUsed + size > m_bufSize) {
+			if (!flush()) {
+				return false;
+			}
+
+			// too big to buffer, write it directly
+			if (size > m_bufSize) {
+				g_errno = 0;
+				m_file->write(data, size, m_offset);
+				if (g_errno) {
+					return false;
+				}
+				m_offset += size;
+				return true;
+			}
+		}
+
+		memcpy(m_buf + m_bufUsed, data, size);
+		m_bufUsed += size;
+		return true;
+	}
+
+	bool flush() {
+		if (m_bufUsed == 0) {
+			return true;
+		}
+
+		g_errno = 0;
+		m_file->write(m_buf, m_bufUsed, m_offset);
+		if (g_errno) {
+			return false;
+		}
+
+		m_offset += m_bufUsed;
+		m_bufUsed = 0;
+		return true;
+	}
+
+private:
+	BigFile *m_file;
+	char *m_buf;
+	int32_t m_bufSize;
+	int32_t m_bufUsed;
+	int64_t m_offset;
+};
+
+} // anonymous namespace
+
+
 bool RdbMap::writeMap2 ( ) {
 	logTrace( g_conf.m_logTraceRdbMap, "BEGIN. filename [%s]", m_file.getFilename());
 	
-	// the current disk offset
-	int64_t offset = 0LL;
 	g_errno = 0;
 
 	if( g_conf.m_logTraceRdbMap ) {
@@ -189,101 +271,72 @@ bool RdbMap::writeMap2 ( ) {
 		log(LOG_DEBUG, " m_numNegativeRecs: %" PRId64, m_numNegativeRecs.load());
 		loghex(LOG_DEBUG, m_lastKey, m_ks, " m_lastKey........: (hexdump)");
 	}
-	
-	// first 8 bytes are the size of the DATA file we're mapping
-	m_file.write ( &m_offset , 8 , offset );
-	if ( g_errno )  {
-		log(LOG_ERROR, "%s:%s: Failed to write to %s (m_offset): %s",
-		    __FILE__, __func__, m_file.getFilename(), mstrerror(g_errno));
-		return false;
-	}
-	
-	offset += 8;
-
-	// when a BigFile gets chopped, keep up a start offset for it
-	m_file.write ( &m_fileStartOffset , 8 , offset );
 
-	if ( g_errno ) {
-		log(LOG_ERROR, "%s:%s: Failed to write to %s (m_fileStartOffset): %s",
+	int32_t bufSize = 1024 * 1024;
+	char *buf = (char *)mmalloc(bufSize, "RdbMapWrite");
+	if ( ! buf ) {
+		log(LOG_ERROR, "%s:%s: Failed to allocate write buffer for %s: %s",
 		    __FILE__, __func__, m_file.getFilename(), mstrerror(g_errno));
 		return false;
 	}
-	
-	offset += 8;
 
-	// store total number of non-deleted records
-	m_file.write ( &m_numPositiveRecs , 8 , offset );
-	if ( g_errno ) {
-		log(LOG_ERROR,"%s:%s: Failed to write to %s (m_numPositiveRecs): %s",
-		    __FILE__, __func__, m_file.getFilename(), mstrerror(g_errno));
-		return false;
-	}
-
-	offset += 8;
-
-	// store total number of deleted records
-	m_file.write ( &m_numNegativeRecs , 8 , offset );
-	if ( g_errno ) {
-		log(LOG_ERROR,"%s:%s: Failed to write to %s (m_numNegativeRecs): %s",
-		    __FILE__, __func__, m_file.getFilename(), mstrerror(g_errno));
-		return false;
-	}
+	MapFileWriter writer(&m_file, buf, bufSize);
 
-	offset += 8;
-
-	// store last key in map
-	m_file.write ( m_lastKey , m_ks , offset );
-	if ( g_errno ) {
-		log(LOG_ERROR,"%s:%s: Failed to write to %s (m_lastKey): %s",
+	// first 8 bytes are the size of the DATA file we're mapping
+	// when a BigFile gets chopped, keep up a start offset for it
+	// then the total number of non-deleted and deleted records
+	// and the last key in map
+	int64_t numPositiveRecs = m_numPositiveRecs;
+	int64_t numNegativeRecs = m_numNegativeRecs;
+	bool status = writer.append(&m_offset, 8) &&
+	              writer.append(&m_fileStartOffset, 8) &&
+	              writer.append(&numPositiveRecs, 8) &&
+	              writer.append(&numNegativeRecs, 8) &&
+	              writer.append(m_lastKey, m_ks);
+
+	if ( ! status ) {
+		log(LOG_ERROR, "%s:%s: Failed to write to %s (header): %s",
 		    __FILE__, __func__, m_file.getFilename(), mstrerror(g_errno));
+		mfree(buf, bufSize, "RdbMapWrite");
 		return false;
 	}
 
-	offset += m_ks;
-
 	logTrace( g_conf.m_logTraceRdbMap, "Writing %" PRId32" segments", m_numSegments);
 
 	// . now store the map itself
 	// . write the segments (keys/offsets) from the map file
 	for ( int32_t i = 0 ; i < m_numSegments ; ++i ) {
-		offset = writeSegment ( i , offset );
-		if ( offset<=0 ) {
+		// how many pages are left to write?
+		int32_t pagesLeft = m_numPages - i * PAGES_PER_SEGMENT;
+		if ( pagesLeft <= 0 ) {
+			break;
+		}
+		// truncate to segment's worth of pages for writing purposes
+		if ( pagesLeft > PAGES_PER_SEGMENT ) {
+			pagesLeft = PAGES_PER_SEGMENT;
+		}
+
+		// the keys, then the relative 2-byte offsets of the segment
+		if ( ! writer.append(m_keys[i], pagesLeft * m_ks) ||
+		     ! writer.append(m_offsets[i], pagesLeft * 2) ) {
 			log(LOG_ERROR, "%s:%s: Failed to write to %s (m_numSegments, segment %" PRId32"): %s",
 			    __FILE__, __func__, m_file.getFilename(), i, mstrerror(g_errno));
+			mfree(buf, bufSize, "RdbMapWrite");
 			return false;
 		}
 	}
 
-	logTrace( g_conf.m_logTraceRdbMap, "END - OK, returning true." );
+	status = writer.flush();
+	if ( ! status ) {
+		log(LOG_ERROR, "%s:%s: Failed to write to %s: %s",
+		    __FILE__, __func__, m_file.getFilename(), mstrerror(g_errno));
+	}
 
-	return true;
-}
+	mfree(buf, bufSize, "RdbMapWrite");
 
+	logTrace( g_conf.m_logTraceRdbMap, "END - %s.", status ? "OK, returning true" : "returning false" );
 
-int64_t RdbMap::writeSegment( int32_t seg , int64_t offset ) {
-	// how many pages have we written?
-	int32_t pagesWritten = seg * PAGES_PER_SEGMENT;
-	// how many pages are left to write?
-	int32_t pagesLeft    = m_numPages - pagesWritten;
-	// if none left to write return offset now
-	if ( pagesLeft <= 0 ) return offset;
-	// truncate to segment's worth of pages for writing purposes
-	if ( pagesLeft > PAGES_PER_SEGMENT ) pagesLeft = PAGES_PER_SEGMENT;
-	// determine writeSize for keys
-	int32_t writeSize = pagesLeft * m_ks;
-	// write the keys segment
-	g_errno = 0;
-	m_file.write ( (char *)m_keys[seg] , writeSize , offset );
-	if ( g_errno ) return -1;//log("RdbMapFile::writeSegment: failed");
-	offset += writeSize ;
-	// determine writeSize for relative 2-byte offsets
-	writeSize = pagesLeft * 2;
-	// write the offsets of segment
-	m_file.write ( (char *)m_offsets[seg] , writeSize , offset );
-	if ( g_errno ) return -1;//log("RdbMapFile::writeSegment: failed");
-	offset += writeSize ;
-	// return the new offset
-	return offset ;
+	return status;
 }
 
 
@@ -447,6 +500,13 @@ bool RdbMap::verifyMap2 ( ) {
 	char lastKey[MAX_KEY_BYTES];
 	KEYMIN(lastKey,m_ks);
 	for ( int32_t i = 0 ; i < m_numPages ; i++ ) {
+		// . only check the first key of memory-mapped segments so
+		//   we do not page in the whole map file at startup
+		// . RdbList::checkList_r() checked them when they were dumped
+		if ( (i % PAGES_PER_SEGMENT) != 0 &&
+		     isMappedSegment ( i / PAGES_PER_SEGMENT ) ) {
+			continue;
+		}
 		char *k = getKeyPtr(i);
 		if ( KEYCMP(k,lastKey,m_ks)>=0 ) {
 			KEYSET(lastKey,k,m_ks); continue; }
@@ -584,8 +644,18 @@ bool RdbMap::readMap2 ( ) {
 		return false;
 	}
 
+	// . mmap the full segments if enabled, the last partial segment is
+	//   read in below because a resumed merge will add pages to it
+	if ( g_conf.m_mmapRdbMaps ) {
+		offset = mapSegments ( offset , fileSize );
+		if ( offset < 0 ) {
+			log( LOG_WARN, "db: Had error mapping %s: %s.", m_file.getFilename(), mstrerror(g_errno));
+			return false;
+		}
+	}
+
 	// read in the segments
-	for ( int32_t i = 0 ; offset < fileSize ; i++ ) {
+	for ( int32_t i = m_numSegments ; offset < fileSize ; i++ ) {
 		// . this advance offset passed the read segment
 		// . it uses fileSize for reading the last partial segment
 		offset = readSegment ( i , offset , fileSize ) ;
@@ -630,10 +700,97 @@ int64_t RdbMap::readSegment ( int32_t seg , int64_t offset , int32_t fileSize )
 	offset += readSize ;
 	// increase m_numPages based on the keys/pages read
 	m_numPages += numKeys;
+	if ( numKeys > 0 ) {
+		KEYSET ( &m_segmentKeys[seg*m_ks] , m_keys[seg] , m_ks );
+	}
 	// return the new offset
 	return offset ;
 }
 
+int64_t RdbMap::mapSegments ( int64_t offset , int32_t fileSize ) {
+	// each segment is PAGES_PER_SEGMENT keys followed by as many offsets
+	int64_t segSize = (int64_t)PAGES_PER_SEGMENT * (m_ks + 2);
+	int32_t numFull = (int32_t)((fileSize - offset) / segSize);
+	// not worth it for small maps
+	if ( numFull <= 0 ) {
+		return offset;
+	}
+
+	char path[1024];
+	snprintf ( path , sizeof(path) , "%s/%s" , m_file.getDir() , m_file.getFilename() );
+	int fd = ::open ( path , O_RDONLY );
+	if ( fd < 0 ) {
+		g_errno = errno;
+		return -1;
+	}
+
+	// . private so pages we write to (a resumed merge adding to the last
+	//   page) are copied and the file is only changed by writeMap()
+	// . it stays valid if the file is renamed or unlinked
+	void *p = mmap ( NULL , fileSize , PROT_READ|PROT_WRITE , MAP_PRIVATE , fd , 0 );
+	::close ( fd );
+	if ( p == MAP_FAILED ) {
+		// we can still read it in
+		log( LOG_WARN, "db: mmap of %s failed: %s. Reading it instead.", path , mstrerror(errno) );
+		return offset;
+	}
+
+	// lookups are b-searches so readahead would mostly be wasted
+	madvise ( p , fileSize , MADV_RANDOM );
+
+	m_mapping = (char *)p;
+	m_mappingSize = fileSize;
+
+	for ( int32_t i = 0 ; i < numFull ; i++ ) {
+		int32_t n = m_numSegments;
+		if ( ! addSegmentPtr ( n ) ) {
+			return -1;
+		}
+		m_keys   [n] = m_mapping + offset;
+		m_offsets[n] = (int16_t *)(m_mapping + offset + PAGES_PER_SEGMENT * m_ks);
+		// this touches one page of the mapping per segment
+		KEYSET ( &m_segmentKeys[n*m_ks] , m_keys[n] , m_ks );
+		m_numSegments++;
+		m_maxNumPages += PAGES_PER_SEGMENT;
+		m_numPages    += PAGES_PER_SEGMENT;
+		offset += segSize;
+	}
+
+	logTrace( g_conf.m_logTraceRdbMap, "Mapped %" PRId32" segments of %s", numFull, m_file.getFilename() );
+
+	return offset;
+}
+
+bool RdbMap::unmapSegments ( ) {
+	if ( ! m_mapping ) {
+		return true;
+	}
+
+	// copy into the heap, one segment at a time so a failure leaves the
+	// map consistent
+	for ( int32_t i = 0 ; i < m_numSegments ; i++ ) {
+		if ( ! isMappedSegment ( i ) ) {
+			continue;
+		}
+		char    *keys    = (char *)   mmalloc ( m_ks * PAGES_PER_SEGMENT , "RdbMap" );
+		int16_t *offsets = (int16_t *)mmalloc ( 2    * PAGES_PER_SEGMENT , "RdbMap" );
+		if ( ! keys || ! offsets ) {
+			if ( keys    ) mfree ( keys    , m_ks * PAGES_PER_SEGMENT , "RdbMap" );
+			if ( offsets ) mfree ( offsets , 2    * PAGES_PER_SEGMENT , "RdbMap" );
+			return false;
+		}
+		memcpy ( keys    , m_keys   [i] , m_ks * PAGES_PER_SEGMENT );
+		memcpy ( offsets , m_offsets[i] , 2    * PAGES_PER_SEGMENT );
+		m_keys   [i] = keys;
+		m_offsets[i] = offsets;
+	}
+
+	munmap ( m_mapping , m_mappingSize );
+	m_mapping = NULL;
+	m_mappingSize = 0;
+	return true;
+}
+
 // . add a record to the map
 // . returns false and sets g_errno on error
 // . offset is the current offset of the rdb file where the key/data was added
@@ -1042,19 +1199,36 @@ int32_t RdbMap::getPage( const char *startKey) const {
 	// if the key exceeds our lastKey then return m_numPages
 	//if ( startKey > m_lastKey ) return m_numPages;
 	if ( KEYCMP(startKey,m_lastKey,m_ks)>0 ) return m_numPages;
-	// . find the disk offset based on "startKey"
-	// . b-search over the map of pages
-	// . "n"   is the page # that has a key <= "startKey"
-	// . "n+1" has a key that is > "startKey"
-	int32_t n     = ( m_numPages  ) / 2;
-	int32_t step  = n / 2;
-	while ( step > 0 ) {
-		//if   ( startKey <= getKey ( n ) ) n -= step;
-		//else                              n += step;
-		if   ( KEYCMP(startKey,getKeyPtr(n),m_ks)<=0 ) n -= step;
-		else                                        n += step;
-		step >>= 1; // divide by 2
+	if ( m_numPages <= 0 ) return 0;
+	// . pick the segment from the in-memory segment index first so we
+	//   only touch the pages of one segment
+	// . "seg" is the last segment whose first key is < "startKey"
+	int32_t numSegs = ( m_numPages + PAGES_PER_SEGMENT - 1 ) / PAGES_PER_SEGMENT;
+	int32_t seg = 0;
+	int32_t lo  = 1;
+	int32_t hi  = numSegs - 1;
+	while ( lo <= hi ) {
+		int32_t mid = ( lo + hi ) / 2;
+		if ( KEYCMP(&m_segmentKeys[mid*m_ks],startKey,m_ks)<0 ) {
+			seg = mid;
+			lo  = mid + 1;
+		}
+		else {
+			hi = mid - 1;
+		}
 	}
+	// . b-search over the pages of that segment
+	// . "n" is the first page with a key >= "startKey", or the first
+	//   page of the next segment if there is none
+	int32_t n   = seg * PAGES_PER_SEGMENT;
+	int32_t end = n + PAGES_PER_SEGMENT;
+	if ( end > m_numPages ) end = m_numPages;
+	while ( n < end ) {
+		int32_t mid = ( n + end ) / 2;
+		if ( KEYCMP(getKeyPtr(mid),startKey,m_ks)<0 ) n   = mid + 1;
+		else                                          end = mid;
+	}
+	if ( n > m_numPages - 1 ) n = m_numPages - 1;
 	// . let's adjust for the inadaquecies of the above algorithm...
 	// . increment n until our key is >= the key in the table
 	//while ( n < m_numPages - 1 &&  getKey(n) < startKey ) n++;
@@ -1107,8 +1281,15 @@ int64_t RdbMap::getMemAllocated() const {
 	// . how much space per segment?
 	// . each page has a key and a 2 byte offset
 	int64_t space = PAGES_PER_SEGMENT * (m_ks + 2);
+	// memory-mapped segments are paged in and out by the kernel
+	int32_t numHeapSegments = 0;
+	for ( int32_t i = 0 ; i < m_numSegments ; i++ ) {
+		if ( ! isMappedSegment ( i ) ) {
+			numHeapSegments++;
+		}
+	}
 	// how many segments we use * segment allocation
-	return (int64_t)m_numSegments * space;
+	return (int64_t)numHeapSegments * space + (int64_t)m_numSegmentPtrs * m_ks;
 }
 
 bool RdbMap::addSegmentPtr ( int32_t n ) {
@@ -1123,9 +1304,16 @@ bool RdbMap::addSegmentPtr ( int32_t n ) {
 					"MapPtrs1" );
 		// failed?
 		if ( ! k ) return false;
+		m_keys = k;
+		// the segment index grows along with it
+		char *sk = (char *) mrealloc (m_segmentKeys,
+					      m_numSegmentPtrs * m_ks ,
+					      nn * m_ks ,
+					      "MapPtrs3" );
+		if ( ! sk ) return false;
+		m_segmentKeys = sk;
 		// succeeded
 		m_numSegmentPtrs = nn;
-		m_keys = k;
 	}
 
 	// try offsets
@@ -1155,6 +1343,10 @@ void RdbMap::reduceMemFootPrint () {
 		return;
 	}
 
+	if ( isMappedSegment ( 0 ) ) {
+		return;
+	}
+
 	// if already reduced, return now
 	if ( m_newPagesPerSegment > 0 ) {
 		return;
@@ -1287,8 +1479,11 @@ bool RdbMap::chopHead ( int32_t fileHeadSize ) {
 	int32_t ks = m_ks;
 	// remove segments before segNum
 	for ( int32_t i = 0 ; i < segNum ; i++ ) {
-		mfree ( m_keys   [i] , ks * PAGES_PER_SEGMENT , "RdbMap" );
-		mfree ( m_offsets[i] , 2  * PAGES_PER_SEGMENT , "RdbMap" );
+		// memory-mapped segments are released with the mapping
+		if ( ! isMappedSegment ( i ) ) {
+			mfree ( m_keys   [i] , ks * PAGES_PER_SEGMENT , "RdbMap" );
+			mfree ( m_offsets[i] , 2  * PAGES_PER_SEGMENT , "RdbMap" );
+		}
 		// set to NULL so we know if accessed illegally
 		m_keys   [i] = NULL;
 		m_offsets[i] = NULL;
@@ -1308,6 +1503,7 @@ bool RdbMap::chopHead ( int32_t fileHeadSize ) {
 	int32_t ss = sizeof(int16_t *);
 	memmove ( &m_keys   [0] , &m_keys   [segNum] , m_numSegments * sk );
 	memmove ( &m_offsets[0] , &m_offsets[segNum] , m_numSegments * ss );
+	memmove ( &m_segmentKeys[0] , &m_segmentKeys[segNum*ks] , m_numSegments * ks );
 	// adjust the m_fileStartOffset so getAbsoluteOffset(),... is ok
 	m_fileStartOffset += segNum * PAGES_PER_SEGMENT * m_pageSize;
 	return true;
@@ -125,7 +125,6 @@ class RdbMap {
 	// . flushes when done
 	bool writeMap  ( bool allDone );
 	bool writeMap2 ( );
-	int64_t writeSegment ( int32_t segment , int64_t offset );
 
 	// . calls addRecord() for each record in the list
 	// . returns false and sets errno on error
@@ -227,6 +226,9 @@ class RdbMap {
 		//#endif
 		KEYSET(&m_keys[page/PAGES_PER_SEG][(page%PAGES_PER_SEG)*m_ks],
 		       k,m_ks);
+		// keep the in-memory segment index in sync
+		if ( (page%PAGES_PER_SEG) == 0 )
+			KEYSET(&m_segmentKeys[(page/PAGES_PER_SEG)*m_ks],k,m_ks);
 	}
 
 	void setOffset            ( int32_t page , int16_t offset ) {
@@ -289,6 +291,16 @@ class RdbMap {
 
 	void printMap ();
  private:
+	// . mmap the full segments of the map file starting at "offset"
+	// . returns the offset of the first unmapped byte or -1 on error
+	int64_t mapSegments ( int64_t offset, int32_t fileSize );
+	// copy memory-mapped segments into the heap and drop the mapping
+	bool unmapSegments ( );
+
+	bool isMappedSegment ( int32_t seg ) const {
+		return m_mapping && m_keys[seg] >= m_mapping &&
+		       m_keys[seg] < m_mapping + m_mappingSize;
+	}
 
 
 	// the map file
@@ -307,6 +319,17 @@ class RdbMap {
 	int16_t         **m_offsets;
 	int32_t            m_numSegmentOffs;
 
+	// . first key of each segment, always in RAM
+	// . getPage() picks the segment from this so a lookup only touches
+	//   the pages of one segment, which matters if it is memory-mapped
+	// . has room for m_numSegmentPtrs keys
+	char            *m_segmentKeys;
+
+	// . the map file if it was memory-mapped by readMap()
+	// . m_keys/m_offsets of full segments point into it
+	char            *m_mapping;
+	int64_t          m_mappingSize;
+
 	bool m_reducedMem;
 
 	// number of valid pages in the map.
@@ -43,6 +43,10 @@ class RdbScan {
 		       int32_t       niceness , // = MAX_NICENESS ,
 		       bool       hitDisk        ); // = true );
 
+	// . class of the disk reads for the job scheduler
+	// . must be set before setRead()
+	void setIoClass(io_class_t ioClass) { m_fstate.m_ioClass = ioClass; }
+
 	// RdbGet likes to get our list
 	RdbList *getList ( ) { return m_rdblist; }
 
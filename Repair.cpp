@@ -1004,6 +1004,7 @@ bool Repair::scanRecs ( ) {
 	bool fixErrors = true;
 	// get the list of recs
 	g_errno = 0;
+	m_msg5.setIoClass(io_class_repair);
 	if ( m_msg5.getList ( RDB_TITLEDB        ,
 			      m_collnum           ,
 			      &m_titleRecList      ,
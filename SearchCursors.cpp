@@ -0,0 +1,165 @@
+#include "SearchCursors.h"
+#include "fctypes.h"
+#include "ScopedLock.h"
+#include "Log.h"
+#include "Errno.h"
+#include <algorithm>
+#include <sys/random.h>
+#include <errno.h>
+
+SearchCursors g_searchCursors;
+
+
+// . tokens are handed out to clients so they must not be guessable from the
+//   ones a client got before. they come from the kernel's cryptographically
+//   secure generator
+// . returns false if it failed
+static bool makeToken(uint64_t *token) {
+	for(;;) {
+		ssize_t r = getrandom(token,sizeof(*token),0);
+		if(r==(ssize_t)sizeof(*token))
+			return true;
+		if(r<0 && errno!=EINTR) {
+			log(LOG_ERROR,"query: getrandom() failed: %s", mstrerror(errno));
+			return false;
+		}
+	}
+}
+
+
+SearchCursors::SearchCursors()
+  : m(),
+    purge_iter(m.begin()),
+    max_age(300000), //5 minutes
+    max_items(1000),
+    mtx()
+{
+}
+
+
+void SearchCursors::configure(int64_t max_age_, size_t max_items_)
+{
+	ScopedLock sl(mtx);
+	max_age = max_age_;
+	max_items = max_items_;
+	while(m.size()>max_items)
+		forced_purge_step();
+}
+
+
+void SearchCursors::clear()
+{
+	ScopedLock sl(mtx);
+	m.clear();
+	purge_iter = m.begin();
+}
+
+
+uint64_t SearchCursors::store(uint64_t token, collnum_t collnum, uint64_t query_hash,
+                              const int64_t *docids, const double *scores, const unsigned *flags, int32_t num_docids,
+                              int64_t num_total_hits, double pct_searched, bool more)
+{
+	ScopedLock sl(mtx);
+
+	purge_step();
+
+	if(max_age==0 || max_items==0)
+		return 0; //disabled
+
+	if(token==0 || m.find(token)==m.end()) {
+		//make a new one instead of taking one a client made up. keep
+		//them positive so they survive being parsed as a signed number
+		do {
+			if(!makeToken(&token))
+				return 0;
+			token &= 0x7fffffffffffffffULL;
+		} while(token==0 || m.find(token)!=m.end());
+	}
+
+	Item &item = m[token];
+	item.timestamp = gettimeofdayInMilliseconds();
+	item.collnum = collnum;
+	item.query_hash = query_hash;
+	item.docids.assign(docids,docids+num_docids);
+	item.scores.assign(scores,scores+num_docids);
+	item.flags.assign(flags,flags+num_docids);
+	item.num_total_hits = num_total_hits;
+	item.pct_searched = pct_searched;
+	item.more = more;
+
+	while(m.size()>max_items) {
+		if(purge_iter==m.end())
+			purge_iter = m.begin();
+		if(purge_iter->first==token)
+			++purge_iter; //do not throw out what we just stored
+		else
+			purge_iter = m.erase(purge_iter);
+	}
+
+	return token;
+}
+
+
+bool SearchCursors::lookup(uint64_t token, collnum_t collnum, uint64_t query_hash,
+                           int32_t first, int32_t count, Slice *slice)
+{
+	ScopedLock sl(mtx);
+
+	purge_step();
+	std::map<uint64_t,Item>::iterator iter = m.find(token);
+	if(iter==m.end())
+		return false;
+
+	Item &item = iter->second;
+	int64_t now = gettimeofdayInMilliseconds();
+	if(item.timestamp+max_age<now)
+		return false; //purge_step() will get it
+	if(item.collnum!=collnum || item.query_hash!=query_hash)
+		return false;
+
+	size_t num_docids = item.docids.size();
+	if(first<0 || count<0)
+		return false;
+	if((size_t)first+count>num_docids && item.more)
+		return false; //caller has to go deeper
+
+	size_t start = std::min((size_t)first,num_docids);
+	size_t end = std::min((size_t)first+count,num_docids);
+	slice->docids.assign(item.docids.begin()+start,item.docids.begin()+end);
+	slice->scores.assign(item.scores.begin()+start,item.scores.begin()+end);
+	slice->flags.assign(item.flags.begin()+start,item.flags.begin()+end);
+	slice->num_total_hits = item.num_total_hits;
+	slice->pct_searched = item.pct_searched;
+
+	item.timestamp = now;
+	return true;
+}
+
+
+size_t SearchCursors::size()
+{
+	ScopedLock sl(mtx);
+	return m.size();
+}
+
+
+void SearchCursors::purge_step()
+{
+	if(purge_iter==m.end())
+		purge_iter = m.begin();
+	else {
+		int64_t now = gettimeofdayInMilliseconds();
+		if(purge_iter->second.timestamp+max_age<now)
+			purge_iter = m.erase(purge_iter);
+		else
+			++purge_iter;
+	}
+}
+
+
+void SearchCursors::forced_purge_step()
+{
+	if(purge_iter==m.end())
+		purge_iter = m.begin();
+	purge_iter = m.erase(purge_iter);
+}
@@ -0,0 +1,80 @@
+#ifndef GB_SEARCHCURSORS_H
+#define GB_SEARCHCURSORS_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <map>
+#include <vector>
+#include "GbMutex.h"
+#include "collnum_t.h"
+
+// . result-set cursors for paging deep into the results of a query
+// . normally a page starting at result #s makes Msg3a get s+n docids from
+//   every shard and Msg40 get the summaries of everything before it again.
+//   with "&cursor=new" Msg40 keeps the visible (clustered, deduped and
+//   filtered) docids it got under a token, and the next pages with
+//   "&cursor=<token>" only get the summaries of their own slice
+// . a cursor is refreshed every time it is used and expires after max_age
+//   of not being used
+class SearchCursors {
+	SearchCursors(const SearchCursors&);
+	SearchCursors& operator=(const SearchCursors&);
+
+	struct Item {
+		int64_t timestamp;
+		collnum_t collnum;
+		uint64_t query_hash;
+		std::vector<int64_t> docids;
+		std::vector<double> scores;
+		std::vector<unsigned> flags;
+		int64_t num_total_hits;
+		double pct_searched;
+		// more docids follow the ones we have
+		bool more;
+	};
+	std::map<uint64_t,Item> m;
+	std::map<uint64_t,Item>::iterator purge_iter;
+	int64_t max_age;
+	size_t max_items;
+	GbMutex mtx;
+
+public:
+	struct Slice {
+		std::vector<int64_t> docids;
+		std::vector<double> scores;
+		std::vector<unsigned> flags;
+		int64_t num_total_hits;
+		double pct_searched;
+	};
+
+	SearchCursors();
+
+	void configure(int64_t max_age, size_t max_items);
+
+	void clear();
+
+	// . store the visible results of a query in rank order
+	// . "token" is the cursor to replace, 0 or an unknown token for a
+	//   new one
+	// . returns the token, 0 if cursors are disabled
+	uint64_t store(uint64_t token, collnum_t collnum, uint64_t query_hash,
+	               const int64_t *docids, const double *scores, const unsigned *flags, int32_t num_docids,
+	               int64_t num_total_hits, double pct_searched, bool more);
+
+	// . copy results [first,first+count) of cursor "token" into "slice"
+	// . returns false if we do not have the cursor, it is for another
+	//   query, or it does not have all of those results while more follow
+	bool lookup(uint64_t token, collnum_t collnum, uint64_t query_hash,
+	            int32_t first, int32_t count, Slice *slice);
+
+	size_t size();
+
+private:
+	void purge_step();
+	void forced_purge_step();
+};
+
+
+extern SearchCursors g_searchCursors;
+
+#endif
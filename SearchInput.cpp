@@ -7,6 +7,8 @@
 #include "Collectiondb.h"
 #include "Conf.h"
 #include "Errno.h"
+#include "hash.h"
+#include <string.h>
 
 SearchInput::SearchInput()
   : m_word_variations_config()
@@ -39,6 +41,8 @@ SearchInput::SearchInput()
 	m_titleMaxLen = 0;
 	m_maxSerpScore = 0.0;
 	m_minSerpDocId = 0;
+	m_cursor = NULL;
+	m_shareTermlists = false;
 	m_fx_qlang = nullptr;
 	m_fx_blang = nullptr;
 	m_fx_fetld = nullptr;
@@ -46,6 +50,7 @@ SearchInput::SearchInput()
 	m_defaultSortLang = NULL;
 	m_dedupURL = 0;
 	m_percentSimilarSummary = 0;
+	m_simHashDedupDistance = -1;
 	m_showBanned = false;
 	m_includeCachedCopy = 0;
 	m_familyFilter = false;
@@ -639,3 +644,68 @@ std::string SearchInput::getPreferredResultLanguage() {
 
 	return "en";
 }
+
+
+// the search parms that only change the paging, the output or the
+// summaries, not the results
+static const char * const s_resultSetIgnoredParms[] = {
+	"c", "n", "s", "cursor", "format", "fx_qid",
+	"showerrors", "scores", "dio", "debug", "admin", "niceness", "minmsgthreeatimeout",
+	"tml", "ns", "sw", "smxcpl", "showimages", "qh", "hq", "dt", "inlinks", "icc",
+	"usecache", "rcache", "wcache",
+};
+
+static bool isResultSetIgnoredParm(const char *cgi) {
+	for ( size_t i = 0; i < sizeof(s_resultSetIgnoredParms)/sizeof(s_resultSetIgnoredParms[0]); i++ ) {
+		if ( strcmp(cgi, s_resultSetIgnoredParms[i]) == 0 )
+			return true;
+	}
+	return false;
+}
+
+
+uint64_t SearchInput::getResultSetHash() const {
+	uint64_t h = hash64n(m_q.originalQuery());
+	h = hash64(m_collnumBuf.getBufStart(), m_collnumBuf.length(), h);
+	h = hash64((const char *)&m_queryLangId, sizeof(m_queryLangId), h);
+
+	for ( int32_t i = 0; i < g_parms.getNumParms(); i++ ) {
+		const Parm *m = g_parms.getParm(i);
+		if ( m->m_obj != OBJ_SI || m->m_off < 0 || ! m->m_cgi )
+			continue;
+		if ( isResultSetIgnoredParm(m->m_cgi) )
+			continue;
+		// so strings "a","" and "","a" of two parms do not hash the same
+		h = hash64((const char *)&i, sizeof(i), h);
+
+		const char *p = (const char *)this + m->m_off;
+		switch ( m->m_type ) {
+			case TYPE_CHARPTR: {
+				const char *s = *(const char * const *)p;
+				if ( s )
+					h = hash64(s, strlen(s), h);
+				break;
+			}
+			case TYPE_STRING:
+			case TYPE_STRINGBOX:
+			case TYPE_STRINGNONEMPTY:
+				h = hash64(p, strnlen(p, m->m_size), h);
+				break;
+			case TYPE_SAFEBUF: {
+				const SafeBuf *sb = (const SafeBuf *)p;
+				h = hash64(sb->getBufStart(), sb->length(), h);
+				break;
+			}
+			case TYPE_COMMENT:
+			case TYPE_CMD:
+			case TYPE_FILEUPLOADBUTTON:
+				break;
+			default:
+				// fixed size value, or an array of them
+				h = hash64(p, m->m_size * (m->m_fixed > 0 ? m->m_fixed : 1), h);
+				break;
+		}
+	}
+	return h;
+}
+
@@ -40,6 +40,12 @@ public:
 
 	std::string getPreferredResultLanguage();
 
+	// . hash of the query, the collections and every search parm that
+	//   changes which results we get or their order
+	// . a result-set cursor is only used for queries with the same hash,
+	//   see SearchCursors.h
+	uint64_t getResultSetHash() const;
+
 	///////////
 	//
 	// BEGIN COMPUTED THINGS
@@ -124,6 +130,14 @@ public:
 	double    m_maxSerpScore;
 	int64_t m_minSerpDocId;
 
+	// result-set cursor, "new" or the token of a previous page. see
+	// SearchCursors.h
+	const char *m_cursor;
+
+	// set by bulk searches so their queries share the termlists they
+	// read, see g_sharedTermlistCache. not a parm
+	bool m_shareTermlists;
+
 	const char *m_fx_qlang;
 	const char *m_fx_blang;
 	const char *m_fx_fetld;
@@ -135,6 +149,7 @@ public:
 	// general parameters
         char   m_dedupURL;
 	int32_t   m_percentSimilarSummary;   // msg40
+	int32_t   m_simHashDedupDistance;    // msg40
 	bool   m_showBanned;
 	int32_t   m_includeCachedCopy;
 	bool   m_familyFilter;            // msg40
@@ -21,6 +21,8 @@
 #include "Posdb.h"
 #include "GbUtil.h"
 #include "Errno.h"
+#include <vector>
+#include <algorithm>
 
 Sections::Sections ( ) {
 	m_sections = NULL;
@@ -52,6 +54,56 @@ Sections::~Sections ( ) {
 	reset();
 }
 
+bool Sections::setFlat(const TokenizerResult *tr, const sec_t *flags) {
+	reset();
+
+	m_tr = tr;
+	m_nw = tr->size();
+
+	// the distinct flag values. there are few, so a linear scan will do
+	std::vector<sec_t> distinct(1, 0);
+	for ( int32_t i = 0 ; i < m_nw ; i++ ) {
+		if ( std::find(distinct.begin(), distinct.end(), flags[i]) == distinct.end() ) {
+			distinct.push_back(flags[i]);
+		}
+	}
+
+	m_sectionPtrBuf.setLabel("psectbuf");
+	if ( ! m_sectionPtrBuf.reserve ( m_nw * sizeof(Section *) ) ) return false;
+	m_sectionPtrs = (Section **)m_sectionPtrBuf.getBufStart();
+
+	m_sectionBuf.setLabel ( "sectbuf" );
+	if ( ! m_sectionBuf.reserve ( distinct.size() * sizeof(Section) ) ) return false;
+	m_sections = (Section *)m_sectionBuf.getBufStart();
+
+	m_numSections = distinct.size();
+	m_maxNumSections = m_numSections;
+
+	for ( int32_t j = 0 ; j < m_numSections ; j++ ) {
+		Section *sn = &m_sections[j];
+		memset ( sn , 0 , sizeof(Section) );
+		sn->m_a = 0;
+		sn->m_b = m_nw;
+		sn->m_firstWordPos = -1;
+		sn->m_lastWordPos = -1;
+		sn->m_flags = distinct[j];
+		if ( j > 0 ) {
+			sn->m_prev = &m_sections[j-1];
+			m_sections[j-1].m_next = sn;
+		}
+	}
+
+	m_rootSection = m_sections;
+	m_lastSection = &m_sections[m_numSections-1];
+
+	for ( int32_t i = 0 ; i < m_nw ; i++ ) {
+		int32_t j = std::find(distinct.begin(), distinct.end(), flags[i]) - distinct.begin();
+		m_sectionPtrs[i] = &m_sections[j];
+	}
+
+	return true;
+}
+
 #define TXF_MATCHED 1
 
 // an element on the stack is a Tag
@@ -181,6 +181,13 @@ public:
 	// . sets m_sections[] array, 1-1 with words array "w"
 	bool set(const TokenizerResult *tr, Bits *bits, const Url *url, uint8_t contentType);
 
+	// . set up one section per distinct value in "flags", which is 1-1 with
+	//   the tokens of "tr". the root section has no flags
+	// . only m_a, m_b and m_flags are set, so this is only good for code
+	//   that looks at the flags of the section a word is in (Summary)
+	// . returns false and sets g_errno on error
+	bool setFlat(const TokenizerResult *tr, const sec_t *flags);
+
 private:
 	bool verifySections ( ) ;
 
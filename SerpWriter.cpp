@@ -0,0 +1,244 @@
+#include "SerpWriter.h"
+#include "SafeBuf.h"
+#include "GbFormat.h"
+#include "GbUtil.h"
+#include "ScopedLock.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+SerpBufferPool g_serpBufferPool;
+
+
+// room for the tags or quotes around a value
+static inline int32_t fieldOverhead(int32_t namelen) {
+	return 2*namelen + 20;
+}
+
+
+static inline void put(SafeBuf *sb, const char *s, int32_t len) {
+	memcpy(sb->getBufPtr(), s, len);
+	sb->incrementLength(len);
+}
+
+
+SerpWriter::SerpWriter(SafeBuf *sb, char format)
+  : m_sb(sb),
+    m_isXml(format==FORMAT_XML)
+{
+}
+
+
+int32_t SerpWriter::formatInt(int64_t value, char *buf) {
+	char tmp[20];
+	int32_t n = 0;
+	// work on the negative value so INT64_MIN does not overflow
+	int64_t v = value<0 ? value : -value;
+	do {
+		tmp[n++] = (char)('0' - v%10);
+		v /= 10;
+	} while(v!=0);
+
+	int32_t len = 0;
+	if(value<0)
+		buf[len++] = '-';
+	while(n>0)
+		buf[len++] = tmp[--n];
+	return len;
+}
+
+
+void SerpWriter::putPrefix(const char *name, int32_t namelen, bool cdata, bool quoted) {
+	if(m_isXml) {
+		put(m_sb,"\t\t<",3);
+		put(m_sb,name,namelen);
+		put(m_sb,">",1);
+		if(cdata)
+			put(m_sb,"<![CDATA[",9);
+	} else {
+		put(m_sb,"\t\t\"",3);
+		put(m_sb,name,namelen);
+		put(m_sb,"\":",2);
+		if(quoted)
+			put(m_sb,"\"",1);
+	}
+}
+
+
+void SerpWriter::putSuffix(const char *name, int32_t namelen, bool cdata, bool quoted) {
+	if(m_isXml) {
+		if(cdata)
+			put(m_sb,"]]>",3);
+		put(m_sb,"</",2);
+		put(m_sb,name,namelen);
+		put(m_sb,">\n",2);
+	} else {
+		if(quoted)
+			put(m_sb,"\"",1);
+		put(m_sb,",\n",2);
+	}
+}
+
+
+bool SerpWriter::simpleField(const char *name, const char *value, int32_t valuelen, bool cdata, bool quoted) {
+	int32_t namelen = strlen(name);
+	if(!m_sb->reserve(fieldOverhead(namelen) + valuelen))
+		return false;
+	putPrefix(name,namelen,cdata,quoted);
+	put(m_sb,value,valuelen);
+	putSuffix(name,namelen,cdata,quoted);
+	return true;
+}
+
+
+bool SerpWriter::intField(const char *name, int64_t value) {
+	char buf[20];
+	int32_t len = formatInt(value,buf);
+	return simpleField(name,buf,len,false,false);
+}
+
+
+bool SerpWriter::boolField(const char *name, bool value) {
+	if(m_isXml)
+		return simpleField(name,value?"1":"0",1,false,false);
+	else
+		return value ? simpleField(name,"true",4,false,false) : simpleField(name,"false",5,false,false);
+}
+
+
+bool SerpWriter::floatField(const char *name, double value) {
+	char buf[64];
+	int len = snprintf(buf,sizeof(buf),"%f",value);
+	if(len<0)
+		return false;
+	if((size_t)len>=sizeof(buf)) {
+		//a huge value. rare enough to not bother avoiding the printf
+		int32_t namelen = strlen(name);
+		if(!m_sb->reserve(fieldOverhead(namelen)))
+			return false;
+		putPrefix(name,namelen,false,false);
+		if(!m_sb->safePrintf("%f",value) || !m_sb->reserve(fieldOverhead(namelen)))
+			return false;
+		putSuffix(name,namelen,false,false);
+		return true;
+	}
+	return simpleField(name,buf,len,false,false);
+}
+
+
+bool SerpWriter::stringField(const char *name, const char *s, int32_t len) {
+	int32_t namelen = strlen(name);
+	if(!m_sb->reserve(fieldOverhead(namelen)))
+		return false;
+	putPrefix(name,namelen,m_isXml,true);
+	if(s && len>0) {
+		bool b = m_isXml ? cdataEncode(m_sb,s,len) : m_sb->jsonEncode(s,len);
+		if(!b)
+			return false;
+	}
+	if(!m_sb->reserve(fieldOverhead(namelen)))
+		return false;
+	putSuffix(name,namelen,m_isXml,true);
+	return true;
+}
+
+
+bool SerpWriter::stringField(const char *name, const char *s) {
+	return stringField(name, s, s ? strlen(s) : 0);
+}
+
+
+bool SerpWriter::verbatimField(const char *name, const char *s, int32_t len) {
+	if(!s || len<0) {
+		s = "";
+		len = 0;
+	}
+	return simpleField(name,s,len,true,true);
+}
+
+
+bool SerpWriter::verbatimField(const char *name, const char *s) {
+	return verbatimField(name, s, s ? strlen(s) : 0);
+}
+
+
+bool SerpWriter::tokenField(const char *name, const char *s) {
+	if(!s)
+		s = "";
+	return simpleField(name,s,strlen(s),false,true);
+}
+
+
+
+SerpBufferPool::SerpBufferPool()
+  : bufs(),
+    num_free(0),
+    max_buffer_size(0),
+    mtx()
+{
+}
+
+
+SerpBufferPool::~SerpBufferPool() {
+	for(size_t i=0; i<bufs.size(); i++)
+		delete bufs[i];
+}
+
+
+void SerpBufferPool::configure(size_t max_buffers, int32_t max_buffer_size_) {
+	ScopedLock sl(mtx);
+	while(bufs.size()>max_buffers) {
+		delete bufs.back();
+		bufs.pop_back();
+	}
+	while(bufs.size()<max_buffers)
+		bufs.push_back(new SafeBuf());
+	if(num_free>bufs.size())
+		num_free = bufs.size();
+	max_buffer_size = max_buffer_size_;
+	//throw out the buffers that are too big now
+	for(size_t i=0; i<num_free; ) {
+		if(bufs[i]->getCapacity()>max_buffer_size) {
+			bufs[i]->purge();
+			std::swap(bufs[i],bufs[num_free-1]);
+			num_free--;
+		} else
+			i++;
+	}
+}
+
+
+bool SerpBufferPool::acquire(SafeBuf *sb, int32_t min_size) {
+	{
+		ScopedLock sl(mtx);
+		if(sb->getCapacity()==0 && num_free>0)
+			sb->stealBuf(bufs[--num_free]);
+		//do not reserve more than we would keep. a bigger page grows
+		//the buffer itself
+		if(min_size>max_buffer_size)
+			min_size = max_buffer_size;
+	}
+	sb->reset();
+	if(min_size<=0)
+		return true;
+	return sb->reserve(min_size,"serpbuf");
+}
+
+
+void SerpBufferPool::release(SafeBuf *sb) {
+	if(sb->getCapacity()==0)
+		return;
+	ScopedLock sl(mtx);
+	if(num_free<bufs.size() && sb->getCapacity()<=max_buffer_size) {
+		bufs[num_free]->stealBuf(sb);
+		bufs[num_free]->reset();
+		num_free++;
+	} else
+		sb->purge();
+}
+
+
+size_t SerpBufferPool::size() {
+	ScopedLock sl(mtx);
+	return num_free;
+}
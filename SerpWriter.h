@@ -0,0 +1,97 @@
+#ifndef GB_SERPWRITER_H
+#define GB_SERPWRITER_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+#include "GbMutex.h"
+
+class SafeBuf;
+
+// . typed writer for the fields of a search result in the xml and json
+//   output formats, see printResult() in PageResults.cpp
+// . a field is written as "\t\t<name>value</name>\n" for xml and as
+//   "\t\t\"name\":value,\n" for json, straight into the output buffer with
+//   one reserve() per field instead of going through a printf format string
+// . only for FORMAT_XML and FORMAT_JSON. the caller prints the enclosing
+//   <result> tags or braces itself
+class SerpWriter {
+	SerpWriter(const SerpWriter&);
+	SerpWriter& operator=(const SerpWriter&);
+
+public:
+	SerpWriter(SafeBuf *sb, char format);
+
+	bool intField(const char *name, int64_t value);
+	bool boolField(const char *name, bool value);
+	bool floatField(const char *name, double value); //like %f
+
+	// utf8 string, cdata-encoded for xml and json-encoded for json
+	bool stringField(const char *name, const char *s, int32_t len);
+	bool stringField(const char *name, const char *s);
+
+	// . string known not to need encoding, like a content type
+	// . inside a cdata section for xml, quoted for json
+	bool verbatimField(const char *name, const char *s, int32_t len);
+	bool verbatimField(const char *name, const char *s);
+
+	// like verbatimField() but without the cdata section for xml
+	bool tokenField(const char *name, const char *s);
+
+	// . writes the decimal representation of "value" into "buf"
+	// . returns the number of bytes written, at most 20
+	static int32_t formatInt(int64_t value, char *buf);
+
+private:
+	// the caller must have reserved room for the tags or quotes
+	void putPrefix(const char *name, int32_t namelen, bool cdata, bool quoted);
+	void putSuffix(const char *name, int32_t namelen, bool cdata, bool quoted);
+	bool simpleField(const char *name, const char *value, int32_t valuelen, bool cdata, bool quoted);
+
+	SafeBuf *m_sb;
+	bool m_isXml;
+};
+
+
+// . the buffers the search results pages are rendered into before they are
+//   copied into the send buffer of the socket. the page is sent in one go
+//   after the last summary, it is not streamed
+// . a results page for many results with full summaries is large, so
+//   instead of growing a new buffer through a series of reallocs for every
+//   query we hand out the buffers of earlier queries, which are already
+//   sized for a typical page
+class SerpBufferPool {
+	SerpBufferPool(const SerpBufferPool&);
+	SerpBufferPool& operator=(const SerpBufferPool&);
+
+	std::vector<SafeBuf*> bufs;
+	size_t num_free;
+	int32_t max_buffer_size;
+	GbMutex mtx;
+
+public:
+	SerpBufferPool();
+	~SerpBufferPool();
+
+	// . keep at most "max_buffers" buffers of at most "max_buffer_size"
+	//   bytes each
+	// . called again when the serpbufferpool or serpbuffermaxsize parms
+	//   change
+	void configure(size_t max_buffers, int32_t max_buffer_size);
+
+	// . give "sb" a free buffer if we have one, and make sure it has room
+	//   for at least "min_size" bytes, but no more than max_buffer_size
+	// . returns false and sets g_errno if reserving the room failed
+	bool acquire(SafeBuf *sb, int32_t min_size);
+
+	// . take the buffer of "sb" back. "sb" is left empty
+	// . "sb" must not be a StackBuf
+	void release(SafeBuf *sb);
+
+	size_t size();
+};
+
+
+extern SerpBufferPool g_serpBufferPool;
+
+#endif
@@ -0,0 +1,33 @@
+#include "SimHash.h"
+#include <string.h>
+
+SimHash::SimHash()
+	: m_numFeatures(0) {
+	memset(m_sums, 0, sizeof(m_sums));
+}
+
+void SimHash::addFeature(uint64_t featureHash, int32_t weight) {
+	for (int32_t i = 0; i < 64; i++) {
+		if (featureHash & (1ULL << i)) {
+			m_sums[i] += weight;
+		} else {
+			m_sums[i] -= weight;
+		}
+	}
+	m_numFeatures++;
+}
+
+uint64_t SimHash::getSimHash() const {
+	uint64_t h = 0;
+	for (int32_t i = 0; i < 64; i++) {
+		if (m_sums[i] > 0) {
+			h |= (1ULL << i);
+		}
+	}
+
+	if (h == 0) {
+		h = 1;
+	}
+
+	return h;
+}
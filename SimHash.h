@@ -0,0 +1,47 @@
+#ifndef GB_SIMHASH_H
+#define GB_SIMHASH_H
+
+#include <inttypes.h>
+#include "BitOperations.h"
+
+// . 64-bit simhash (Charikar) of a document, for near-duplicate detection
+// . every feature (word shingle) votes on each of the 64 bits, so two
+//   documents sharing most features differ in only a few bits
+// . the bits are split into SIMHASH_NUM_BANDS bands. two simhashes within
+//   SIMHASH_NUM_BANDS-1 bits of each other have at least one equal band,
+//   so near-dups can be found with a hash table lookup per band instead
+//   of comparing every pair
+
+#define SIMHASH_NUM_BANDS 4
+#define SIMHASH_BAND_BITS (64/SIMHASH_NUM_BANDS)
+#define SIMHASH_MAX_DISTANCE (SIMHASH_NUM_BANDS-1)
+
+class SimHash {
+public:
+	SimHash();
+
+	void addFeature(uint64_t featureHash, int32_t weight = 1);
+
+	// . the simhash of the features added so far
+	// . never 0, 0 means no simhash in titlerecs and msg20 replies
+	uint64_t getSimHash() const;
+
+	int32_t getNumFeatures() const { return m_numFeatures; }
+
+	static int32_t getDistance(uint64_t h1, uint64_t h2) {
+		return getNumBitsOn64(h1 ^ h2);
+	}
+
+	// . band #i of the simhash, tagged with the band number so all
+	//   bands can go in the same hash table
+	static uint64_t getBandKey(uint64_t simHash, int32_t band) {
+		uint64_t bits = (simHash >> (band * SIMHASH_BAND_BITS)) & ((1ULL << SIMHASH_BAND_BITS) - 1);
+		return ((uint64_t)band << SIMHASH_BAND_BITS) | bits;
+	}
+
+private:
+	int32_t m_sums[64];
+	int32_t m_numFeatures;
+};
+
+#endif // GB_SIMHASH_H
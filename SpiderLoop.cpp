@@ -2,6 +2,7 @@
 #include "Spider.h"
 #include "SpiderColl.h"
 #include "SpiderCache.h"
+#include "SpiderPrefetch.h"
 #include "Doledb.h"
 #include "UdpSlot.h"
 #include "UdpServer.h"
@@ -67,6 +68,7 @@ SpiderLoop::SpiderLoop ( ) {
 	m_maxUsed = 0;
 	m_sc = NULL;
 	m_gettingDoledbList = false;
+	m_listPrefetched = false;
 	m_activeList = NULL;
 	m_bookmark = NULL;
 	m_activeListValid = false;
@@ -627,6 +629,9 @@ bool SpiderLoop::gotDoledbList2 ( ) {
 	// unlock
 	m_gettingDoledbList = false;
 
+	// a new list to prefetch from
+	m_listPrefetched = false;
+
 	// shortcuts
 	CollectionRec *cr = m_sc->getCollectionRec();
 
@@ -659,6 +664,11 @@ bool SpiderLoop::gotDoledbList2 ( ) {
 	if ( m_numSpidersOut >= MAX_SPIDERS ) bail = true;
 
 	if ( bail ) {
+		// we will get to these once some spiders are done
+		if ( m_numSpidersOut >= MAX_SPIDERS && ! g_conf.m_readOnlyMode && ! g_dailyMerge.m_mergeMode ) {
+			m_list.resetListPtr();
+			prefetchDoledbList ( cr->m_collnum );
+		}
 		// return false to indicate to try another
 		log(LOG_DEBUG,"spider:gotDoledbList2:bailing");
 		return false;
@@ -755,6 +765,7 @@ bool SpiderLoop::gotDoledbList2 ( ) {
 	// skip? and re-get another doledb list from next priority...
 	if ( out >= max ) {
 		log(LOG_DEBUG,"spider:gotDoledbList2:returning, out=%d max=%d", out, max);
+		prefetchDoledbList ( cr->m_collnum );
 		return true;
 	}
 
@@ -821,6 +832,8 @@ bool SpiderLoop::gotDoledbList2 ( ) {
 	// we now read 50k instead of 2k from doledb in order to fix
 	// one ip from bottle corking the whole priority!!
 	if ( ipOut >= maxSpidersOutPerIp ) {
+		// get it ready for when the spiders on its ip are done
+		g_spiderPrefetch.prefetch ( sreq, cr->m_collnum );
 skipDoledbRec:
 		log(LOG_DEBUG,"spider:gotDoledbList2:Skipping spider record with firstIp=0x%08x", sreq->m_firstIp);
 		// skip
@@ -851,6 +864,15 @@ skipDoledbRec:
 		goto skipDoledbRec;
 	}
 
+	// . the lookups we started for it while it waited are still out.
+	//   launch the urls that are ready first and get back to this one on
+	//   a later doledb scan
+	// . isPending() gives up on the lookups after a few seconds
+	if ( g_spiderPrefetch.isPending ( sreq->m_url, cr->m_collnum, gettimeofdayInMilliseconds() ) ) {
+		log(LOG_DEBUG,"spider:gotDoledbList2:lookups for %s still out", sreq->m_url);
+		goto skipDoledbRec;
+	}
+
 	char ipbuf[16];
 	logDebug( g_conf.m_logDebugSpider, "spider: %" PRId32" spiders out for %s for %s", ipOut, iptoa(sreq->m_firstIp,ipbuf), sreq->m_url );
 
@@ -937,6 +959,7 @@ skipDoledbRec:
 	// then it tries to call spiderDoledUrls() to keep the spider queue
 	// spidering fully.
 	if ( ! status ) {
+		prefetchDoledbList ( collnum );
 		return false;
 	}
 
@@ -955,6 +978,34 @@ skipDoledbRec:
 
 
 
+// . look up the ip, robots.txt and tagrec of the doledb recs left in
+//   m_list that we can not launch right now
+// . only once per list read. urls we prefetched already are skipped
+//   without parsing them
+// . does not move the list ptr
+void SpiderLoop::prefetchDoledbList ( collnum_t collnum ) {
+	if ( g_conf.m_spiderPrefetchMaxUrls <= 0 ) return;
+	if ( m_listPrefetched ) return;
+	m_listPrefetched = true;
+
+	char *saved = m_list.getListPtr();
+
+	int32_t count = 0;
+	for ( ; ! m_list.isExhausted() && count < g_conf.m_spiderPrefetchMaxUrls ; m_list.skipCurrentRecord() ) {
+		char *rec = m_list.getCurrentRec();
+		// skip negative keys and dataless recs
+		const key96_t *doledbKey = (const key96_t *)rec;
+		if ( ( doledbKey->n0 & 0x01 ) == 0 ) continue;
+		if ( m_list.getCurrentRecSize() <= 16 ) continue;
+
+		const SpiderRequest *sreq = (const SpiderRequest *)(rec + sizeof(key96_t) + 4);
+		g_spiderPrefetch.prefetch ( sreq, collnum );
+		count++;
+	}
+
+	m_list.setListPtr ( saved );
+}
+
 // . spider the next url that needs it the most
 // . returns false if blocked on a spider launch, otherwise true.
 // . returns false if your callback will be called
@@ -70,6 +70,7 @@ private:
 
 	void spiderDoledUrls ( ) ;
 	bool gotDoledbList2  ( ) ;
+	void prefetchDoledbList ( collnum_t collnum ) ;
 
 	// . returns false if blocked and "callback" will be called,
 	//   true otherwise
@@ -105,6 +106,9 @@ private:
 
 	bool m_gettingDoledbList;
 
+	// did prefetchDoledbList() walk m_list already
+	bool m_listPrefetched;
+
 	CollectionRec *m_crx;
 	CollectionRec *m_activeList;
 	CollectionRec *m_bookmark;
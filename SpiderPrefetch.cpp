@@ -0,0 +1,381 @@
+#include "SpiderPrefetch.h"
+#include "Spider.h"
+#include "Collectiondb.h"
+#include "Conf.h"
+#include "GbDns.h"
+#include "Msg13.h"
+#include "Tagdb.h"
+#include "Url.h"
+#include "SafeBuf.h"
+#include "hash.h"
+#include "ip.h"
+#include "IPAddressChecks.h"
+#include "max_niceness.h"
+#include "gbmemcpy.h"
+#include "fctypes.h"
+#include "Mem.h"
+#include "Log.h"
+#include "Errno.h"
+#include <new>
+
+SpiderPrefetch g_spiderPrefetch;
+
+// . forget prefetched urls nobody asked for after this long
+// . a tagrec older than this may miss tags added since, so it is not
+//   handed out either
+static const int64_t s_maxStateAge = 10000;
+
+// hold back the launch of a url for at most this long while its lookups
+// are out. after that it may as well do them itself
+static const int64_t s_maxLaunchWait = 3000;
+
+// do not look up the ip and robots.txt of a host again for this long.
+// the dns and robots.txt caches keep them longer than that
+static const int64_t s_maxHostAge = 60000;
+
+// how often we walk the tables looking for old entries
+static const int64_t s_purgeInterval = 5000;
+
+class SpiderPrefetch::PrefetchState {
+public:
+	PrefetchState()
+		: m_key(0)
+		, m_collnum(-1)
+		, m_firstIp(0)
+		, m_startTime(0)
+		, m_doneTime(0)
+		, m_numPending(0)
+		, m_doRobotsTxt(false)
+		, m_tagRecValid(false) {
+		m_robotsUrl[0] = '\0';
+	}
+
+	int64_t   m_key;
+	collnum_t m_collnum;
+	int32_t   m_firstIp;
+	int64_t   m_startTime;
+	// zero while lookups are outstanding
+	int64_t   m_doneTime;
+	int32_t   m_numPending;
+	bool      m_doRobotsTxt;
+
+	Url m_url;
+	char m_robotsUrl[MAX_URL_LEN+1];
+
+	GbDns::DnsResponse m_dnsResponse;
+
+	Msg8a   m_msg8a;
+	TagRec  m_tagRec;
+	SafeBuf m_tagRecBuf;
+	bool    m_tagRecValid;
+
+	Msg13        m_msg13;
+	Msg13Request m_msg13Request;
+};
+
+static int64_t getStateKey(const char *url, collnum_t collnum) {
+	return hash64(url, strlen(url), (uint64_t)collnum);
+}
+
+SpiderPrefetch::SpiderPrefetch()
+	: m_states()
+	, m_recentHosts()
+	, m_numOutstanding(0)
+	, m_lastPurge(0) {
+}
+
+SpiderPrefetch::~SpiderPrefetch() {
+	// lookups still out reference their state, so leave those be
+	for (auto it = m_states.begin(); it != m_states.end(); ++it) {
+		PrefetchState *st = it->second;
+		if (st->m_numPending == 0) {
+			mdelete(st, sizeof(PrefetchState), "spprefetch");
+			delete st;
+		}
+	}
+}
+
+SpiderPrefetch::PrefetchState *SpiderPrefetch::findState(const char *url, collnum_t collnum) const {
+	if (m_states.empty()) {
+		return NULL;
+	}
+
+	auto it = m_states.find(getStateKey(url, collnum));
+	if (it == m_states.end()) {
+		return NULL;
+	}
+
+	return it->second;
+}
+
+SpiderPrefetch::PrefetchState *SpiderPrefetch::addState(const char *url, collnum_t collnum, int64_t now) {
+	int32_t maxUrls = g_conf.m_spiderPrefetchMaxUrls;
+	if (maxUrls <= 0) {
+		return NULL;
+	}
+
+	int64_t key = getStateKey(url, collnum);
+	if (m_states.find(key) != m_states.end()) {
+		return NULL;
+	}
+
+	if ((int32_t)m_states.size() >= maxUrls) {
+		purge(now);
+		if ((int32_t)m_states.size() >= maxUrls) {
+			return NULL;
+		}
+	}
+
+	PrefetchState *st;
+	try {
+		st = new PrefetchState();
+	} catch (std::bad_alloc&) {
+		log(LOG_WARN, "spider: could not allocate prefetch state");
+		return NULL;
+	}
+	mnew(st, sizeof(PrefetchState), "spprefetch");
+
+	st->m_url.set(url);
+	if (!st->m_url.getHost() || st->m_url.getHostLen() <= 0) {
+		mdelete(st, sizeof(PrefetchState), "spprefetch");
+		delete st;
+		return NULL;
+	}
+
+	st->m_key       = key;
+	st->m_collnum   = collnum;
+	st->m_startTime = now;
+
+	// one tagdb lookup per url. prefetch() adds the host lookups
+	st->m_numPending = 1;
+
+	m_states[key] = st;
+	m_numOutstanding++;
+
+	return st;
+}
+
+void SpiderPrefetch::prefetch(const SpiderRequest *sreq, collnum_t collnum) {
+	if (g_conf.m_spiderPrefetchMaxUrls <= 0) {
+		return;
+	}
+
+	// docids from page reindex have nothing to look up
+	if (sreq->m_url[0] != 'h') {
+		return;
+	}
+
+	int64_t now = gettimeofdayInMilliseconds();
+	if (now - m_lastPurge >= s_purgeInterval) {
+		purge(now);
+	}
+
+	// we see the same waiting urls on every doledb scan, so check for
+	// them before parsing anything
+	if (findState(sreq->m_url, collnum)) {
+		return;
+	}
+
+	const CollectionRec *cr = g_collectiondb.getRec(collnum);
+	if (!cr) {
+		return;
+	}
+
+	PrefetchState *st = addState(sreq->m_url, collnum, now);
+	if (!st) {
+		return;
+	}
+
+	st->m_firstIp = sreq->m_firstIp;
+
+	logDebug(g_conf.m_logDebugSpider, "spider: prefetching %s", st->m_url.getUrl());
+
+	// the dns and robots.txt lookups only once per host since they are
+	// cached by host
+	int64_t hostKey = hash64(st->m_url.getHost(), st->m_url.getHostLen(), (uint64_t)collnum);
+	auto hit = m_recentHosts.find(hostKey);
+	bool doHost = (hit == m_recentHosts.end() || now - hit->second >= s_maxHostAge);
+	if (doHost) {
+		m_recentHosts[hostKey] = now;
+		st->m_numPending++;
+		st->m_doRobotsTxt = cr->m_useRobotsTxt;
+
+		if (GbDns::getARecord(st->m_url.getHost(), st->m_url.getHostLen(), gotIpWrapper, st,
+		                      &st->m_dnsResponse)) {
+			gotIp(st);
+		}
+	}
+
+	if (st->m_msg8a.getTagRec(&st->m_url, collnum, MAX_NICENESS, st, gotTagRecWrapper, &st->m_tagRec)) {
+		gotTagRecWrapper(st);
+	}
+}
+
+void SpiderPrefetch::gotIpWrapper(GbDns::DnsResponse *response, void *state) {
+	PrefetchState *st = static_cast<PrefetchState*>(state);
+	if (response) {
+		st->m_dnsResponse = *response;
+	}
+	g_spiderPrefetch.gotIp(st);
+}
+
+void SpiderPrefetch::gotIp(PrefetchState *st) {
+	int32_t ip = 0;
+	if (st->m_dnsResponse.m_errno == 0 && !st->m_dnsResponse.m_ips.empty()) {
+		ip = st->m_dnsResponse.m_ips[0];
+	}
+
+	// . XmlDoc::getIsAllowed() does not fetch robots.txt for these either
+	// . msg13 needs a real ip
+	const CollectionRec *cr = g_collectiondb.getRec(st->m_collnum);
+	if (!st->m_doRobotsTxt || !cr || ip == 0 || ip == -1 || ip == 1) {
+		doneLookup(st);
+		return;
+	}
+
+	// the same robots.txt url XmlDoc::getIsAllowed() makes
+	const Url *u = &st->m_url;
+	char *p = st->m_robotsUrl;
+	if (u->getScheme()) {
+		gbmemcpy(p, u->getScheme(), u->getSchemeLen());
+		p += u->getSchemeLen();
+		p += sprintf(p, "://");
+	} else {
+		p += sprintf(p, "http://");
+	}
+	gbmemcpy(p, u->getHost(), u->getHostLen());
+	p += u->getHostLen();
+	if (u->getPort() != u->getDefaultPort()) {
+		p += sprintf(p, ":%" PRId32, u->getPort());
+	}
+	p += sprintf(p, "/robots.txt");
+
+	// . set it up like XmlDoc::getHttpReply2() does for the robots.txt
+	//   extra doc so msg13 forwards it to the same host and uses the same
+	//   cache key. a download for it that is already out there will wait
+	//   in line for ours
+	Msg13Request *r = &st->m_msg13Request;
+	r->reset();
+	r->ptr_url             = st->m_robotsUrl;
+	r->size_url            = (p - st->m_robotsUrl) + 1;
+	r->m_maxTextDocLen     = cr->m_maxTextDocLen;
+	r->m_maxOtherDocLen    = cr->m_maxOtherDocDownloadLen;
+	r->m_maxCacheAge       = cr->m_maxRobotsCacheAge;
+	r->m_urlIp             = ip;
+	r->m_firstIp           = st->m_firstIp;
+	r->m_urlHash48         = hash64b(st->m_robotsUrl) & 0x0000ffffffffffffLL;
+	r->m_niceness          = MAX_NICENESS;
+	r->m_crawlDelayMS      = 0;
+	r->m_skipHammerCheck   = 1;
+	r->m_collnum           = st->m_collnum;
+	r->m_forceUseFloaters  = cr->m_forceUseFloaters;
+	if (g_conf.m_useCompressionProxy) {
+		r->m_useCompressionProxy = true;
+		r->m_compressReply       = true;
+	}
+
+	if (is_internal_net_ip(ip)) {
+		r->m_maxTextDocLen  = -1;
+		r->m_maxOtherDocLen = -1;
+	}
+
+	// . no use caching it if the collection does not
+	// . still warms the dns cache of the spidering host
+	if (r->m_maxCacheAge <= 0) {
+		doneLookup(st);
+		return;
+	}
+
+	logDebug(g_conf.m_logDebugSpider, "spider: prefetching %s", st->m_robotsUrl);
+
+	if (st->m_msg13.getDoc(r, st, gotRobotsTxtWrapper)) {
+		gotRobotsTxtWrapper(st);
+	}
+}
+
+void SpiderPrefetch::gotRobotsTxtWrapper(void *state) {
+	PrefetchState *st = static_cast<PrefetchState*>(state);
+	if (g_errno) {
+		logDebug(g_conf.m_logDebugSpider, "spider: prefetching %s failed: %s", st->m_robotsUrl, mstrerror(g_errno));
+		g_errno = 0;
+	}
+	// we only wanted it in the cache
+	st->m_msg13.reset();
+	g_spiderPrefetch.doneLookup(st);
+}
+
+void SpiderPrefetch::gotTagRecWrapper(void *state) {
+	g_spiderPrefetch.gotTagRec(static_cast<PrefetchState*>(state));
+}
+
+void SpiderPrefetch::gotTagRec(PrefetchState *st) {
+	if (g_errno) {
+		logDebug(g_conf.m_logDebugSpider, "spider: prefetching tagrec of %s failed: %s", st->m_url.getUrl(), mstrerror(g_errno));
+		g_errno = 0;
+	} else if (st->m_tagRec.serialize(st->m_tagRecBuf)) {
+		st->m_tagRecValid = true;
+	}
+	doneLookup(st);
+}
+
+void SpiderPrefetch::doneLookup(PrefetchState *st) {
+	if (--st->m_numPending > 0) {
+		return;
+	}
+
+	st->m_doneTime = gettimeofdayInMilliseconds();
+	m_numOutstanding--;
+
+	logDebug(g_conf.m_logDebugSpider, "spider: prefetched %s in %" PRId64"ms", st->m_url.getUrl(),
+	         st->m_doneTime - st->m_startTime);
+}
+
+bool SpiderPrefetch::isPending(const char *url, collnum_t collnum, int64_t now) const {
+	const PrefetchState *st = findState(url, collnum);
+	return st && st->m_numPending > 0 && now - st->m_startTime < s_maxLaunchWait;
+}
+
+bool SpiderPrefetch::getTagRec(const char *url, collnum_t collnum, int64_t now, SafeBuf *dst) {
+	PrefetchState *st = findState(url, collnum);
+	if (!st || st->m_numPending > 0 || !st->m_tagRecValid) {
+		return false;
+	}
+
+	if (now - st->m_doneTime >= s_maxStateAge) {
+		return false;
+	}
+
+	dst->reset();
+	if (!dst->safeMemcpy(&st->m_tagRecBuf)) {
+		return false;
+	}
+
+	m_states.erase(st->m_key);
+	mdelete(st, sizeof(PrefetchState), "spprefetch");
+	delete st;
+
+	return true;
+}
+
+void SpiderPrefetch::purge(int64_t now) {
+	m_lastPurge = now;
+
+	for (auto it = m_states.begin(); it != m_states.end(); ) {
+		PrefetchState *st = it->second;
+		if (st->m_numPending == 0 && now - st->m_doneTime >= s_maxStateAge) {
+			it = m_states.erase(it);
+			mdelete(st, sizeof(PrefetchState), "spprefetch");
+			delete st;
+		} else {
+			++it;
+		}
+	}
+
+	for (auto it = m_recentHosts.begin(); it != m_recentHosts.end(); ) {
+		if (now - it->second >= s_maxHostAge) {
+			it = m_recentHosts.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef GB_SPIDERPREFETCH_H
+#define GB_SPIDERPREFETCH_H
+
+#include "collnum_t.h"
+#include <inttypes.h>
+#include <unordered_map>
+
+namespace GbDns {
+	struct DnsResponse;
+}
+
+class SpiderRequest;
+class SafeBuf;
+class Url;
+
+// . looks up the ip, robots.txt and tagdb record of spider requests that
+//   are waiting in doledb, so the XmlDoc that spiders the url later finds
+//   them in the dns cache, the msg13 robots.txt cache and our tagrec table
+//   instead of doing those round trips one after the other
+// . SpiderLoop feeds us the doledb records it can not launch yet because
+//   the spider slots (for the priority or the ip) are all taken, and holds
+//   back the launch of a url while its lookups are still out
+// . urls are keyed by the string in the spider request
+// . everything runs in the main thread
+class SpiderPrefetch {
+public:
+	SpiderPrefetch();
+	~SpiderPrefetch();
+
+	// start the lookups for this request unless we did so recently
+	void prefetch(const SpiderRequest *sreq, collnum_t collnum);
+
+	// . true if the lookups for "url" are still out and were started
+	//   recently enough to be worth waiting for
+	bool isPending(const char *url, collnum_t collnum, int64_t now) const;
+
+	// . copy the prefetched tagrec of "url" into "dst" and forget it
+	// . returns false if we do not have it (yet) or it is too old
+	bool getTagRec(const char *url, collnum_t collnum, int64_t now, SafeBuf *dst);
+
+	int32_t getNumOutstanding() const { return m_numOutstanding; }
+	int32_t getNumUrls() const { return (int32_t)m_states.size(); }
+
+protected:
+	class PrefetchState;
+
+	// . the table part of prefetch(), without starting any lookup
+	// . returns NULL if we have "url" already, are full or it has no host
+	PrefetchState *addState(const char *url, collnum_t collnum, int64_t now);
+
+	void gotTagRec(PrefetchState *st);
+	void doneLookup(PrefetchState *st);
+	void purge(int64_t now);
+
+private:
+	static void gotIpWrapper(GbDns::DnsResponse *response, void *state);
+	static void gotTagRecWrapper(void *state);
+	static void gotRobotsTxtWrapper(void *state);
+
+	void gotIp(PrefetchState *st);
+	PrefetchState *findState(const char *url, collnum_t collnum) const;
+
+	// keyed by hash64 of the url and collnum
+	std::unordered_map<int64_t, PrefetchState*> m_states;
+
+	// hosts we resolved and got robots.txt for lately, with the time
+	std::unordered_map<int64_t, int64_t> m_recentHosts;
+
+	int32_t m_numOutstanding;
+	int64_t m_lastPurge;
+};
+
+extern SpiderPrefetch g_spiderPrefetch;
+
+#endif // GB_SPIDERPREFETCH_H
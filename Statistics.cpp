@@ -21,6 +21,7 @@
 #include <map>
 #include <set>
 #include <vector>
+#include <algorithm>
 
 static const time_t dump_interval = 60;
 static const char tmp_filename[] = "statistics.txt.new";
@@ -346,6 +347,65 @@ static void dump_io_statistics( FILE *fp ) {
 	}
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Document indexing statistics
+
+struct IndexStatistics {
+	IndexStatistics()
+		: count(0)
+		, cpu_sum(0)
+		, cpu_max(0)
+		, main_loop_sum(0)
+		, main_loop_max(0) {
+	}
+
+	unsigned count;
+	unsigned cpu_sum;
+	unsigned cpu_max;
+	unsigned main_loop_sum;
+	unsigned main_loop_max;
+};
+
+//indexed by whether the meta list was built in a spider_index job
+static IndexStatistics index_stats[2];
+static GbMutex mtx_index_stats;
+
+void Statistics::register_index_time( bool in_job, unsigned cpu_ms, unsigned main_loop_ms ) {
+	ScopedLock sl(mtx_index_stats);
+	IndexStatistics &is = index_stats[in_job ? 1 : 0];
+
+	is.count++;
+	is.cpu_sum += cpu_ms;
+	is.cpu_max = std::max(is.cpu_max, cpu_ms);
+	is.main_loop_sum += main_loop_ms;
+	is.main_loop_max = std::max(is.main_loop_max, main_loop_ms);
+}
+
+static void dump_index_statistics( FILE *fp ) {
+	IndexStatistics iscopy[2];
+	ScopedLock sl(mtx_index_stats);
+	for ( int i = 0; i < 2; i++ ) {
+		iscopy[i] = index_stats[i];
+		index_stats[i] = IndexStatistics();
+	}
+	sl.unlock();
+
+	for ( int i = 0; i < 2; i++ ) {
+		const IndexStatistics &is = iscopy[i];
+		if (is.count == 0) {
+			continue;
+		}
+
+		fprintf( fp, "index:in_job=%d;count=%u;cpu_sum=%u;cpu_max=%u;main_loop_sum=%u;main_loop_max=%u\n",
+		         i,
+		         is.count,
+		         is.cpu_sum,
+		         is.cpu_max,
+		         is.main_loop_sum,
+		         is.main_loop_max );
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Language/Charset statistics
 
@@ -559,6 +619,7 @@ static void dump_statistics(time_t now) {
 	dump_query_statistics(fp);
 	dump_spider_statistics(fp);
 	dump_io_statistics(fp);
+	dump_index_statistics(fp);
 	dump_encoding_statistics(fp);
 	dump_rdb_cache_statistics(fp);
 	dump_assorted_statistics(fp);
@@ -14,6 +14,8 @@ void register_spider_time( bool is_new, int error_code, int http_status, unsigne
 
 void register_io_time( bool is_write, int error_code, unsigned long bytes, unsigned ms );
 
+void register_index_time( bool in_job, unsigned cpu_ms, unsigned main_loop_ms );
+
 void register_document_encoding(int error_code, int16_t charsetId, uint8_t langId, uint16_t countryId);
 
 void register_socket_limit_hit();
@@ -179,6 +179,21 @@ void Summary::setSummary(const std::string &summary) {
 	m_displayLen = m_summaryLen;
 }
 
+// use a summary made by setSummaryFromTags() earlier
+void Summary::setSummaryFromTags(const char *summary, int32_t summaryLen) {
+	if ( summaryLen >= MAX_SUMMARY_LEN ) {
+		summaryLen = MAX_SUMMARY_LEN - 1;
+	}
+
+	memcpy(m_summary, summary, summaryLen);
+	m_summaryLen = summaryLen;
+	m_summary[m_summaryLen] = '\0';
+	m_summaryExcerptLen[0] = m_summaryLen;
+	m_numExcerpts = 1;
+	m_displayLen = m_summaryLen;
+	m_isSetFromTags = true;
+}
+
 // let's try to get a nicer summary by using what the website set as description
 // Use the following in priority order (highest first)
 // - itemprop = "description"
@@ -259,7 +274,7 @@ bool Summary::setSummaryFromTags( Xml *xml, unsigned maxSummaryLen, const char *
 }
 
 // returns false and sets g_errno on error
-bool Summary::setSummary(const Xml *xml, const TokenizerResult *tr, const Sections *sections, Pos *pos, const Query *q, unsigned maxSummaryLen,
+bool Summary::setSummary(int32_t titleRecVersion, const TokenizerResult *tr, const Sections *sections, Pos *pos, const Query *q, unsigned maxSummaryLen,
                          int32_t maxNumLines, int32_t numDisplayLines, int32_t maxNumCharsPerLine, const Url *f,
                          const Matches *matches, const char *titleBuf, int32_t titleBufLen) {
 	logTrace(g_conf.m_logTraceSummary, "BEGIN");
@@ -294,7 +309,7 @@ bool Summary::setSummary(const Xml *xml, const TokenizerResult *tr, const Sectio
 
 	// Nothing to match...print beginning of content as summary
 	if ( matches->getNumMatches() == 0 && maxNumLines > 0 ) {
-		bool status = getDefaultSummary(xml, tr, sections, pos, maxSummaryLen);
+		bool status = getDefaultSummary(titleRecVersion, tr, sections, pos, maxSummaryLen);
 		logTrace(g_conf.m_logTraceSummary, "END. getDefaultSummary. Returning %s", status ? "true" : "false");
 		return status;
 	}
@@ -602,7 +617,7 @@ bool Summary::setSummary(const Xml *xml, const TokenizerResult *tr, const Sectio
 		// . removes back to back spaces
 		// . converts html entities
 		// . filters in stores words in [a,b) interval
-		int32_t len = pos->filter( tr, maxa, maxb, false, p, pend, xml->getVersion() );
+		int32_t len = pos->filter( tr, maxa, maxb, false, p, pend, titleRecVersion );
 
 		// break out if did not fit
 		if ( len == 0 ) {
@@ -688,7 +703,7 @@ bool Summary::setSummary(const Xml *xml, const TokenizerResult *tr, const Sectio
 
 	// If we still didn't find a summary, get the default summary
 	if ( p == m_summary ) {
-		bool status = getDefaultSummary ( xml, tr, sections, pos, maxSummaryLen );
+		bool status = getDefaultSummary ( titleRecVersion, tr, sections, pos, maxSummaryLen );
 		if ( m_numDisplayLines > 0 ) {
 			m_displayLen = m_summaryLen;
 		}
@@ -1129,7 +1144,7 @@ int64_t Summary::getBestWindow(const Matches *matches, int32_t mm, int32_t *last
 }
 
 // get summary when no search terms could be found
-bool Summary::getDefaultSummary(const Xml *xml, const TokenizerResult *tr, const Sections *sections, Pos *pos, unsigned maxSummaryLen) {
+bool Summary::getDefaultSummary(int32_t titleRecVersion, const TokenizerResult *tr, const Sections *sections, Pos *pos, unsigned maxSummaryLen) {
 	logTrace(g_conf.m_logTraceSummary, "BEGIN");
 
 	char *p    = m_summary;
@@ -1225,7 +1240,7 @@ bool Summary::getDefaultSummary(const Xml *xml, const TokenizerResult *tr, const
 	}
 
 	if (bestStart >= 0 && bestEnd > bestStart){
-		p += pos->filter( tr, bestStart, bestEnd, true, p, pend - 10, xml->getVersion() );
+		p += pos->filter( tr, bestStart, bestEnd, true, p, pend - 10, titleRecVersion );
 
 		// NULL terminate
 		*p++ = '\0';
@@ -42,12 +42,15 @@ public:
 
 	void setSummary(const std::string &summary);
 
-	bool setSummary(const Xml *xml, const TokenizerResult *tr, const Sections *sections, Pos *pos, const Query *q,
+	bool setSummary(int32_t titleRecVersion, const TokenizerResult *tr, const Sections *sections, Pos *pos, const Query *q,
 	                unsigned maxSummaryLen, int32_t numDisplayLines, int32_t maxNumLines, int32_t maxNumCharsPerLine,
 	                const Url *f, const Matches *matches, const char *titleBuf, int32_t titleBufLen);
 
 	bool setSummaryFromTags(Xml *xml, unsigned maxSummaryLen, const char *titleBuf, int32_t titleBufLen);
 
+	// use a summary made by setSummaryFromTags() earlier (SummaryStore)
+	void setSummaryFromTags(const char *summary, int32_t summaryLen);
+
 	char       *getSummary();
 	const char *getSummary() const;
 	int32_t getSummaryDisplayLen() const;
@@ -58,7 +61,7 @@ public:
 private:
 	bool verifySummary(const char *titleBuf, int32_t titleBufLen);
 
-	bool getDefaultSummary(const Xml *xml, const TokenizerResult *tr, const Sections *sections, Pos *pos, unsigned maxSummaryLen);
+	bool getDefaultSummary(int32_t titleRecVersion, const TokenizerResult *tr, const Sections *sections, Pos *pos, unsigned maxSummaryLen);
 
 	int64_t getBestWindow (const Matches *matches, int32_t mn, int32_t *lasta, int32_t *besta, int32_t *bestb,
 	                       char *gotIt, char *retired, int32_t maxExcerptLen );
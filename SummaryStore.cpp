@@ -0,0 +1,399 @@
+#include "SummaryStore.h"
+#include "Xml.h"
+#include "Url.h"
+#include "Title.h"
+#include "Summary.h"
+#include "Matches.h"
+#include "SafeBuf.h"
+#include "Errno.h"
+#include "Log.h"
+#include <string.h>
+
+// per token flags
+static const uint8_t TF_TAG     = 0x01;
+static const uint8_t TF_ALFANUM = 0x02;
+static const uint8_t TF_SCRIPT  = 0x04;
+static const uint8_t TF_STYLE   = 0x08;
+static const uint8_t TF_SELECT  = 0x10;
+static const uint8_t TF_IFRAME  = 0x20;
+static const uint8_t TF_HEAD    = 0x40;
+static const uint8_t TF_TITLE   = 0x80;
+
+// the section flags Summary and Matches look at
+static const struct {
+	uint8_t m_tokenFlag;
+	sec_t   m_secFlag;
+} s_sectionFlags[] = {
+	{ TF_SCRIPT, SEC_SCRIPT },
+	{ TF_STYLE,  SEC_STYLE },
+	{ TF_SELECT, SEC_SELECT },
+	{ TF_IFRAME, SEC_IN_IFRAME },
+	{ TF_HEAD,   SEC_IN_HEAD },
+	{ TF_TITLE,  SEC_IN_TITLE },
+};
+
+static bool appendVarint(SafeBuf *sb, uint64_t value) {
+	while (value >= 0x80) {
+		if (!sb->pushChar(static_cast<char>((value & 0x7f) | 0x80))) {
+			return false;
+		}
+		value >>= 7;
+	}
+	return sb->pushChar(static_cast<char>(value));
+}
+
+static bool readVarint(const char **p, const char *pend, uint64_t *value) {
+	*value = 0;
+	for (int shift = 0; *p < pend && shift < 64; shift += 7) {
+		unsigned char c = *(*p)++;
+		*value |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool appendString(SafeBuf *sb, const char *s, int32_t len) {
+	return sb->safeMemcpy(&len, sizeof(len)) && sb->safeMemcpy(s, len);
+}
+
+static bool readInt32(const char **p, const char *pend, int32_t *value) {
+	if (pend - *p < (int32_t)sizeof(*value)) {
+		return false;
+	}
+	memcpy(value, *p, sizeof(*value));
+	*p += sizeof(*value);
+	return true;
+}
+
+static bool readString(const char **p, const char *pend, const char **s, int32_t *len) {
+	if (!readInt32(p, pend, len) || *len < 0 || pend - *p < *len) {
+		return false;
+	}
+	*s = *p;
+	*p += *len;
+	return true;
+}
+
+
+SummaryStore::SummaryStore()
+	: m_tr()
+	, m_bits()
+	, m_bitsForSummary()
+	, m_pos()
+	, m_phrases()
+	, m_sections() {
+	reset();
+}
+
+void SummaryStore::reset() {
+	m_data = NULL;
+	m_dataSize = 0;
+	m_robotsFlags = 0;
+	m_titleMaxLen = 0;
+	m_summaryMaxLen = 0;
+	m_title = NULL;
+	m_titleLen = 0;
+	m_tagSummary = NULL;
+	m_tagSummaryLen = 0;
+	m_metaTags.clear();
+	m_numTokens = 0;
+	m_tokens = NULL;
+	m_tokensSize = 0;
+	m_text = NULL;
+	m_textSize = 0;
+	m_tokensSet = false;
+	m_tr.clear();
+	m_bits.reset();
+	m_bitsForSummary.reset();
+	m_pos.reset();
+	m_phrases.reset();
+	m_sections.reset();
+}
+
+void SummaryStore::setArena(Arena *arena) {
+	m_bits.setArena(arena);
+	m_bitsForSummary.setArena(arena);
+	m_pos.setArena(arena);
+	m_phrases.setArena(arena);
+}
+
+// . serialized layout:
+//   uint8_t version, uint8_t robotsFlags, int32_t titleMaxLen,
+//   int32_t summaryMaxLen, title, tag summary, int32_t numMetaTags followed
+//   by the meta tag names and contents, int32_t numTokens, tokens, text
+// . strings are an int32_t length followed by the bytes
+// . each token is a flags byte, the nodeid if it is a tag, varints for the
+//   gap to the end of the previous token and the length in the source and,
+//   if it is not a tag, a varint for the length of its text
+// . the tokens and meta tags are only needed to make a summary if there is a
+//   title but no summary from tags, so they are left out otherwise
+bool SummaryStore::build(SafeBuf *sb, Xml *xml, const Url *url, uint8_t contentType, bool isSiteRoot,
+                         int32_t titleMaxLen, int32_t summaryMaxLen, uint8_t robotsFlags) {
+	if (summaryMaxLen >= MAX_SUMMARY_LEN) {
+		g_errno = EBUFTOOSMALL;
+		return false;
+	}
+
+	Title title;
+	bool hasTitle = title.setTitleFromTags(xml, titleMaxLen, contentType, isSiteRoot);
+	if (!hasTitle && g_errno) {
+		return false;
+	}
+
+	// the summary from tags depends on the title
+	Summary summary;
+	bool hasSummary = false;
+	if (hasTitle) {
+		hasSummary = summary.setSummaryFromTags(xml, summaryMaxLen, title.getTitle(), title.getTitleLen());
+		if (!hasSummary && g_errno) {
+			return false;
+		}
+	}
+
+	bool needTokens = hasTitle && !hasSummary;
+
+	sb->setLabel("sumstore");
+	char version = s_version;
+	if (!sb->pushChar(version) ||
+	    !sb->pushChar(robotsFlags) ||
+	    !sb->safeMemcpy(&titleMaxLen, sizeof(titleMaxLen)) ||
+	    !sb->safeMemcpy(&summaryMaxLen, sizeof(summaryMaxLen)) ||
+	    !appendString(sb, title.getTitle(), hasTitle ? title.getTitleLen() : 0) ||
+	    !appendString(sb, summary.getSummary(), hasSummary ? summary.getSummaryLen() : 0)) {
+		return false;
+	}
+
+	// meta tags for Matches
+	int32_t numMetaTags = 0;
+	int32_t numMetaTagsOffset = sb->length();
+	if (!sb->safeMemcpy(&numMetaTags, sizeof(numMetaTags))) {
+		return false;
+	}
+
+	for (int32_t i = 0; needTokens && i < xml->getNumNodes(); i++) {
+		if (xml->getNodeId(i) != TAG_META) {
+			continue;
+		}
+
+		int32_t nameLen;
+		const char *name = xml->getString(i, "name", &nameLen);
+		if (!Matches::getMetaTagFlags(name, nameLen)) {
+			continue;
+		}
+
+		int32_t contentLen;
+		const char *content = xml->getString(i, "content", &contentLen);
+		if (!content || contentLen <= 0) {
+			continue;
+		}
+
+		if (!appendString(sb, name, nameLen) || !appendString(sb, content, contentLen)) {
+			return false;
+		}
+		numMetaTags++;
+	}
+	memcpy(sb->getBufStart() + numMetaTagsOffset, &numMetaTags, sizeof(numMetaTags));
+
+	// the tokens
+	TokenizerResult tr;
+	Bits bits;
+	Sections sections;
+	if (needTokens) {
+		xml_tokenizer_phase_1(xml, &tr);
+		calculate_tokens_hashes(&tr);
+
+		if (!bits.set(&tr)) {
+			return false;
+		}
+
+		// returns true and sets g_errno on error
+		sections.set(&tr, &bits, url, contentType);
+		if (g_errno) {
+			return false;
+		}
+	}
+
+	int32_t numTokens = tr.size();
+	SafeBuf tokens;
+	SafeBuf text;
+	size_t prevEnd = 0;
+	for (int32_t i = 0; i < numTokens; i++) {
+		const TokenRange &token = tr[i];
+		if (token.start_pos < prevEnd || token.end_pos < token.start_pos) {
+			log(LOG_WARN, "sumstore: tokens out of order for %s", url->getUrl());
+			g_errno = EBADENGINEER;
+			return false;
+		}
+
+		uint8_t flags = 0;
+		if (token.nodeid) {
+			flags |= TF_TAG;
+		}
+		if (token.is_alfanum) {
+			flags |= TF_ALFANUM;
+		}
+
+		if (sections.m_sectionPtrs && sections.m_sectionPtrs[i]) {
+			sec_t secFlags = sections.m_sectionPtrs[i]->m_flags;
+			for (const auto &sf : s_sectionFlags) {
+				if (secFlags & sf.m_secFlag) {
+					flags |= sf.m_tokenFlag;
+				}
+			}
+		}
+
+		if (!tokens.pushChar(flags) ||
+		    (token.nodeid && !tokens.safeMemcpy(&token.nodeid, sizeof(token.nodeid))) ||
+		    !appendVarint(&tokens, token.start_pos - prevEnd) ||
+		    !appendVarint(&tokens, token.end_pos - token.start_pos)) {
+			return false;
+		}
+
+		if (!token.nodeid) {
+			if (!appendVarint(&tokens, token.token_len) || !text.safeMemcpy(token.token_start, token.token_len)) {
+				return false;
+			}
+		}
+
+		prevEnd = token.end_pos;
+	}
+
+	return sb->safeMemcpy(&numTokens, sizeof(numTokens)) &&
+	       appendString(sb, tokens.getBufStart(), tokens.length()) &&
+	       appendString(sb, text.getBufStart(), text.length());
+}
+
+bool SummaryStore::set(const char *data, int32_t dataSize) {
+	reset();
+
+	const char *p = data;
+	const char *pend = data + dataSize;
+
+	if (dataSize < 2 || (uint8_t)p[0] != s_version) {
+		return false;
+	}
+	m_robotsFlags = p[1];
+	p += 2;
+
+	int32_t numMetaTags;
+	if (!readInt32(&p, pend, &m_titleMaxLen) ||
+	    !readInt32(&p, pend, &m_summaryMaxLen) ||
+	    !readString(&p, pend, &m_title, &m_titleLen) ||
+	    !readString(&p, pend, &m_tagSummary, &m_tagSummaryLen) ||
+	    !readInt32(&p, pend, &numMetaTags) || numMetaTags < 0) {
+		return false;
+	}
+
+	for (int32_t i = 0; i < numMetaTags; i++) {
+		MetaTag metaTag;
+		if (!readString(&p, pend, &metaTag.m_name, &metaTag.m_nameLen) ||
+		    !readString(&p, pend, &metaTag.m_content, &metaTag.m_contentLen)) {
+			m_metaTags.clear();
+			return false;
+		}
+		m_metaTags.push_back(metaTag);
+	}
+
+	// a token takes at least a flags byte and two varints, so a count that
+	// does not fit in the stored tokens is corrupt and must not size the
+	// reserve in setTokens()
+	if (!readInt32(&p, pend, &m_numTokens) || m_numTokens < 0 ||
+	    !readString(&p, pend, &m_tokens, &m_tokensSize) ||
+	    m_numTokens > m_tokensSize / 3 ||
+	    !readString(&p, pend, &m_text, &m_textSize) ||
+	    p != pend) {
+		reset();
+		return false;
+	}
+
+	m_data = data;
+	m_dataSize = dataSize;
+	return true;
+}
+
+void SummaryStore::getMetaTag(int32_t i, const char **name, int32_t *nameLen, const char **content, int32_t *contentLen) const {
+	const MetaTag &metaTag = m_metaTags[i];
+	*name = metaTag.m_name;
+	*nameLen = metaTag.m_nameLen;
+	*content = metaTag.m_content;
+	*contentLen = metaTag.m_contentLen;
+}
+
+bool SummaryStore::setTokens() {
+	if (m_tokensSet) {
+		return true;
+	}
+
+	m_tr.clear();
+	m_tr.tokens.reserve(m_numTokens);
+
+	std::vector<sec_t> secFlags;
+	secFlags.reserve(m_numTokens);
+
+	const char *p = m_tokens;
+	const char *pend = m_tokens + m_tokensSize;
+	size_t prevEnd = 0;
+	int32_t textOffset = 0;
+
+	for (int32_t i = 0; i < m_numTokens; i++) {
+		if (p >= pend) {
+			g_errno = ECORRUPTDATA;
+			return false;
+		}
+		uint8_t flags = *p++;
+
+		nodeid_t nodeid = 0;
+		if (flags & TF_TAG) {
+			if (pend - p < (int32_t)sizeof(nodeid)) {
+				g_errno = ECORRUPTDATA;
+				return false;
+			}
+			memcpy(&nodeid, p, sizeof(nodeid));
+			p += sizeof(nodeid);
+		}
+
+		uint64_t gap;
+		uint64_t srcLen;
+		uint64_t textLen = 0;
+		if (!readVarint(&p, pend, &gap) ||
+		    !readVarint(&p, pend, &srcLen) ||
+		    (!(flags & TF_TAG) && !readVarint(&p, pend, &textLen)) ||
+		    textLen > (uint64_t)(m_textSize - textOffset)) {
+			g_errno = ECORRUPTDATA;
+			return false;
+		}
+
+		size_t startPos = prevEnd + gap;
+		size_t endPos = startPos + srcLen;
+		if (flags & TF_TAG) {
+			m_tr.tokens.emplace_back(startPos, endPos, m_text + textOffset, 0, nodeid, 0);
+		} else {
+			m_tr.tokens.emplace_back(startPos, endPos, m_text + textOffset, textLen, true, (flags & TF_ALFANUM) != 0);
+		}
+		textOffset += textLen;
+		prevEnd = endPos;
+
+		sec_t sf = 0;
+		for (const auto &f : s_sectionFlags) {
+			if (flags & f.m_tokenFlag) {
+				sf |= f.m_secFlag;
+			}
+		}
+		secFlags.push_back(sf);
+	}
+
+	calculate_tokens_hashes(&m_tr);
+
+	if (!m_bits.set(&m_tr) ||
+	    !m_bitsForSummary.setForSummary(&m_tr) ||
+	    !m_pos.set(&m_tr) ||
+	    !m_phrases.set(m_tr, m_bits) ||
+	    !m_sections.setFlat(&m_tr, secFlags.data())) {
+		return false;
+	}
+
+	m_tokensSet = true;
+	return true;
+}
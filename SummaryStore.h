@@ -0,0 +1,120 @@
+#ifndef GB_SUMMARYSTORE_H
+#define GB_SUMMARYSTORE_H
+
+#include "tokenizer.h"
+#include "Bits.h"
+#include "Pos.h"
+#include "Phrases.h"
+#include "Sections.h"
+#include <inttypes.h>
+#include <vector>
+
+class Xml;
+class Url;
+class SafeBuf;
+class Arena;
+
+// . compact copy of what Msg20 needs to make the title and summary of a doc,
+//   stored in the titlerec (XmlDoc::ptr_summaryStore) so query time does not
+//   have to parse the html again
+// . holds the phase-1 tokens of the doc with the text of the tags dropped
+//   (tags are kept as zero-length tokens so token numbers and positions are
+//   the same as when tokenizing the Xml), the section flags the summary code
+//   looks at, the title and summary made from tags for the collection's max
+//   lengths, the meta tags used by Matches and the robots meta tag flags
+// . token hashes, Bits, Pos and Phrases are cheap so they are recomputed from
+//   the stored tokens rather than stored
+class SummaryStore {
+public:
+	static const uint8_t s_version = 1;
+
+	// robots meta tag flags
+	static const uint8_t s_robotsNoIndex   = 0x01;
+	static const uint8_t s_robotsNoFollow  = 0x02;
+	static const uint8_t s_robotsNoArchive = 0x04;
+	static const uint8_t s_robotsNoSnippet = 0x08;
+
+	SummaryStore();
+
+	void reset();
+
+	// . serialize the store for "xml" into "sb"
+	// . returns false and sets g_errno on error
+	static bool build(SafeBuf *sb, Xml *xml, const Url *url, uint8_t contentType, bool isSiteRoot,
+	                  int32_t titleMaxLen, int32_t summaryMaxLen, uint8_t robotsFlags);
+
+	// . use a serialized store. "data" must stay around while we are used
+	// . returns false if the store is from an unknown version or corrupt
+	bool set(const char *data, int32_t dataSize);
+
+	bool isSet() const { return m_data != NULL; }
+
+	// take the bits, positions and phrases from "arena" instead of Mem
+	void setArena(Arena *arena);
+
+	// title and summary were made with these max lengths
+	int32_t getTitleMaxLen() const { return m_titleMaxLen; }
+	int32_t getSummaryMaxLen() const { return m_summaryMaxLen; }
+
+	// title from tags. length is 0 if there was none
+	const char *getTitle() const { return m_title; }
+	int32_t getTitleLen() const { return m_titleLen; }
+
+	// summary from tags. length is 0 if there was none
+	const char *getTagSummary() const { return m_tagSummary; }
+	int32_t getTagSummaryLen() const { return m_tagSummaryLen; }
+
+	uint8_t getRobotsFlags() const { return m_robotsFlags; }
+
+	int32_t getNumMetaTags() const { return (int32_t)m_metaTags.size(); }
+	void getMetaTag(int32_t i, const char **name, int32_t *nameLen, const char **content, int32_t *contentLen) const;
+
+	// . set up the tokens, bits, positions, phrases and sections from the
+	//   stored tokens. only needed if the summary is not from tags
+	// . returns false and sets g_errno on error
+	bool setTokens();
+
+	const TokenizerResult *getTokenizerResult() const { return &m_tr; }
+	Bits *getBitsForSummary() { return &m_bitsForSummary; }
+	Pos *getPos() { return &m_pos; }
+	Phrases *getPhrases() { return &m_phrases; }
+	const Sections *getSections() const { return &m_sections; }
+
+private:
+	struct MetaTag {
+		const char *m_name;
+		int32_t     m_nameLen;
+		const char *m_content;
+		int32_t     m_contentLen;
+	};
+
+	const char *m_data;
+	int32_t     m_dataSize;
+
+	uint8_t m_robotsFlags;
+	int32_t m_titleMaxLen;
+	int32_t m_summaryMaxLen;
+
+	const char *m_title;
+	int32_t     m_titleLen;
+	const char *m_tagSummary;
+	int32_t     m_tagSummaryLen;
+
+	std::vector<MetaTag> m_metaTags;
+
+	int32_t     m_numTokens;
+	const char *m_tokens;
+	int32_t     m_tokensSize;
+	const char *m_text;
+	int32_t     m_textSize;
+
+	bool            m_tokensSet;
+	TokenizerResult m_tr;
+	Bits            m_bits;
+	Bits            m_bitsForSummary;
+	Pos             m_pos;
+	Phrases         m_phrases;
+	Sections        m_sections;
+};
+
+#endif // GB_SUMMARYSTORE_H
@@ -13,6 +13,7 @@
 #include "Process.h"
 #include "ip.h"
 #include "Errno.h"
+#include "hash.h"
 #include <sys/time.h>             // time()
 #include <sys/types.h>            // setsockopt()
 #include <sys/socket.h>           // setsockopt()
@@ -98,6 +99,9 @@ void TcpServer::reset() {
 	// if so, stop listening, may block
 	close ( m_sock );
 	// shutdown SSL
+	for ( std::map<uint64_t, SSL_SESSION*>::iterator it = m_sslSessions.begin(); it != m_sslSessions.end(); ++it )
+		SSL_SESSION_free ( it->second );
+	m_sslSessions.clear();
 	if (m_useSSL && m_ctx) {
 		SSL_CTX_free(m_ctx);
 		// clean up the SSL crap
@@ -516,14 +520,17 @@ bool TcpServer::gotTcpServerIp ( TcpState *tst , int32_t ip ) {
 bool TcpServer::sendMsg( const char *hostname, int32_t hostnameLen, int32_t ip, int16_t port, char *sendBuf,
 			 int32_t sendBufSize, int32_t sendBufUsed, int32_t msgTotalSize, void *state,
 			 void ( *callback )( void *state, TcpSocket *s ), int32_t timeout,
-			 int32_t maxTextDocLen, int32_t maxOtherDocLen, bool useHttpTunnel ) {
+			 int32_t maxTextDocLen, int32_t maxOtherDocLen, bool useHttpTunnel, bool keepAlive ) {
 	// debug
 	char ipbuf[16];
 	log(LOG_DEBUG,"tcp: Getting doc for ip=%s.", iptoa(ip,ipbuf));
 
 	// . get an unused socket that's pre-connected to this ip/port
 	// . returns NULL if it can't
-	TcpSocket *s = getAvailableSocket ( ip , port );
+	// . a tunnel has to start out with a fresh CONNECT
+	TcpSocket *s = NULL;
+	if ( ! useHttpTunnel )
+		s = getAvailableSocket ( ip , port , hostname , hostnameLen );
 
 	// . sendMsg(...) returns false if blocked, true otherwise
 	// . it also sets g_errno on error
@@ -561,6 +568,13 @@ bool TcpServer::sendMsg( const char *hostname, int32_t hostnameLen, int32_t ip,
 			s->m_hostname[hostnameLen] = '\0';
 		}
 
+		s->m_keepAlive = keepAlive;
+		s->m_numReuses++;
+
+		if ( g_conf.m_logDebugTcp )
+			log( LOG_DEBUG, "tcp: reusing kept-alive sd=%i to %s:%u reuses=%" PRId32,
+			     s->m_sd, ipbuf, (unsigned)(uint16_t)port, s->m_numReuses );
+
 		return sendMsg( s, sendBuf, sendBufSize, sendBufUsed, msgTotalSize, state, callback, timeout,
 						maxTextDocLen, maxOtherDocLen );
 	}
@@ -619,6 +633,8 @@ bool TcpServer::sendMsg( const char *hostname, int32_t hostnameLen, int32_t ip,
 	s->m_tunnelMode       = 0;
 	s->m_truncated        = false;
 	s->m_blockedContentType = false;
+	s->m_keepAlive        = keepAlive;
+	s->m_numReuses        = 0;
 
 	// if http request starts with "CONNECT ..." then enter tunnel mode
 	if ( useHttpTunnel ) {
@@ -733,7 +749,10 @@ bool TcpServer::sendMsg( TcpSocket *s, char *sendBuf, int32_t sendBufSize, int32
 
 // . TcpSockets are 1-1 with socket descriptors
 // . returns NULL if no available sockets w/ this ip/port were found
-TcpSocket *TcpServer::getAvailableSocket ( int32_t ip, int16_t port ) {
+// . ssl sockets must also have been connected for the same hostname because
+//   the certificate was checked against its SNI
+TcpSocket *TcpServer::getAvailableSocket ( int32_t ip, int16_t port, const char *hostname,
+					   int32_t hostnameLen ) {
 	// . search for an available socket already connected to our ip/port
 	for ( int32_t i = 0 ; i <= m_lastFilled ; i++ ) {
 		TcpSocket *s = m_tcpSockets[i];
@@ -741,6 +760,23 @@ TcpSocket *TcpServer::getAvailableSocket ( int32_t ip, int16_t port ) {
 		if ( s->m_ip   != ip   ) continue;
 		if ( s->m_port != port ) continue;
 		if ( ! s->isAvailable()) continue;
+		if ( s->m_isIncoming   ) continue;
+		if ( m_useSSL ) {
+			if ( ! hostname || ! s->m_hostname ) continue;
+			if ( s->m_hostnameSize != hostnameLen + 1 ) continue;
+			if ( strncmp ( s->m_hostname , hostname , hostnameLen ) != 0 ) continue;
+		}
+		// . the server may have closed it since we last polled. a FIN
+		//   reads as 0 bytes. anything else it sent unasked for also
+		//   makes the connection useless to us
+		char c;
+		int n = ::recv ( s->m_sd , &c , 1 , MSG_PEEK | MSG_DONTWAIT );
+		if ( n >= 0 || ( errno != EAGAIN && errno != EWOULDBLOCK ) ) {
+			if ( g_conf.m_logDebugTcp )
+				log( LOG_DEBUG, "tcp: kept-alive sd=%i was closed by the server", s->m_sd );
+			destroySocket ( s );
+			continue;
+		}
 		// reset the start time
 		s->m_startTime      = gettimeofdayInMilliseconds();
 		s->m_lastActionTime = gettimeofdayInMilliseconds();
@@ -752,6 +788,65 @@ TcpSocket *TcpServer::getAvailableSocket ( int32_t ip, int16_t port ) {
 	return NULL;
 }
 
+// . a kept-alive socket the server closed while it sat idle in our pool reads
+//   nothing, or a reset, in reply to the request we wrote on it
+// . that says nothing about the server, so instead of handing the caller an
+//   empty reply or ECONNRESET (which Msg13 takes for a ban) send the same
+//   request once more on a fresh connection
+// . returns true if "s" was destroyed and the request resent, in which case
+//   the callback is called for the new socket only
+bool TcpServer::resendOnNewSocket ( TcpSocket *s ) {
+	if ( s->m_numReuses <= 0 || s->m_totalRead > 0 ) return false;
+	if ( s->m_isIncoming || s->m_tunnelMode || s->m_streamingMode ) return false;
+	if ( ! s->m_sendBuf || ! s->m_callback ) return false;
+	if ( g_errno && g_errno != ECONNRESET && g_errno != EPIPE ) return false;
+
+	char ipbuf[16];
+	log( LOG_INFO, "tcp: kept-alive sd=%i to %s:%u was closed before the reply, resending on a new connection",
+	     s->m_sd, iptoa(s->m_ip,ipbuf), (unsigned)(uint16_t)s->m_port );
+
+	// the other idle sockets to this server were probably dropped along
+	// with this one. the new connection must be a fresh one, so that a
+	// second failure is reported as is
+	for ( int32_t i = 0 ; i <= m_lastFilled ; i++ ) {
+		TcpSocket *t = m_tcpSockets[i];
+		if ( ! t || t == s ) continue;
+		if ( t->m_ip != s->m_ip || t->m_port != s->m_port ) continue;
+		if ( ! t->isAvailable() || t->m_isIncoming ) continue;
+		destroySocket ( t );
+	}
+
+	// the new socket owns the request now
+	char *sendBuf = s->m_sendBuf;
+	s->m_sendBuf = NULL;
+
+	g_errno = 0;
+	bool status = sendMsg ( s->m_hostname, s->m_hostname ? s->m_hostnameSize - 1 : 0, s->m_ip, s->m_port,
+				sendBuf, s->m_sendBufSize, s->m_sendBufUsed, s->m_totalToSend,
+				s->m_state, s->m_callback, s->m_timeout, s->m_maxTextDocLen, s->m_maxOtherDocLen,
+				false, s->m_keepAlive );
+
+	// . it failed right away and set g_errno. sendMsg() does not call the
+	//   callback then, so report its error through the old socket
+	// . sendMsg() freed the request
+	if ( status ) makeCallback ( s );
+	destroySocket ( s );
+	return true;
+}
+
+// . how many idle kept-alive sockets we have to this ip/port
+int32_t TcpServer::getNumAvailableSockets ( int32_t ip, int16_t port ) {
+	int32_t count = 0;
+	for ( int32_t i = 0 ; i <= m_lastFilled ; i++ ) {
+		TcpSocket *s = m_tcpSockets[i];
+		if ( ! s ) continue;
+		if ( s->m_ip != ip || s->m_port != port ) continue;
+		if ( ! s->isAvailable() || s->m_isIncoming ) continue;
+		count++;
+	}
+	return count;
+}
+
 
 // . gets a new TcpSocket
 // . returns NULL and set g_errno on error
@@ -1149,6 +1244,14 @@ static void readSocketWrapper2(int sd, void *state) {
 	//log("........... TcpServer::readSocketWrapper(sd=%d,this=%p,s=%p)",sd,THIS,s);
 	// . return if does not exist
 	if ( ! s ) return ;
+	// . an idle kept-alive connection became readable. the server closed
+	//   it or sent something we did not ask for, either way it is done
+	if ( s->isAvailable() && ! s->m_isIncoming ) {
+		if ( g_conf.m_logDebugTcp )
+			log( LOG_DEBUG, "tcp: closing idle kept-alive sd=%i", s->m_sd );
+		THIS->destroySocket ( s );
+		return;
+	}
 	// doing an ssl accept?
 	if ( s->m_sockState == ST_SSL_ACCEPT ) {
 		// try to complete SSL_accept() function
@@ -1233,6 +1336,9 @@ static void readSocketWrapper2(int sd, void *state) {
 	if ( status == -1 ) {
 		// g_errno is not set if it just read 0 bytes
 		//if ( ! g_errno ) { g_process.shutdownAbort(true); }
+		// . a reused connection the server closed before replying is
+		//   not an answer from the server, try once more on a new one
+		if ( THIS->resendOnNewSocket ( s ) ) return;
 		THIS->makeCallback  ( s );
 		THIS->destroySocket ( s ); 
 		return;
@@ -1248,6 +1354,16 @@ static void readSocketWrapper2(int sd, void *state) {
 	if ( s->m_sendBuf && s->m_tunnelMode != 1 ) {
 		// i guess ok
 		g_errno = 0;
+		// . keep the connection if the reply ended exactly where its
+		//   Content-Length said it would. decide before the callback
+		//   takes the read buffer
+		if ( s->m_keepAlive &&
+		     ( s->m_tunnelMode != 0 ||
+		       s->m_truncated ||
+		       s->m_blockedContentType ||
+		       s->m_totalToRead <= 0 ||
+		       s->m_readOffset != s->m_totalToRead ) )
+			s->m_keepAlive = false;
 		// callback must free all m_sendBuf/m_readBuf in TcpSocket
 		THIS->makeCallback ( s );
 		// . if the socket was closed by remote side we destroy it
@@ -1261,7 +1377,8 @@ static void readSocketWrapper2(int sd, void *state) {
 		//	THIS->destroySocket ( s );
 		//else    
 		//	THIS->recycleSocket ( s );
-		THIS->destroySocket ( s );		
+		if ( s->m_keepAlive ) THIS->recycleSocket ( s );
+		else                  THIS->destroySocket ( s );
 		return;
 	}
 
@@ -2084,6 +2201,10 @@ void TcpServer::destroySocket ( TcpSocket *s ) {
 	// . now that we do http tunneling to the proxy using the non-ssl
 	//   tcp server, we do ssl handshakes on "s" so free it up here...
 	if ( s->m_ssl ) { // m_useSSL && s->m_ssl) {
+		// remember the session of a download that went fine so
+		// the next connection to this server can resume it
+		if ( m_useSSL && ! s->m_isIncoming && ! g_errno && SSL_is_init_finished ( s->m_ssl ) )
+			saveSslSession ( s );
 		/*
 		errno = 0;
 		// shit, this blocks?
@@ -2235,8 +2356,51 @@ void TcpServer::destroySocket ( TcpSocket *s ) {
 //   supports keep alives...
 void TcpServer::recycleSocket ( TcpSocket *s ) {
 	// mdw... this now just destroys, baby, no more keep-alives
-	destroySocket ( s );
-	return;
+	// . except for our own downloads where the reply allowed it. see
+	//   HttpServer.cpp::getMsgSize()
+	if ( s->m_isIncoming || ! s->m_keepAlive || s->m_streamingMode ||
+	     s->m_waitingOnHandler || s->m_udpSlot || g_errno ||
+	     s->m_sockState == ST_CLOSE_CALLED ||
+	     ! g_conf.m_spiderKeepAlive ||
+	     getNumAvailableSockets ( s->m_ip , s->m_port ) >= g_conf.m_spiderKeepAliveMaxPerHost ) {
+		destroySocket ( s );
+		return;
+	}
+
+	// the callback may have taken the buffers already
+	if ( s->m_readBuf ) mfree ( s->m_readBuf , s->m_readBufSize , "TcpServer" );
+	if ( s->m_sendBuf ) mfree ( s->m_sendBuf , s->m_sendBufSize , "TcpServer" );
+	s->m_readBuf     = NULL;
+	s->m_readBufSize = 0;
+	s->m_readOffset  = 0;
+	s->m_totalRead   = 0;
+	s->m_totalToRead = 0;
+	s->m_sendBuf     = NULL;
+	s->m_sendBufSize = 0;
+	s->m_sendBufUsed = 0;
+	s->m_sendOffset  = 0;
+	s->m_totalSent   = 0;
+	s->m_totalToSend = 0;
+
+	if ( s->m_writeRegistered ) {
+		g_loop.unregisterWriteCallback ( s->m_sd , this , writeSocketWrapper );
+		s->m_writeRegistered = false;
+	}
+
+	// nobody is waiting on it now
+	s->m_callback           = NULL;
+	s->m_state              = NULL;
+	s->m_truncated          = false;
+	s->m_blockedContentType = false;
+	s->m_keepAlive          = false;
+	s->m_lastActionTime     = gettimeofdayInMilliseconds();
+	s->m_sockState          = ST_AVAILABLE;
+
+	if ( g_conf.m_logDebugTcp ) {
+		char ipbuf[16];
+		log( LOG_DEBUG, "tcp: keeping alive sd=%i to %s:%u", s->m_sd,
+		     iptoa(s->m_ip,ipbuf), (unsigned)(uint16_t)s->m_port );
+	}
 }
 
 // . called by Loop::runLoop() every one second
@@ -2271,6 +2435,12 @@ void TcpServer::readTimeoutPoll ( ) {
 			destroySocket ( s );
 			continue;
 		}
+		// close kept-alive download connections nobody reused in time
+		if ( s->isAvailable() && ! s->m_isIncoming &&
+		     now - s->m_lastActionTime >= g_conf.m_spiderKeepAliveIdleTimeout ) {
+			destroySocket ( s );
+			continue;
+		}
 		// . if he is sending, that sticks too, so try it!
 		// . or if we're connecting to him...
 		if ( s->isSending() || 
@@ -2656,6 +2826,39 @@ bool TcpServer::sendChunk( TcpSocket *s, SafeBuf *sb, void *state,
 
 
 // returns -1 on error with g_errno set. returns 0 if would block. 1 if done.
+static const int32_t s_maxSslSessions = 4096;
+
+static uint64_t getSslSessionKey ( const TcpSocket *s ) {
+	uint64_t key = ((uint64_t)(uint32_t)s->m_ip << 16) | (uint16_t)s->m_port;
+	if ( s->m_hostname ) key = hash64 ( s->m_hostname , s->m_hostnameSize - 1 , key );
+	return key;
+}
+
+void TcpServer::saveSslSession ( TcpSocket *s ) {
+	SSL_SESSION *session = SSL_get1_session ( s->m_ssl );
+	if ( ! session ) return;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	if ( ! SSL_SESSION_is_resumable ( session ) ) {
+		SSL_SESSION_free ( session );
+		return;
+	}
+#endif
+	uint64_t key = getSslSessionKey ( s );
+	std::map<uint64_t, SSL_SESSION*>::iterator it = m_sslSessions.find ( key );
+	if ( it != m_sslSessions.end() ) {
+		SSL_SESSION_free ( it->second );
+		it->second = session;
+		return;
+	}
+	// crude but bounded. the busy servers come right back
+	if ( (int32_t)m_sslSessions.size() >= s_maxSslSessions ) {
+		for ( it = m_sslSessions.begin(); it != m_sslSessions.end(); ++it )
+			SSL_SESSION_free ( it->second );
+		m_sslSessions.clear();
+	}
+	m_sslSessions[key] = session;
+}
+
 int TcpServer::sslHandshake ( TcpSocket *s ) {
 	if ( s->m_sockState != ST_SSL_HANDSHAKE ) { g_process.shutdownAbort(true); }
 
@@ -2670,6 +2873,13 @@ int TcpServer::sslHandshake ( TcpSocket *s ) {
 
 		SSL_set_fd(s->m_ssl, s->m_sd);
 		SSL_set_connect_state(s->m_ssl);
+
+		// resume the last session with this server if we have one
+		if ( m_useSSL ) {
+			std::map<uint64_t, SSL_SESSION*>::iterator it = m_sslSessions.find ( getSslSessionKey ( s ) );
+			if ( it != m_sslSessions.end() )
+				SSL_set_session ( s->m_ssl , it->second );
+		}
 	}
 
 	// set hostname for SNI
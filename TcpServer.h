@@ -22,6 +22,7 @@
 #include <openssl/crypto.h>
 #include <openssl/err.h>
 #include <atomic>
+#include <map>
 #include "TcpSocket.h"            
 
 // raised from 5k to 15k in case we are a spider compression proxy
@@ -87,7 +88,7 @@ class TcpServer {
 	bool sendMsg( const char *hostname, int32_t hostnameLen, int32_t ip, int16_t port, char *sendBuf,
 				  int32_t sendBufSize, int32_t sendBufUsed, int32_t msgTotalSize, void *state,
 				  void ( *callback )( void *state, TcpSocket *s ), int32_t timeout, int32_t maxTextDocLen,
-				  int32_t maxOtherDocLen, bool useHttpTunnel = false );
+				  int32_t maxOtherDocLen, bool useHttpTunnel = false, bool keepAlive = false );
 
 	// . send request over an available (pre-connected) TcpSocket
 	// . destroys the socket on error
@@ -135,7 +136,10 @@ class TcpServer {
 
 	// private:
 
-	TcpSocket *getAvailableSocket ( int32_t ip, int16_t port ) ;
+	TcpSocket *getAvailableSocket ( int32_t ip, int16_t port, const char *hostname = NULL,
+					int32_t hostnameLen = 0 ) ;
+	int32_t    getNumAvailableSockets ( int32_t ip, int16_t port ) ;
+	bool       resendOnNewSocket  ( TcpSocket *s ) ;
 	TcpSocket *getNewSocket       ( ) ;
 	TcpSocket *wrapSocket         ( int sd , int32_t niceness, bool incoming);
 	bool       closeLeastUsed     ( int32_t maxIdleTime = -1 ) ;
@@ -143,6 +147,11 @@ class TcpServer {
 
 	int sslHandshake ( TcpSocket *s ) ;
 
+	// . tls sessions of outgoing connections keyed on ip/port/hostname so
+	//   a reconnect to the same server can do an abbreviated handshake
+	void saveSslSession ( TcpSocket *s ) ;
+	std::map<uint64_t, SSL_SESSION*> m_sslSessions;
+
 	// . we call this to try to figure out the size of the WHOLE msg
 	//   being read so that we might pre-allocate memory for it
 	// . overriden for different protocols
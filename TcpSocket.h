@@ -106,6 +106,14 @@ class TcpSocket {
 	bool m_truncated;
 	bool m_blockedContentType;
 
+	// . set by the sender of an outgoing request that asked for keep-alive
+	// . cleared by getMsgSize() if the reply does not allow reusing the
+	//   connection. if still set when the reply is read the socket goes
+	//   back to ST_AVAILABLE instead of being closed
+	bool m_keepAlive;
+	// how many requests were sent on this connection before the current
+	int32_t m_numReuses;
+
 	char        m_niceness;
 	bool        m_streamingMode;
 
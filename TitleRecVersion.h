@@ -36,7 +36,10 @@
 //#define TITLEREC_CURRENT_VERSION    128
 
 // make sure parameter is stripped even if query parameter is separated with '?'
-#define TITLEREC_CURRENT_VERSION    129
+//#define TITLEREC_CURRENT_VERSION    129
+
+// pre-tokenized summary store (ptr_summaryStore)
+#define TITLEREC_CURRENT_VERSION    130
 
 #define TITLEREC_CURRENT_VERSION_STR    TO_STRING(TITLEREC_CURRENT_VERSION)
 
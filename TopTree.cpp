@@ -22,6 +22,7 @@ TopTree::TopTree() {
 	m_docsWanted = 0;
 	m_ridiculousMax = 0;
 	m_kickedOutDocIds = false;
+	m_maxDocIdsPerSite = 0;
 	memset(m_domCount, 0, sizeof(m_domCount));
 	memset(m_domMinNode, 0, sizeof(m_domMinNode));
 
@@ -45,16 +46,29 @@ void TopTree::reset() {
 	m_highNode = -1;
 	m_pickRight = 0;
 	m_t2.reset();
+	m_siteTable.reset();
+	m_maxDocIdsPerSite = 0;
 }
 
 // . pre-allocate memory
 // . returns false and sets g_errno on error
-bool TopTree::setNumNodes ( int32_t docsWanted , bool doSiteClustering ) {
+bool TopTree::setNumNodes ( int32_t docsWanted , bool doSiteClustering ,
+			   int32_t maxDocIdsPerSite ) {
 
 	// save this
 	m_docsWanted       = docsWanted;
 	m_doSiteClustering = doSiteClustering;
 
+	// per-site limit only applies to site clustering
+	m_maxDocIdsPerSite = doSiteClustering ? maxDocIdsPerSite : 0;
+	if ( m_maxDocIdsPerSite < 0 ) m_maxDocIdsPerSite = 0;
+	m_siteTable.reset();
+	if ( m_maxDocIdsPerSite > 0 &&
+	     ! m_siteTable.set ( 4 , 4 * ( 1 + m_maxDocIdsPerSite ) ,
+				 docsWanted * 2 , NULL , 0 , false , "tt-sites" ) ) {
+		return false;
+	}
+
 	// reset this
 	m_kickedOutDocIds = false;
 	
@@ -219,6 +233,30 @@ bool TopTree::addNode ( TopNode *t , int32_t tnn ) {
 
  addIt:
 
+	// . site clustering: if this site already has its max nodes we only
+	//   keep the higher scoring ones, like setClusterLevels() would
+	// . the site's lowest node is removed after we are added, like
+	//   "deleteMe" below, since it is in the empty node list after "t"
+	int32_t siteDeleteMe = -1;
+	if ( m_maxDocIdsPerSite > 0 && t->m_siteHash32 ) {
+		const int32_t *sv = (const int32_t *)m_siteTable.getValue ( &t->m_siteHash32 );
+		if ( sv && sv[0] >= m_maxDocIdsPerSite ) {
+			// get the lowest node of the site
+			int32_t lowest = sv[1];
+			for ( int32_t j = 2 ; j <= sv[0] ; j++ ) {
+				if ( isLowerThan ( &m_nodes[sv[j]] , &m_nodes[lowest] ) )
+					lowest = sv[j];
+			}
+			if ( ! isLowerThan ( &m_nodes[lowest] , t ) ) {
+				logTrace(g_conf.m_logTraceTopTree, "END, site %" PRIu32" has %" PRId32" better docids - skipping", t->m_siteHash32, sv[0]);
+				m_kickedOutDocIds = true;
+				return false;
+			}
+			logTrace(g_conf.m_logTraceTopTree, "site %" PRIu32" is full, replacing docId %" PRId64, t->m_siteHash32, m_nodes[lowest].m_docId);
+			siteDeleteMe = lowest;
+		}
+	}
+
 	int32_t iparent = -1;
 	// this is -1 if there are no nodes used in the tree
 	int32_t i = m_headNode;
@@ -404,6 +442,16 @@ bool TopTree::addNode ( TopNode *t , int32_t tnn ) {
 		deleteNode ( deleteMe , domHash );
 	}
 
+	// same for the lowest node of our site, unless that was "deleteMe"
+	if ( siteDeleteMe >= 0 && siteDeleteMe != deleteMe ) {
+		logTrace(g_conf.m_logTraceTopTree, "deleting site node %" PRId32, siteDeleteMe);
+		removeNode ( siteDeleteMe );
+	}
+
+	if ( m_maxDocIdsPerSite > 0 ) {
+		addSiteNode ( tnn );
+	}
+
 	// remove as many docids as we should
 	// BR 20170421: Added m_numUsedNodes > m_docsWanted check, otherwise it would exceed m_docsWanted, I guess due to rounding.
 	while ( m_vcount-1.0 >= m_docsWanted || m_numUsedNodes > m_docsWanted || m_numUsedNodes == m_numNodes) {
@@ -415,63 +463,120 @@ bool TopTree::addNode ( TopNode *t , int32_t tnn ) {
 		if ( tn < 0 ) gbshutdownLogicError();
 		// sanity check
 		//if ( getNext(tn) == -1 ) gbshutdownLogicError();
-		// get the min node
-		TopNode *t = &m_nodes[tn];
-		uint8_t domHash2 = Docid::getDomHash8FromDocId(t->m_docId);
-		// . also must delete from m_t2
-		// . make the key
-		key96_t k;
-		// WARNING: if t->m_score is fractional, the fraction will be
-		// dropped and could result in the lower scoring of the two 
-		// docids being kept.
-		uint32_t cs ;
-
-		cs = ((uint32_t)t->m_score);
-
-		k.n1  =  domHash2                << 24; // 1 byte domHash
-		//k.n1 |= (t->m_bscore & ~0xc0)    << 16; // 1 byte bscore
-		k.n1 |=  cs                      >> 16; // 4 byte score
-		k.n0  =  ((int64_t)cs)         << (64-16);
-		k.n0 |=  t->m_docId; // getDocIdFromPtr ( t->m_docIdPtr );
 		// delete the low node, this might do a rotation
-		deleteNode ( tn , domHash2 );
+		if ( ! removeNode ( tn ) ) break;
+	}
+	// logTrace(g_conf.m_logTraceTopTree, "Cleanup done. No longer true: m_vcount-1.0 %f >= m_docsWanted %" PRId32 " || m_numUsedNodes %" PRId32 " == m_numNodes %" PRId32 "", m_vcount-1.0, m_docsWanted, m_numUsedNodes, m_numNodes);
 
-		// the rest is for site clustering only
-		if ( ! m_doSiteClustering ) continue;
+	logTrace(g_conf.m_logTraceTopTree, "END. m_docsWanted: %" PRId32 ", m_numUsedNodes: %" PRId32 "", m_docsWanted, m_numUsedNodes);
+	return true;
+}
+
+
+// true if "a" ranks below "b". lower-scoring stuff is on the LEFT!
+bool TopTree::isLowerThan ( const TopNode *a , const TopNode *b ) {
+	if ( a->m_score < b->m_score ) return true;
+	if ( a->m_score > b->m_score ) return false;
+	// store lower docids first
+	return a->m_docId > b->m_docId;
+}
 
-		// get the node from t2
-		int32_t min = m_t2.getNode_unlocked(0, (char *)&k);
-		// sanity check. LEAVE THIS HERE!
-		if ( min < 0 ) { break; }
+// . delete node #i from the tree and from m_t2 if site clustering
+// . m_t2 must be locked
+// . returns false if node #i was not in m_t2
+bool TopTree::removeNode ( int32_t i ) {
+	TopNode *t = &m_nodes[i];
+	uint8_t domHash2 = Docid::getDomHash8FromDocId(t->m_docId);
+	// . also must delete from m_t2
+	// . make the key
+	key96_t k;
+	// WARNING: if t->m_score is fractional, the fraction will be
+	// dropped and could result in the lower scoring of the two 
+	// docids being kept.
+	uint32_t cs ;
+
+	cs = ((uint32_t)t->m_score);
+
+	k.n1  =  domHash2                << 24; // 1 byte domHash
+	//k.n1 |= (t->m_bscore & ~0xc0)    << 16; // 1 byte bscore
+	k.n1 |=  cs                      >> 16; // 4 byte score
+	k.n0  =  ((int64_t)cs)         << (64-16);
+	k.n0 |=  t->m_docId; // getDocIdFromPtr ( t->m_docIdPtr );
+	// delete the node, this might do a rotation
+	deleteNode ( i , domHash2 );
+
+	// the rest is for site clustering only
+	if ( ! m_doSiteClustering ) return true;
+
+	// get the node from t2
+	int32_t min = m_t2.getNode_unlocked(0, (char *)&k);
+	// sanity check. LEAVE THIS HERE!
+	if ( min < 0 ) return false;
+	// sanity check
+	//key96_t *kp1 = (key96_t *)m_t2.getKey(min);
+	//if ( (kp1->n1) >>24 != domHash2 ) gbshutdownLogicError();
+	// get next node from t2
+	int32_t next = m_t2.getNextNode_unlocked(min);
+	// delete from m_t2
+	m_t2.deleteNode_unlocked(min, false);
+	// skip if not th emin
+	if ( m_domMinNode[domHash2] != min ) return true;
+	// if we were the last, that's it
+	if ( m_domCount[domHash2] == 0 ) {
+		// no more entries for this domHash2
+		m_domMinNode[domHash2] = -1;
 		// sanity check
-		//key96_t *kp1 = (key96_t *)m_t2.getKey(min);
-		//if ( (kp1->n1) >>24 != domHash2 ) gbshutdownLogicError();
-		// get next node from t2
-		int32_t next = m_t2.getNextNode_unlocked(min);
-		// delete from m_t2
-		m_t2.deleteNode_unlocked(min, false);
-		// skip if not th emin
-		if ( m_domMinNode[domHash2] != min ) continue;
-		// if we were the last, that's it
-		if ( m_domCount[domHash2] == 0 ) {
-			// no more entries for this domHash2
-			m_domMinNode[domHash2] = -1;
-			// sanity check
-			//if ( next > 0 ) {
-			//key96_t *kp2 = (key96_t *)m_t2.getKey(next);
-			//if ( (kp2->n1) >>24 == domHash2 ) gbshutdownLogicError();
-			//}
-			continue;
+		//if ( next > 0 ) {
+		//key96_t *kp2 = (key96_t *)m_t2.getKey(next);
+		//if ( (kp2->n1) >>24 == domHash2 ) gbshutdownLogicError();
+		//}
+		return true;
+	}
+	// the new min is the "next" of the old min
+	m_domMinNode[domHash2] = next;
+	return true;
+}
+
+// remember node #i under its site hash
+void TopTree::addSiteNode ( int32_t i ) {
+	uint32_t siteHash32 = m_nodes[i].m_siteHash32;
+	if ( ! siteHash32 ) return;
+
+	int32_t *sv = (int32_t *)m_siteTable.getValue32 ( (int32_t)siteHash32 );
+	if ( ! sv ) {
+		int32_t slot;
+		if ( ! m_siteTable.addKey ( &siteHash32 , NULL , &slot ) ) {
+			// can not track it, so it is just not limited
+			g_errno = 0;
+			return;
 		}
-		// the new min is the "next" of the old min
-		m_domMinNode[domHash2] = next;
+		sv = (int32_t *)m_siteTable.getValueFromSlot ( slot );
+		sv[0] = 0;
 	}
-	// logTrace(g_conf.m_logTraceTopTree, "Cleanup done. No longer true: m_vcount-1.0 %f >= m_docsWanted %" PRId32 " || m_numUsedNodes %" PRId32 " == m_numNodes %" PRId32 "", m_vcount-1.0, m_docsWanted, m_numUsedNodes, m_numNodes);
 
-	logTrace(g_conf.m_logTraceTopTree, "END. m_docsWanted: %" PRId32 ", m_numUsedNodes: %" PRId32 "", m_docsWanted, m_numUsedNodes);
-	return true;
+	// sanity, addNode() made room
+	if ( sv[0] >= m_maxDocIdsPerSite ) gbshutdownLogicError();
+
+	sv[++sv[0]] = i;
 }
 
+// forget node #i under its site hash
+void TopTree::deleteSiteNode ( int32_t i ) {
+	uint32_t siteHash32 = m_nodes[i].m_siteHash32;
+	if ( ! siteHash32 ) return;
+
+	int32_t *sv = (int32_t *)m_siteTable.getValue32 ( (int32_t)siteHash32 );
+	if ( ! sv ) return;
+
+	for ( int32_t j = 1 ; j <= sv[0] ; j++ ) {
+		if ( sv[j] != i ) continue;
+		sv[j] = sv[sv[0]];
+		sv[0]--;
+		break;
+	}
+
+	if ( sv[0] == 0 ) m_siteTable.removeKey ( &siteHash32 );
+}
 
 // . remove this node from the tree
 // . used to remove the last node and replace it with a higher scorer
@@ -481,6 +586,8 @@ void TopTree::deleteNode ( int32_t i , uint8_t domHash ) {
 	// sanity check
 	if ( PARENT(i) == -2 ) gbshutdownLogicError();
 
+	if ( m_maxDocIdsPerSite > 0 ) deleteSiteNode ( i );
+
 	// if it was the low node, update it
 	if ( i == m_lowNode ) {
 		m_lowNode = getNext ( i );
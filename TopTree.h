@@ -8,6 +8,7 @@
 #define GB_TOPTREE_H
 
 #include "RdbTree.h"
+#include "HashTableX.h"
 
 
 class TopNode {
@@ -23,6 +24,7 @@ class TopNode {
 	float          m_score    ;
 	int64_t      m_docId;
 	unsigned     m_flags; //from Docid2FlagsAndSiteMap
+	uint32_t     m_siteHash32; //from Docid2FlagsAndSiteMap, 0 if unknown
 
 	// tree info, indexes into m_nodes array
 	int32_t m_parent;
@@ -36,8 +38,11 @@ class TopTree {
 	~TopTree();
 	// free mem
 	void reset();
-	// pre-allocate memory
-	bool setNumNodes ( int32_t docsWanted , bool doSiteClustering );
+	// . pre-allocate memory
+	// . if "maxDocIdsPerSite" is positive we keep at most that many nodes
+	//   of the same TopNode::m_siteHash32 when site clustering
+	bool setNumNodes ( int32_t docsWanted , bool doSiteClustering ,
+			   int32_t maxDocIdsPerSite = 0 );
 	// . add a node
 	// . get an empty first, fill it in and call addNode(t)
 	int32_t getEmptyNode ( ) { return m_emptyNode; }
@@ -64,6 +69,7 @@ class TopTree {
 	int32_t getNumNodes() const { return m_numNodes; }
 	int32_t getNumUsedNodes() const { return m_numUsedNodes; }
 	int32_t getNumDocsWanted() const { return m_docsWanted; }
+	int32_t getMaxDocIdsPerSite() const { return m_maxDocIdsPerSite; }
 
 private:
 	int32_t  m_docsWanted;
@@ -106,6 +112,17 @@ private:
 	// keys per domHash, where X is usually "m_ridiculousMax"
 	RdbTree m_t2;
 
+	// . the node numbers of each site hash, so the clustering Msg39 does
+	//   with the clusterdb recs happens while the nodes are added and
+	//   the same-site nodes do not take the place of other sites
+	// . value is the node count followed by m_maxDocIdsPerSite node numbers
+	int32_t    m_maxDocIdsPerSite;
+	HashTableX m_siteTable;
+
+	static bool isLowerThan ( const TopNode *a , const TopNode *b );
+	bool removeNode  ( int32_t i ) ;
+	void addSiteNode ( int32_t i ) ;
+	void deleteSiteNode ( int32_t i ) ;
 	void deleteNode  ( int32_t i , uint8_t domHash ) ;
 	void setDepths   ( int32_t i ) ;
 	int32_t rotateLeft  ( int32_t i ) ;
@@ -0,0 +1,386 @@
+#include "TruncatedTermlists.h"
+#include "RdbList.h"
+#include "Posdb.h"
+#include "PageTemperatureRegistry.h"
+#include "Mem.h"
+#include "ScopedLock.h"
+#include "Errno.h"
+#include "Log.h"
+#include <vector>
+#include <queue>
+#include <algorithm>
+
+TruncatedTermlists g_truncatedTermlists;
+
+
+static const char memory_note[] = "truncatedlist";
+
+
+void PostingsSummary::add(const void *key)
+{
+	unsigned char hash_group = Posdb::getHashGroup(key);
+	hash_groups |= 1U<<hash_group;
+	density_ranks |= 1U<<Posdb::getDensityRank(key);
+	if(hash_group==HASHGROUP_INLINKTEXT)
+		linker_site_ranks |= 1U<<Posdb::getWordSpamRank(key);
+	else
+		word_spam_ranks |= 1U<<Posdb::getWordSpamRank(key);
+}
+
+
+TruncatedTermlists::TruncatedTermlists()
+  : m(),
+    purge_iter(m.begin()),
+    pending(),
+    generation(0),
+    max_memory(0), //disabled
+    memory_used(0),
+    mtx()
+{
+}
+
+
+void TruncatedTermlists::configure(size_t max_memory_)
+{
+	ScopedLock sl(mtx);
+	max_memory = max_memory_;
+	while(memory_used>max_memory && !m.empty())
+		forced_purge_step();
+}
+
+
+void TruncatedTermlists::clear()
+{
+	ScopedLock sl(mtx);
+	for(std::map<Key,Item>::iterator iter = m.begin();
+	    iter!=m.end();
+	    ++iter)
+		mfree(iter->second.data,iter->second.datalen,memory_note);
+	m.clear();
+	purge_iter = m.begin();
+	memory_used = 0;
+	generation++;
+}
+
+
+void TruncatedTermlists::clear(collnum_t collnum)
+{
+	ScopedLock sl(mtx);
+	for(std::map<Key,Item>::iterator iter = m.begin();
+	    iter!=m.end();
+	    ) {
+		if(iter->first.collnum==collnum) {
+			mfree(iter->second.data,iter->second.datalen,memory_note);
+			memory_used -= iter->second.datalen;
+			iter = m.erase(iter);
+		} else
+			++iter;
+	}
+	purge_iter = m.begin();
+	generation++;
+}
+
+
+bool TruncatedTermlists::is_registered(collnum_t collnum, int32_t file_id, int64_t term_id)
+{
+	Key key;
+	key.collnum = collnum;
+	key.file_id = file_id;
+	key.term_id = term_id;
+	ScopedLock sl(mtx);
+	return m.find(key)!=m.end();
+}
+
+
+bool TruncatedTermlists::lookup(collnum_t collnum, int32_t file_id, int64_t term_id, RdbList *list, int32_t *max_dropped_site_rank, PostingsSummary *dropped_postings)
+{
+	Key key;
+	key.collnum = collnum;
+	key.file_id = file_id;
+	key.term_id = term_id;
+	ScopedLock sl(mtx);
+	std::map<Key,Item>::iterator iter = m.find(key);
+	if(iter==m.end())
+		return false;
+
+	char *rdblistmem = (char*)mmalloc(iter->second.datalen,"RdbList");
+	if(!rdblistmem)
+		return false;
+	memcpy(rdblistmem,iter->second.data,iter->second.datalen);
+	list->set(rdblistmem,
+	          iter->second.datalen,
+	          rdblistmem,
+	          iter->second.datalen,
+	          iter->second.start_key,
+	          iter->second.end_key,
+	          Posdb::getFixedDataSize(),
+	          true,
+	          Posdb::getUseHalfKeys(),
+	          Posdb::getKeySize());
+	*max_dropped_site_rank = iter->second.max_dropped_site_rank;
+	*dropped_postings = iter->second.dropped_postings;
+	return true;
+}
+
+
+void TruncatedTermlists::insert(collnum_t collnum, int32_t file_id, int64_t term_id, RdbList *list, int32_t max_docids)
+{
+	uint64_t expected_generation;
+	{
+		ScopedLock sl(mtx);
+		if(max_memory==0)
+			return; //disabled
+		expected_generation = generation;
+	}
+
+	//truncate outside the lock, it means a walk through the whole list
+	RdbList truncated;
+	int32_t max_dropped_site_rank;
+	PostingsSummary dropped_postings;
+	if(!make_truncated_list(list,max_docids,&truncated,&max_dropped_site_rank,&dropped_postings)) {
+		g_errno = 0;
+		return;
+	}
+
+	Key key;
+	key.collnum = collnum;
+	key.file_id = file_id;
+	key.term_id = term_id;
+	add(key,&truncated,max_dropped_site_rank,dropped_postings,expected_generation);
+}
+
+
+struct TruncatedTermlists::TruncateJob {
+	TruncatedTermlists *that;
+	Key key;
+	RdbList list;
+	int32_t max_docids;
+	uint64_t generation;
+};
+
+
+void TruncatedTermlists::insert_in_background(collnum_t collnum, int32_t file_id, int64_t term_id, RdbList *list, int32_t max_docids)
+{
+	Key key;
+	key.collnum = collnum;
+	key.file_id = file_id;
+	key.term_id = term_id;
+
+	TruncateJob *job;
+	{
+		ScopedLock sl(mtx);
+		if(max_memory==0)
+			return; //disabled
+		if(m.find(key)!=m.end() || pending.find(key)!=pending.end())
+			return;
+
+		job = new TruncateJob;
+		job->that = this;
+		job->key = key;
+		job->max_docids = max_docids;
+		job->generation = generation;
+		pending.insert(key);
+	}
+
+	//the query goes on using its list so the job gets a copy. a memcpy is
+	//much cheaper than the truncation walk
+	int32_t listSize = list->getListSize();
+	char *copy = (char*)mmalloc(listSize,"RdbList");
+	if(copy) {
+		memcpy(copy,list->getList(),listSize);
+		job->list.set(copy, listSize, copy, listSize,
+		              list->getStartKey(), list->getEndKey(),
+		              Posdb::getFixedDataSize(), true, Posdb::getUseHalfKeys(), Posdb::getKeySize());
+		if(g_jobScheduler.submit(truncateJob, truncateJobDone, job, thread_type_index_generate, 0))
+			return;
+		log(LOG_DEBUG,"query: could not submit truncation job for termId=%" PRId64, term_id);
+	}
+
+	g_errno = 0;
+	ScopedLock sl(mtx);
+	pending.erase(key);
+	delete job;
+}
+
+
+void TruncatedTermlists::truncateJob(void *state)
+{
+	TruncateJob *job = static_cast<TruncateJob*>(state);
+	RdbList truncated;
+	int32_t max_dropped_site_rank;
+	PostingsSummary dropped_postings;
+	if(!make_truncated_list(&job->list,job->max_docids,&truncated,&max_dropped_site_rank,&dropped_postings)) {
+		g_errno = 0;
+		return;
+	}
+	job->list.freeList();
+	job->that->add(job->key,&truncated,max_dropped_site_rank,dropped_postings,job->generation);
+}
+
+
+void TruncatedTermlists::truncateJobDone(void *state, job_exit_t /*exit_type*/)
+{
+	TruncateJob *job = static_cast<TruncateJob*>(state);
+	{
+		ScopedLock sl(job->that->mtx);
+		job->that->pending.erase(job->key);
+	}
+	delete job;
+}
+
+
+void TruncatedTermlists::add(const Key &key, RdbList *truncated, int32_t max_dropped_site_rank, const PostingsSummary &dropped_postings, uint64_t expected_generation)
+{
+	size_t datalen = truncated->getListSize();
+
+	ScopedLock sl(mtx);
+	if(datalen==0 || datalen>max_memory)
+		return;
+	if(generation!=expected_generation)
+		return; //cleared while we truncated, the file may be gone
+	if(m.find(key)!=m.end())
+		return; //another query beat us to it
+
+	void *datacopy = mmalloc(datalen,memory_note);
+	if(!datacopy)
+		return;
+	memcpy(datacopy,truncated->getList(),datalen);
+
+	Item item;
+	item.data = (char*)datacopy;
+	item.datalen = datalen;
+	truncated->getStartKey(item.start_key);
+	truncated->getEndKey(item.end_key);
+	item.max_dropped_site_rank = max_dropped_site_rank;
+	item.dropped_postings = dropped_postings;
+	m.insert(std::make_pair(key,item));
+	memory_used += datalen;
+
+	while(memory_used>max_memory && !m.empty())
+		forced_purge_step();
+}
+
+
+size_t TruncatedTermlists::size()
+{
+	ScopedLock sl(mtx);
+	return m.size();
+}
+
+
+namespace {
+struct RankedDocId {
+	double rank;
+	uint64_t docid;
+	int32_t site_rank;
+	int32_t bytes;
+	//priority_queue with std::greater keeps the worst one on top
+	bool operator>(const RankedDocId &r) const {
+		if(rank!=r.rank) return rank>r.rank;
+		return docid<r.docid; //lower docid wins ties
+	}
+};
+}
+
+
+static double getStaticRank(int32_t site_rank, uint64_t docid) {
+	//siterank first, the page temperature (0..1) orders docids within a siterank
+	double temperature;
+	if(g_pageTemperatureRegistry.empty() ||
+	   !g_pageTemperatureRegistry.query_page_temperature(docid,0.0,1.0,&temperature))
+		temperature = 0.5;
+	return site_rank + temperature;
+}
+
+
+bool TruncatedTermlists::make_truncated_list(RdbList *src, int32_t max_docids, RdbList *dst, int32_t *max_dropped_site_rank, PostingsSummary *dropped_postings)
+{
+	*max_dropped_site_rank = -1;
+	dropped_postings->clear();
+	dst->set(NULL, 0, NULL, 0,
+	         src->getStartKey(), src->getEndKey(),
+	         Posdb::getFixedDataSize(), true, Posdb::getUseHalfKeys(), Posdb::getKeySize());
+	if(max_docids<=0 || src->isEmpty())
+		return true;
+
+	//pass 1: find the best docids
+	std::priority_queue<RankedDocId,std::vector<RankedDocId>,std::greater<RankedDocId> > best;
+	RankedDocId current;
+	current.docid = 0;
+	bool haveCurrent = false;
+	for(src->resetListPtr(); !src->isExhausted(); src->skipCurrentRecord()) {
+		char key[18];
+		src->getCurrentKey(key);
+		uint64_t docid = Posdb::getDocId(key);
+		if(!haveCurrent || docid!=current.docid) {
+			if(haveCurrent) {
+				best.push(current);
+				if((int32_t)best.size()>max_docids) {
+					*max_dropped_site_rank = std::max(*max_dropped_site_rank,best.top().site_rank);
+					best.pop();
+				}
+			}
+			current.site_rank = Posdb::getSiteRank(key);
+			current.rank = getStaticRank(current.site_rank,docid);
+			current.docid = docid;
+			current.bytes = 0;
+			haveCurrent = true;
+		}
+		current.bytes += src->getCurrentRecSize();
+	}
+	best.push(current);
+	if((int32_t)best.size()>max_docids) {
+		*max_dropped_site_rank = std::max(*max_dropped_site_rank,best.top().site_rank);
+		best.pop();
+	}
+
+	std::vector<uint64_t> docids;
+	docids.reserve(best.size());
+	//the first key in the new list is always a full one
+	int32_t neededSize = 18;
+	for(; !best.empty(); best.pop()) {
+		docids.push_back(best.top().docid);
+		neededSize += best.top().bytes;
+	}
+	std::sort(docids.begin(),docids.end());
+
+	if(!dst->growList(neededSize)) {
+		src->resetListPtr();
+		return false;
+	}
+
+	//pass 2: copy the postings of those docids. they come in docid order
+	std::vector<uint64_t>::const_iterator next = docids.begin();
+	for(src->resetListPtr(); !src->isExhausted(); src->skipCurrentRecord()) {
+		char key[18];
+		src->getCurrentKey(key);
+		uint64_t docid = Posdb::getDocId(key);
+		while(next!=docids.end() && *next<docid)
+			++next;
+		if(next!=docids.end() && *next==docid) {
+			//addRecord() compresses the key again relative to the previous one
+			if(!dst->addRecord(key,0,NULL)) {
+				src->resetListPtr();
+				return false;
+			}
+		} else if(*max_dropped_site_rank>=0)
+			dropped_postings->add(key);
+	}
+	src->resetListPtr();
+	dst->resetListPtr();
+	return true;
+}
+
+
+void TruncatedTermlists::forced_purge_step()
+{
+	if(purge_iter==m.end())
+		purge_iter = m.begin();
+	else {
+		std::map<Key,Item>::iterator iter = purge_iter;
+		++purge_iter;
+		mfree(iter->second.data,iter->second.datalen,memory_note);
+		memory_used -= iter->second.datalen;
+		m.erase(iter);
+	}
+}
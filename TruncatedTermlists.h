@@ -0,0 +1,128 @@
+#ifndef GB_TRUNCATEDTERMLISTS_H
+#define GB_TRUNCATEDTERMLISTS_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <map>
+#include <set>
+#include "GbMutex.h"
+#include "collnum_t.h"
+#include "JobScheduler.h" // job_exit_t
+
+class RdbList;
+
+// . which hashgroups, density ranks and spam ranks a set of posdb postings
+//   has, a bit for each value
+// . PosdbTable::getMaxSingleTermScore() bounds the score a document gets
+//   from such postings with the weights of any query
+struct PostingsSummary {
+	uint32_t hash_groups;
+	uint32_t density_ranks;
+	uint32_t word_spam_ranks;    //of the postings not in inlink text
+	uint32_t linker_site_ranks;  //the spam rank of inlink text postings
+	PostingsSummary() { clear(); }
+	void clear() { hash_groups = density_ranks = word_spam_ranks = linker_site_ranks = 0; }
+	bool empty() const { return hash_groups==0; }
+	void add(const void *key);
+	void add(const PostingsSummary &s) {
+		hash_groups |= s.hash_groups;
+		density_ranks |= s.density_ranks;
+		word_spam_ranks |= s.word_spam_ranks;
+		linker_site_ranks |= s.linker_site_ranks;
+	}
+};
+
+// . a tier of truncated posdb termlists: for long termlists we keep only the
+//   postings of the top N docids by static rank (siterank and page
+//   temperature) so a query can intersect those instead of reading and
+//   scoring millions of docids. Msg39 falls back to the full lists when the
+//   truncated ones do not produce enough results, or when the docids left
+//   out of them could still score better than the results it got, see
+//   Msg39::controlLoop()
+// . like HighFrequencyTermShortcuts but for any term, and maintained by
+//   ourselves instead of being generated offline: the first time Msg2 reads
+//   a long list of a posdb file it hands a copy to a job thread which
+//   truncates it and adds it here, so the query does not wait for it
+// . posdb files never change once written, so an entry is good until the
+//   file goes away in a merge. RdbBase clears the collection then since
+//   file ids may be reused
+class TruncatedTermlists {
+	TruncatedTermlists(const TruncatedTermlists&);
+	TruncatedTermlists& operator=(const TruncatedTermlists&);
+
+	struct Key {
+		collnum_t collnum;
+		int32_t file_id;
+		int64_t term_id;
+		bool operator<(const Key &k) const {
+			if(collnum!=k.collnum) return collnum<k.collnum;
+			if(file_id!=k.file_id) return file_id<k.file_id;
+			return term_id<k.term_id;
+		}
+	};
+	struct Item {
+		char *data;
+		size_t datalen;
+		char start_key[18];
+		char end_key[18];
+		int32_t max_dropped_site_rank;
+		PostingsSummary dropped_postings;
+	};
+	std::map<Key,Item> m;
+	std::map<Key,Item>::iterator purge_iter;
+	std::set<Key> pending;  //being truncated in a job thread
+	uint64_t generation;    //bumped by clear() so lists of deleted files are not added
+	size_t max_memory;
+	size_t memory_used;
+	GbMutex mtx;
+
+	struct TruncateJob;
+
+public:
+	TruncatedTermlists();
+	~TruncatedTermlists() { clear(); }
+
+	void configure(size_t max_memory);
+
+	void clear();
+	void clear(collnum_t collnum);
+
+	bool is_registered(collnum_t collnum, int32_t file_id, int64_t term_id);
+
+	// . copy the truncated list into "list"
+	// . "max_dropped_site_rank" is the highest siterank of the docids it
+	//   left out, -1 if none, and "dropped_postings" what their postings
+	//   have
+	// . returns false if we do not have it
+	bool lookup(collnum_t collnum, int32_t file_id, int64_t term_id, RdbList *list, int32_t *max_dropped_site_rank, PostingsSummary *dropped_postings);
+
+	// truncate the full termlist "list" to "max_docids" docids and add it
+	void insert(collnum_t collnum, int32_t file_id, int64_t term_id, RdbList *list, int32_t max_docids);
+
+	// . like insert() but truncates a copy of "list" in a job thread
+	// . does nothing if we have the list or are truncating it already, or
+	//   if the job can not be submitted
+	void insert_in_background(collnum_t collnum, int32_t file_id, int64_t term_id, RdbList *list, int32_t max_docids);
+
+	size_t size();
+
+	// . put the postings of the best "max_docids" docids of posdb list
+	//   "src" into "dst", still in key order
+	// . sets "max_dropped_site_rank" to the highest siterank of the docids
+	//   left out, -1 if none, and "dropped_postings" to what their
+	//   postings have
+	// . returns false and sets g_errno on error
+	static bool make_truncated_list(RdbList *src, int32_t max_docids, RdbList *dst, int32_t *max_dropped_site_rank, PostingsSummary *dropped_postings);
+
+private:
+	void add(const Key &key, RdbList *truncated, int32_t max_dropped_site_rank, const PostingsSummary &dropped_postings, uint64_t expected_generation);
+	void forced_purge_step();
+
+	static void truncateJob(void *state);
+	static void truncateJobDone(void *state, job_exit_t exit_type);
+};
+
+
+extern TruncatedTermlists g_truncatedTermlists;
+
+#endif
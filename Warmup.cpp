@@ -0,0 +1,475 @@
+#include "Warmup.h"
+#include "Rdb.h"
+#include "RdbBase.h"
+#include "RdbMap.h"
+#include "RdbList.h"
+#include "BigFile.h"
+#include "File.h"
+#include "Msg5.h"
+#include "Posdb.h"
+#include "Hostdb.h"
+#include "Conf.h"
+#include "Loop.h"
+#include "JobScheduler.h"
+#include "ScopedLock.h"
+#include "hash.h"
+#include "fctypes.h"
+#include "Log.h"
+#include "Errno.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <new>
+
+Warmup g_warmup;
+
+static const int32_t s_hotSetVersion = 1;
+
+// number of ranges read through Msg5 at the same time
+static const int32_t s_maxReplaysOut = 8;
+
+// how often we check if the warm-up is taking too long
+static const int32_t s_timeoutCheckInterval = 1000;
+
+// how often a full hot set is aged to make room for new ranges
+static const int32_t s_agingInterval = 60000;
+
+static uint64_t getRangeHash(rdbid_t rdbId, collnum_t collnum, const char *startKey) {
+	return hash64(startKey, getKeySizeFromRdbId(rdbId), hash64((uint64_t)rdbId, (uint64_t)collnum));
+}
+
+Warmup::Warmup()
+	: m_mtx()
+	, m_hotRanges()
+	, m_isWarmingUp(false)
+	, m_startTime(0)
+	, m_prefetchRanges()
+	, m_prefetchedBytes(0)
+	, m_replayRanges()
+	, m_nextReplay(0)
+	, m_numReplaysOut(0)
+	, m_msg5s(NULL)
+	, m_lists(NULL)
+	, m_replaysDone(false) {
+}
+
+bool Warmup::init() {
+	if (!g_loop.registerSleepCallback(s_agingInterval, this, ageHotRangesWrapper, "Warmup::ageHotRangesWrapper")) {
+		log(LOG_WARN, "warmup: Failed to register aging callback");
+		return false;
+	}
+
+	char filename[1024];
+	sprintf(filename, "%shotset.dat", g_hostdb.m_dir);
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		if (errno != ENOENT) {
+			log(LOG_WARN, "warmup: Failed to open %s: %s", filename, strerror(errno));
+		}
+		return true;
+	}
+
+	int32_t version = 0;
+	int32_t numRanges = 0;
+	if (read(fd, &version, sizeof(version)) != sizeof(version) ||
+	    read(fd, &numRanges, sizeof(numRanges)) != sizeof(numRanges) ||
+	    version != s_hotSetVersion || numRanges < 0) {
+		log(LOG_WARN, "warmup: Ignoring %s with unknown format", filename);
+		close(fd);
+		return true;
+	}
+
+	// do not trust the count of a corrupt or truncated file with the
+	// size of the reserve
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		log(LOG_WARN, "warmup: Failed to stat %s: %s", filename, strerror(errno));
+		close(fd);
+		return true;
+	}
+	int64_t maxRanges = (st.st_size - (int64_t)(sizeof(version) + sizeof(numRanges))) / (int64_t)sizeof(HotRange);
+	if (numRanges > maxRanges) {
+		log(LOG_WARN, "warmup: %s is truncated. It has room for %" PRId64" of %" PRId32" ranges",
+		    filename, maxRanges, numRanges);
+		numRanges = (int32_t)maxRanges;
+	}
+
+	ScopedLock sl(m_mtx);
+	m_hotRanges.clear();
+	m_hotRanges.reserve(numRanges);
+
+	for (int32_t i = 0; i < numRanges; ++i) {
+		HotRange range;
+		if (read(fd, &range, sizeof(range)) != sizeof(range)) {
+			log(LOG_WARN, "warmup: %s is truncated. Read %" PRId32" of %" PRId32" ranges", filename, i, numRanges);
+			break;
+		}
+
+		if (range.m_rdbId != RDB_POSDB && range.m_rdbId != RDB_TITLEDB) {
+			continue;
+		}
+
+		m_hotRanges[getRangeHash(range.m_rdbId, range.m_collnum, range.m_startKey)] = range;
+	}
+	close(fd);
+
+	log(LOG_INFO, "warmup: Loaded %zu hot ranges from %s", m_hotRanges.size(), filename);
+
+	// don't take queries until start() has warmed up the caches
+	m_isWarmingUp = g_conf.m_warmupEnabled && !m_hotRanges.empty();
+	return true;
+}
+
+void Warmup::recordRead(rdbid_t rdbId, collnum_t collnum, const char *startKey, const char *endKey, int32_t minRecSizes) {
+	if (!g_conf.m_warmupEnabled) {
+		return;
+	}
+
+	uint64_t h = getRangeHash(rdbId, collnum, startKey);
+
+	ScopedLock sl(m_mtx);
+	auto it = m_hotRanges.find(h);
+	if (it != m_hotRanges.end()) {
+		++it->second.m_hits;
+		it->second.m_minRecSizes = std::max(it->second.m_minRecSizes, minRecSizes);
+		return;
+	}
+
+	// full. ageHotRanges() will make room
+	if ((int32_t)m_hotRanges.size() >= g_conf.m_warmupMaxRanges) {
+		return;
+	}
+
+	char ks = getKeySizeFromRdbId(rdbId);
+
+	HotRange range;
+	memset(&range, 0, sizeof(range));
+	range.m_rdbId = rdbId;
+	range.m_collnum = collnum;
+	range.m_minRecSizes = minRecSizes;
+	range.m_hits = 1;
+	memcpy(range.m_startKey, startKey, ks);
+	memcpy(range.m_endKey, endKey, ks);
+
+	m_hotRanges[h] = range;
+}
+
+void Warmup::ageHotRangesWrapper(int fd, void *state) {
+	Warmup *that = static_cast<Warmup*>(state);
+	that->ageHotRanges();
+}
+
+// . age a full hot set so ranges that are no longer read make room
+// . done from a timer instead of in recordRead() so reads never walk the
+//   whole set while holding the lock
+void Warmup::ageHotRanges() {
+	if (!g_conf.m_warmupEnabled) {
+		return;
+	}
+
+	ScopedLock sl(m_mtx);
+	if ((int32_t)m_hotRanges.size() < g_conf.m_warmupMaxRanges) {
+		return;
+	}
+
+	for (auto it = m_hotRanges.begin(); it != m_hotRanges.end(); ) {
+		it->second.m_hits /= 2;
+		if (it->second.m_hits == 0) {
+			it = m_hotRanges.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+// hottest first
+std::vector<Warmup::HotRange> Warmup::getHotRanges() {
+	std::vector<HotRange> ranges;
+
+	{
+		ScopedLock sl(m_mtx);
+		ranges.reserve(m_hotRanges.size());
+		for (auto it = m_hotRanges.begin(); it != m_hotRanges.end(); ++it) {
+			ranges.push_back(it->second);
+		}
+	}
+
+	std::sort(ranges.begin(), ranges.end(), [](const HotRange &a, const HotRange &b) {
+		return a.m_hits > b.m_hits;
+	});
+
+	return ranges;
+}
+
+bool Warmup::save() {
+	if (g_conf.m_readOnlyMode) {
+		return true;
+	}
+
+	std::vector<HotRange> ranges = getHotRanges();
+
+	char filename[1024];
+	sprintf(filename, "%shotset.saving", g_hostdb.m_dir);
+
+	int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, getFileCreationFlags());
+	if (fd < 0) {
+		log(LOG_WARN, "warmup: Failed to open %s for writing: %s", filename, strerror(errno));
+		return false;
+	}
+
+	int32_t numRanges = ranges.size();
+	size_t size = ranges.size() * sizeof(HotRange);
+	if (write(fd, &s_hotSetVersion, sizeof(s_hotSetVersion)) != sizeof(s_hotSetVersion) ||
+	    write(fd, &numRanges, sizeof(numRanges)) != sizeof(numRanges) ||
+	    (size > 0 && write(fd, &ranges[0], size) != (ssize_t)size)) {
+		log(LOG_WARN, "warmup: Failed to write %s: %s", filename, strerror(errno));
+		close(fd);
+		unlink(filename);
+		return false;
+	}
+	close(fd);
+
+	char newFilename[1024];
+	sprintf(newFilename, "%shotset.dat", g_hostdb.m_dir);
+
+	if (::rename(filename, newFilename) == -1) {
+		log(LOG_WARN, "warmup: Failed to rename %s to %s: %s", filename, newFilename, strerror(errno));
+		return false;
+	}
+
+	log(LOG_INFO, "warmup: Saved %" PRId32" hot ranges to %s", numRanges, newFilename);
+	return true;
+}
+
+void Warmup::start() {
+	if (!m_isWarmingUp) {
+		return;
+	}
+
+	m_startTime = gettimeofdayInMilliseconds();
+
+	if (!g_loop.registerSleepCallback(s_timeoutCheckInterval, this, checkTimeoutWrapper, "Warmup::checkTimeoutWrapper")) {
+		log(LOG_WARN, "warmup: Failed to register timeout callback");
+		finish("error");
+		return;
+	}
+
+	m_replayRanges = getHotRanges();
+	m_prefetchRanges.clear();
+	m_prefetchedBytes = 0;
+
+	// . turn the hot key ranges into byte ranges of the current files.
+	//   ranges are saved as keys so they stay valid across merges
+	// . refill the termfreq cache while we are at it
+	int64_t budget = g_conf.m_warmupMaxBytes;
+	for (auto it = m_replayRanges.begin(); it != m_replayRanges.end() && budget > 0; ++it) {
+		const HotRange &range = *it;
+
+		if (range.m_rdbId == RDB_POSDB) {
+			g_posdb.getTermFreq(range.m_collnum, Posdb::getTermId(range.m_startKey));
+		}
+
+		RdbBase *base = getRdbBase(range.m_rdbId, range.m_collnum);
+		if (!base) {
+			g_errno = 0;
+			continue;
+		}
+
+		for (int32_t i = 0; i < base->getNumFiles() && budget > 0; ++i) {
+			if (!base->isReadable(i)) {
+				continue;
+			}
+
+			RdbMap *map = base->getMap(i);
+			BigFile *file = base->getFile(i);
+
+			int32_t startPage;
+			int32_t endPage;
+			char maxKey[MAX_KEY_BYTES];
+			if (!map->getPageRange(range.m_startKey, range.m_endKey, &startPage, &endPage, maxKey)) {
+				continue;
+			}
+
+			int64_t offset = map->getAbsoluteOffset(startPage);
+			int64_t size = map->getAbsoluteOffset(endPage + 1) - offset;
+			if (range.m_minRecSizes >= 0 && size > range.m_minRecSizes) {
+				size = range.m_minRecSizes;
+			}
+			size = std::min(size, budget);
+
+			// split it up by part file
+			while (size > 0) {
+				int32_t partNum = file->getPartNum(offset);
+				int64_t partOffset = offset % MAX_PART_SIZE;
+				int64_t partSize = std::min<int64_t>(size, MAX_PART_SIZE - partOffset);
+
+				const File *part = file->getFile2(partNum);
+				if (!part) {
+					break;
+				}
+
+				PrefetchRange prefetch;
+				prefetch.m_filename = part->getFilename();
+				prefetch.m_offset = partOffset;
+				prefetch.m_size = partSize;
+				m_prefetchRanges.push_back(prefetch);
+
+				offset += partSize;
+				size -= partSize;
+				budget -= partSize;
+			}
+		}
+	}
+
+	m_replayRanges.resize(std::min<size_t>(m_replayRanges.size(), std::max(g_conf.m_warmupMaxReplays, 0)));
+
+	log(LOG_INFO, "warmup: Warming up %zu hot ranges (%zu prefetch ranges)", m_replayRanges.size(), m_prefetchRanges.size());
+
+	if (!g_jobScheduler.submit(prefetchWrapper, prefetchDoneWrapper, this, thread_type_unspecified_io, 0)) {
+		log(LOG_WARN, "warmup: Could not submit prefetch job. Skipping readahead");
+		prefetchDone();
+	}
+}
+
+// runs in a thread
+void Warmup::prefetchWrapper(void *state) {
+	Warmup *that = static_cast<Warmup*>(state);
+
+	// files are sorted by hotness, not name, so only reopen when it changes
+	std::string filename;
+	int fd = -1;
+	for (auto it = that->m_prefetchRanges.begin(); it != that->m_prefetchRanges.end() && that->m_isWarmingUp; ++it) {
+		if (it->m_filename != filename) {
+			if (fd >= 0) {
+				close(fd);
+			}
+			filename = it->m_filename;
+			fd = open(filename.c_str(), O_RDONLY);
+		}
+
+		if (fd < 0) {
+			continue;
+		}
+
+		if (readahead(fd, it->m_offset, it->m_size) != 0) {
+			posix_fadvise(fd, it->m_offset, it->m_size, POSIX_FADV_WILLNEED);
+		}
+		that->m_prefetchedBytes += it->m_size;
+	}
+
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+void Warmup::prefetchDoneWrapper(void *state, job_exit_t exit_type) {
+	Warmup *that = static_cast<Warmup*>(state);
+	that->prefetchDone();
+}
+
+void Warmup::prefetchDone() {
+	log(LOG_INFO, "warmup: Read ahead %" PRId64" bytes in %" PRId64" ms",
+	    m_prefetchedBytes, gettimeofdayInMilliseconds() - m_startTime);
+
+	m_prefetchRanges.clear();
+	m_prefetchRanges.shrink_to_fit();
+
+	if (!m_isWarmingUp || m_replayRanges.empty()) {
+		finish("done");
+		return;
+	}
+
+	try {
+		m_msg5s = new Msg5[s_maxReplaysOut];
+		m_lists = new RdbList[s_maxReplaysOut];
+	} catch (std::bad_alloc&) {
+		log(LOG_WARN, "warmup: Could not allocate Msg5s for refilling the disk page cache");
+		delete[] m_msg5s;
+		m_msg5s = NULL;
+		finish("error");
+		return;
+	}
+
+	m_nextReplay = 0;
+	m_numReplaysOut = 0;
+	replayRanges();
+}
+
+// . read the hottest ranges like a query would so they end up in the disk
+//   page cache
+// . lower priority than real queries so we don't slow down our twins if
+//   they need us
+void Warmup::replayRanges() {
+	for (int32_t i = 0; i < s_maxReplaysOut; ++i) {
+		if (m_msg5s[i].isWaitingForList()) {
+			continue;
+		}
+
+		while (m_isWarmingUp && m_nextReplay < m_replayRanges.size()) {
+			const HotRange &range = m_replayRanges[m_nextReplay++];
+
+			m_numReplaysOut++;
+			if (!m_msg5s[i].getList(range.m_rdbId, range.m_collnum, &m_lists[i], range.m_startKey, range.m_endKey,
+			                        range.m_minRecSizes, false, 0, -1, this, replayDoneWrapper, 1, true, -1, false)) {
+				// blocked
+				break;
+			}
+
+			m_numReplaysOut--;
+			g_errno = 0;
+		}
+	}
+
+	if (m_numReplaysOut == 0) {
+		// we may be in the callback of one of the Msg5s
+		m_replaysDone = true;
+		finish("done");
+	}
+}
+
+void Warmup::replayDoneWrapper(void *state, RdbList *list, Msg5 *msg5) {
+	Warmup *that = static_cast<Warmup*>(state);
+	that->replayDone(msg5);
+}
+
+void Warmup::replayDone(Msg5 *msg5) {
+	g_errno = 0;
+	m_numReplaysOut--;
+	replayRanges();
+}
+
+// . also frees the Msg5s once all replays are done. stays registered
+//   until then
+void Warmup::checkTimeoutWrapper(int fd, void *state) {
+	Warmup *that = static_cast<Warmup*>(state);
+	if (that->m_isWarmingUp && gettimeofdayInMilliseconds() - that->m_startTime >= g_conf.m_warmupMaxTime * 1000LL) {
+		that->finish("timed out");
+	}
+
+	if (that->m_replaysDone) {
+		delete[] that->m_msg5s;
+		that->m_msg5s = NULL;
+		delete[] that->m_lists;
+		that->m_lists = NULL;
+		that->m_replaysDone = false;
+	}
+
+	if (!that->m_isWarmingUp && !that->m_msg5s) {
+		g_loop.unregisterSleepCallback(that, checkTimeoutWrapper);
+	}
+}
+
+// ready for queries. outstanding reads are left to finish on their own
+void Warmup::finish(const char *reason) {
+	if (!m_isWarmingUp) {
+		return;
+	}
+
+	m_isWarmingUp = false;
+
+	log(LOG_INFO, "warmup: Warm-up %s after %" PRId64" ms. Accepting queries",
+	    reason, gettimeofdayInMilliseconds() - m_startTime);
+}
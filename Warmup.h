@@ -0,0 +1,98 @@
+#ifndef GB_WARMUP_H
+#define GB_WARMUP_H
+
+#include "rdbid_t.h"
+#include "collnum_t.h"
+#include "types.h"
+#include "GbMutex.h"
+#include "JobScheduler.h"
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <atomic>
+
+class Msg5;
+class RdbList;
+
+// . keeps track of the posdb termlists and titledb records read by Msg3 for
+//   queries (the "hot set") and saves it to hotset.dat with the other
+//   blocking files
+// . after a restart the hot set is read ahead into the page cache and the
+//   termfreq and disk page caches are refilled. until that is done (or
+//   "warm-up max time" has passed) we set PFLAG_WARMINGUP so our twins get
+//   the queries
+class Warmup {
+public:
+	Warmup();
+
+	// load the hot set saved by the previous run
+	bool init();
+
+	// start warming up. call when the rdbs are loaded
+	void start();
+
+	bool isWarmingUp() const { return m_isWarmingUp; }
+
+	// called by Msg3 for every list read from disk
+	void recordRead(rdbid_t rdbId, collnum_t collnum, const char *startKey, const char *endKey, int32_t minRecSizes);
+
+	bool save();
+
+private:
+	struct HotRange {
+		rdbid_t   m_rdbId;
+		collnum_t m_collnum;
+		int32_t   m_minRecSizes;
+		uint32_t  m_hits;
+		char      m_startKey[MAX_KEY_BYTES];
+		char      m_endKey[MAX_KEY_BYTES];
+	};
+
+	struct PrefetchRange {
+		std::string m_filename;
+		int64_t     m_offset;
+		int64_t     m_size;
+	};
+
+	std::vector<HotRange> getHotRanges();
+
+	static void prefetchWrapper(void *state);
+	static void prefetchDoneWrapper(void *state, job_exit_t exit_type);
+	void prefetchDone();
+
+	void replayRanges();
+	static void replayDoneWrapper(void *state, RdbList *list, Msg5 *msg5);
+	void replayDone(Msg5 *msg5);
+
+	static void checkTimeoutWrapper(int fd, void *state);
+	void finish(const char *reason);
+
+	static void ageHotRangesWrapper(int fd, void *state);
+	void ageHotRanges();
+
+	GbMutex m_mtx;
+	std::unordered_map<uint64_t, HotRange> m_hotRanges;
+
+	std::atomic<bool> m_isWarmingUp;
+	int64_t m_startTime;
+
+	// filled on the main thread, read ahead in a job
+	std::vector<PrefetchRange> m_prefetchRanges;
+	int64_t m_prefetchedBytes;
+
+	// ranges read through Msg5 to fill the disk page cache
+	std::vector<HotRange> m_replayRanges;
+	size_t m_nextReplay;
+	int32_t m_numReplaysOut;
+	Msg5 *m_msg5s;
+	RdbList *m_lists;
+
+	// . all replays are done, free m_msg5s and m_lists
+	// . not done right away because the last replay finishes in the
+	//   callback of one of the Msg5s, see checkTimeoutWrapper()
+	bool m_replaysDone;
+};
+
+extern Warmup g_warmup;
+
+#endif // GB_WARMUP_H
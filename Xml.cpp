@@ -1,6 +1,7 @@
 #include "Xml.h"
 
 #include "Mem.h"     // mfree(), mmalloc()
+#include "Arena.h"
 #include "Titledb.h"
 #include "tokenizer.h"
 #include "Pos.h"
@@ -11,6 +12,9 @@
 #include "utf8_fast.h"
 #include "hash.h"
 #include "gbmemcpy.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 Xml::Xml  () { 
@@ -19,7 +23,18 @@ Xml::Xml  () {
 	m_nodes = NULL; 
 	m_numNodes=0;
 	m_maxNumNodes = 0;
+	m_allocSize = 0;
+	m_tagPairHashes = NULL;
+	m_numTagPairHashes = 0;
+	m_maxTagPairHashes = 0;
+	m_lastTagPairHash = 0;
+	m_firstTagHash = 0;
+	m_linkNodes = NULL;
+	m_numLinkNodes = 0;
+	m_metaNodes = NULL;
+	m_numMetaNodes = 0;
 	m_version = 0;
+	m_arena = NULL;
 }
 
 // . should free m_xml if m_copy is true
@@ -168,16 +183,121 @@ int32_t Xml::getNodeNum ( int32_t n0 , int32_t n1 , const char *tagName , int32_
 	return i;
 }
 
+XmlNode *Xml::allocNodes() {
+	// every tag but the first one makes a tag pair hash
+	m_maxTagPairHashes = m_maxNumNodes < s_maxTagPairHashes ? m_maxNumNodes : s_maxTagPairHashes;
+
+	m_allocSize = sizeof(XmlNode) * m_maxNumNodes +
+	              sizeof(int32_t) * m_maxNumNodes * 2 +
+	              sizeof(uint32_t) * m_maxTagPairHashes;
+
+	char *buf;
+	if ( m_arena ) {
+		buf = (char *)m_arena->alloc( m_allocSize );
+	} else {
+		buf = (char *)mmalloc( m_allocSize, "Xml1" );
+	}
+	if ( ! buf ) {
+		return NULL;
+	}
+
+	XmlNode *nodes = (XmlNode *)buf;
+	m_linkNodes = (int32_t *)(nodes + m_maxNumNodes);
+	m_metaNodes = m_linkNodes + m_maxNumNodes;
+	m_tagPairHashes = (uint32_t *)(m_metaNodes + m_maxNumNodes);
+	return nodes;
+}
+
 void Xml::reset ( ) {
 	// free old nodes array if any
-	if ( m_nodes ) {
-		mfree ( m_nodes, m_maxNumNodes*sizeof(XmlNode),"Xml1");
+	if ( m_nodes && ! m_arena ) {
+		mfree ( m_nodes, m_allocSize, "Xml1" );
 	}
 
 	m_xml         = NULL;
 	m_nodes       = NULL; 
 	m_numNodes    = 0;
 	m_maxNumNodes = 0;
+	m_allocSize   = 0;
+
+	m_tagPairHashes    = NULL;
+	m_numTagPairHashes = 0;
+	m_maxTagPairHashes = 0;
+	m_lastTagPairHash  = 0;
+	m_firstTagHash     = 0;
+	m_linkNodes        = NULL;
+	m_numLinkNodes     = 0;
+	m_metaNodes        = NULL;
+	m_numMetaNodes     = 0;
+}
+
+void Xml::indexNode( int32_t n ) {
+	nodeid_t id = m_nodes[n].m_nodeId;
+
+	// text nodes
+	if ( id <= 0 ) {
+		return;
+	}
+
+	// . hash each tag with the one before it. a tag after the same tag
+	//   keeps its own hash, the xor would zero it out
+	// . 0 has a special meaning so it is never used
+	uint32_t h = hash32h( id, 0 );
+	if ( h == 0 ) {
+		h = 1;
+	}
+	if ( ! m_lastTagPairHash ) {
+		m_firstTagHash = h;
+	} else if ( m_numTagPairHashes < m_maxTagPairHashes ) {
+		m_tagPairHashes[m_numTagPairHashes++] = ( h == m_lastTagPairHash ) ? h : h ^ m_lastTagPairHash;
+	}
+	m_lastTagPairHash = h;
+
+	switch ( id ) {
+		case TAG_META:
+			m_metaNodes[m_numMetaNodes++] = n;
+			break;
+		case TAG_A:
+		case TAG_LINK:       // rss feed url
+		case TAG_LOC:        // sitemap.xml url
+		case TAG_AREA:
+		case TAG_ENCLOSURE:
+		case TAG_WEBLOG:
+		case TAG_URLFROM:    // <UrlFrom> for ahrefs.com
+		case TAG_FBORIGLINK:
+			m_linkNodes[m_numLinkNodes++] = n;
+			break;
+		default:
+			break;
+	}
+}
+
+// . replace the NUL bytes with spaces and count the '<'s in the same pass
+// . 16 bytes at a time if we can
+static int32_t clearNullsAndCountTags( char *s, int32_t slen ) {
+	int32_t count = 0;
+	int32_t i = 0;
+#ifdef __SSE2__
+	const __m128i lt    = _mm_set1_epi8( '<' );
+	const __m128i zero  = _mm_setzero_si128();
+	const __m128i space = _mm_set1_epi8( ' ' );
+	for ( ; i + 16 <= slen ; i += 16 ) {
+		__m128i v = _mm_loadu_si128( (const __m128i *)( s + i ) );
+		count += __builtin_popcount( _mm_movemask_epi8( _mm_cmpeq_epi8( v, lt ) ) );
+		__m128i nul = _mm_cmpeq_epi8( v, zero );
+		if ( _mm_movemask_epi8( nul ) ) {
+			_mm_storeu_si128( (__m128i *)( s + i ), _mm_or_si128( v, _mm_and_si128( nul, space ) ) );
+		}
+	}
+#endif
+	for ( ; i < slen ; i++ ) {
+		if ( !s[i] ) {
+			s[i] = ' ';
+		} else if ( s[i] == '<' ) {
+			count++;
+		}
+	}
+	return count;
 }
 
 
@@ -245,7 +365,7 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 		m_numNodes = 0;
 		// make the array
 		m_maxNumNodes = 1;
-		m_nodes =(XmlNode *)mmalloc(sizeof(XmlNode)*m_maxNumNodes,"x");
+		m_nodes = allocNodes();
 		if ( ! m_nodes ) return false;
 		XmlNode *xd = &m_nodes[m_numNodes];
 		// hack the node
@@ -278,18 +398,8 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 	/// Shouldn't all string be valid utf-8 at this point?
 	// . replacing NULL bytes with spaces in the buffer
 	// . utf8 should never have any 0 bytes in it either!
-	for ( i = 0 ; i < slen ; i++ ) {
-		if ( !s[i] ) {
-			s[i] = ' ';
-		}
-	}
-
-	// counting the max num nodes
-	for ( i = 0 ; s[i] ; i++ ) {
-		if ( s[i] == '<' ) {
-			m_maxNumNodes++;
-		}
-	}
+	// . counting the max num nodes
+	m_maxNumNodes = clearNullsAndCountTags( s, slen );
 
 	// account for the text (non-tag) nodes (padding nodes between tags)
 	m_maxNumNodes *= 2 ;
@@ -317,7 +427,7 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 		m_maxNumNodes = bigMax;
 	}
 
-	m_nodes = (XmlNode *)mmalloc( sizeof( XmlNode ) * m_maxNumNodes, "Xml1" );
+	m_nodes = allocNodes();
 	if ( ! m_nodes ) { 
 		reset();
 		log(LOG_WARN, "build: Could not allocate %" PRId32 " bytes need to parse document.",
@@ -395,6 +505,8 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 			}
 		}
 
+		indexNode( m_numNodes );
+
 		if ( xi->m_nodeId != TAG_SCRIPT || !xi->isFrontTag() ) {
 			++m_numNodes;
 			continue;
@@ -581,6 +693,7 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 		xn->m_hash       = 0;
 		xn->m_isVisible  = false;
 		xn->m_isBreaking = false;
+		indexNode( m_numNodes - 1 );
 		// advance i to get to the </script> or <gbframe> etc.
 		i = p - &m_xml[0] ;
 	}
@@ -593,6 +706,11 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 		m_numNodes--;
 	}
 
+	// if only had one tag, use that
+	if ( m_numTagPairHashes == 0 && m_firstTagHash ) {
+		m_tagPairHashes[m_numTagPairHashes++] = m_firstTagHash;
+	}
+
 	// debug msg time
 	if ( g_conf.m_logTimingBuild ) {
 		logf( LOG_TIMING, "build: xml: set: 4d. %" PRIu64 "", gettimeofdayInMilliseconds() );
@@ -758,9 +876,8 @@ int32_t Xml::getText( char *buf, int32_t bufMaxSize, int32_t node1, int32_t node
 // just get a pointer to it
 char *Xml::getMetaContentPointer( const char *field, int32_t fieldLen, const char *name, int32_t *slen ) {
 	// find the first meta summary node
-	for ( int32_t i = 0 ; i < m_numNodes ; i++ ) {
-		// continue if not a meta tag
-		if ( m_nodes[i].m_nodeId != TAG_META ) continue;
+	for ( int32_t k = 0 ; k < m_numMetaNodes ; k++ ) {
+		int32_t i = m_metaNodes[k];
 		// . does it have a type field that's "summary"
 		// . <meta name=summary content="...">
 		// . <meta http-equiv="refresh" content="0;URL=http://y.com/">
@@ -800,9 +917,9 @@ int32_t Xml::getMetaContent( char *buf, int32_t bufLen, const char *field, int32
 	char *dst    = buf;
 	char *dstEnd = buf + bufLen;
 	// find the first meta summary node
-	for ( int32_t i = startNode ; i < m_numNodes ; i++ ) {
-		// continue if not a meta tag
-		if ( m_nodes[i].m_nodeId != TAG_META ) {
+	for ( int32_t k = 0 ; k < m_numMetaNodes ; k++ ) {
+		int32_t i = m_metaNodes[k];
+		if ( i < startNode ) {
 			continue;
 		}
 
@@ -10,6 +10,8 @@
 #include "Sanity.h"
 
 
+class Arena;
+
 class Xml {
 public:
 	Xml();
@@ -17,6 +19,9 @@ public:
 	// . should free m_xml if m_copy is true
 	~Xml();
 
+	// take the node array from "arena" instead of Mem. call before set()
+	void setArena(Arena *arena) { m_arena = arena; }
+
 	// do we have any xml in here?
 	bool isEmpty() const {
 		return ( m_xml == nullptr );
@@ -86,6 +91,21 @@ public:
 		return m_nodes[n].m_nodeId;
 	}
 
+	// . these are filled in by set() while it parses, so the consumers do
+	//   not have to walk all the nodes again
+	// . the adjacent tag pair hashes, see XmlDoc::getTagPairHashVector()
+	static const int32_t s_maxTagPairHashes = 2000;
+	const uint32_t *getTagPairHashes() const { return m_tagPairHashes; }
+	int32_t getNumTagPairHashes() const { return m_numTagPairHashes; }
+
+	// . numbers of the nodes that may hold a link, see Links::set()
+	const int32_t *getLinkNodes() const { return m_linkNodes; }
+	int32_t getNumLinkNodes() const { return m_numLinkNodes; }
+
+	// . numbers of the <meta> nodes
+	const int32_t *getMetaNodes() const { return m_metaNodes; }
+	int32_t getNumMetaNodes() const { return m_numMetaNodes; }
+
 	// get all nodes!
 	XmlNode *getNodes() {
 		return m_nodes;
@@ -187,9 +207,29 @@ private:
 	// used because "s" may have words separated by periods
 	int64_t getCompoundHash( const char *s, int32_t len ) const;
 
+	// m_maxNumNodes nodes from m_arena or Mem. the node number arrays
+	// are put after them
+	XmlNode *allocNodes();
+
+	// add node #n to the tag pair hashes and node number arrays
+	void indexNode( int32_t n );
+
 	XmlNode *m_nodes;
 	int32_t m_numNodes;
 	int32_t m_maxNumNodes;
+	int32_t m_allocSize;
+
+	uint32_t *m_tagPairHashes;
+	int32_t m_numTagPairHashes;
+	int32_t m_maxTagPairHashes;
+	uint32_t m_lastTagPairHash;
+	uint32_t m_firstTagHash;
+
+	int32_t *m_linkNodes;
+	int32_t m_numLinkNodes;
+
+	int32_t *m_metaNodes;
+	int32_t m_numMetaNodes;
 
 	// If this is a unicode buffer, then m_xml is encoded in UTF-16
 	// m_xmlLen is still the size of the buffer IN BYTES
@@ -197,6 +237,8 @@ private:
 	int32_t m_xmlLen;
 
 	int32_t m_version;
+
+	Arena *m_arena;
 };
 
 #endif // GB_XML_H
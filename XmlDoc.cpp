@@ -2,6 +2,7 @@
 #include "XmlDoc.h"
 #include "Conf.h"
 #include "Clusterdb.h" // g_clusterdb
+#include "Anchordb.h"
 #include "Collectiondb.h"
 #include "iana_charset.h"
 #include "Stats.h"
@@ -31,6 +32,7 @@
 #include "PageRoot.h"
 #include "BitOperations.h"
 #include "Robots.h"
+#include "SpiderPrefetch.h"
 #include <pthread.h>
 #include "JobScheduler.h"
 #include "Process.h"
@@ -62,6 +64,7 @@
 #include <fstream>
 #include <sysexits.h>
 #include "gbmemcpy.h"
+#include "SimHash.h"
 
 #ifdef _VALGRIND_
 #include <valgrind/memcheck.h>
@@ -89,7 +92,9 @@ static unsigned char getCharacterLanguage(const char *utf8Char);
 static void doneReadingArchiveFileWrapper ( int fd, void *state );
 #endif
 
-XmlDoc::XmlDoc() {
+XmlDoc::XmlDoc()
+  : m_arena("xmldocarena")
+{
 	//clear all fields in the titledb structure (which are the first fileds in this class)
 	memset(&m_headerSize, 0, (size_t)((char*)&ptr_firstUrl-(char*)&m_headerSize));
 
@@ -112,6 +117,12 @@ XmlDoc::XmlDoc() {
 	memset ( p , 0 , (char *)pend - (char *)p );//(int32_t)pend-(int32_t)p
 	m_msg22Request.m_inUse = 0;
 	m_indexedDoc = false;
+	m_metaListJobRunning = false;
+	m_metaListJobRecall = false;
+	m_metaListBuiltInJob = false;
+	m_metaListJobErrno = 0;
+	m_indexCpuTime = 0;
+	m_indexMainLoopTime = 0;
 	m_msg4Waiting = false;
 	m_msg4Launched = false;
 	m_blockedDoc = false;
@@ -123,6 +134,9 @@ XmlDoc::XmlDoc() {
 	m_robotsNoFollow = false;
 	m_robotsNoArchive = false;
 	m_robotsNoSnippet = false;
+	m_summaryStoreBufValid = false;
+	m_summaryStoreChecked = false;
+	m_useSummaryStore = false;
 	m_addSpiderRequest = false;
 	m_dupTrPtr = NULL;
 	m_oldTitleRec = NULL;
@@ -140,6 +154,13 @@ XmlDoc::XmlDoc() {
 	m_errno = 0;
 	m_docId = 0;
 
+	m_xml.setArena(&m_arena);
+	m_bits.setArena(&m_arena);
+	m_bits2.setArena(&m_arena);
+	m_pos.setArena(&m_arena);
+	m_phrases.setArena(&m_arena);
+	m_summaryStore.setArena(&m_arena);
+
 	reset();
 }
 
@@ -177,6 +198,12 @@ void XmlDoc::reset ( ) {
 	m_loaded = false;
 
 	m_indexedDoc = false;
+	m_metaListJobRunning = false;
+	m_metaListJobRecall = false;
+	m_metaListBuiltInJob = false;
+	m_metaListJobErrno = 0;
+	m_indexCpuTime = 0;
+	m_indexMainLoopTime = 0;
 	m_msg4Launched = false;
 	m_blockedDoc = false;
 	m_checkedUrlBlockList = false;
@@ -190,6 +217,11 @@ void XmlDoc::reset ( ) {
 	m_robotsNoFollow = false;
 	m_robotsNoArchive = false;
 	m_robotsNoSnippet = false;
+	m_summaryStoreBuf.purge();
+	m_summaryStoreBufValid = false;
+	m_summaryStore.reset();
+	m_summaryStoreChecked = false;
+	m_useSummaryStore = false;
 	m_hostNameServers.clear();
 	m_ips.clear();
 	m_addSpiderRequest = false;
@@ -329,6 +361,7 @@ void XmlDoc::reset ( ) {
 	m_tagRec.reset();
 	m_newTagBuf.reset();
 	m_dupList.reset();
+	m_nearDupList.reset();
 	m_msg8a.reset();
 	m_currentMsg8a.reset();
 	m_msg13.reset();
@@ -342,6 +375,9 @@ void XmlDoc::reset ( ) {
 	m_esbuf.reset();
 	m_tagRecBuf.reset();
 
+	// the parsing structures using it were reset above
+	m_arena.reset();
+
 	// origin of this XmlDoc
 	m_setFromTitleRec    = false;
 	m_setFromUrl         = false;
@@ -1158,6 +1194,11 @@ bool XmlDoc::set2 ( char    *titleRec ,
 	m_tagRecDataValid             = true;
 	m_contentHash32Valid          = true;
 	m_tagPairHash32Valid          = true;
+	// titlerecs made before we had it have none, so compute it then
+	if ( m_contentSimHashLo32 || m_contentSimHashHi32 ) {
+		m_contentSimHash64 = ((uint64_t)m_contentSimHashHi32 << 32) | m_contentSimHashLo32;
+		m_contentSimHash64Valid = true;
+	}
 	m_imageDataValid              = true;
 	m_utf8ContentValid            = true;
 	m_siteValid                   = true;
@@ -1288,6 +1329,18 @@ void XmlDoc::setCallback ( void *state, bool (*callback) (void *state) ) {
 	m_callback2 = callback;
 }
 
+static int64_t getThreadCpuTimeMicroseconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t getMonotonicTimeMicroseconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 static void indexDoc3(void *state) {
 	XmlDoc *that = reinterpret_cast<XmlDoc*>(state);
 	logTrace( g_conf.m_logTraceXmlDoc, "Calling XmlDoc::indexDoc" );
@@ -1307,6 +1360,9 @@ static void indexDoc3(void *state) {
 static void indexedDoc3(void *state, job_exit_t exit_type) {
 	XmlDoc *that = reinterpret_cast<XmlDoc*>(state);
 	if(that->m_indexedDoc) {
+		Statistics::register_index_time(that->m_metaListBuiltInJob,
+		                                that->m_indexCpuTime / 1000,
+		                                that->m_indexMainLoopTime / 1000);
 		logTrace(g_conf.m_logTraceXmlDoc, "Calling callback");
 		that->callCallback();
 	}
@@ -1319,28 +1375,69 @@ static void indexDocWrapper ( void *state ) {
 	XmlDoc *THIS = (XmlDoc *)state;
 	// make sure has not been freed from under us!
 	if ( THIS->m_freed ) { g_process.shutdownAbort(true);}
-	// note it
-	THIS->setStatus ( "in index doc wrapper" );
 
-#if 0
-	//Running indexDoc()/indexDoc2()/IndexDoc3()/getMetaList() causes a bug in the
-	//masterloop/callback logic to manifest itself. It is tricky to track down so
-	//disable job submission for now until we have time to clean up the callback
-	//logic. The downside is that some large documents can temporarily stall the
-	//main thread.
-
-	//shovel this off to a thread
-	if(g_jobScheduler.submit(&indexDoc3,indexedDoc3,THIS,thread_type_spider_index,THIS->m_niceness)) {
-		//excellent
-		logTrace( g_conf.m_logTraceXmlDoc, "END, queued for thread" );
+	// . a request launched by getMetaList() in the job came back before
+	//   the job finished. let the job finish first, it will call us again
+	if ( THIS->m_metaListJobRunning ) {
+		THIS->m_metaListJobRecall = true;
+		logTrace( g_conf.m_logTraceXmlDoc, "END, metalist job still running" );
 		return;
 	}
-#endif
-	//threads not available (or oom or simmilar)
+
+	// note it
+	THIS->setStatus ( "in index doc wrapper" );
+
+	// . everything up to getMetaList() runs here in the main thread. the
+	//   cpu heavy getMetaList() is handed to a spider_index job by
+	//   offloadMetaList() once its network inputs are in
+	int64_t startTime = getMonotonicTimeMicroseconds();
+	int64_t startCpuTime = getThreadCpuTimeMicroseconds();
+
 	indexDoc3(THIS);
+
+	THIS->m_indexMainLoopTime += getMonotonicTimeMicroseconds() - startTime;
+	THIS->m_indexCpuTime += getThreadCpuTimeMicroseconds() - startCpuTime;
+
 	indexedDoc3(THIS, job_exit_normal);
 }
 
+// runs in a spider_index job
+static void getMetaListJob(void *state) {
+	XmlDoc *that = reinterpret_cast<XmlDoc*>(state);
+	int64_t startCpuTime = getThreadCpuTimeMicroseconds();
+
+	g_errno = 0;
+	char *metaList = that->getMetaList();
+	if ( metaList == (char *)-1 ) {
+		// offloadMetaList() is missing a network getter and the
+		// request was launched from this thread
+		log(LOG_ERROR, "build: getMetaList() blocked in job for %s", that->m_firstUrl.getUrl());
+		gbshutdownLogicError();
+	}
+	that->m_metaListJobErrno = metaList ? 0 : g_errno;
+
+	that->m_indexCpuTime += getThreadCpuTimeMicroseconds() - startCpuTime;
+}
+
+static void gotMetaListJob(void *state, job_exit_t exit_type) {
+	XmlDoc *that = reinterpret_cast<XmlDoc*>(state);
+	that->m_metaListJobRunning = false;
+
+	if ( exit_type != job_exit_normal ) {
+		log(LOG_WARN, "build: metalist job for %s was not run", that->m_firstUrl.getUrl());
+		g_errno = (exit_type == job_exit_program_exit) ? ESHUTTINGDOWN : ECANCELLED;
+		indexDocWrapper(that);
+		return;
+	}
+
+	that->m_metaListJobRecall = false;
+
+	// . back in the main thread. continue with indexDoc2(), getMetaList()
+	//   returns the list we just built
+	g_errno = that->m_metaListJobErrno;
+	indexDocWrapper(that);
+}
+
 
 // . the highest level function in here
 // . user is requesting to inject this url
@@ -2030,8 +2127,156 @@ unsigned *XmlDoc::getDefaultSitePageTemperature() {
 	return nullptr;
 }
 
-// . returns false if blocked, true otherwise
-// . sets g_errno on error and returns true
+// . hand getMetaList() to a spider_index job once everything it needs from
+//   the network is in, so hashing a big document does not stall the main loop
+// . only the getters below that wait for the network (download, dns,
+//   titledb, tagdb, linkdb, the root doc and the outlink lookups) are
+//   called here, in the main thread, and block through m_masterLoop as
+//   usual. tokenizing, the title rec, the new tags, the spider reply and
+//   the hashing are left to the job
+// . getIndexCode() needs the language for the url filters, so the phase 1
+//   tokens, sections and language are set before the job starts
+// . if getMetaList() blocks in the job a getter is missing here, see
+//   getMetaListJob()
+// . returns true if getMetaList() is being run in a job or an input blocked,
+//   false to just call getMetaList() here
+bool XmlDoc::offloadMetaList ( ) {
+	if ( ! g_conf.m_indexDocsInThreads ) return false;
+	// already built
+	if ( m_metaListValid ) return false;
+	// only for indexDoc(), others expect getMetaList() to be synchronous
+	if ( m_masterLoop != indexDocWrapper || m_masterState != this ) return false;
+	// nothing heavy to do for deletes and consistency checks
+	if ( m_deleteFromIndex || m_doingConsistencyCheck ) return false;
+
+	CollectionRec *cr = getCollRec();
+	if ( ! cr ) return false;
+
+	setStatus("getting metalist inputs");
+
+	// . any error is left for getMetaList() to handle
+	// . same order as getMetaList()
+	int32_t *ch32 = getContentHash32();
+	if ( ! ch32 ) return false;
+	if ( ch32 == (void *)-1 ) return true;
+
+	int16_t *hs = getHttpStatus();
+	if ( ! hs ) return false;
+	if ( hs == (void *)-1 ) return true;
+
+	char *site = getSite();
+	if ( ! site ) return false;
+	if ( site == (void *)-1 ) return true;
+
+	int64_t *docId = getDocId();
+	if ( ! docId ) return false;
+	if ( docId == (int64_t *)-1 ) return true;
+
+	double dont_care;
+	if ( ! g_pageTemperatureRegistry.query_page_temperature(m_docId,0,1,&dont_care) ) {
+		unsigned *dspt = getDefaultSitePageTemperature();
+		if ( dspt == (unsigned *)-1 ) return true;
+	}
+
+	XmlDoc **pod = getOldXmlDoc();
+	if ( ! pod ) return false;
+	if ( pod == (XmlDoc **)-1 ) return true;
+
+	char *isIndexed = getIsIndexed();
+	if ( ! isIndexed ) return false;
+	if ( isIndexed == (char *)-1 ) return true;
+
+	int32_t *indexCode = getIndexCode();
+	if ( ! indexCode ) return false;
+	if ( indexCode == (void *)-1 ) return true;
+
+	// error docs only get a spider reply, not worth a job
+	if ( *indexCode ) return false;
+
+	// the old doc is set from its title rec but its getters are not
+	// checked for blocking, so its list is made here
+	XmlDoc *od = *pod;
+	if ( od ) {
+		od->m_useSpiderdb = false;
+		od->m_useTagdb = false;
+		char *oldList = od->getMetaList(true);
+		if ( ! oldList ) return false;
+		if ( oldList == (char *)-1 ) return true;
+	}
+
+	LinkInfo *info1 = getLinkInfo1();
+	if ( ! info1 ) return false;
+	if ( info1 == (void *)-1 ) return true;
+
+	int32_t *sni = getSiteNumInlinks();
+	if ( ! sni ) return false;
+	if ( sni == (void *)-1 ) return true;
+
+	int32_t *ip = getIp();
+	if ( ! ip ) return false;
+	if ( ip == (int32_t *)-1 ) return true;
+
+	TagRec *gr = getTagRec();
+	if ( ! gr ) return false;
+	if ( gr == (TagRec *)-1 ) return true;
+
+	int64_t *de = getDownloadEndTime();
+	if ( ! de ) return false;
+	if ( de == (void *)-1 ) return true;
+
+	// prepareToMakeTitleRec() downloads the thumbnail
+	if ( cr->m_makeImageThumbnails ) {
+		char **id = getThumbnailData();
+		if ( ! id ) return false;
+		if ( id == (void *)-1 ) return true;
+	}
+
+	char *spiderLinks = getSpiderLinks();
+	if ( ! spiderLinks ) return false;
+	if ( spiderLinks == (char *)-1 ) return true;
+
+	// for the outlink spider requests, getNewTagBuf() and
+	// getLinkSiteHashes()
+	if ( ( m_useSpiderdb && *spiderLinks ) || m_useLinkdb ) {
+		TagRec ***grv = getOutlinkTagRecVector();
+		if ( ! grv ) return false;
+		if ( grv == (void *)-1 ) return true;
+	}
+
+	if ( m_useSpiderdb && *spiderLinks ) {
+		int32_t **ipv = getOutlinkFirstIpVector();
+		if ( ! ipv ) return false;
+		if ( ipv == (void *)-1 ) return true;
+	}
+
+	// the root doc is fetched for its title by getNewTagBuf(), which
+	// only adds the sitenuminlinks tag when repairing
+	if ( m_useTagdb && *ip && *ip != -1 && ! ( m_useSecondaryRdbs && ! m_useTitledb ) ) {
+		char *rtb = getRootTitleBuf();
+		if ( ! rtb ) return false;
+		if ( rtb == (void *)-1 ) return true;
+	}
+
+	if ( m_useSpiderdb && m_useSecondaryRdbs ) {
+		int32_t *fip = getFirstIp();
+		if ( ! fip ) return false;
+		if ( fip == (void *)-1 ) return true;
+	}
+
+	m_metaListJobRunning = true;
+	m_metaListJobRecall = false;
+	m_metaListJobErrno = 0;
+	if ( ! g_jobScheduler.submit(getMetaListJob, gotMetaListJob, this, thread_type_spider_index, m_niceness) ) {
+		// threads not available (or oom or simmilar)
+		m_metaListJobRunning = false;
+		return false;
+	}
+
+	m_metaListBuiltInJob = true;
+	logTrace( g_conf.m_logTraceXmlDoc, "metalist queued for job" );
+	return true;
+}
+
 bool XmlDoc::indexDoc2 ( ) {
 	logTrace( g_conf.m_logTraceXmlDoc, "BEGIN" );
 
@@ -2087,6 +2332,12 @@ bool XmlDoc::indexDoc2 ( ) {
 	}
 
 
+	// build the meta list in a spider_index job?
+	if ( offloadMetaList() ) {
+		logTrace( g_conf.m_logTraceXmlDoc, "END, return false. metalist offloaded or waiting for its inputs" );
+		return false;
+	}
+
 	// . now get the meta list from it to add
 	// . returns NULL and sets g_errno on error
 	char *metaList = getMetaList ( );
@@ -2201,6 +2452,33 @@ static void getTitleRecBufWrapper ( void *state ) {
 
 // . return NULL and sets g_errno on error
 // . returns -1 if blocked
+// . true if the inlinks of "info1" and "info2" have the same link text
+//   and site inlink counts
+static bool isLinkTextUnchanged ( LinkInfo *info1 , LinkInfo *info2 ) {
+	if ( info1->getNumGoodInlinks() != info2->getNumGoodInlinks() )
+		return false;
+	Inlink *k1 = NULL;
+	Inlink *k2 = NULL;
+	for ( ; k1=info1->getNextInlink(k1) ,
+		      k2=info2->getNextInlink(k2); ) {
+		if ( ! k1 )
+			break;
+		if ( ! k2 )
+			break;
+		if ( k1->m_siteNumInlinks != k2->m_siteNumInlinks )
+			return false;
+		const char *s1   = k1->getLinkText();
+		int32_t     len1 = k1->size_linkText - 1; // exclude \0
+		const char *s2   = k2->getLinkText();
+		int32_t     len2 = k2->size_linkText - 1; // exclude \0
+		if ( len1 != len2 )
+			return false;
+		if ( len1 > 0 && memcmp(s1,s2,len1) != 0 )
+			return false;
+	}
+	return true;
+}
+
 int32_t *XmlDoc::getIndexCode ( ) {
 
 	logTrace( g_conf.m_logTraceXmlDoc, "BEGIN" );
@@ -2368,6 +2646,90 @@ int32_t *XmlDoc::getIndexCode ( ) {
 		return &m_indexCode;
 	}
 
+	// . a recrawl of a page that did not change since we indexed it only
+	//   needs a new spider reply. find out before parsing anything
+	// . the 304 comes from the If-Modified-Since sent by getHttpReply2()
+	// . the inlinks and the url filters may have changed even if the
+	//   content did not, so check those like for any other page below
+	if ( *isAllowed && ! m_recycleContent ) {
+		XmlDoc **pod = getOldXmlDoc();
+		if ( ! pod || pod == (XmlDoc **)-1 ) {
+			logTrace( g_conf.m_logTraceXmlDoc, "END, getOldXmlDoc failed" );
+			return (int32_t *)pod;
+		}
+
+		XmlDoc *od = *pod;
+		if ( canShortCircuitUnchanged ( od ) ) {
+			bool unchanged = ( mime->getHttpStatus() == 304 );
+
+			if ( ! unchanged && g_conf.m_skipUnchangedRecrawls && mime->getHttpStatus() == 200 ) {
+				int64_t *ch64 = getExactContentHash64();
+				if ( ! ch64 || ch64 == (void *)-1 ) {
+					logTrace( g_conf.m_logTraceXmlDoc, "END, getExactContentHash64 failed" );
+					return (int32_t *)ch64;
+				}
+
+				// the old doc has its utf8 content from the titlerec
+				int64_t *och64 = od->getExactContentHash64();
+				if ( ! och64 || och64 == (void *)-1 ) {
+					logTrace( g_conf.m_logTraceXmlDoc, "END, old getExactContentHash64 failed" );
+					return (int32_t *)och64;
+				}
+
+				unchanged = ( *ch64 == *och64 );
+			}
+
+			if ( unchanged ) {
+				LinkInfo *info1 = getLinkInfo1();
+				if ( ! info1 || info1 == (LinkInfo *)-1 ) {
+					logTrace( g_conf.m_logTraceXmlDoc, "END, getLinkInfo1 failed" );
+					return (int32_t *)info1;
+				}
+
+				LinkInfo *info2 = od->getLinkInfo1();
+				if ( ! info2 || info2 == (LinkInfo *)-1 ) {
+					logTrace( g_conf.m_logTraceXmlDoc, "END, getLinkInfo1 (od) failed" );
+					return (int32_t *)info2;
+				}
+
+				// . new link text means reindexing the content
+				// . getHttpReply2() compared the same link info before
+				//   asking for a 304, so this only sends a 200 on
+				unchanged = isLinkTextUnchanged ( info1, info2 );
+			}
+
+			if ( unchanged ) {
+				// . the url filters match on the language. the content
+				//   is that of the old doc, so use its language instead
+				//   of parsing ours
+				if ( ! m_langIdValid ) {
+					m_langId      = od->m_langId;
+					m_langIdValid = true;
+				}
+
+				int32_t *priority = getSpiderPriority();
+				if ( ! priority || priority == (void *)-1 ) {
+					logTrace( g_conf.m_logTraceXmlDoc, "END, getSpiderPriority failed" );
+					return (int32_t *)priority;
+				}
+
+				if ( *priority == -3 ) { // SPIDER_PRIORITY_FILTERED
+					m_indexCode      = EDOCFILTERED;
+					m_indexCodeValid = true;
+					logTrace( g_conf.m_logTraceXmlDoc, "END, EDOCFILTERED (unchanged)" );
+					return &m_indexCode;
+				}
+
+				logDebug( g_conf.m_logDebugSpider, "build: skipping unchanged %s (httpstatus=%d)",
+				          m_firstUrl.getUrl(), (int)mime->getHttpStatus() );
+				m_indexCode      = EDOCUNCHANGED;
+				m_indexCodeValid = true;
+				logTrace( g_conf.m_logTraceXmlDoc, "END, EDOCUNCHANGED (short-circuit)" );
+				return &m_indexCode;
+			}
+		}
+	}
+
 	// check meta noindex
 	bool *ini = getIsNoIndex();
 	if (!ini || ini == (bool*) -1) {
@@ -2665,30 +3027,8 @@ int32_t *XmlDoc::getIndexCode ( ) {
 			return (int32_t *)info2;
 		}
 
-		Inlink *k1 = NULL;
-		Inlink *k2 = NULL;
-		char *s1, *s2;
-		int32_t len1,len2;
-		if ( info1->getNumGoodInlinks() !=
-		     info2->getNumGoodInlinks() )
+		if ( ! isLinkTextUnchanged ( info1, info2 ) )
 			goto changed;
-		for ( ; k1=info1->getNextInlink(k1) ,
-			      k2=info2->getNextInlink(k2); ) {
-			if ( ! k1 )
-				break;
-			if ( ! k2 )
-				break;
-			if ( k1->m_siteNumInlinks != k2->m_siteNumInlinks )
-				goto changed;
-			s1   = k1->getLinkText();
-			len1 = k1->size_linkText - 1; // exclude \0
-			s2   = k2->getLinkText();
-			len2 = k2->size_linkText - 1; // exclude \0
-			if ( len1 != len2 )
-				goto changed;
-			if ( len1 > 0 && memcmp(s1,s2,len1) != 0 )
-				goto changed;
-		}
 		// no change in link text, look for change in page content now
 		int32_t *ch32 = getContentHash32();
 		if ( ! ch32 || ch32 == (void *)-1 )
@@ -2950,6 +3290,11 @@ char *XmlDoc::prepareToMakeTitleRec ( ) {
 		return (char *)tph;
 	}
 
+	uint64_t *sh64 = getContentSimHash64();
+	if (!sh64 || sh64 == (uint64_t *)-1) {
+		return (char *)sh64;
+	}
+
 	m_prepared = true;
 	return (char *)1;
 }
@@ -3239,6 +3584,7 @@ SafeBuf *XmlDoc::getTitleRecBuf ( ) {
 	if ( ! m_hostHash32aValid            ) { g_process.shutdownAbort(true); }
 	if ( ! m_contentHash32Valid          ) { g_process.shutdownAbort(true); }
 	if ( ! m_tagPairHash32Valid          ) { g_process.shutdownAbort(true); }
+	if ( ! m_contentSimHash64Valid       ) { g_process.shutdownAbort(true); }
 
 	setStatus ( "compressing into final title rec");
 
@@ -4500,47 +4846,11 @@ int32_t *XmlDoc::getTagPairHashVector ( ) {
 	Xml      *xml      = getXml     ();
 	if ( ! xml || xml == (Xml *)-1 ) return (int32_t *)xml;
 
-	// store the hashes here
-	uint32_t hashes [ 2000 ];
-	int32_t          nh = 0;
-	// go through each node
-	XmlNode *nodes = xml->getNodes    ();
-	int32_t   n       = xml->getNumNodes ();
-
-	// start with the ith node
-	int32_t i = 0;
-
-	uint32_t saved = 0;
-	uint32_t lastHash = 0;
-	// loop over the nodes
-	for ( ; i < n ; i++ ) {
-		// skip NON tags
-		if ( ! nodes[i].isTag() ) continue;
-		// use the tag id as the hash, its unique
-		uint32_t h = hash32h ( nodes[i].getNodeId() , 0 );
-		// ensure hash is not 0, that has special meaning
-		if ( h == 0 ) h = 1;
-		// store in case we have only one hash
-		saved = h;
-
-		// if we are the first, set this
-		if ( ! lastHash ) {
-			lastHash = h;
-			continue;
-		}
-
-		// if they were the same do not xor, they will zero out
-		if ( h == lastHash ) hashes[nh++] = h;
-		// incorporate it into the last hash
-		else                 hashes[nh++] = h ^ lastHash;
-
-		// we are the new last hash
-		lastHash = h;
-		// bust out if no room
-		if ( nh >= 2000 ) break;
-	}
-	// if only had one tag after, use that
-	if ( nh == 0 && saved ) hashes[nh++] = saved;
+	// . the hashes of the adjacent tag pairs were made by Xml::set()
+	// . copy them because we sort them
+	uint32_t hashes [ Xml::s_maxTagPairHashes ];
+	int32_t          nh = xml->getNumTagPairHashes();
+	gbmemcpy ( hashes , xml->getTagPairHashes() , nh * 4 );
 
 	// . TODO: remove the link text hashes here?
 	// . because will probably be identical..
@@ -5134,6 +5444,46 @@ int64_t *XmlDoc::getExactContentHash64 ( ) {
 	return &m_exactContentHash64;
 }
 
+// . simhash of the 3-word shingles of the document for near-dup detection
+// . unlike getExactContentHash64() it ignores the markup, punctuation and
+//   case, and a few changed words only flip a few bits
+// . 0 if the doc has no words
+uint64_t *XmlDoc::getContentSimHash64 ( ) {
+
+	if ( m_contentSimHash64Valid )
+		return &m_contentSimHash64;
+
+	TokenizerResult *tr = getTokenizerResult();
+	if ( ! tr || tr == (TokenizerResult *)-1 ) return (uint64_t *)tr;
+
+	SimHash sh;
+	uint64_t w0 = 0;
+	uint64_t w1 = 0;
+	int32_t numWords = 0;
+	for ( int32_t i = 0 ; i < (int32_t)tr->size() ; i++ ) {
+		const auto &token = (*tr)[i];
+		if ( ! token.is_alfanum || token.nodeid ) continue;
+		uint64_t w2 = (uint64_t)token.token_hash;
+		numWords++;
+		if ( numWords >= 3 )
+			sh.addFeature ( hash64 ( hash64 ( w0 , w1 ) , w2 ) );
+		w0 = w1;
+		w1 = w2;
+	}
+
+	// too short for a shingle, use the words
+	if ( numWords == 1 )
+		sh.addFeature ( w1 );
+	else if ( numWords == 2 )
+		sh.addFeature ( hash64 ( w0 , w1 ) );
+
+	m_contentSimHash64 = numWords ? sh.getSimHash() : 0;
+	m_contentSimHashLo32 = (uint32_t)m_contentSimHash64;
+	m_contentSimHashHi32 = (uint32_t)(m_contentSimHash64 >> 32);
+	m_contentSimHash64Valid = true;
+	return &m_contentSimHash64;
+}
+
 
 
 RdbList *XmlDoc::getDupList ( ) {
@@ -5210,6 +5560,81 @@ RdbList *XmlDoc::getDupList ( ) {
 	return &m_dupList;
 }
 
+// . same as getDupList() but for the docids with our simhash, so it
+//   catches copies with different markup or a few changed words
+RdbList *XmlDoc::getNearDupList ( ) {
+	logTrace( g_conf.m_logTraceXmlDoc, "BEGIN" );
+
+	if ( m_nearDupListValid )
+	{
+		logTrace( g_conf.m_logTraceXmlDoc, "END, already valid" );
+		return &m_nearDupList;
+	}
+
+	CollectionRec *cr = getCollRec();
+	if ( ! cr )
+	{
+		logTrace( g_conf.m_logTraceXmlDoc, "END, could not get collection" );
+		return NULL;
+	}
+
+	uint64_t *psh64 = getContentSimHash64();
+	if ( ! psh64 || psh64 == (void *)-1 )
+	{
+		logTrace( g_conf.m_logTraceXmlDoc, "END, getContentSimHash64 returned -1" );
+		return (RdbList *)psh64;
+	}
+
+	// no words, nothing to match
+	if ( *psh64 == 0 ) {
+		m_nearDupList.reset();
+		m_nearDupListValid = true;
+		logTrace( g_conf.m_logTraceXmlDoc, "END, no simhash" );
+		return &m_nearDupList;
+	}
+
+	// must match term in XmlDoc::hashNoSplit()
+	char qbuf[256];
+	snprintf(qbuf, 256, "%" PRIu64, *psh64);
+	int64_t pre     = hash64b ( "gbsimhash" , 0LL );
+	int64_t rawHash = hash64b ( qbuf , 0LL );
+	int64_t termId  = hash64 ( rawHash , pre );
+	key144_t sk ;
+	key144_t ek ;
+	Posdb::makeStartKey ( &sk,termId ,0);
+	Posdb::makeEndKey   ( &ek,termId ,MAX_DOCID);
+	log(LOG_DEBUG,"build: check simhash termid=%" PRIu64" for docid %" PRIu64
+	    ,(uint64_t)(termId&TERMID_MASK)
+	    ,(uint64_t)m_docId);
+	m_nearDupListValid = true;
+	if ( ! m_msg0.getList ( -1    , // hostId
+				RDB_POSDB,
+				cr->m_collnum,
+				&m_nearDupList ,
+				(char *)&sk          ,
+				(char *)&ek          ,
+				606006        , // minRecSizes in bytes
+				m_masterState , // state
+				m_masterLoop  ,
+				m_niceness    ,
+				true , // error correction?
+				true , // include tree?
+				-1 , // firsthosti
+				0 , // startfilenum
+				-1, // # files
+				msg0_getlist_infinite_timeout , // timeout
+				false , // isRealMerge
+				true, // shardByTermId
+				-1  ) ) // forceParitySplit
+	{
+		logTrace( g_conf.m_logTraceXmlDoc, "END, return -1. msg0.getList blocked." );
+		return (RdbList *)-1;
+	}
+
+	logTrace( g_conf.m_logTraceXmlDoc, "END, done." );
+	return &m_nearDupList;
+}
+
 
 // moved DupDetector.cpp into here...
 char *XmlDoc::getIsDup ( ) {
@@ -5259,6 +5684,18 @@ char *XmlDoc::getIsDup ( ) {
 	// sanity. must be posdb list.
 	if ( ! list->isEmpty() && list->getKeySize() != 18 ) { g_process.shutdownAbort(true);}
 
+	// and the docids with our simhash if checking for near-dups
+	RdbList *nearList = NULL;
+	if ( cr->m_nearDupDedupingEnabled ) {
+		nearList = getNearDupList();
+		if ( ! nearList || nearList == (RdbList *)-1 )
+		{
+			logTrace( g_conf.m_logTraceXmlDoc, "END, getNearDupList returned -1" );
+			return (char *)nearList;
+		}
+		if ( ! nearList->isEmpty() && nearList->getKeySize() != 18 ) { g_process.shutdownAbort(true);}
+	}
+
 	// so getSiteRank() does not core
 	int32_t *sni = getSiteNumInlinks();
 	if ( ! sni || sni == (int32_t *)-1 )
@@ -5272,31 +5709,34 @@ char *XmlDoc::getIsDup ( ) {
 	// assume not a dup
 	m_isDup = (char)false;
 	// get the docid that we are a dup of
-	for ( ; ! list->isExhausted() ; list->skipCurrentRecord() ) {
-		char *rec = list->getCurrentRec();
-
-		// get the docid
-		int64_t d = Posdb::getDocId ( rec );
-
-		// just let the best site rank win i guess?
-		// even though one page may have more inlinks???
-		char sr = (char )Posdb::getSiteRank ( rec );
-
-		// skip if us
-		if ( d == m_docId ) continue;
-
-		// if his rank is <= ours then he was here first and we
-		// are the dup i guess...
-		if ( sr >= myRank ) {
-			log("build: doc %s is dup of docid %" PRId64,
-			    m_firstUrl.getUrl(),d);
-			m_isDup = (char)true;
-			m_isDupValid = true;
-			m_docIdWeAreADupOf = d;
-			logTrace( g_conf.m_logTraceXmlDoc, "END, we are a duplicate" );
-			return &m_isDup;
+	RdbList *lists[2] = { list, nearList };
+	for ( int32_t k = 0 ; k < 2 ; k++ ) {
+		if ( ! lists[k] ) continue;
+		for ( lists[k]->resetListPtr() ; ! lists[k]->isExhausted() ; lists[k]->skipCurrentRecord() ) {
+			char *rec = lists[k]->getCurrentRec();
+
+			// get the docid
+			int64_t d = Posdb::getDocId ( rec );
+
+			// just let the best site rank win i guess?
+			// even though one page may have more inlinks???
+			char sr = (char )Posdb::getSiteRank ( rec );
+
+			// skip if us
+			if ( d == m_docId ) continue;
+
+			// if his rank is <= ours then he was here first and we
+			// are the dup i guess...
+			if ( sr >= myRank ) {
+				log("build: doc %s is %sdup of docid %" PRId64,
+				    m_firstUrl.getUrl(), k ? "near-" : "", d);
+				m_isDup = (char)true;
+				m_isDupValid = true;
+				m_docIdWeAreADupOf = d;
+				logTrace( g_conf.m_logTraceXmlDoc, "END, we are a duplicate" );
+				return &m_isDup;
+			}
 		}
-
 	}
 
 	m_isDup = (char)false;
@@ -6641,6 +7081,16 @@ TagRec *XmlDoc::getTagRec ( ) {
 	// nah, try this
 	Url *u = getFirstUrl();
 
+	// the spider loop may have looked it up while we sat in doledb
+	if ( m_sreqValid &&
+	     g_spiderPrefetch.getTagRec ( m_sreq.m_url, cr->m_collnum, gettimeofdayInMilliseconds(), &m_tagRecBuf ) ) {
+		m_tagRec.setFromBuf ( m_tagRecBuf.getBufStart(), m_tagRecBuf.length() );
+		ptr_tagRecData =  m_tagRecBuf.getBufStart();
+		size_tagRecData = m_tagRecBuf.length();
+		m_tagRecValid = true;
+		return &m_tagRec;
+	}
+
 	// get it, user our collection for lookups, not m_tagdbColl[] yet!
 	if ( !m_msg8a.getTagRec( u, cr->m_collnum, m_niceness, this, gotTagRecWrapper, &m_tagRec ) ) {
 		// we blocked, return -1
@@ -8267,6 +8717,26 @@ char **XmlDoc::getHttpReply2 ( ) {
 	// sanity check
 	if ( od && m_recycleContent ) {g_process.shutdownAbort(true); }
 
+	// . a 304 is only handled if getIndexCode() can end in EDOCUNCHANGED
+	//   without the content. otherwise it is a bad http status
+	// . new link text means reindexing the content, so do not ask then
+	bool sendIfModifiedSince = false;
+	if ( od && g_conf.m_spiderIfModifiedSince && canShortCircuitUnchanged ( od ) ) {
+		LinkInfo *info1 = getLinkInfo1();
+		if ( ! info1 || info1 == (LinkInfo *)-1 ) {
+			logTrace( g_conf.m_logTraceXmlDoc, "END, return, error calling getLinkInfo1" );
+			return info1 ? (char **)-1 : NULL;
+		}
+
+		LinkInfo *info2 = od->getLinkInfo1();
+		if ( ! info2 || info2 == (LinkInfo *)-1 ) {
+			logTrace( g_conf.m_logTraceXmlDoc, "END, return, error calling getLinkInfo1 (od)" );
+			return info2 ? (char **)-1 : NULL;
+		}
+
+		sendIfModifiedSince = isLinkTextUnchanged ( info1, info2 );
+	}
+
 	// validate m_firstIpValid
 	int32_t *pfip = getFirstIp();
 	if ( ! pfip || pfip == (void *)-1 )
@@ -8407,7 +8877,8 @@ char **XmlDoc::getHttpReply2 ( ) {
 		// sanity check
 		if ( ! od->m_spideredTimeValid ) { g_process.shutdownAbort(true); }
 		// only get it if modified since last spider time
-		r->m_ifModifiedSince = od->m_spideredTime;
+		if ( sendIfModifiedSince )
+			r->m_ifModifiedSince = od->m_spideredTime;
 	}
 
 	// if doing frame expansion on a doc we just downloaded as the
@@ -11667,6 +12138,9 @@ void XmlDoc::logIt (SafeBuf *bb ) {
 	if ( m_contentHash32Valid )
 		sb->safePrintf("ch32=%010" PRIu32" ",m_contentHash32);
 
+	if ( m_contentSimHash64Valid )
+		sb->safePrintf("simhash=%016" PRIx64" ",m_contentSimHash64);
+
 	if ( m_domHash32Valid )
 		sb->safePrintf("dh32=%010" PRIu32" ",m_domHash32);
 
@@ -12250,6 +12724,21 @@ void XmlDoc::printMetaList ( char *p , char *pend , SafeBuf *sb ) {
 				       docId);
 
 		}
+		else if ( rdbId == RDB_ANCHORDB ) {
+			const key128_t *k2 = (const key128_t *)k;
+			sb->safePrintf("<td>"
+				       "<nobr>"
+				       "linkeeSiteHash32=0x%08" PRIx32" "
+				       "linkeeUrlHash=0x%016" PRIx64" "
+				       "docId=%" PRIu64" "
+				       "datasize=%" PRId32
+				       "</nobr>"
+				       "</td>",
+				       Anchordb::getLinkeeSiteHash32(k2),
+				       Anchordb::getLinkeeUrlHash64(k2),
+				       Anchordb::getLinkerDocId(k2),
+				       dataSize);
+		}
 		else if ( rdbId == RDB_CLUSTERDB ) {
 			const key96_t *k2 = (const key96_t *)k;
 			int32_t siteHash26 = Clusterdb::getSiteHash26  ( k2 );
@@ -12691,6 +13180,8 @@ char *XmlDoc::getMetaList(bool forDelete) {
 		m_isSiteRoot2 = 1;
 		m_tagPairHash32Valid = true;
 		m_tagPairHash32 = 0;
+		m_contentSimHash64Valid = true;
+		m_contentSimHash64 = 0;
 		m_spiderLinksValid = true;
 		m_spiderLinks2 = 1;
 		m_langIdValid = true;
@@ -12975,8 +13466,10 @@ char *XmlDoc::getMetaList(bool forDelete) {
 		return m_metaList;
 	}
 
-	if(!forDelete)
+	if(!forDelete) {
 		lookupAndSetExplicitKeywords();
+		setSummaryStore();
+	}
 
 	// get the old meta list if we had an old doc
 	char *oldList = NULL;
@@ -13316,6 +13809,24 @@ char *XmlDoc::getMetaList(bool forDelete) {
 	int32_t needLinkdb = kt1.getNumUsedSlots() * (sizeof(key224_t)+1);
 	need += needLinkdb;
 
+	// . ANCHORDB
+	// . the link text of the outlinks for Msg25. these are complete
+	//   meta list records already
+	// . there is no anchordb2 to rebuild into
+	// . when anchordb is turned off we stop adding records but still
+	//   delete those of the docs we reindex, so turning it back on does
+	//   not give Msg25 link text that is no longer on the linker
+	bool useAnchordb = g_conf.m_useAnchordb ||
+	                   (forDelete && g_anchordb.getRdb()->getCollNumTotalRecs(m_collnum) > 0);
+	SafeBuf anchorBuf;
+	if (m_useLinkdb && nl2 && useAnchordb && !m_useSecondaryRdbs && !hashLinksForAnchordb(&anchorBuf, forDelete)) {
+		logTrace(g_conf.m_logTraceXmlDoc, "END, hashLinksForAnchordb failed");
+		return NULL;
+	}
+
+	int32_t needAnchordb = anchorBuf.length();
+	need += needAnchordb;
+
 	// we add a negative key to doledb usually (include datasize now)
 	int32_t needDoledb = forDelete ? 0 : (sizeof(key96_t) + 1);
 	need += needDoledb;
@@ -13638,6 +14149,20 @@ char *XmlDoc::getMetaList(bool forDelete) {
 	// sanity check
 	verifyMetaList(m_metaList, m_p, forDelete);
 
+	//
+	// ADD ANCHORDB RECS
+	//
+	if (addLinkInfo && needAnchordb > 0) {
+		setStatus("adding anchordb recs");
+		gbmemcpy(m_p, anchorBuf.getBufStart(), needAnchordb);
+		m_p += needAnchordb;
+	}
+
+	anchorBuf.purge();
+
+	// sanity check
+	verifyMetaList(m_metaList, m_p, forDelete);
+
 	// if we are injecting we must add the spider request
 	// we are injecting from so the url can be scheduled to be
 	// spidered again.
@@ -13833,6 +14358,9 @@ skipNewAdd2:
 		// record in the oldList
 		char *om = oldList;
 
+		// how many posdb keys the old doc had
+		int32_t numOldPosdbKeys = 0;
+
 		// the size
 		int32_t osize = oldListSize;
 
@@ -13872,6 +14400,10 @@ skipNewAdd2:
 			// version of this key back (add 1 for rdbId)
 			needx += ks + 1;
 
+			if (rdbId == RDB_POSDB) {
+				numOldPosdbKeys++;
+			}
+
 			// do not add it if datasize > 0
 			// do not include discovery or lost dates in the linkdb key...
 			uint64_t hk = (rdbId == RDB_LINKDB) ? hash64(k + 12, ks - 12) : hash64(k, ks);
@@ -13901,6 +14433,49 @@ skipNewAdd2:
 		char *nptr = nm;
 		char *nmax = nm + needx;
 
+		// . posdb uses an index file so the newest posdb file owns all
+		//   keys of a docid and the merge drops the docid's keys from
+		//   older files. so we can not just add the changed posdb keys,
+		//   but if none changed we can skip them all
+		// . count the new posdb keys and how many of them the old doc had
+		bool skipPosdb = false;
+		if (g_conf.m_doIncrementalUpdating && !m_useSecondaryRdbs) {
+			int32_t numNewPosdbKeys = 0;
+			int32_t numSamePosdbKeys = 0;
+			for (char *p = m_metaList; p < m_p;) {
+				rdbid_t rdbId = (rdbid_t)(*p & 0x7f);
+				p++;
+				int32_t ks = getKeySizeFromRdbId(rdbId);
+				char *key = p;
+				p += ks;
+				bool isDel = ((key[0] & 0x01) == 0x00);
+				int32_t ds = isDel ? 0 : getDataSizeFromRdbId(rdbId);
+				if (ds == -1) {
+					ds = *(int32_t *)p;
+					p += 4;
+				}
+				p += ds;
+
+				if (rdbId != RDB_POSDB) {
+					continue;
+				}
+				numNewPosdbKeys++;
+				uint64_t hk = hash64(key, ks);
+				if (dt8.getSlot(&hk) >= 0) {
+					numSamePosdbKeys++;
+				}
+			}
+			skipPosdb = (numNewPosdbKeys == numOldPosdbKeys && numSamePosdbKeys == numNewPosdbKeys);
+		}
+
+		// no need to write the same title rec again. note that this
+		// means its spidered time is not updated either
+		bool skipTitleRec = g_conf.m_skipUnchangedTitleRecs && !m_useSecondaryRdbs && !m_docRebuild &&
+		                    isTitleRecUnchanged(od);
+
+		logDebug(g_conf.m_logDebugBuild, "build: incremental update of %s skipPosdb=%s skipTitleRec=%s",
+		         ptr_firstUrl, skipPosdb ? "true" : "false", skipTitleRec ? "true" : "false");
+
 		// scan each rec in the current meta list, see if its in either
 		// the dt12 or dt16 hash table, if it already is, then
 		// do NOT add it to the new metalist, nm, because there is
@@ -13956,6 +14531,10 @@ skipNewAdd2:
 				// as a delete key below
 				dt8.removeSlot(slot);
 
+				if (rdbId == RDB_TITLEDB && skipTitleRec) {
+					continue;
+				}
+
 				// but do add like a titledb rec that has the
 				// same key, because its data is probably
 				// different...
@@ -13966,7 +14545,7 @@ skipNewAdd2:
 				if (ds == 0 && g_conf.m_doIncrementalUpdating) {
 					// don't do incremental updating when using index file
 					Rdb *rdb = getRdbFromId(rdbId);
-					if (!rdb->isUseIndexFile()) {
+					if (!rdb->isUseIndexFile() || (rdbId == RDB_POSDB && skipPosdb)) {
 						continue;
 					}
 				}
@@ -14072,6 +14651,35 @@ skipNewAdd2:
 	return m_metaList;
 }
 
+// . true if a recrawl may end with EDOCUNCHANGED as soon as we know the
+//   content did not change, before parsing the new content
+// . getNewSpiderReply() needs the spider request for that
+bool XmlDoc::canShortCircuitUnchanged ( XmlDoc *od ) {
+	if ( ! od || ! m_sreqValid ) {
+		return false;
+	}
+
+	if ( m_recycleContent || m_wasContentInjected || m_useSecondaryRdbs || m_docRebuild ) {
+		return false;
+	}
+
+	if ( m_sreq.m_isPageReindex || m_sreq.m_recycleContent ) {
+		return false;
+	}
+
+	// the old doc must have been indexed fine with the current version
+	if ( od->m_indexCode || od->m_httpStatus != 200 || od->m_version != TITLEREC_CURRENT_VERSION ) {
+		return false;
+	}
+
+	CollectionRec *cr = getCollRec();
+	if ( ! cr || cr->m_recycleContent ) {
+		return false;
+	}
+
+	return true;
+}
+
 // . copy from old title rec to us to speed things up!
 // . returns NULL and set g_errno on error
 // . returns -1 if blocked
@@ -14140,6 +14748,45 @@ void XmlDoc::copyFromOldDoc ( XmlDoc *od ) {
 	else m_linkInfo1Valid = false;
 }
 
+// . true if the title rec we would store is the same as the old doc's except
+//   for the spidered/indexed times
+// . m_* members and ptr_* members must have been set by getTitleRecBuf()
+bool XmlDoc::isTitleRecUnchanged(XmlDoc *od) {
+	if (!od || !m_titleRecBufValid || !od->m_setFromTitleRec) {
+		return false;
+	}
+
+	// the whole serialized header except m_spideredTime and m_indexedTime
+	const char *hdr = (const char *)&m_headerSize;
+	const char *ohdr = (const char *)&od->m_headerSize;
+	size_t timesStart = (const char *)&m_spideredTime - hdr;
+	size_t timesEnd = (const char *)(&m_indexedTime + 1) - hdr;
+	size_t headerSize = (const char *)&ptr_firstUrl - hdr;
+	if (memcmp(hdr, ohdr, timesStart) != 0 ||
+	    memcmp(hdr + timesEnd, ohdr + timesEnd, headerSize - timesEnd) != 0) {
+		return false;
+	}
+
+	// then the variable length data, like getTitleRecBuf() serializes it
+	int32_t np = ((char *)&size_firstUrl - (char *)&ptr_firstUrl) / sizeof(char *);
+	char **pd = (char **)&ptr_firstUrl;
+	int32_t *ps = (int32_t *)&size_firstUrl;
+	char **opd = (char **)&od->ptr_firstUrl;
+	int32_t *ops = (int32_t *)&od->size_firstUrl;
+	for (int32_t i = 0; i < np; i++, pd++, ps++, opd++, ops++) {
+		int32_t size = *pd ? *ps : 0;
+		int32_t osize = *opd ? *ops : 0;
+		if (size != osize) {
+			return false;
+		}
+		if (size > 0 && memcmp(*pd, *opd, size) != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 // for adding a quick reply for EFAKEIP and for diffbot query reindex requests
 SpiderReply *XmlDoc::getFakeSpiderReply ( ) {
 
@@ -15405,6 +16052,15 @@ Msg20Reply *XmlDoc::getMsg20ReplyStepwise() {
 	if ( m_contentHash32Valid ) m_reply.m_contentHash32 = m_contentHash32;
 	else                        m_reply.m_contentHash32 = 0;
 
+	// . for msg40 deduping, also stored in the title rec
+	// . older title recs do not have it so make it from the words
+	m_reply.m_contentSimHash64 = 0;
+	if ( ! m_req->m_getLinkText ) {
+		uint64_t *sh64 = getContentSimHash64();
+		if ( ! sh64 || sh64 == (void *)-1 ) { checkPointerError(sh64); return (Msg20Reply *)sh64; }
+		m_reply.m_contentSimHash64 = *sh64;
+	}
+
 	if ( cr->m_checkURLFilters && ! m_checkedUrlFilters ) {
 		// do not re-check
 		m_checkedUrlFilters = true;
@@ -15941,53 +16597,22 @@ Msg20Reply *XmlDoc::getMsg20ReplyStepwise() {
 		}
 	}
 
-	// convert "linkNode" into a string ptr into the document
-	const char *node = xml->getNodePtr(linkNode)->m_node;
-	// . find the word index, "n" for this node
-	// . this is INEFFICIENT!!
-	int32_t   nw = tr->size();
-	int32_t   n;
-
-	for ( n = 0; n < nw && (*tr)[n].token_start < node ; n++ ) {
-	}
+	//
+	// get the surrounding link text, around "linkNode"
+	//
+	int32_t n = 0;
+	char *p = m_surroundingTextBuf;
+	int32_t len2 = getSurroundingText ( linkNode, &n, p, m_surroundingTextBuf + sizeof(m_surroundingTextBuf)/2 );
 
 	// sanity check
-	if ( n >= nw ) {
+	if ( len2 < 0 ) {
 		log("links: crazy! could not get word before linknode");
 		g_errno = EBADENGINEER;
 		return NULL;
 	}
 
-	//
-	// get the surrounding link text, around "linkNode"
-	//
-	// radius of 80 characters around n
-	int32_t  radius = 80;
-	char *p      = m_surroundingTextBuf;
-	char *pend   = m_surroundingTextBuf + sizeof(m_surroundingTextBuf)/2;
-	// . make a neighborhood in the "words" space [a,b]
-	// . radius is in characters, so "convert" into words by dividing by 5
-	int32_t a = n - radius / 5;
-	int32_t b = n + radius / 5;
-	if ( a <     0 ) a =     0;
-	if ( b >    nw ) b =    nw;
-	int32_t *pp  = pos->m_pos;
-	int32_t  len;
-	// if too big shring the biggest, a or b?
-	while ( (len=pp[b]-pp[a]) >= 2 * radius + 1 ) {
-		// decrease the largest, a or b
-		if ( a<n && (pp[n]-pp[a])>(pp[b]-pp[n])) a++;
-		else if ( b>n )                          b--;
-	}
-	// only store it if we can
-	if ( p + len + 1 < pend ) {
-		// store it
-		// FILTER the html entities!!
-		int32_t len2 = pos->filter( tr, a, b, false, p, pend, m_version );
-
-		// ensure NULL terminated
-		p[len2] = '\0';
-		// store in reply. it will be serialized when sent.
+	// store in reply. it will be serialized when sent.
+	if ( len2 > 0 ) {
 		m_reply.ptr_surroundingText  = p;
 		m_reply.size_surroundingText = len2 + 1;
 	}
@@ -16023,6 +16648,68 @@ Msg20Reply *XmlDoc::getMsg20ReplyStepwise() {
 }
 
 
+// . filter the text around the link at xml node "linkNode" into "buf"
+// . "*n" is the word to start looking for the node at. it is set to the word
+//   of the node, so callers going through the links in document order do
+//   not scan the words from the start for each one
+// . returns the length of the \0 terminated text, which is 0 if it did not
+//   fit, or -1 if the node is past the words
+int32_t XmlDoc::getSurroundingText ( int32_t linkNode , int32_t *n , char *buf , char *bufEnd ) {
+	const TokenizerResult *tr = &m_tokenizerResult;
+	Pos *pos = &m_pos;
+
+	// convert "linkNode" into a string ptr into the document
+	const char *node = m_xml.getNodePtr(linkNode)->m_node;
+	// . find the word index, "i" for this node
+	int32_t nw = tr->size();
+	int32_t i = *n;
+	if ( i < 0 || i >= nw || (*tr)[i].token_start > node ) {
+		i = 0;
+	}
+
+	for ( ; i < nw && (*tr)[i].token_start < node ; i++ ) {
+	}
+
+	if ( i >= nw ) {
+		return -1;
+	}
+
+	*n = i;
+
+	// radius of 80 characters around i
+	int32_t radius = 80;
+	// . make a neighborhood in the "words" space [a,b]
+	// . radius is in characters, so "convert" into words by dividing by 5
+	int32_t a = i - radius / 5;
+	int32_t b = i + radius / 5;
+	if ( a <     0 ) a =     0;
+	if ( b >    nw ) b =    nw;
+	const int32_t *pp = pos->m_pos;
+	int32_t len;
+	// if too big shring the biggest, a or b?
+	while ( (len=pp[b]-pp[a]) >= 2 * radius + 1 ) {
+		// decrease the largest, a or b
+		if ( a<i && (pp[i]-pp[a])>(pp[b]-pp[i])) a++;
+		else if ( b>i )                          b--;
+	}
+
+	buf[0] = '\0';
+
+	// only store it if we can
+	if ( buf + len + 1 >= bufEnd ) {
+		return 0;
+	}
+
+	// FILTER the html entities!!
+	int32_t len2 = pos->filter( tr, a, b, false, buf, bufEnd, m_version );
+
+	// ensure NULL terminated
+	buf[len2] = '\0';
+
+	return len2;
+}
+
+
 Query *XmlDoc::getQuery() {
 	if ( m_queryValid ) return &m_query;
 
@@ -16048,6 +16735,41 @@ Query *XmlDoc::getQuery() {
 	return &m_query;
 }
 
+// . true if Msg20 can make the title and summary from ptr_summaryStore
+//   instead of parsing the html again
+// . the store has the title and summary from tags made with the max lengths
+//   of the collection, so the request must use the same
+bool XmlDoc::useSummaryStore() {
+	if ( m_summaryStoreChecked ) {
+		return m_useSummaryStore;
+	}
+
+	m_summaryStoreChecked = true;
+	m_useSummaryStore = false;
+
+	if ( ! g_conf.m_useSummaryStore || ! m_req || m_version < 130 || ! ptr_summaryStore || size_summaryStore <= 0 ) {
+		return false;
+	}
+
+	if ( ! m_summaryStore.set( ptr_summaryStore, size_summaryStore ) ) {
+		log( LOG_WARN, "query: bad summary store in titlerec of docid %" PRId64, m_docId );
+		return false;
+	}
+
+	// the title is not from tags so it depends on the query
+	if ( m_summaryStore.getTitleLen() <= 0 ) {
+		return false;
+	}
+
+	if ( m_summaryStore.getTitleMaxLen() != m_req->m_titleMaxLen ||
+	     m_summaryStore.getSummaryMaxLen() != m_req->m_summaryMaxLen ) {
+		return false;
+	}
+
+	m_useSummaryStore = true;
+	return true;
+}
+
 Matches *XmlDoc::getMatches () {
 	// return it if it is set
 	if ( m_matchesValid ) return &m_matches;
@@ -16058,6 +16780,36 @@ Matches *XmlDoc::getMatches () {
 		return &m_matches;
 	}
 
+	if ( useSummaryStore() ) {
+		Title *ti = getTitle();
+		if ( ! ti || ti == (Title *)-1 ) return (Matches *)ti;
+		Query *q = getQuery();
+		if ( ! q ) return (Matches *)q;
+
+		int64_t start = logQueryTimingStart();
+
+		if ( ! m_summaryStore.setTokens() ) {
+			return NULL;
+		}
+
+		m_matches.setQuery ( q );
+
+		LinkInfo *linkInfo = getLinkInfo1();
+		if(linkInfo==(LinkInfo*)-1)
+			linkInfo = NULL;
+		// returns false and sets g_errno on error
+		if ( !m_matches.set( m_summaryStore.getTokenizerResult(), m_summaryStore.getPhrases(),
+		                     m_summaryStore.getSections(), m_summaryStore.getBitsForSummary(),
+		                     m_summaryStore.getPos(), NULL, ti, getFirstUrl(), linkInfo, &m_summaryStore ) ) {
+			return NULL;
+		}
+
+		logQueryTimingEnd( __func__, start );
+
+		m_matchesValid = true;
+		return &m_matches;
+	}
+
 	// need a buncha crap
 	TokenizerResult *tr = getTokenizerResult();
 	if ( ! tr || tr == (TokenizerResult *)-1 ) return (Matches *)tr;
@@ -16231,6 +16983,13 @@ Title *XmlDoc::getTitle() {
 		return &m_title;
 	}
 
+	// title from tags made when the doc was indexed
+	if ( useSummaryStore() ) {
+		m_title.setTitle( std::string( m_summaryStore.getTitle(), m_summaryStore.getTitleLen() ) );
+		m_titleValid = true;
+		return &m_title;
+	}
+
 	int32_t titleMaxLen = 80;
 	if ( m_req ) {
 		titleMaxLen = m_req->m_titleMaxLen;
@@ -16288,6 +17047,22 @@ Title *XmlDoc::getTitle() {
 }
 
 
+// . get the highest number of summary lines that we need
+// . the summary vector we generate for doing summary-based deduping
+//   typically has more lines in it than the summary we generate for
+//   displaying to the user
+static int32_t getNumSummaryLines( const Msg20Request *req, const CollectionRec *cr ) {
+	int32_t numLines = req->m_numSummaryLines;
+	if ( cr->m_percentSimilarSummary >   0  &&
+	     cr->m_percentSimilarSummary < 100  &&
+	     req->m_getSummaryVector            &&
+	     cr->m_summDedupNumLines > numLines   ) {
+		// request more lines than we will display
+		numLines = cr->m_summDedupNumLines;
+	}
+	return numLines;
+}
+
 Summary *XmlDoc::getSummary () {
 	if ( m_summaryValid ) {
 		return &m_summary;
@@ -16317,6 +17092,10 @@ Summary *XmlDoc::getSummary () {
 		return &m_summary;
 	}
 
+	if ( useSummaryStore() ) {
+		return getSummaryFromStore();
+	}
+
 	Xml *xml = getXml();
 	if ( ! xml || xml == (Xml *)-1 ) {
 		checkPointerError(xml);
@@ -16387,22 +17166,63 @@ Summary *XmlDoc::getSummary () {
 
 	start = logQueryTimingStart();
 
-	// . get the highest number of summary lines that we need
-	// . the summary vector we generate for doing summary-based deduping
-	//   typically has more lines in it than the summary we generate for
-	//   displaying to the user
-	int32_t numLines = m_req->m_numSummaryLines;
-	if ( cr->m_percentSimilarSummary >   0  &&
-	     cr->m_percentSimilarSummary < 100  &&
-	     m_req->m_getSummaryVector            &&
-	     cr->m_summDedupNumLines > numLines   ) {
-		// request more lines than we will display
-		numLines = cr->m_summDedupNumLines;
+	// compute the summary
+	bool status = m_summary.setSummary( xml->getVersion(), tr, sections, pos, q, m_req->m_summaryMaxLen,
+	                                    getNumSummaryLines( m_req, cr ), m_req->m_numSummaryLines,
+	                                    m_req->m_summaryMaxNumCharsPerLine, getFirstUrl(), mm,
+	                                    ti->getTitle(), ti->getTitleLen() );
+
+	// error, g_errno should be set!
+	if ( ! status ) {
+		checkPointerError(NULL);
+		return NULL;
 	}
 
-	// compute the summary
-	bool status = m_summary.setSummary( xml, tr, sections, pos, q, m_req->m_summaryMaxLen, numLines,
-	                                    m_req->m_numSummaryLines, m_req->m_summaryMaxNumCharsPerLine, getFirstUrl(), mm,
+	logQueryTimingEnd( __func__, start );
+
+	m_summaryValid = true;
+	return &m_summary;
+}
+
+// same as getSummary() but from the tokens in the summary store
+Summary *XmlDoc::getSummaryFromStore() {
+	Title *ti = getTitle();
+	if ( ! ti || ti == (Title *)-1 ) {
+		checkPointerError(ti);
+		return (Summary *)ti;
+	}
+
+	if ( m_summaryStore.getTagSummaryLen() > 0 ) {
+		m_summary.setSummaryFromTags( m_summaryStore.getTagSummary(), m_summaryStore.getTagSummaryLen() );
+		m_summaryValid = true;
+		return &m_summary;
+	}
+
+	Matches *mm = getMatches();
+	if ( ! mm || mm == (Matches *)-1 ) {
+		checkPointerError(mm);
+		return (Summary *)mm;
+	}
+
+	Query *q = getQuery();
+	if ( ! q ) {
+		checkPointerError(q);
+		return (Summary *)q;
+	}
+
+	CollectionRec *cr = getCollRec();
+	if ( ! cr ) {
+		checkPointerError(NULL);
+		return NULL;
+	}
+
+	int64_t start = logQueryTimingStart();
+
+	// getMatches() set up the tokens
+	bool status = m_summary.setSummary( m_version, m_summaryStore.getTokenizerResult(), m_summaryStore.getSections(),
+	                                    m_summaryStore.getPos(), q, m_req->m_summaryMaxLen,
+	                                    getNumSummaryLines( m_req, cr ), m_req->m_numSummaryLines,
+	                                    m_req->m_summaryMaxNumCharsPerLine, getFirstUrl(), mm,
 	                                    ti->getTitle(), ti->getTitleLen() );
 
 	// error, g_errno should be set!
@@ -16537,6 +17357,17 @@ bool *XmlDoc::parseRobotsMetaTag() {
 		return &m_parsedRobotsMetaTag;
 	}
 
+	// flags of the robots meta tags when the doc was indexed
+	if (useSummaryStore()) {
+		uint8_t robotsFlags = m_summaryStore.getRobotsFlags();
+		m_robotsNoIndex = (robotsFlags & SummaryStore::s_robotsNoIndex);
+		m_robotsNoFollow = (robotsFlags & SummaryStore::s_robotsNoFollow);
+		m_robotsNoArchive = (robotsFlags & SummaryStore::s_robotsNoArchive);
+		m_robotsNoSnippet = (robotsFlags & SummaryStore::s_robotsNoSnippet);
+		m_parsedRobotsMetaTag = true;
+		return &m_parsedRobotsMetaTag;
+	}
+
 	Xml *xml = getXml();
 	if (!xml || xml == (void *)-1) {
 		return (bool*)xml;
@@ -47,6 +47,8 @@
 #include "Query.h"
 #include "Title.h"
 #include "Summary.h"
+#include "SummaryStore.h"
+#include "Arena.h"
 #include "Spider.h" // SpiderRequest/SpiderReply definitions
 #include "HttpMime.h" // ET_DEFLAT
 #include "Json.h"
@@ -159,8 +161,10 @@ public:
 	int32_t    m_reserved2;
 	uint32_t   m_spideredTime; // time_t
 	uint32_t  m_indexedTime; // slightly > m_spideredTime (time_t)
-	uint32_t  m_reserved32;
-	uint32_t  m_reserved33;
+	// simhash of the words for near-dup detection (SimHash.h), 0 if the
+	// titlerec predates it
+	uint32_t  m_contentSimHashLo32;
+	uint32_t  m_contentSimHashHi32;
 	uint32_t    m_firstIndexedDate; // time_t
 	uint32_t    m_outlinksAddedDate; // time_t
 
@@ -241,7 +245,7 @@ public:
 	char      *ptr_site;
 	LinkInfo  *ptr_linkInfo1;
 	char      *ptr_linkdbData;
-	char      *ptr_unused14;
+	char      *ptr_summaryStore;
 	char      *ptr_tagRecData;
 	LinkInfo  *ptr_unused9;
 
@@ -264,7 +268,7 @@ public:
 	int32_t       size_site;
 	int32_t       size_linkInfo1;
 	int32_t       size_linkdbData;
-	int32_t       size_unused14;
+	int32_t       size_summaryStore;
 	int32_t       size_tagRecData;
 	int32_t       size_unused9;
 
@@ -326,6 +330,7 @@ public:
 	void getRebuiltSpiderRequest ( class SpiderRequest *sreq ) ;
 	bool indexDoc ( );
 	bool indexDoc2 ( );
+	bool offloadMetaList ( );
 
 	char *prepareToMakeTitleRec ( ) ;
 	// store TitleRec into "buf" so it can be added to metalist
@@ -373,7 +378,9 @@ public:
 	float *getPageSimilarity ( class XmlDoc *xd2 ) ;
 	float *getPercentChanged ( );
 	int64_t *getExactContentHash64();
+	uint64_t *getContentSimHash64 ( ) ;
 	class RdbList *getDupList ( ) ;
+	class RdbList *getNearDupList ( ) ;
 	char *getIsDup ( ) ;
 	char *getMetaDescription( int32_t *mdlen ) ;
 	char *getMetaSummary ( int32_t *mslen ) ;
@@ -483,6 +490,8 @@ public:
 	bool m_updatedMetaData;
 
 	void copyFromOldDoc ( class XmlDoc *od ) ;
+	bool isTitleRecUnchanged ( class XmlDoc *od ) ;
+	bool canShortCircuitUnchanged ( class XmlDoc *od ) ;
 
 	class SpiderReply *getFakeSpiderReply ( );
 
@@ -498,6 +507,10 @@ public:
 
 	void lookupAndSetExplicitKeywords();
 
+	void setSummaryStore();
+	bool useSummaryStore();
+	Summary *getSummaryFromStore();
+
 	int32_t getSiteRank ();
 	bool addTable144 ( class HashTableX *tt1 , 
 			   int64_t docId ,
@@ -514,6 +527,8 @@ public:
 	bool hashUrl ( class HashTableX *table, bool urlOnly );
 	bool hashIncomingLinkText(HashTableX *table);
 	bool hashLinksForLinkdb ( class HashTableX *table ) ;
+	bool hashLinksForAnchordb ( SafeBuf *sb , bool forDelete ) ;
+	int32_t getSurroundingText ( int32_t linkNode , int32_t *n , char *buf , char *bufEnd ) ;
 	bool hashNeighborhoods ( class HashTableX *table ) ;
 	bool hashTitle ( class HashTableX *table );
 	bool hashBody2 ( class HashTableX *table );
@@ -649,6 +664,10 @@ public:
 	// used by msg7 to store udp slot
 	class UdpSlot *m_injectionSlot;
 
+	// . parsing structures below take their memory from here. it is all
+	//   released at once in reset()
+	Arena      m_arena;
+
 	// . same thing, a little more complicated
 	// . these classes are only set on demand
 	Xml        m_xml;
@@ -828,6 +847,8 @@ public:
 	bool m_isLinkSpamValid;
 	bool m_isErrorPageValid;
 	bool m_exactContentHash64Valid;
+	bool m_contentSimHash64Valid;
+	bool m_nearDupListValid;
 	bool m_jpValid;
 	bool m_blockedDocValid;
 	bool m_defaultSitePageTemperatureValid;
@@ -861,7 +882,10 @@ public:
 	float m_percentChanged;
 	// what docids are similar to us? docids are in this list
 	RdbList m_dupList;
+	// docids with our simhash
+	RdbList m_nearDupList;
 	int64_t m_exactContentHash64;
+	uint64_t m_contentSimHash64;
 	Msg0 m_msg0;
 	char m_isDup;	// may be -1
 	int64_t m_docIdWeAreADupOf;
@@ -925,6 +949,14 @@ public:
 	char m_isWWWDup;	// May be -1
 
 	SafeBuf m_explicitKeywordsBuf;
+
+	// serialized into ptr_summaryStore when indexing
+	SafeBuf m_summaryStoreBuf;
+	bool m_summaryStoreBufValid;
+	// set from ptr_summaryStore when making a Msg20Reply
+	SummaryStore m_summaryStore;
+	bool m_summaryStoreChecked;
+	bool m_useSummaryStore;
 	SafeBuf m_linkSiteHashBuf;
 	SafeBuf m_linkdbDataBuf;
 	SafeBuf m_langVec;
@@ -1124,6 +1156,17 @@ public:
 
 	bool m_indexedDoc; //indexDoc() perfomrned completely
 
+	// getMetaList() is running in a spider_index job
+	bool m_metaListJobRunning;
+	// a callback called indexDocWrapper() while the job was running
+	bool m_metaListJobRecall;
+	bool m_metaListBuiltInJob;
+	int32_t m_metaListJobErrno;
+
+	// per-document indexing cost in microseconds
+	int64_t m_indexCpuTime;
+	int64_t m_indexMainLoopTime;
+
 	bool m_msg4Waiting;
 	bool m_msg4Launched;
 
@@ -8,6 +8,10 @@
 #include "Process.h"
 #include "ip.h"
 #include "Posdb.h"
+#include "Anchordb.h"
+#include "Msg25.h"
+#include "linkspam.h"
+#include "FrequentPhrases.h"
 #include "Conf.h"
 #include "UrlBlockCheck.h"
 #include "Domains.h"
@@ -223,6 +227,16 @@ bool XmlDoc::hashNoSplit ( HashTableX *tt ) {
 		int32_t clen = sprintf(cbuf, "%" PRIu64, (uint64_t)*pch64);
 		hi.m_prefix = "gbcontenthash";
 		if (!hashString(cbuf, clen, &hi)) return false;
+
+		// for near-dup deduping, see XmlDoc::getNearDupList()
+		uint64_t *psh64 = getContentSimHash64();
+		if (!psh64 || psh64 == (void *)-1) { g_process.shutdownAbort(true); }
+
+		if (*psh64) {
+			clen = sprintf(cbuf, "%" PRIu64, *psh64);
+			hi.m_prefix = "gbsimhash";
+			if (!hashString(cbuf, clen, &hi)) return false;
+		}
 	}
 
 	// now hash the site
@@ -843,6 +857,142 @@ bool XmlDoc::hashLinksForLinkdb ( HashTableX *dt ) {
 	return true;
 }
 
+// . returns false and sets g_errno on error
+// . store an anchordb record for each unique outlink in "sb", in meta list
+//   format, with what XmlDoc::getMsg20Reply() gives Msg25 for the link
+// . "forDelete" lists only have the keys
+// . rss/atom feeds have no records, Msg25 still gets their item via Msg20
+bool XmlDoc::hashLinksForAnchordb ( SafeBuf *sb , bool forDelete ) {
+	if ( ! m_linksValid ) { g_process.shutdownAbort(true); }
+
+	if ( m_xml.isRSSFeed() ) {
+		return true;
+	}
+
+	int32_t *linkSiteHashes = getLinkSiteHashes();
+	if ( ! linkSiteHashes || linkSiteHashes == (void *)-1 ) {
+		g_process.shutdownAbort(true);
+	}
+
+	int64_t docId = *getDocId();
+
+	// the linker as XmlDoc::getMsg20Reply() makes it
+	Url redir;
+	const Url *linker = getFirstUrl();
+	if ( ptr_redirUrl ) {
+		redir.set ( ptr_redirUrl );
+		linker = &redir;
+	}
+
+	AnchorRec ar;
+	memset ( &ar, 0, sizeof(ar) );
+	// the link spam checks that do not depend on the linkee, done once
+	LinkSpamChecker linkSpamChecker;
+	if ( ! forDelete ) {
+		int32_t *ipptr = getIp();
+		ar.m_ip               = ipptr ? *ipptr : 0;
+		ar.m_firstIp          = m_firstIpValid ? m_firstIp : ar.m_ip;
+		ar.m_midDomHash       = hash32 ( linker->getMidDomain(), linker->getMidDomainLen() );
+		ar.m_firstIndexedDate = m_firstIndexedDate;
+		ar.m_siteNumInlinks   = m_siteNumInlinksValid ? m_siteNumInlinks : 0;
+		ar.m_numOutlinks      = (uint16_t)std::min ( m_links.getNumLinks(), 0xffff );
+		ar.m_country          = m_countryIdValid ? m_countryId : 0;
+		ar.m_language         = m_langIdValid ? m_langId : 0;
+		ar.m_siteRank         = getSiteRank();
+		ar.m_isPermalink      = m_isPermalinkValid ? m_isPermalink : 0;
+		ar.m_urlSize          = getFirstUrl()->getUrlLen() + 1;
+		linkSpamChecker.set ( linker, ar.m_siteNumInlinks, &m_xml, &m_links, 150000 );
+	}
+
+	HashTableX dedup;
+	if ( ! dedup.set ( sizeof(key128_t), 0, m_links.getNumLinks() * 2, NULL, 0, false, "anchor-dedup" ) ) {
+		return false;
+	}
+
+	// the word of the last link node, links are in document order
+	int32_t wordHint = 0;
+
+	for ( int32_t i = 0 ; i < m_links.getNumLinks() ; i++ ) {
+		if ( m_links.getLinkLen(i) == 0 ) {
+			continue;
+		}
+
+		key128_t k = Anchordb::makeKey ( linkSiteHashes[i], m_links.getLinkHash64(i), docId, false );
+
+		// XmlDoc::getMsg20Reply() gets the link text of the first
+		// link to the url too
+		if ( dedup.isInTable ( &k ) ) {
+			continue;
+		}
+		if ( ! dedup.addKey ( &k ) ) {
+			return false;
+		}
+
+		if ( forDelete ) {
+			if ( ! sb->pushChar ( (char)RDB_ANCHORDB ) || ! sb->safeMemcpy ( &k, sizeof(k) ) ) {
+				return false;
+			}
+			continue;
+		}
+
+		char linkText[MAX_LINK_TEXT_LEN];
+		int32_t linkNode = -1;
+		int32_t textLen = m_links.getLinkText2 ( i, linkText, sizeof(linkText) - 2, NULL, NULL, &linkNode, NULL );
+		if ( textLen > 0 && ! verifyUtf8 ( linkText, textLen ) ) {
+			textLen = 0;
+		}
+		linkText[textLen] = '\0';
+
+		// . the same vote XmlDoc::getMsg20Reply() makes for this
+		//   linkee when Msg25 asks it to do the link spam check
+		// . we keep the surrounding text even if it is spam, Msg25
+		//   drops it if it does the check, see setMsg20Reply()
+		const char *note = NULL;
+		bool spam = false;
+		if ( linkNode >= 0 ) {
+			Url linkee;
+			linkee.set ( m_links.getLinkPtr(i), m_links.getLinkLen(i) );
+			spam = linkSpamChecker.isLinkSpam ( &note, &linkee, linkNode );
+		}
+
+		char surroundingText[MAX_SURROUNDING_TEXT_WIDTH];
+		int32_t surroundingLen = 0;
+		if ( linkNode >= 0 ) {
+			surroundingLen = getSurroundingText ( linkNode, &wordHint, surroundingText,
+							      surroundingText + sizeof(surroundingText) / 2 );
+		}
+
+		ar.m_isLinkSpam          = spam;
+		ar.m_linkTextNumWords    = (uint16_t)getLinkTextNumWords ( linkText, textLen );
+		ar.m_linkTextSize        = textLen > 0 ? textLen + 1 : 0;
+		ar.m_surroundingTextSize = surroundingLen > 0 ? surroundingLen + 1 : 0;
+		ar.m_noteSize            = note ? strlen(note) + 1 : 0;
+
+		int32_t dataSize = ar.getStoredSize();
+
+		if ( ! sb->reserve ( 1 + sizeof(k) + 4 + dataSize, "anchorbuf" ) ) {
+			return false;
+		}
+
+		sb->pushChar ( (char)RDB_ANCHORDB );
+		sb->safeMemcpy ( &k, sizeof(k) );
+		sb->safeMemcpy ( &dataSize, 4 );
+		sb->safeMemcpy ( &ar, sizeof(ar) );
+		sb->safeMemcpy ( getFirstUrl()->getUrl(), ar.m_urlSize );
+		if ( ar.m_linkTextSize ) {
+			sb->safeMemcpy ( linkText, ar.m_linkTextSize );
+		}
+		if ( ar.m_surroundingTextSize ) {
+			sb->safeMemcpy ( surroundingText, ar.m_surroundingTextSize );
+		}
+		if ( ar.m_noteSize ) {
+			sb->safeMemcpy ( note, ar.m_noteSize );
+		}
+	}
+
+	return true;
+}
+
 // . returns false and sets g_errno on error
 // . copied Url2.cpp into here basically, so we can now dump Url2.cpp
 bool XmlDoc::hashUrl ( HashTableX *tt, bool urlOnly ) { // , bool isStatusDoc ) {
@@ -1476,6 +1626,67 @@ void XmlDoc::lookupAndSetExplicitKeywords() {
 	}
 }
 
+// . serialize the pre-tokenized summary store into ptr_summaryStore so
+//   Msg20 can make the title and summary without parsing the html again
+// . best effort, we just index without it on error
+void XmlDoc::setSummaryStore() {
+	if ( m_summaryStoreBufValid ) {
+		return;
+	}
+
+	ptr_summaryStore = NULL;
+	size_summaryStore = 0;
+
+	if ( m_version < 130 ) {
+		m_summaryStoreBufValid = true;
+		return;
+	}
+
+	CollectionRec *cr = getCollRec();
+	if ( ! cr ) {
+		return;
+	}
+
+	uint8_t *ct = getContentType();
+	if ( ! ct || ct == (uint8_t *)-1 ) {
+		return;
+	}
+
+	char *isRoot = getIsSiteRoot();
+	if ( ! isRoot || isRoot == (char *)-1 ) {
+		return;
+	}
+
+	Xml *xml = getXml();
+	if ( ! xml || xml == (Xml *)-1 ) {
+		return;
+	}
+
+	bool *parsed = parseRobotsMetaTag();
+	if ( ! parsed || parsed == (bool *)-1 ) {
+		return;
+	}
+
+	uint8_t robotsFlags = 0;
+	if ( m_robotsNoIndex ) robotsFlags |= SummaryStore::s_robotsNoIndex;
+	if ( m_robotsNoFollow ) robotsFlags |= SummaryStore::s_robotsNoFollow;
+	if ( m_robotsNoArchive ) robotsFlags |= SummaryStore::s_robotsNoArchive;
+	if ( m_robotsNoSnippet ) robotsFlags |= SummaryStore::s_robotsNoSnippet;
+
+	m_summaryStoreBuf.purge();
+	if ( ! SummaryStore::build( &m_summaryStoreBuf, xml, getFirstUrl(), *ct, *isRoot, cr->m_titleMaxLen,
+	                            cr->m_summaryMaxLen, robotsFlags ) ) {
+		log( LOG_WARN, "build: could not make summary store for %s: %s", m_firstUrl.getUrl(), mstrerror( g_errno ) );
+		g_errno = 0;
+		m_summaryStoreBuf.purge();
+	} else if ( m_summaryStoreBuf.length() > 0 ) {
+		ptr_summaryStore = m_summaryStoreBuf.getBufStart();
+		size_summaryStore = m_summaryStoreBuf.length();
+	}
+
+	m_summaryStoreBufValid = true;
+}
+
 bool XmlDoc::hashExplicitKeywords(HashTableX *tt) {
 	if(m_version<128)
 		return true;
@@ -2236,6 +2447,77 @@ bool XmlDoc::hashWords3(HashInfo *hi, const TokenizerResult *tr, size_t begin_to
 		} else {
 			logTrace(g_conf.m_logTraceTokenIndexing,"NOT indexing two-word phrase(s)");
 		}
+
+
+		////////
+		//
+		// frequent phrases of 3+ words
+		//
+		////////
+
+		if(!g_frequentPhrases.empty() && bits->canBeInPhrase(i)) {
+			int32_t pos = 0;
+			uint64_t h = FrequentPhrases::hashWord(0, token.token_start, token.token_len, &pos);
+			int32_t numWords = 1;
+			unsigned prev = i;
+			for(unsigned j=i+1; j<end_token && numWords<g_frequentPhrases.getMaxWords(); j++) {
+				const auto &token2 = (*tr)[j];
+				if(!token2.is_alfanum) {
+					if(!bits->canBeInPhrase(j) && !bits->canPairAcross(j))
+						break;
+					continue;
+				}
+				//only the first of the alternative tokens at a position, like the bigrams above
+				if(token2.start_pos<(*tr)[prev].end_pos)
+					continue;
+				if(!bits->canBeInPhrase(j))
+					break;
+				h = FrequentPhrases::hashWord(h, token2.token_start, token2.token_len, &pos);
+				prev = j;
+				numWords++;
+				if(numWords<FREQUENTPHRASES_MIN_WORDS || !g_frequentPhrases.isFrequentPhrase(h))
+					continue;
+
+				logTrace(g_conf.m_logTraceTokenIndexing,"Indexing %d-word frequent phrase starting with '%.*s', h=%" PRIu64, numWords, (int)token.token_len, token.token_start, h);
+				uint64_t ph;
+				if ( plen > 0 ) ph = hash64 ( h , prefixHash );
+				else            ph = h;
+				key144_t k;
+				Posdb::makeKey ( &k ,
+						ph ,
+						0LL,//docid
+						wposvec[i],//dist,
+						densvec[i],// densityRank , // 0-15
+						MAXDIVERSITYRANK, //phrase
+						ws, // wordSpamRank ,
+						0,//siterank
+						hashGroup,
+						// we set to docLang final hash loop
+						langUnknown, // langid
+						0 , // multiplier
+						false, // syn?
+						false , // delkey?
+						hi->m_shardByTermId );
+				dt->addTerm144 ( &k );
+
+				// add to wts for PageParser.cpp display
+				int32_t phraseLen = (token2.token_start + token2.token_len) - token.token_start;
+				if(wts && phraseLen>0 && phraseLen<=256) {
+					if(!storeTerm(token.token_start,phraseLen,ph,hi,i,
+						wposvec[i], // wordPos
+						densvec[i],// densityRank , // 0-15
+						MAXDIVERSITYRANK,//phrase
+						ws,
+						hashGroup,
+						wbuf,
+						wts,
+						SOURCE_BIGRAM, // synsrc
+						langId,
+						k))
+						return false;
+				}
+			}
+		}
 	}
 
 	// between calls? i.e. hashTitle() and hashBody()
@@ -3,6 +3,7 @@
 #include "Sanity.h"
 #include "utf8_fast.h"
 #include "hash.h"
+#include <string.h>
 
 static int32_t getTagLen(const char *node, int maxNodeLen);
 
@@ -325,8 +326,19 @@ int32_t XmlNode::set( char *node, int maxNodeLen, bool pureXml ) {
 		m_hash       = 0;
 		int32_t i = 0;
 
-		// inc i as long as it's NOT the beginning of a tag
-		while ( node[i] && ( node[i] != '<' || !isTagStart( node + i ) ) ) {
+		// . inc i as long as it's NOT the beginning of a tag
+		// . Xml::set() has replaced any NUL bytes so the text goes on
+		//   until the end of the content or the next tag
+		for ( ;; ) {
+			const char *lt = (const char *)memchr( node + i, '<', maxNodeLen - i );
+			if ( ! lt ) {
+				i = maxNodeLen;
+				break;
+			}
+			i = lt - node;
+			if ( isTagStart( lt ) ) {
+				break;
+			}
 			++i;
 		}
 
@@ -623,34 +623,70 @@ bool isLinkSpam ( const Url *linker,
 		  const Url *linkee ,
 		  // node position of the linkee in the linker's content
 		  int32_t  linkNode ) {
-	// same host linkers can be link spam (TODO: make same ip block)
-	// because we only allow up to 10 to vote as a single voter
-	if ( linkee ) {
-		const char *h1    = linkee->getHost();
-		int32_t  h1len = linkee->getHostLen();
-		const char *h2    = linker->getHost();
-		int32_t h2len = linker->getHostLen();
-		if ( h1len == h2len && strncmp ( h1 , h2 , h1len ) == 0 ) 
-			return false;
-	}
+	LinkSpamChecker checker;
+	checker.set ( linker, siteNumInlinks, xml, links, maxDocLen );
+	return checker.isLinkSpam ( note, linkee, linkNode );
+}
 
-	// do not allow .info or .biz to vote ever for now
+
+LinkSpamChecker::LinkSpamChecker()
+  : m_linker(NULL),
+    m_siteNumInlinks(0),
+    m_xml(NULL),
+    m_links(NULL),
+    m_linkerNote(NULL),
+    m_isLinkerSpam(false),
+    m_needleMatches1(),
+    m_needles2Note(NULL),
+    m_isPostPage(false),
+    m_hasTextArea(false),
+    m_hasSubmit(false),
+    m_isEduOrGov(false),
+    m_isAdult(false)
+{
+}
+
+
+void LinkSpamChecker::set ( const Url *linker,
+			    int32_t siteNumInlinks ,
+			    Xml *xml,
+			    Links *links ,
+			    int32_t maxDocLen ) {
+	m_linker = linker;
+	m_siteNumInlinks = siteNumInlinks;
+	m_xml = xml;
+	m_links = links;
+	m_linkerNote = NULL;
+	m_isLinkerSpam = true;
+	m_needleMatches1.clear();
+	m_needles2Note = NULL;
+	m_isPostPage = false;
+	m_hasTextArea = false;
+	m_hasSubmit = false;
+
+	// edu, gov, etc. can have link chains
 	const char *tld    = linker->getTLD();
 	int32_t  tldLen = linker->getTLDLen();
+	m_isEduOrGov = tldLen >= 3 && ( strncmp ( tld, "edu" , 3) == 0 || strncmp ( tld, "gov" , 3) == 0 );
+
+	// if linker is naughty, he cannot vote
+	m_isAdult = linker->isAdult();
+
+	// do not allow .info or .biz to vote ever for now
 	if ( tldLen == 4 && strncmp ( tld, "info" , tldLen) == 0 ) {
-		*note = ".info tld";
-		return true;
+		m_linkerNote = ".info tld";
+		return;
 	}
 	if ( tldLen == 3 && strncmp ( tld, "biz" , tldLen) == 0 ) {
-		*note = ".biz tld";
-		return true;
+		m_linkerNote = ".biz tld";
+		return;
 	}
 
 	// i saw a german doc get its textarea cut out because of this, so
 	// we need this here
 	if ( xml && xml->getContentLen() > maxDocLen ) {
-		*note ="doc too big";
-		return true; 
+		m_linkerNote ="doc too big";
+		return;
 	}
 
 	// guestbook in hostname - domain?
@@ -661,25 +697,28 @@ bool isLinkSpam ( const Url *linker,
 		bool hasIt = false;
 		if ( strnstr ( hd , "guestbook", hdlen ) ) hasIt = true;
 		if ( hasIt ) { 
-			*note = "guestbook in hostname"; 
-			return true; 
+			m_linkerNote = "guestbook in hostname"; 
+			return;
 		}
 	}
 
 	// do not allow any cgi url to vote
-	if ( linker->isCgi() ) { *note = "path is cgi"; return true; }
+	if ( linker->isCgi() ) { m_linkerNote = "path is cgi"; return; }
 
-	if(isLinkfulPath(linker->getPath(),linker->getPathLen(),note))
-		return true;
+	if(isLinkfulPath(linker->getPath(),linker->getPathLen(),&m_linkerNote))
+		return;
+
+	m_isLinkerSpam = false;
 
 	if( !xml ) {
-		return false;
+		return;
 	}
 
 	// does title contain "web statistics for"?
 	if(isWebstatisticsPage(xml)) {
-		*note = "stats page";
-		return true;
+		m_linkerNote = "stats page";
+		m_isLinkerSpam = true;
+		return;
 	}
 
 	/////////////////////////////////////////////////////
@@ -688,34 +727,14 @@ bool isLinkSpam ( const Url *linker,
 	//
 	/////////////////////////////////////////////////////
 
-	const char *haystack     = xml->getContent();
-	int32_t  haystackSize = xml->getContentLen();
-
-	char *linkPos = NULL;
-	if ( linkNode >= 0 ) linkPos = xml->getNode ( linkNode );
-
-	// do not call them "bad links" if our link occurs before any
-	// comment section. our link's position therefore needs to be known,
-	// that is why we pass in linkPos.
-	NeedleMatch needleMatches1[numNeedles1];
-	bool hadPreMatch;
-	getMatches2(s_needles1, needleMatches1, numNeedles1, haystack, haystackSize, linkPos, &hadPreMatch);
-
-	// see if we got a hit
-	for ( int32_t i = 0 ; i < numNeedles1 ; i++ ) {
-		int32_t need = 1;
-		// open.thumbshots.org needs multiple counts
-		if ( i == 0 ) need = 5;
-		if ( needleMatches1[i].m_count < need ) continue;
-		*note = s_needles1[i].m_string;
-		return true;
-	}
+	// . count all matches, isLinkSpam() only counts the comment section
+	//   ones before the link
+	m_needleMatches1.resize(numNeedles1);
+	getMatches2(s_needles1, &m_needleMatches1[0], numNeedles1, xml->getContent(), xml->getContentLen(), NULL, NULL);
 
 	// now check outlinks on the page for these substrings
-	haystack     = links->getLinkBuf();
-	haystackSize = links->getLinkBufLen();
 	NeedleMatch needleMatches2[numNeedles2];
-	getMatches2(s_needles2, needleMatches2, numNeedles2, haystack, haystackSize, NULL, NULL);
+	getMatches2(s_needles2, needleMatches2, numNeedles2, links->getLinkBuf(), links->getLinkBufLen(), NULL, NULL);
 
 	// see if we got a hit
 	for ( int32_t i = 0 ; i < numNeedles2 ; i++ ) {
@@ -723,8 +742,8 @@ bool isLinkSpam ( const Url *linker,
 		// open.thumbshots.org needs multiple counts
 		//if ( i == 9 ) need = 5;
 		if ( needleMatches2[i].m_count < need ) continue;
-		*note = s_needles2[i].m_string;
-		return true;
+		m_needles2Note = s_needles2[i].m_string;
+		break;
 	}
 
 	//skiplinks:
@@ -736,27 +755,19 @@ bool isLinkSpam ( const Url *linker,
 	// <form method=POST 
 	//  action="http://peaceaction.org/wboard/wwwboard.cgi">
 	int32_t nn = xml->getNumNodes();
-	bool gotTextArea = false;
-	bool gotSubmit   = false;
 	for ( int32_t i=0; i < nn ; i++ ) {
 		// <textarea> tags are bad... but only if we have not
-		// matched "track" or whatever from above... check for that
-		// if you uncommment this... otherwise you disable all blogs!
-		// Only do this check if we did match a comment related phrase
-		// in s_needles1[] BUT it was BEFORE our outlink. That 
-		// basically means that we do *not* recognize the format of 
-		// the comment page and so therefore need to be more 
-		// restrictive about allowing this page to vote.
-		if ( ! hadPreMatch ) {
-			// is it a <textarea> tag?
-			if ( xml->getNodeId ( i ) == TAG_TEXTAREA ) 
-				gotTextArea = true;
-			// is it an <input> tag?
-			int32_t len = 0;
-			if ( xml->getNodeId ( i ) == TAG_INPUT &&
-			     xml->getString(i,"submit",&len)) gotSubmit = true;
-		}
-
+		// matched "track" or whatever from above. isLinkSpam()
+		// checks for that
+		// is it a <textarea> tag?
+		if ( xml->getNodeId ( i ) == TAG_TEXTAREA ) 
+			m_hasTextArea = true;
+		// is it an <input> tag?
+		int32_t len = 0;
+		if ( xml->getNodeId ( i ) == TAG_INPUT &&
+		     xml->getString(i,"submit",&len)) m_hasSubmit = true;
+
+		if ( m_isPostPage ) continue;
 		if ( xml->getNodeId ( i ) != TAG_FORM ) continue;
 			
 		// get the method field of this base tag
@@ -778,20 +789,82 @@ bool isLinkSpam ( const Url *linker,
 		// they can have these search boxes though
 		if ( val && strstr ( s , "/mt/mt-search" ) ) val = false;
 		s[slen] = c;
-		if ( val ) { *note = "post page"; return true; }
+		if ( val ) m_isPostPage = true;
 	}
+}
 
-	if ( gotTextArea && gotSubmit ) {
+
+bool LinkSpamChecker::isLinkSpam ( const char **note ,
+				   const Url *linkee ,
+				   // node position of the linkee in the linker's content
+				   int32_t  linkNode ) const {
+	// same host linkers can be link spam (TODO: make same ip block)
+	// because we only allow up to 10 to vote as a single voter
+	if ( linkee ) {
+		const char *h1    = linkee->getHost();
+		int32_t  h1len = linkee->getHostLen();
+		const char *h2    = m_linker->getHost();
+		int32_t h2len = m_linker->getHostLen();
+		if ( h1len == h2len && strncmp ( h1 , h2 , h1len ) == 0 ) 
+			return false;
+	}
+
+	if ( m_linkerNote ) *note = m_linkerNote;
+	if ( m_isLinkerSpam ) return true;
+
+	if( !m_xml ) {
+		return false;
+	}
+
+	char *linkPos = NULL;
+	if ( linkNode >= 0 ) linkPos = m_xml->getNode ( linkNode );
+
+	// . do not call them "bad links" if our link occurs before any
+	//   comment section. our link's position therefore needs to be known,
+	//   that is why we pass in linkPos.
+	// . the comment section needles need only one match
+	bool hadPreMatch = false;
+	for ( int32_t i = 0 ; i < numNeedles1 ; i++ ) {
+		const NeedleMatch &m = m_needleMatches1[i];
+		if ( linkPos && s_needles1[i].m_isSection ) {
+			if ( m.m_lastMatch && m.m_lastMatch > linkPos )
+				hadPreMatch = true;
+			if ( ! m.m_firstMatch || m.m_firstMatch > linkPos ) continue;
+		} else {
+			int32_t need = 1;
+			// open.thumbshots.org needs multiple counts
+			if ( i == 0 ) need = 5;
+			if ( m.m_count < need ) continue;
+		}
+		*note = s_needles1[i].m_string;
+		return true;
+	}
+
+	if ( m_needles2Note ) {
+		*note = m_needles2Note;
+		return true;
+	}
+
+	if ( m_isPostPage ) {
+		*note = "post page";
+		return true;
+	}
+
+	// Only do the textarea check if we did match a comment related phrase
+	// in s_needles1[] BUT it was BEFORE our outlink. That basically means
+	// that we do *not* recognize the format of the comment page and so
+	// therefore need to be more restrictive about allowing this page to
+	// vote.
+	if ( ! hadPreMatch && m_hasTextArea && m_hasSubmit ) {
 		*note = "textarea tag";
 		return true;
 	}
 
 	// edu, gov, etc. can have link chains
-	if ( tldLen >= 3 && strncmp ( tld, "edu" , 3) == 0 ) return false;
-	if ( tldLen >= 3 && strncmp ( tld, "gov" , 3) == 0 ) return false;
+	if ( m_isEduOrGov ) return false;
 
 	// if linker is naughty, he cannot vote
-	if ( linker->isAdult() )
+	if ( m_isAdult )
 		return true;
 
 	// if being called from PageTitledb.cpp for displaying a titlerec, 
@@ -803,7 +876,7 @@ bool isLinkSpam ( const Url *linker,
 
 	// . if they link to any adult site, consider them link spam
 	// . just consider a 100 link radius around linkNode
-	int32_t nl = links->getNumLinks();
+	int32_t nl = m_links->getNumLinks();
 
 	// init these before the loop
 	int32_t  hlen  = linkee->getHostLen();
@@ -815,8 +888,8 @@ bool isLinkSpam ( const Url *linker,
  loop:
 
 	// return true right away if it is a link chain
-	if ( siteNumInlinks < 1000 && 
-	     isLinkChain ( xml , linker, linkee , x , note ) ) 
+	if ( m_siteNumInlinks < 1000 && 
+	     isLinkChain ( m_xml , m_linker, linkee , x , note ) ) 
 		return true;
 
 	// if no domain, that's it
@@ -826,8 +899,8 @@ bool isLinkSpam ( const Url *linker,
 	// . if any of those areas are not link chains, then assume we are
 	//   not a link chain
 	for ( x++ ; x < nl ; x++ ) {
-		char *link = links->getLinkPtr(x);
-		int32_t  linkLen = links->getLinkLen(x);
+		char *link = m_links->getLinkPtr(x);
+		int32_t  linkLen = m_links->getLinkLen(x);
 		if ( ! link          ) continue;
 		if ( linkLen <= 0    ) continue;
 		if ( linkLen > uulen ) continue;
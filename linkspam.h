@@ -4,8 +4,12 @@
 #define GB_LINKSPAM_H
 
 #include <inttypes.h>
+#include <vector>
+#include "matches2.h"
 
 class Url;
+class Xml;
+class Links;
 
 bool setLinkSpam (const Url       *linker             ,
                    int32_t             siteNumInlinks     ,
@@ -22,4 +26,40 @@ bool isLinkSpam  ( const  Url       *linker         ,
 		   const Url          *linkee         ,
 		   int32_t             linkNode       );
 
+// . isLinkSpam() for all the outlinks of a document
+// . set() does the checks that do not depend on the linkee, like scanning
+//   the content and the outlinks for the needles, so isLinkSpam() only does
+//   the ones that do
+// . "linker", "xml" and "links" must stay around
+class LinkSpamChecker {
+public:
+	LinkSpamChecker();
+
+	void set ( const Url *linker, int32_t siteNumInlinks, Xml *xml, Links *links, int32_t maxDocLen );
+
+	// same as ::isLinkSpam() with the set() args
+	bool isLinkSpam ( const char **note, const Url *linkee, int32_t linkNode ) const;
+
+private:
+	const Url *m_linker;
+	int32_t m_siteNumInlinks;
+	Xml *m_xml;
+	Links *m_links;
+
+	// the linker can not vote at all
+	const char *m_linkerNote;
+	bool m_isLinkerSpam;
+
+	// the content needles, the comment section ones only count before
+	// the link
+	std::vector<NeedleMatch> m_needleMatches1;
+	// the outlink needle that matched, NULL if none
+	const char *m_needles2Note;
+	bool m_isPostPage;
+	bool m_hasTextArea;
+	bool m_hasSubmit;
+	bool m_isEduOrGov;
+	bool m_isAdult;
+};
+
 #endif // GB_LINKSPAM_H
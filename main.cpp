@@ -28,11 +28,13 @@
 #include "UdpServer.h"
 #include "Serialize.h"
 #include "Repair.h"
+#include "Warmup.h"
 #include "DailyMerge.h"
 #include "MsgC.h"
 #include "HttpServer.h"
 #include "Loop.h"
 #include "HighFrequencyTermShortcuts.h"
+#include "FrequentPhrases.h"
 #include "PageTemperatureRegistry.h"
 #include "Docid2Siteflags.h"
 #include "SiteMedianPageTemperatureRegistry.h"
@@ -51,6 +53,11 @@
 #include "Title.h"
 #include "Speller.h"
 #include "SummaryCache.h"
+#include "QueryPlanCache.h"
+#include "SearchCursors.h"
+#include "SerpWriter.h"
+#include "TruncatedTermlists.h"
+#include "Msg2.h"
 #include "InstanceInfoExchange.h"
 #include "WantedChecker.h"
 #include "Dns.h"
@@ -1308,6 +1315,9 @@ int main2 ( int argc , char *argv[] ) {
 	//Load the high-frequency term shortcuts (if they exist)
 	g_hfts.load();
 
+	//Load the frequent phrases (if they exist)
+	g_frequentPhrases.load();
+
 	//Load the page temperature
 	g_pageTemperatureRegistry.load();
 	
@@ -1404,6 +1414,10 @@ int main2 ( int argc , char *argv[] ) {
 				 false    )){ // is dns?
 		log("db: UdpServer init failed." ); return 1; }
 
+	// load the hot set so we advertise that we are warming up
+	if ( ! g_warmup.init() ) {
+		log("db: Warmup init failed." ); return 1; }
+
 	// start up repair loop
 	if ( ! g_repair.init() ) {
 		log("db: Repair init failed." ); return 1; }
@@ -1426,6 +1440,11 @@ int main2 ( int argc , char *argv[] ) {
 
 	g_stable_summary_cache.configure(g_conf.m_stableSummaryCacheMaxAge, g_conf.m_stableSummaryCacheSize);
 	g_unstable_summary_cache.configure(g_conf.m_unstableSummaryCacheMaxAge, g_conf.m_unstableSummaryCacheSize);
+	g_queryPlanCache.configure(g_conf.m_queryPlanCacheMaxAge, g_conf.m_queryPlanCacheSize);
+	g_truncatedTermlists.configure(g_conf.m_truncatedTermlistsMaxMemory);
+	initSharedTermlistCache();
+	g_searchCursors.configure(g_conf.m_searchCursorMaxAge, g_conf.m_searchCursorMaxItems);
+	g_serpBufferPool.configure(g_conf.m_serpBufferPoolSize, g_conf.m_serpBufferMaxSize);
 	
 	// . then webserver
 	// . server should listen to a socket and register with g_loop
@@ -1519,6 +1538,9 @@ int main2 ( int argc , char *argv[] ) {
 	// . comment out when testing SpiderCache
 	g_spiderLoop.init();
 
+	// read the hot set ahead and refill the caches before taking queries
+	g_warmup.start();
+
 	// allow saving of conf again
 	g_conf.m_save = true;
 
@@ -205,6 +205,7 @@ char *getMatches2(const Needle *needles, NeedleMatch *needlesMatch, int32_t numN
 			// store ptr if NULL
 			if ( ! needlesMatch[j].m_firstMatch )
 				needlesMatch[j].m_firstMatch = (char *)p;
+			needlesMatch[j].m_lastMatch = (char *)p;
 
 			// otherwise, just count it
 			needlesMatch[j].m_count++;
@@ -324,6 +325,7 @@ char *getMatches2(const Needle *needles, NeedleMatch *needlesMatch, int32_t numN
 			// store ptr if NULL
 			if ( ! needlesMatch[j].m_firstMatch )
 				needlesMatch[j].m_firstMatch = (char *)p;
+			needlesMatch[j].m_lastMatch = (char *)p;
 
 			// otherwise, just count it
 			needlesMatch[j].m_count++;
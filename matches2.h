@@ -30,11 +30,13 @@ class NeedleMatch {
 public:
 	NeedleMatch()
 		: m_count(0)
-		, m_firstMatch(nullptr) {
+		, m_firstMatch(nullptr)
+		, m_lastMatch(nullptr) {
 	}
 
 	int32_t m_count;
 	char *m_firstMatch;
+	char *m_lastMatch;
 };
 
 char *getMatches2(const Needle *needles, NeedleMatch *needlesMatch, int32_t numNeedles,
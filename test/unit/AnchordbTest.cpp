@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "Anchordb.h"
+#include "Msg20.h"
+#include <string.h>
+
+TEST(AnchordbTest, MakeKey) {
+	uint32_t linkeeSiteHash32 = 0x12345678;
+	uint64_t linkeeUrlHash64 = 0x00007edcba987654ULL;
+	int64_t linkerDocId = 0x0000003456789abcLL;
+
+	key128_t k = Anchordb::makeKey(linkeeSiteHash32, linkeeUrlHash64, linkerDocId, false);
+	EXPECT_EQ(linkeeSiteHash32, Anchordb::getLinkeeSiteHash32(&k));
+	EXPECT_EQ(linkeeUrlHash64, Anchordb::getLinkeeUrlHash64(&k));
+	EXPECT_EQ(linkerDocId, Anchordb::getLinkerDocId(&k));
+	EXPECT_FALSE(KEYNEG((const char *)&k));
+
+	key128_t del = Anchordb::makeKey(linkeeSiteHash32, linkeeUrlHash64, linkerDocId, true);
+	EXPECT_TRUE(KEYNEG((const char *)&del));
+
+	key128_t startKey = Anchordb::makeStartKey(linkeeSiteHash32, linkeeUrlHash64);
+	key128_t endKey = Anchordb::makeEndKey(linkeeSiteHash32, linkeeUrlHash64);
+	EXPECT_TRUE(startKey <= del);
+	EXPECT_TRUE(k <= endKey);
+}
+
+static int32_t makeAnchorRec(char *buf, const char *url, const char *linkText,
+                             const char *surroundingText = NULL, const char *note = NULL) {
+	int32_t urlSize = strlen(url) + 1;
+	int32_t linkTextSize = linkText ? strlen(linkText) + 1 : 0;
+	int32_t surroundingTextSize = surroundingText ? strlen(surroundingText) + 1 : 0;
+	int32_t noteSize = note ? strlen(note) + 1 : 0;
+
+	AnchorRec *ar = (AnchorRec *)buf;
+	memset(ar, 0, sizeof(AnchorRec));
+	ar->m_ip = 0x01020304;
+	ar->m_siteRank = 3;
+	ar->m_urlSize = urlSize;
+	ar->m_linkTextSize = linkTextSize;
+	ar->m_surroundingTextSize = surroundingTextSize;
+	ar->m_noteSize = noteSize;
+	ar->m_isLinkSpam = (note != NULL);
+	memcpy(ar->m_buf, url, urlSize);
+	if (linkText) {
+		memcpy(ar->m_buf + urlSize, linkText, linkTextSize);
+	}
+	if (surroundingText) {
+		memcpy(ar->m_buf + urlSize + linkTextSize, surroundingText, surroundingTextSize);
+	}
+	if (note) {
+		memcpy(ar->m_buf + urlSize + linkTextSize + surroundingTextSize, note, noteSize);
+	}
+
+	return ar->getStoredSize();
+}
+
+TEST(AnchordbTest, AnchorRec) {
+	char buf[256];
+	int32_t size = makeAnchorRec(buf, "http://www.example.com/", "example link");
+	ASSERT_TRUE(AnchorRec::isValid(buf, size));
+	EXPECT_FALSE(AnchorRec::isValid(buf, size - 1));
+	EXPECT_FALSE(AnchorRec::isValid(buf, sizeof(AnchorRec) - 1));
+
+	const AnchorRec *ar = (const AnchorRec *)buf;
+	EXPECT_STREQ("http://www.example.com/", ar->getUrl());
+	EXPECT_STREQ("example link", ar->getLinkText());
+	EXPECT_EQ(NULL, ar->getSurroundingText());
+	EXPECT_EQ(NULL, ar->getNote());
+
+	Msg20Reply reply;
+	ar->setMsg20Reply(&reply, 1234, true);
+	EXPECT_EQ(1234, reply.m_docId);
+	EXPECT_EQ(0x01020304, reply.m_ip);
+	EXPECT_EQ(3, reply.m_siteRank);
+	EXPECT_STREQ("example link", reply.ptr_linkText);
+	EXPECT_EQ(13, reply.size_linkText);
+	EXPECT_EQ(0, reply.size_surroundingText);
+
+	// without a terminating \0
+	buf[size - 1] = 'x';
+	EXPECT_FALSE(AnchorRec::isValid(buf, size));
+
+	// no linker url
+	size = makeAnchorRec(buf, "", NULL);
+	EXPECT_FALSE(AnchorRec::isValid(buf, size));
+}
+
+TEST(AnchordbTest, LinkSpam) {
+	char buf[256];
+	int32_t size = makeAnchorRec(buf, "http://www.example.com/", "example link", "around the link", "path has cgi");
+	ASSERT_TRUE(AnchorRec::isValid(buf, size));
+	const AnchorRec *ar = (const AnchorRec *)buf;
+
+	// a spammy voter has no surrounding text, like the msg20 reply
+	Msg20Reply checked;
+	ar->setMsg20Reply(&checked, 1234, true);
+	EXPECT_TRUE(checked.m_isLinkSpam);
+	EXPECT_STREQ("path has cgi", checked.ptr_note);
+	EXPECT_EQ(NULL, checked.ptr_surroundingText);
+	EXPECT_EQ(0, checked.size_surroundingText);
+
+	// without the link spam check it is a normal voter
+	Msg20Reply unchecked;
+	ar->setMsg20Reply(&unchecked, 1234, false);
+	EXPECT_FALSE(unchecked.m_isLinkSpam);
+	EXPECT_EQ(NULL, unchecked.ptr_note);
+	EXPECT_STREQ("around the link", unchecked.ptr_surroundingText);
+	EXPECT_EQ(16, unchecked.size_surroundingText);
+}
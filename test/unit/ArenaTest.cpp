@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include "Arena.h"
+#include "Mem.h"
+#include "Xml.h"
+#include "Bits.h"
+#include "Phrases.h"
+#include "tokenizer.h"
+#include "HttpMime.h"
+#include "TitleRecVersion.h"
+#include <stdint.h>
+
+TEST(ArenaTest, Alloc) {
+	Arena arena("arenatest", 1024);
+
+	char *a = (char *)arena.alloc(10);
+	char *b = (char *)arena.alloc(1);
+	ASSERT_TRUE(a != NULL);
+	ASSERT_TRUE(b != NULL);
+	EXPECT_EQ(0U, (uintptr_t)a % 16);
+	EXPECT_EQ(0U, (uintptr_t)b % 16);
+	EXPECT_GE(b, a + 10);
+	memset(a, 'a', 10);
+	memset(b, 'b', 1);
+	EXPECT_EQ('a', a[9]);
+
+	EXPECT_EQ(2, arena.getNumAllocs());
+	EXPECT_EQ(1, arena.getNumBlocks());
+	EXPECT_EQ(32U, arena.getUsed());
+
+	// a big one gets its own block and we keep filling the first one
+	char *big = (char *)arena.alloc(4000);
+	ASSERT_TRUE(big != NULL);
+	memset(big, 'x', 4000);
+	EXPECT_EQ(2, arena.getNumBlocks());
+	char *c = (char *)arena.alloc(16);
+	EXPECT_EQ(b + 16, c);
+	EXPECT_EQ(2, arena.getNumBlocks());
+
+	// fill up the first block
+	for (int i = 0; i < 100; i++) {
+		ASSERT_TRUE(arena.alloc(100) != NULL);
+	}
+	EXPECT_GT(arena.getNumBlocks(), 2);
+	EXPECT_GE(arena.getAllocated(), arena.getUsed());
+}
+
+TEST(ArenaTest, Reset) {
+	size_t usedMem = g_mem.getUsedMem();
+
+	Arena arena("arenatest", 1024);
+	for (int i = 0; i < 50; i++) {
+		ASSERT_TRUE(arena.alloc(i * 10) != NULL);
+	}
+	EXPECT_GT(g_mem.getUsedMem(), usedMem);
+
+	arena.reset();
+	EXPECT_EQ(usedMem, g_mem.getUsedMem());
+	EXPECT_EQ(0U, arena.getUsed());
+	EXPECT_EQ(0U, arena.getAllocated());
+	EXPECT_EQ(0, arena.getNumAllocs());
+	EXPECT_EQ(0, arena.getNumBlocks());
+
+	// usable again
+	EXPECT_TRUE(arena.alloc(10) != NULL);
+}
+
+TEST(ArenaTest, ParsingStructures) {
+	static const char html[] = "<html><head><title>arena</title></head><body><p>The quick brown fox jumps over the lazy dog</p></body></html>";
+
+	Arena arena("arenatest");
+	size_t usedMem = g_mem.getUsedMem();
+	{
+		char buf[sizeof(html)];
+		memcpy(buf, html, sizeof(html));
+
+		Xml xml;
+		xml.setArena(&arena);
+		ASSERT_TRUE(xml.set(buf, strlen(buf), TITLEREC_CURRENT_VERSION, CT_HTML));
+		EXPECT_GT(xml.getNumNodes(), 0);
+		EXPECT_GT(arena.getNumAllocs(), 0);
+
+		TokenizerResult tr;
+		xml_tokenizer_phase_1(&xml, &tr);
+		calculate_tokens_hashes(&tr);
+
+		Bits bits;
+		bits.setArena(&arena);
+		ASSERT_TRUE(bits.set(&tr));
+
+		Phrases phrases;
+		phrases.setArena(&arena);
+		ASSERT_TRUE(phrases.set(tr, bits));
+
+		// nothing is freed until the arena is reset
+		xml.reset();
+		bits.reset();
+		phrases.reset();
+		EXPECT_GT(arena.getUsed(), 0U);
+	}
+	arena.reset();
+	EXPECT_EQ(usedMem, g_mem.getUsedMem());
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include "FrequentPhrases.h"
+#include "hash.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static uint64_t hashPhrase(const char *words[], int numWords) {
+	uint64_t h = 0;
+	int32_t pos = 0;
+	for (int i = 0; i < numWords; i++) {
+		h = FrequentPhrases::hashWord(h, words[i], strlen(words[i]), &pos);
+	}
+	return h;
+}
+
+TEST(FrequentPhrasesTest, BigramId) {
+	// the first two words give the bigram id like XmlDoc::hashWords3() makes it
+	const char *words[] = { "To", "be" };
+	int32_t pos = 2;
+	uint64_t bigramId = hash64Lower_utf8_cont("be", 2, hash64Lower_utf8("to", 2), &pos);
+	EXPECT_EQ(bigramId, hashPhrase(words, 2));
+}
+
+TEST(FrequentPhrasesTest, Load) {
+	char filename[] = "/tmp/frequent_phrases_XXXXXX";
+	int fd = mkstemp(filename);
+	ASSERT_NE(-1, fd);
+	FILE *fp = fdopen(fd, "w");
+	ASSERT_TRUE(fp != NULL);
+	fprintf(fp, "# comment\n");
+	fprintf(fp, "to be or not to be\n");
+	fprintf(fp, "the who\n");
+	fprintf(fp, "Lord of the Rings\n");
+	fclose(fp);
+
+	FrequentPhrases fps;
+	EXPECT_TRUE(fps.empty());
+	ASSERT_TRUE(fps.load(filename));
+	unlink(filename);
+
+	EXPECT_FALSE(fps.empty());
+	EXPECT_EQ(6, fps.getMaxWords());
+
+	const char *phrase1[] = { "to", "be", "or", "not", "to", "be" };
+	EXPECT_TRUE(fps.isFrequentPhrase(hashPhrase(phrase1, 6)));
+	// only the whole phrase
+	EXPECT_FALSE(fps.isFrequentPhrase(hashPhrase(phrase1, 4)));
+
+	// case insensitive
+	const char *phrase2[] = { "lord", "of", "the", "rings" };
+	EXPECT_TRUE(fps.isFrequentPhrase(hashPhrase(phrase2, 4)));
+
+	// bigrams have termlists already
+	const char *phrase3[] = { "the", "who" };
+	EXPECT_FALSE(fps.isFrequentPhrase(hashPhrase(phrase3, 2)));
+
+	fps.unload();
+	EXPECT_TRUE(fps.empty());
+	EXPECT_EQ(0, fps.getMaxWords());
+}
+
+TEST(FrequentPhrasesTest, LoadMissingFile) {
+	FrequentPhrases fps;
+	EXPECT_FALSE(fps.load("/nonexistent/frequent_phrases.txt"));
+	EXPECT_TRUE(fps.empty());
+}
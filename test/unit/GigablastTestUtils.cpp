@@ -10,6 +10,7 @@
 #include "Doledb.h"
 #include "Clusterdb.h"
 #include "Linkdb.h"
+#include "Lang.h"
 
 static void deleteRdbFiles() {
 	// delete all rdb files
@@ -106,3 +107,14 @@ void GbTest::addPosdbKey(RdbList *list, int64_t termId, int64_t docId, int32_t w
 	::Posdb::makeKey(&key, termId, docId, wordPos, 0, 0, 0, 0, 0, 0, 0, false, isDelKey, false);
 	list->addRecord(key, 0, NULL);
 }
+
+void GbTest::makePosdbList(RdbList *list, int64_t termId, int numDocIds) {
+	list->set(nullptr, 0, nullptr, 0, Posdb::getFixedDataSize(), true, Posdb::getUseHalfKeys(), Posdb::getKeySize());
+	for (int docId = 1; docId <= numDocIds; ++docId) {
+		for (int32_t wordPos = 0; wordPos < 2; ++wordPos) {
+			char key[MAX_KEY_BYTES];
+			::Posdb::makeKey(&key, termId, docId, wordPos * 10, 0, 0, 0, docId % 16, 0, langUnknown, 0, false, false, false);
+			list->addRecord(key, 0, NULL);
+		}
+	}
+}
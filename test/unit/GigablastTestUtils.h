@@ -14,6 +14,9 @@ namespace GbTest {
 	void addPosdbKey(RdbBuckets *buckets, int64_t termId, int64_t docId, int32_t wordPos, bool isDelKey = false);
 	void addPosdbKey(RdbIndex *index, int64_t termId, int64_t docId, int32_t wordPos, bool isDelKey = false);
 	void addPosdbKey(RdbList *list, int64_t termId, int64_t docId, int32_t wordPos, bool isDelKey = false);
+
+	// docids 1..numDocIds with siterank docid%16 and two positions each
+	void makePosdbList(RdbList *list, int64_t termId, int numDocIds);
 }
 
 
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include "HttpServer.h"
+#include "TcpSocket.h"
+#include <string.h>
+
+static int32_t getReplySize(const char *reply, bool keepAlive, bool *keptAlive) {
+	TcpSocket s;
+	memset(&s, 0, sizeof(s));
+	s.m_maxTextDocLen = -1;
+	s.m_maxOtherDocLen = -1;
+	s.m_keepAlive = keepAlive;
+	int32_t size = getMsgSize(reply, strlen(reply), &s);
+	*keptAlive = s.m_keepAlive;
+	return size;
+}
+
+TEST(HttpServerTest, KeepAliveReply) {
+	bool keptAlive;
+
+	// 1.1 with content-length can be reused
+	const char *reply11 = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+	EXPECT_EQ((int32_t)strlen(reply11), getReplySize(reply11, true, &keptAlive));
+	EXPECT_TRUE(keptAlive);
+
+	// 1.0 needs an explicit keep-alive
+	const char *reply10 = "HTTP/1.0 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+	getReplySize(reply10, true, &keptAlive);
+	EXPECT_FALSE(keptAlive);
+
+	const char *reply10ka = "HTTP/1.0 200 OK\r\nConnection: Keep-Alive\r\nContent-Length: 5\r\n\r\nhello";
+	getReplySize(reply10ka, true, &keptAlive);
+	EXPECT_TRUE(keptAlive);
+
+	// server wants to close
+	const char *replyClose = "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 5\r\n\r\nhello";
+	getReplySize(replyClose, true, &keptAlive);
+	EXPECT_FALSE(keptAlive);
+
+	// no way to tell where the reply ends
+	const char *replyNoLen = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\nhello";
+	EXPECT_EQ(-1, getReplySize(replyNoLen, true, &keptAlive));
+	EXPECT_FALSE(keptAlive);
+
+	const char *replyChunked = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello";
+	getReplySize(replyChunked, true, &keptAlive);
+	EXPECT_FALSE(keptAlive);
+}
+
+TEST(HttpServerTest, KeepAliveNoBody) {
+	bool keptAlive;
+
+	// a 304 ends with the mime when kept alive
+	const char *reply = "HTTP/1.1 304 Not Modified\r\nETag: \"abc\"\r\n\r\n";
+	EXPECT_EQ((int32_t)strlen(reply), getReplySize(reply, true, &keptAlive));
+	EXPECT_TRUE(keptAlive);
+
+	// otherwise we still wait for the close
+	EXPECT_EQ(-1, getReplySize(reply, false, &keptAlive));
+}
@@ -0,0 +1,107 @@
+#include "JobScheduler.h"
+#include "Conf.h"
+#include "Mem.h"
+#include "BigFile.h"
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+static void msleep(int msecs) {
+	struct timespec ts;
+	ts.tv_sec = msecs/1000;
+	ts.tv_nsec = (msecs%1000)*1000000;
+	nanosleep(&ts,NULL);
+}
+
+static int job_order[4];
+static unsigned jobs_started = 0;
+static void start_routine(void *state) {
+	FileState *fstate = static_cast<FileState*>(state);
+	job_order[jobs_started++] = (int)(intptr_t)fstate->m_state;
+	msleep(50);
+}
+static void finish_routine(void *, job_exit_t) {
+}
+
+//keeps the single i/o thread busy until all the jobs are queued, so which
+//one it picks first does not depend on timing
+static pthread_mutex_t gate_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static bool gate_open = false;
+static void gate_routine(void *) {
+	pthread_mutex_lock(&gate_mtx);
+	while(!gate_open)
+		pthread_cond_wait(&gate_cond,&gate_mtx);
+	pthread_mutex_unlock(&gate_mtx);
+}
+
+int main(void) {
+	g_conf.m_maxMem = 1000000000LL;
+	g_mem.m_memtablesize = 8194*1024;
+	g_mem.init();
+	
+	//verify that query reads go before merges and that merges are rate-limited
+	{
+		g_conf.m_ioMergeMaxRate = 1; //MB/s
+		g_conf.m_ioQueryReadDeadline = 100;
+		
+		JobScheduler js;
+		js.initialize(0,1,0,1,0,0,0);
+		
+		FileState gate_fstate;
+		gate_fstate.m_bytesToGo = 0;
+		js.submit_io(gate_routine,
+		             finish_routine,
+		             &gate_fstate,
+		             thread_type_unspecified_io,
+		             0, //priority/niceness
+		             false, //is_write
+		             0  //start_deadline
+		            );
+		
+		FileState fstate[4];
+		for(int i=0; i<4; i++) {
+			fstate[i].m_state = (void*)(intptr_t)i;
+			fstate[i].m_bytesToGo = 1024*1024;
+		}
+		fstate[0].m_ioClass = io_class_merge;
+		fstate[1].m_ioClass = io_class_merge;
+		fstate[2].m_ioClass = io_class_merge;
+		//fstate[3] is unspecified with niceness 0, so it is a query read
+		for(int i=0; i<4; i++)
+			js.submit_io(start_routine,
+			             finish_routine,
+			             &fstate[i],
+			             thread_type_unspecified_io,
+			             i==3 ? 0 : 1, //priority/niceness
+			             false, //is_write
+			             0  //start_deadline
+			            );
+		
+		pthread_mutex_lock(&gate_mtx);
+		gate_open = true;
+		pthread_cond_signal(&gate_cond);
+		pthread_mutex_unlock(&gate_mtx);
+		
+		msleep(300);
+		//query read + the merge reads covered by the initial full bucket. The rest must wait for tokens
+		assert(jobs_started>=2 && jobs_started<4);
+		assert(job_order[0]==3);
+		
+		msleep(2500);
+		assert(jobs_started==4);
+		
+		js.cleanup_finished_jobs();
+		IoSchedulerStatistics stats = js.query_io_statistics();
+		assert(stats.io_class[io_class_merge].job_count==3);
+		assert(stats.io_class[io_class_query].job_count==2); //the gate and the query read
+		assert(stats.io_class[io_class_merge].throttle_count>0);
+		
+		js.finalize();
+	}
+	
+	
+	printf("success\n");
+	return 0;
+}
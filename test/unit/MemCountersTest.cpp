@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include "MemCounters.h"
+#include <thread>
+#include <vector>
+#include <string.h>
+
+static int64_t getLabelAllocated(const char *label, int64_t *numAllocs) {
+	std::vector<MemCounters::LabelStats> stats(MemCounters::s_maxLabels);
+	int32_t n = MemCounters::getLabelStats(&stats[0], MemCounters::s_maxLabels);
+	for (int32_t i = 0; i < n; i++) {
+		if (strcmp(stats[i].m_label, label) == 0) {
+			*numAllocs = stats[i].m_numAllocs;
+			return stats[i].m_allocated;
+		}
+	}
+	*numAllocs = 0;
+	return 0;
+}
+
+TEST(MemCountersTest, LabelId) {
+	uint16_t a = MemCounters::getLabelId("mctest-a");
+	uint16_t b = MemCounters::getLabelId("mctest-b");
+	EXPECT_NE(a, b);
+	EXPECT_EQ(a, MemCounters::getLabelId("mctest-a"));
+
+	// same text in another buffer, and other text in the same buffer
+	char buf[32];
+	strcpy(buf, "mctest-a");
+	EXPECT_EQ(a, MemCounters::getLabelId(buf));
+	strcpy(buf, "mctest-c");
+	EXPECT_NE(a, MemCounters::getLabelId(buf));
+
+	// only the first 15 chars count
+	EXPECT_EQ(MemCounters::getLabelId("mctest-longlabel1"), MemCounters::getLabelId("mctest-longlabel2"));
+
+	char label[MemCounters::s_maxLabelLen + 1];
+	MemCounters::getLabel(b, label);
+	EXPECT_STREQ("mctest-b", label);
+}
+
+TEST(MemCountersTest, Threads) {
+	uint16_t churn = MemCounters::getLabelId("mctest-churn");
+	uint16_t kept = MemCounters::getLabelId("mctest-kept");
+
+	int64_t usedBefore;
+	MemCounters::getTotals(&usedBefore, NULL, NULL);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 32; t++) {
+		threads.emplace_back([churn, kept]() {
+			for (int i = 0; i < 10000; i++) {
+				MemCounters::addAlloc(churn, 100);
+				MemCounters::rmAlloc(churn, 100);
+			}
+			for (int i = 0; i < 100; i++) {
+				MemCounters::addAlloc(kept, 1000);
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	int64_t numAllocs;
+	EXPECT_EQ(0, getLabelAllocated("mctest-churn", &numAllocs));
+	EXPECT_EQ(0, numAllocs);
+	EXPECT_EQ(32 * 100 * 1000, getLabelAllocated("mctest-kept", &numAllocs));
+	EXPECT_EQ(32 * 100, numAllocs);
+
+	int64_t used;
+	MemCounters::getTotals(&used, NULL, NULL);
+	EXPECT_EQ(usedBefore + 32 * 100 * 1000, used);
+
+	for (int i = 0; i < 32 * 100; i++) {
+		MemCounters::rmAlloc(kept, 1000);
+	}
+	EXPECT_EQ(0, getLabelAllocated("mctest-kept", &numAllocs));
+}
+
+TEST(MemCountersTest, Samples) {
+	uint16_t labelId = MemCounters::getLabelId("mctest-sample");
+	int32_t numSamples = MemCounters::getNumSamples();
+
+	int data[100];
+	for (int i = 0; i < 100; i++) {
+		ASSERT_TRUE(MemCounters::addSample(&data[i], sizeof(int), labelId));
+	}
+	EXPECT_EQ(numSamples + 100, MemCounters::getNumSamples());
+
+	for (int i = 0; i < 100; i += 2) {
+		MemCounters::rmSample(&data[i]);
+	}
+
+	std::vector<MemCounters::Sample> samples(numSamples + 100);
+	int32_t n = MemCounters::getSamples(&samples[0], samples.size());
+	EXPECT_EQ(numSamples + 50, n);
+	int32_t found = 0;
+	for (int32_t i = 0; i < n; i++) {
+		if (samples[i].m_ptr >= (void *)&data[0] && samples[i].m_ptr < (void *)&data[100]) {
+			EXPECT_EQ(1, ((int *)samples[i].m_ptr - data) % 2);
+			EXPECT_EQ(labelId, samples[i].m_labelId);
+			EXPECT_GT(samples[i].m_numFrames, 0);
+			found++;
+		}
+	}
+	EXPECT_EQ(50, found);
+
+	for (int i = 1; i < 100; i += 2) {
+		MemCounters::rmSample(&data[i]);
+	}
+	EXPECT_EQ(numSamples, MemCounters::getNumSamples());
+}
+
+TEST(MemCountersTest, ShouldSample) {
+	EXPECT_FALSE(MemCounters::shouldSample(0));
+
+	int32_t count = 0;
+	for (int i = 0; i < 1000; i++) {
+		if (MemCounters::shouldSample(10)) {
+			count++;
+		}
+	}
+	EXPECT_EQ(100, count);
+}
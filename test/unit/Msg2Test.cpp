@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include "Msg2.h"
+#include "RdbCache.h"
+#include "RdbList.h"
+#include "Posdb.h"
+#include "Conf.h"
+#include "GigablastTestUtils.h"
+
+static const int64_t s_termId = 0x4321;
+
+TEST(Msg2Test, SharedTermlists) {
+	g_conf.m_bulkSearchTermlistCacheMem = 1000000;
+	ASSERT_TRUE(initSharedTermlistCache());
+
+	RdbList src;
+	GbTest::makePosdbList(&src, s_termId, 20);
+	addSharedTermlist(0, 7, s_termId, 0, MAX_DOCID, &src);
+
+	RdbList dst;
+	ASSERT_TRUE(getSharedTermlist(0, 7, s_termId, 0, MAX_DOCID, &dst));
+	ASSERT_EQ(src.getListSize(), dst.getListSize());
+	EXPECT_EQ(0, memcmp(src.getList(), dst.getList(), src.getListSize()));
+	EXPECT_EQ(0, KEYCMP(src.getStartKey(), dst.getStartKey(), sizeof(posdbkey_t)));
+	EXPECT_EQ(0, KEYCMP(src.getEndKey(), dst.getEndKey(), sizeof(posdbkey_t)));
+
+	// other file, docid range or collection
+	RdbList other;
+	EXPECT_FALSE(getSharedTermlist(0, 8, s_termId, 0, MAX_DOCID, &other));
+	EXPECT_FALSE(getSharedTermlist(0, 7, s_termId, 0, MAX_DOCID / 2, &other));
+	EXPECT_FALSE(getSharedTermlist(1, 7, s_termId, 0, MAX_DOCID, &other));
+
+	// gone after a merge of the collection's posdb files
+	{
+		RdbCacheLock rcl(g_sharedTermlistCache);
+		g_sharedTermlistCache.clear(0);
+	}
+	EXPECT_FALSE(getSharedTermlist(0, 7, s_termId, 0, MAX_DOCID, &other));
+
+	// resized or turned off while running
+	addSharedTermlist(0, 7, s_termId, 0, MAX_DOCID, &src);
+	g_conf.m_bulkSearchTermlistCacheMem = 2000000;
+	ASSERT_TRUE(initSharedTermlistCache());
+	EXPECT_TRUE(g_sharedTermlistCache.isInitialized());
+	EXPECT_FALSE(getSharedTermlist(0, 7, s_termId, 0, MAX_DOCID, &other));
+
+	g_conf.m_bulkSearchTermlistCacheMem = 0;
+	ASSERT_TRUE(initSharedTermlistCache());
+	EXPECT_FALSE(g_sharedTermlistCache.isInitialized());
+	EXPECT_FALSE(getSharedTermlist(0, 7, s_termId, 0, MAX_DOCID, &other));
+	addSharedTermlist(0, 7, s_termId, 0, MAX_DOCID, &src);
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include "PosdbTable.h"
+#include "TruncatedTermlists.h"
+#include "ScoringWeights.h"
+#include "BaseScoringParameters.h"
+#include "RdbList.h"
+#include "Posdb.h"
+#include "Lang.h"
+
+static const int64_t s_termId = 0x5678;
+
+// . docids 1..800, 100 per siterank from 15 down to 8
+// . all have the term in the body, the ones on the best sites in the title
+//   as well
+static void makeTermList(RdbList *list) {
+	list->set(nullptr, 0, nullptr, 0, Posdb::getFixedDataSize(), true, Posdb::getUseHalfKeys(), Posdb::getKeySize());
+	for (int docId = 1; docId <= 800; ++docId) {
+		int siteRank = 15 - (docId - 1) / 100;
+		char key[18];
+		if (siteRank >= 14) {
+			Posdb::makeKey(key, s_termId, docId, 2, MAXDENSITYRANK, 0, MAXWORDSPAMRANK, siteRank, HASHGROUP_TITLE, langEnglish, 0, false, false, false);
+			list->addRecord(key, 0, NULL);
+		}
+		Posdb::makeKey(key, s_termId, docId, 40, 20, 0, MAXWORDSPAMRANK, siteRank, HASHGROUP_BODY, langEnglish, 0, false, false, false);
+		list->addRecord(key, 0, NULL);
+	}
+}
+
+// the defaults of the ranking parms
+static void initScoringParameters(BaseScoringParameters *bsp) {
+	bsp->clear();
+	bsp->m_siteRankMultiplier = 0.333333;
+	bsp->m_diversityWeightMin = bsp->m_diversityWeightMax = 1.0;
+	bsp->m_densityWeightMin = 0.35;
+	bsp->m_densityWeightMax = 1.0;
+	bsp->m_hashGroupWeightBody = 1.0;
+	bsp->m_hashGroupWeightTitle = 8.0;
+	bsp->m_hashGroupWeightHeading = 1.5;
+	bsp->m_hashGroupWeightInlist = 0.3;
+	bsp->m_hashGroupWeightInMetaTag = 0.1;
+	bsp->m_hashGroupWeightInLinkText = 16.0;
+	bsp->m_hashGroupWeightInTag = 1.0;
+	bsp->m_hashGroupWeightNeighborhood = 0.0;
+	bsp->m_hashGroupWeightInternalLinkText = 4.0;
+	bsp->m_hashGroupWeightInUrl = 1.0;
+	bsp->m_hashGroupWeightInMenu = 0.2;
+	bsp->m_hashGroupWeightExplicitKeywords = 16.0;
+	bsp->m_hashGroupWeightMidDomain = 5.0;
+	bsp->m_hashGroupWeightLemma = 0.9;
+}
+
+TEST(PosdbTableTest, TruncatedTermlistsEarlyStop) {
+	BaseScoringParameters bsp;
+	initScoringParameters(&bsp);
+	DerivedScoringWeights weights;
+	weights.init(bsp);
+
+	// keep the 200 docids with a title hit
+	RdbList src;
+	makeTermList(&src);
+	RdbList dst;
+	int32_t maxDroppedSiteRank;
+	PostingsSummary droppedPostings;
+	ASSERT_TRUE(TruncatedTermlists::make_truncated_list(&src, 200, &dst, &maxDroppedSiteRank, &droppedPostings));
+	EXPECT_EQ(13, maxDroppedSiteRank);
+
+	// the last of the results we got: siterank 14, a title and a body hit
+	float titleHit = 100.0 * 8.0 * 8.0 * weights.m_densityWeights[MAXDENSITYRANK] * weights.m_densityWeights[MAXDENSITYRANK];
+	float bodyHit  = 100.0 * 1.0 * 1.0 * weights.m_densityWeights[20] * weights.m_densityWeights[20];
+	float minScore = (titleHit + bodyHit) * (14 * bsp.m_siteRankMultiplier + 1.0);
+
+	// the docids left out only have body hits, they can not beat it
+	float maxDroppedScore = PosdbTable::getMaxScoreForSiteRank(bsp, maxDroppedSiteRank, PosdbTable::getMaxSingleTermScore(droppedPostings, weights, 10));
+	EXPECT_LT(maxDroppedScore, minScore);
+
+	// but they could if they had the term in the title or the inlink text
+	PostingsSummary allPostings;
+	for (src.resetListPtr(); !src.isExhausted(); src.skipCurrentRecord()) {
+		char key[18];
+		src.getCurrentKey(key);
+		allPostings.add(key);
+	}
+	EXPECT_GT(PosdbTable::getMaxScoreForSiteRank(bsp, maxDroppedSiteRank, PosdbTable::getMaxSingleTermScore(allPostings, weights, 10)), minScore);
+
+	char key[18];
+	Posdb::makeKey(key, s_termId, 1000, 2, MAXDENSITYRANK, 0, 3, 8, HASHGROUP_INLINKTEXT, langEnglish, 0, false, false, false);
+	PostingsSummary inlinkPostings = droppedPostings;
+	inlinkPostings.add(key);
+	EXPECT_GT(PosdbTable::getMaxScoreForSiteRank(bsp, maxDroppedSiteRank, PosdbTable::getMaxSingleTermScore(inlinkPostings, weights, 10)), minScore);
+}
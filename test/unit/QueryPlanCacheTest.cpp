@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include "QueryPlanCache.h"
+#include "Query.h"
+#include "Mem.h"
+
+static Query *makeQuery(const char *queryStr) {
+	Query *q = new Query();
+	mnew(q, sizeof(Query), "queryplan");
+	EXPECT_TRUE(q->set(queryStr, langEnglish, 1.0, 1.0, nullptr, false, true, ABS_MAX_QUERY_TERMS));
+	return q;
+}
+
+TEST(QueryPlanCacheTest, CheckinCheckout) {
+	QueryPlanCache cache;
+	cache.configure(60000, 10);
+
+	EXPECT_EQ(NULL, cache.checkout(1, "hello world"));
+
+	Query *q = makeQuery("hello world");
+	int32_t numTerms = q->getNumTerms();
+	cache.checkin(1, q);
+	EXPECT_EQ(1U, cache.size());
+
+	// a query is only handed out once
+	Query *q2 = cache.checkout(1, "hello world");
+	EXPECT_EQ(q, q2);
+	EXPECT_EQ(numTerms, q2->getNumTerms());
+	EXPECT_EQ(0U, cache.size());
+	EXPECT_EQ(NULL, cache.checkout(1, "hello world"));
+
+	cache.checkin(1, q2);
+	EXPECT_EQ(1U, cache.size());
+}
+
+TEST(QueryPlanCacheTest, DifferentQuery) {
+	QueryPlanCache cache;
+	cache.configure(60000, 10);
+
+	cache.checkin(1, makeQuery("hello world"));
+	// same key but not the same query string
+	EXPECT_EQ(NULL, cache.checkout(1, "hello there"));
+	EXPECT_EQ(0U, cache.size());
+}
+
+TEST(QueryPlanCacheTest, Duplicate) {
+	QueryPlanCache cache;
+	cache.configure(60000, 10);
+
+	Query *q = makeQuery("hello world");
+	cache.checkin(1, q);
+	// another msg39 parsed the same query meanwhile
+	cache.checkin(1, makeQuery("hello world"));
+	EXPECT_EQ(1U, cache.size());
+	EXPECT_EQ(q, cache.checkout(1, "hello world"));
+	cache.checkin(1, q);
+}
+
+TEST(QueryPlanCacheTest, Maxed) {
+	QueryPlanCache cache;
+	cache.configure(60000, 5);
+
+	for (int64_t key = 1; key <= 10; key++) {
+		cache.checkin(key, makeQuery("hello world"));
+	}
+	EXPECT_EQ(5U, cache.size());
+}
+
+TEST(QueryPlanCacheTest, Disabled) {
+	QueryPlanCache cache;
+	cache.configure(60000, 0);
+
+	cache.checkin(1, makeQuery("hello world"));
+	EXPECT_EQ(0U, cache.size());
+	EXPECT_EQ(NULL, cache.checkout(1, "hello world"));
+}
+
+TEST(QueryPlanCacheTest, Expired) {
+	QueryPlanCache cache;
+	cache.configure(1000, 10);
+
+	cache.checkin(1, makeQuery("hello world"));
+	sleep(2);
+	EXPECT_EQ(NULL, cache.checkout(1, "hello world"));
+	EXPECT_EQ(0U, cache.size());
+}
@@ -162,3 +162,73 @@ TEST(RdbBucketsTest, PosdbAddDuplicateNode) {
 	expectRecord(&list, 2, docId);
 	EXPECT_TRUE(list.isExhausted());
 }
+
+TEST(RdbBucketsTest, PosdbSwap) {
+	static const int64_t docId = 1;
+	RdbBuckets active;
+	active.set(Posdb::getFixedDataSize(), 1024 * 1024, "test-posdb", RDB_POSDB, "posdb", Posdb::getKeySize());
+	RdbBuckets snapshot;
+	snapshot.set(Posdb::getFixedDataSize(), 1024 * 1024, "test-posdb", RDB_POSDB, "posdb", Posdb::getKeySize());
+
+	for (int i = 0; i < 1000; i++) {
+		addPosdbKey(&active, i, docId);
+	}
+
+	active.swap(&snapshot);
+	EXPECT_EQ(0, active.getNumKeys());
+	EXPECT_EQ(1000, snapshot.getNumKeys());
+
+	// both must still be usable after the swap
+	addPosdbKey(&active, 2000, docId);
+	addPosdbKey(&snapshot, 3000, docId);
+
+	const char *startKey = KEYMIN();
+	const char *endKey = KEYMAX();
+	int32_t numPosRecs  = 0;
+	int32_t numNegRecs = 0;
+
+	RdbList list;
+	active.getList(0, startKey, endKey, -1, &list, &numPosRecs, &numNegRecs, Posdb::getUseHalfKeys());
+	expectRecord(&list, 2000, docId);
+	EXPECT_TRUE(list.isExhausted());
+
+	snapshot.getList(0, startKey, endKey, -1, &list, &numPosRecs, &numNegRecs, Posdb::getUseHalfKeys());
+	for (int i = 0; i < 1000; i++) {
+		expectRecord(&list, i, docId);
+	}
+	expectRecord(&list, 3000, docId);
+	EXPECT_TRUE(list.isExhausted());
+}
+
+TEST(RdbBucketsTest, PosdbRestoreSnapshot) {
+	static const int64_t docId = 1;
+	RdbBuckets active;
+	active.set(Posdb::getFixedDataSize(), 1024 * 1024, "test-posdb", RDB_POSDB, "posdb", Posdb::getKeySize());
+	RdbBuckets snapshot;
+	snapshot.set(Posdb::getFixedDataSize(), 1024 * 1024, "test-posdb", RDB_POSDB, "posdb", Posdb::getKeySize());
+
+	addPosdbKey(&active, 1, docId);
+	addPosdbKey(&active, 2, docId);
+	addPosdbKey(&active, 3, docId);
+	active.swap(&snapshot);
+
+	// newer records override the snapshot
+	addPosdbKey(&active, 2, docId, true);
+	addPosdbKey(&active, 4, docId);
+
+	EXPECT_TRUE(snapshot.restoreSnapshot(&active));
+	EXPECT_EQ(0, snapshot.getNumKeys());
+
+	const char *startKey = KEYMIN();
+	const char *endKey = KEYMAX();
+	int32_t numPosRecs  = 0;
+	int32_t numNegRecs = 0;
+
+	RdbList list;
+	active.getList(0, startKey, endKey, -1, &list, &numPosRecs, &numNegRecs, Posdb::getUseHalfKeys());
+	expectRecord(&list, 1, docId);
+	expectRecord(&list, 2, docId, true);
+	expectRecord(&list, 3, docId);
+	expectRecord(&list, 4, docId);
+	EXPECT_TRUE(list.isExhausted());
+}
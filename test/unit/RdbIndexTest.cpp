@@ -3,6 +3,7 @@
 #include "RdbBuckets.h"
 #include "Posdb.h"
 #include "GigablastTestUtils.h"
+#include "Conf.h"
 
 static uint64_t getDocId(docidsconst_ptr_t docIds, size_t index) {
 	return ((*docIds.get())[index] >> RdbIndex::s_docIdOffset);
@@ -257,3 +258,137 @@ TEST(RdbIndexTest, DeleteAddKeySave) {
 	// cleanup
 	index.unlink();
 }
+
+TEST(RdbIndexTest, DocIdSetLookupIterate) {
+	docids_t entries;
+	for (uint64_t docId = 3; docId < 10000; docId += 7) {
+		entries.push_back((docId << RdbIndex::s_docIdOffset) | (docId % 2));
+	}
+
+	RdbIndexDocIdSet docIdSet(entries);
+	EXPECT_EQ(entries.size(), docIdSet.size());
+	EXPECT_GT(docIdSet.getNumPartitions(), 1);
+
+	for (uint64_t docId = 0; docId < 10010; ++docId) {
+		uint64_t entry = 0;
+		bool expected = (docId >= 3 && docId < 10000 && (docId - 3) % 7 == 0);
+		EXPECT_EQ(expected, docIdSet.find(docId, &entry));
+		if (expected) {
+			EXPECT_EQ((docId << RdbIndex::s_docIdOffset) | (docId % 2), entry);
+		}
+	}
+
+	docids_t decoded;
+	docIdSet.getDocIds(&decoded);
+	EXPECT_EQ(entries, decoded);
+
+	// range iteration
+	RdbIndexDocIdSet::Iterator it = docIdSet.begin(5000);
+	ASSERT_FALSE(it.isExhausted());
+	EXPECT_EQ(5002, it.getDocId());
+	it.next();
+	EXPECT_EQ(5009, it.getDocId());
+
+	it.skipTo(9000);
+	EXPECT_EQ(9003, it.getDocId());
+	EXPECT_EQ(9003 % 2 == 0, it.isDelete());
+
+	it.skipTo(10000);
+	EXPECT_TRUE(it.isExhausted());
+}
+
+TEST(RdbIndexTest, DocIdSetMerge) {
+	docids_t entries;
+	for (uint64_t docId = 0; docId < 1000; docId += 2) {
+		entries.push_back(docId << RdbIndex::s_docIdOffset);
+	}
+
+	RdbIndexDocIdSet docIdSet(entries);
+	uint64_t numPartitions = docIdSet.getNumPartitions();
+
+	// odd docIds into the first partition only, and replace docId 10 with a positive key
+	docids_t newEntries;
+	for (uint64_t docId = 1; docId < 20; docId += 2) {
+		newEntries.push_back(docId << RdbIndex::s_docIdOffset);
+		if (docId == 9) {
+			newEntries.push_back((10 << RdbIndex::s_docIdOffset) | RdbIndex::s_delBitMask);
+		}
+	}
+
+	std::unique_ptr<RdbIndexDocIdSet> merged(RdbIndexDocIdSet::merge(docIdSet, newEntries));
+	EXPECT_EQ(entries.size() + 10, merged->size());
+	EXPECT_EQ(numPartitions + 1, merged->getNumPartitions());
+
+	// the other partitions are copied as they are
+	size_t oldTableSize = numPartitions * RdbIndexDocIdSet::s_partitionEntrySize;
+	size_t newTableSize = merged->getNumPartitions() * RdbIndexDocIdSet::s_partitionEntrySize;
+	size_t oldDeltasSize = docIdSet.getDataSize() - oldTableSize;
+	EXPECT_EQ(0, memcmp(docIdSet.getData() + docIdSet.getDataSize() - oldDeltasSize / 2,
+	                    merged->getData() + merged->getDataSize() - oldDeltasSize / 2,
+	                    oldDeltasSize / 2));
+	EXPECT_LT(newTableSize, merged->getDataSize());
+
+	for (uint64_t docId = 0; docId < 1000; ++docId) {
+		uint64_t entry = 0;
+		bool expected = (docId % 2 == 0 || docId < 20);
+		EXPECT_EQ(expected, merged->find(docId, &entry));
+		if (expected) {
+			EXPECT_EQ(docId == 10, (entry & RdbIndex::s_delBitMask) != 0);
+		}
+	}
+
+	// serialized form can be used again
+	RdbIndexDocIdSet copy;
+	ASSERT_TRUE(copy.set(merged->size(), merged->getNumPartitions(), merged->getData(), merged->getDataSize()));
+	docids_t decoded, expected;
+	merged->getDocIds(&expected);
+	copy.getDocIds(&decoded);
+	EXPECT_EQ(expected, decoded);
+
+	RdbIndexDocIdSet::Iterator it = copy.begin(15);
+	EXPECT_EQ(15, it.getDocId());
+	it.skipTo(21);
+	EXPECT_EQ(22, it.getDocId());
+}
+
+TEST(RdbIndexTest, SaveReadMapped) {
+	static const int64_t termId = 1;
+	static const int total_records = 1000;
+
+	{
+		RdbIndex index;
+		index.set(".", "test-posdbidx", Posdb::getFixedDataSize(), Posdb::getUseHalfKeys(), Posdb::getKeySize(), RDB_POSDB, false);
+		for (int i = 0; i < total_records; ++i) {
+			GbTest::addPosdbKey(&index, termId, i * 2, 0);
+		}
+		index.writeIndex(true);
+	}
+
+	g_conf.m_mmapRdbIndexes = true;
+
+	RdbIndex index;
+	index.set(".", "test-posdbidx", Posdb::getFixedDataSize(), Posdb::getUseHalfKeys(), Posdb::getKeySize(), RDB_POSDB, false);
+	ASSERT_TRUE(index.readIndex());
+	EXPECT_TRUE(index.verifyIndex());
+	EXPECT_TRUE(index.getDocIdSet()->isMapped());
+	EXPECT_EQ(total_records, index.getDocIdSet()->size());
+
+	for (int i = 0; i < total_records * 2; ++i) {
+		EXPECT_EQ((i % 2) == 0, index.exist(i));
+	}
+
+	// keep the mapped set alive while the file is rewritten
+	auto oldDocIds = index.getDocIdSet();
+	GbTest::addPosdbKey(&index, termId, total_records * 2 + 1, 0);
+	EXPECT_TRUE(index.exist(total_records * 2 + 1));
+	ASSERT_TRUE(index.writeIndex(true));
+
+	EXPECT_EQ(total_records, oldDocIds->size());
+	EXPECT_TRUE(oldDocIds->exist((total_records - 1) * 2));
+	EXPECT_EQ(total_records + 1, index.getDocIdSet()->size());
+
+	g_conf.m_mmapRdbIndexes = false;
+
+	// cleanup
+	index.unlink();
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include "RdbMap.h"
+#include "BigFile.h"
+#include "Conf.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+static const int32_t s_recSize = sizeof(key96_t);
+
+static key96_t makeKey(int64_t i) {
+	key96_t k;
+	k.n1 = (uint32_t)(i >> 40);
+	k.n0 = ((uint64_t)i << 1) | 0x01;
+	return k;
+}
+
+// build a map over a (sparse) data file spanning a few segments
+static void createMap(int32_t numRecs) {
+	RdbMap map;
+	map.set(".", "rdbmaptest.map", 0, false, sizeof(key96_t), GB_INDEXDB_PAGE_SIZE);
+
+	for (int32_t i = 0; i < numRecs; ++i) {
+		key96_t k = makeKey(i);
+		ASSERT_TRUE(map.addRecord((char *)&k, (char *)&k, s_recSize));
+	}
+	ASSERT_TRUE(map.writeMap(false));
+
+	int fd = open("rdbmaptest.dat", O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ASSERT_TRUE(fd >= 0);
+	ASSERT_EQ(0, ftruncate(fd, map.getFileSize()));
+	close(fd);
+}
+
+static void loadMap(RdbMap *map, BigFile *dataFile, bool useMmap) {
+	g_conf.m_mmapRdbMaps = useMmap;
+	map->set(".", "rdbmaptest.map", 0, false, sizeof(key96_t), GB_INDEXDB_PAGE_SIZE);
+	ASSERT_TRUE(map->readMap(dataFile));
+}
+
+static void removeFiles() {
+	unlink("rdbmaptest.map");
+	unlink("rdbmaptest.dat");
+}
+
+TEST(RdbMapTest, MappedMatchesRead) {
+	int32_t recsPerSegment = (PAGES_PER_SEGMENT * GB_INDEXDB_PAGE_SIZE) / s_recSize;
+	int32_t numRecs = recsPerSegment * 5 / 2;
+	createMap(numRecs);
+
+	BigFile dataFile;
+	dataFile.set(".", "rdbmaptest.dat");
+
+	RdbMap readMap;
+	loadMap(&readMap, &dataFile, false);
+	RdbMap mappedMap;
+	loadMap(&mappedMap, &dataFile, true);
+
+	EXPECT_EQ(readMap.getNumPages(), mappedMap.getNumPages());
+	EXPECT_EQ(readMap.getFileSize(), mappedMap.getFileSize());
+	EXPECT_EQ(numRecs, mappedMap.getNumRecs());
+
+	// only the partial last segment lives on the heap
+	EXPECT_LT(mappedMap.getMemAllocated(), readMap.getMemAllocated());
+
+	for (int32_t i = 0; i < numRecs; i += 97) {
+		key96_t k = makeKey(i);
+		int32_t page = mappedMap.getPage((const char *)&k);
+		EXPECT_EQ(readMap.getPage((const char *)&k), page);
+		// record i starts on that page
+		EXPECT_EQ((int64_t)i * s_recSize / GB_INDEXDB_PAGE_SIZE, page);
+	}
+
+	// past the last key
+	key96_t k = makeKey(numRecs);
+	EXPECT_EQ(mappedMap.getNumPages(), mappedMap.getPage((const char *)&k));
+
+	g_conf.m_mmapRdbMaps = false;
+	removeFiles();
+}
+
+TEST(RdbMapTest, MappedWriteBack) {
+	int32_t recsPerSegment = (PAGES_PER_SEGMENT * GB_INDEXDB_PAGE_SIZE) / s_recSize;
+	int32_t numRecs = recsPerSegment * 2;
+	createMap(numRecs);
+
+	BigFile dataFile;
+	dataFile.set(".", "rdbmaptest.dat");
+
+	// resume adding to a mapped map and save it over its own file
+	{
+		RdbMap map;
+		loadMap(&map, &dataFile, true);
+		for (int32_t i = numRecs; i < numRecs + recsPerSegment; ++i) {
+			key96_t k = makeKey(i);
+			ASSERT_TRUE(map.addRecord((char *)&k, (char *)&k, s_recSize));
+		}
+		ASSERT_TRUE(map.writeMap(false));
+
+		int fd = open("rdbmaptest.dat", O_RDWR);
+		ASSERT_TRUE(fd >= 0);
+		ASSERT_EQ(0, ftruncate(fd, map.getFileSize()));
+		close(fd);
+	}
+
+	RdbMap map;
+	loadMap(&map, &dataFile, true);
+	EXPECT_EQ(numRecs + recsPerSegment, map.getNumRecs());
+
+	key96_t k = makeKey(numRecs + 1);
+	EXPECT_EQ((int64_t)(numRecs + 1) * s_recSize / GB_INDEXDB_PAGE_SIZE, map.getPage((const char *)&k));
+
+	g_conf.m_mmapRdbMaps = false;
+	removeFiles();
+}
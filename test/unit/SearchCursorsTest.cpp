@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "SearchCursors.h"
+
+static const int32_t s_numDocIds = 30;
+
+static uint64_t storeResults(SearchCursors *cursors, uint64_t token, int32_t numDocIds, bool more) {
+	int64_t docIds[s_numDocIds];
+	double scores[s_numDocIds];
+	unsigned flags[s_numDocIds];
+	for (int32_t i = 0; i < numDocIds; ++i) {
+		docIds[i] = 1000 + i;
+		scores[i] = 100.0 - i;
+		flags[i] = 0;
+	}
+	return cursors->store(token, 0, 0x1234, docIds, scores, flags, numDocIds, 12345, 1.0, more);
+}
+
+TEST(SearchCursorsTest, StoreLookup) {
+	SearchCursors cursors;
+	cursors.configure(60000, 10);
+
+	uint64_t token = storeResults(&cursors, 0, s_numDocIds, true);
+	ASSERT_NE(0U, token);
+	EXPECT_EQ(1U, cursors.size());
+
+	SearchCursors::Slice slice;
+	ASSERT_TRUE(cursors.lookup(token, 0, 0x1234, 10, 11, &slice));
+	ASSERT_EQ(11U, slice.docids.size());
+	EXPECT_EQ(1010, slice.docids[0]);
+	EXPECT_EQ(90.0, slice.scores[0]);
+	EXPECT_EQ(1020, slice.docids[10]);
+	EXPECT_EQ(12345, slice.num_total_hits);
+
+	// other collection or query
+	EXPECT_FALSE(cursors.lookup(token, 1, 0x1234, 10, 11, &slice));
+	EXPECT_FALSE(cursors.lookup(token, 0, 0x4321, 10, 11, &slice));
+	EXPECT_FALSE(cursors.lookup(token + 1, 0, 0x1234, 10, 11, &slice));
+}
+
+TEST(SearchCursorsTest, PastTheEnd) {
+	SearchCursors cursors;
+	cursors.configure(60000, 10);
+
+	// more results follow so the cursor cannot give this page
+	uint64_t token = storeResults(&cursors, 0, s_numDocIds, true);
+	SearchCursors::Slice slice;
+	EXPECT_FALSE(cursors.lookup(token, 0, 0x1234, 25, 11, &slice));
+
+	// storing deeper results keeps the token
+	EXPECT_EQ(token, storeResults(&cursors, token, s_numDocIds, false));
+	ASSERT_TRUE(cursors.lookup(token, 0, 0x1234, 25, 11, &slice));
+	EXPECT_EQ(5U, slice.docids.size());
+	ASSERT_TRUE(cursors.lookup(token, 0, 0x1234, 40, 11, &slice));
+	EXPECT_EQ(0U, slice.docids.size());
+}
+
+TEST(SearchCursorsTest, Limits) {
+	SearchCursors cursors;
+
+	cursors.configure(60000, 0);
+	EXPECT_EQ(0U, storeResults(&cursors, 0, s_numDocIds, false));
+
+	cursors.configure(60000, 2);
+	// we hand out the tokens
+	uint64_t token1 = storeResults(&cursors, 42, s_numDocIds, false);
+	EXPECT_NE(0U, token1);
+	EXPECT_NE(42U, token1);
+	uint64_t token2 = storeResults(&cursors, 0, s_numDocIds, false);
+	uint64_t token3 = storeResults(&cursors, 0, s_numDocIds, false);
+	EXPECT_EQ(2U, cursors.size());
+
+	SearchCursors::Slice slice;
+	EXPECT_TRUE(cursors.lookup(token3, 0, 0x1234, 0, 10, &slice));
+	EXPECT_TRUE(cursors.lookup(token1, 0, 0x1234, 0, 10, &slice) != cursors.lookup(token2, 0, 0x1234, 0, 10, &slice));
+
+	// expired
+	cursors.configure(-1, 2);
+	EXPECT_FALSE(cursors.lookup(token3, 0, 0x1234, 0, 10, &slice));
+}
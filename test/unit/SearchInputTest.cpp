@@ -0,0 +1,34 @@
+#include <gtest/gtest.h>
+#include "SearchInput.h"
+#include "Parms.h"
+
+TEST(SearchInputTest, ResultSetHash) {
+	g_parms.init();
+
+	SearchInput si;
+	si.clear();
+	si.m_query = "foo bar";
+	uint64_t h = si.getResultSetHash();
+
+	// paging and output parms do not change the results
+	si.m_firstResultNum = 100;
+	si.m_docsWanted = 50;
+	si.m_titleMaxLen = 30;
+	EXPECT_EQ(h, si.getResultSetHash());
+
+	si.m_doSiteClustering = !si.m_doSiteClustering;
+	EXPECT_NE(h, si.getResultSetHash());
+	si.m_doSiteClustering = !si.m_doSiteClustering;
+	EXPECT_EQ(h, si.getResultSetHash());
+
+	si.m_fx_qlang = "de";
+	EXPECT_NE(h, si.getResultSetHash());
+	si.m_fx_qlang = nullptr;
+
+	si.m_baseScoringParameters.m_flagRankAdjustment[3] += 1;
+	EXPECT_NE(h, si.getResultSetHash());
+	si.m_baseScoringParameters.m_flagRankAdjustment[3] -= 1;
+
+	si.m_query = "foo baz";
+	EXPECT_NE(h, si.getResultSetHash());
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include "SerpWriter.h"
+#include "SafeBuf.h"
+#include "GbFormat.h"
+#include <string>
+
+static std::string str(const SafeBuf &sb) {
+	return std::string(sb.getBufStart(), sb.length());
+}
+
+TEST(SerpWriterTest, FormatInt) {
+	char buf[20];
+	EXPECT_EQ("0", std::string(buf, SerpWriter::formatInt(0, buf)));
+	EXPECT_EQ("7", std::string(buf, SerpWriter::formatInt(7, buf)));
+	EXPECT_EQ("-42", std::string(buf, SerpWriter::formatInt(-42, buf)));
+	EXPECT_EQ("4294967295", std::string(buf, SerpWriter::formatInt(4294967295LL, buf)));
+	EXPECT_EQ("9223372036854775807", std::string(buf, SerpWriter::formatInt(INT64_MAX, buf)));
+	EXPECT_EQ("-9223372036854775808", std::string(buf, SerpWriter::formatInt(INT64_MIN, buf)));
+}
+
+TEST(SerpWriterTest, Xml) {
+	SafeBuf sb;
+	SerpWriter sw(&sb, FORMAT_XML);
+	sw.intField("docId", 123456789012LL);
+	sw.floatField("docScore", 1.5);
+	sw.boolField("isAdult", false);
+	sw.stringField("title", "a]]>b");
+	sw.stringField("sum", NULL);
+	sw.verbatimField("contentType", "html");
+	sw.tokenField("langAbbr", "en");
+	EXPECT_EQ("\t\t<docId>123456789012</docId>\n"
+	          "\t\t<docScore>1.500000</docScore>\n"
+	          "\t\t<isAdult>0</isAdult>\n"
+	          "\t\t<title><![CDATA[a]]&gt;b]]></title>\n"
+	          "\t\t<sum><![CDATA[]]></sum>\n"
+	          "\t\t<contentType><![CDATA[html]]></contentType>\n"
+	          "\t\t<langAbbr>en</langAbbr>\n",
+	          str(sb));
+}
+
+TEST(SerpWriterTest, Json) {
+	SafeBuf sb;
+	SerpWriter sw(&sb, FORMAT_JSON);
+	sw.intField("docId", 123456789012LL);
+	sw.floatField("docScore", 1.5);
+	sw.boolField("isAdult", true);
+	sw.stringField("title", "a\"b\n");
+	sw.stringField("url", "example.com/abc", 11);
+	sw.verbatimField("site", NULL, -1);
+	sw.tokenField("langAbbr", "en");
+	EXPECT_EQ("\t\t\"docId\":123456789012,\n"
+	          "\t\t\"docScore\":1.500000,\n"
+	          "\t\t\"isAdult\":true,\n"
+	          "\t\t\"title\":\"a\\\"b\\n\",\n"
+	          "\t\t\"url\":\"example.com\",\n"
+	          "\t\t\"site\":\"\",\n"
+	          "\t\t\"langAbbr\":\"en\",\n",
+	          str(sb));
+}
+
+TEST(SerpWriterTest, BufferPool) {
+	SerpBufferPool pool;
+	pool.configure(2, 100000);
+
+	SafeBuf sb1;
+	ASSERT_TRUE(pool.acquire(&sb1, 1000));
+	EXPECT_GE(sb1.getCapacity(), 1000);
+	sb1.safeStrcpy("hello");
+	const char *buf1 = sb1.getBufStart();
+
+	// the buffer comes back empty to the next one asking
+	pool.release(&sb1);
+	EXPECT_EQ(0, sb1.getCapacity());
+	EXPECT_EQ(1U, pool.size());
+
+	SafeBuf sb2;
+	ASSERT_TRUE(pool.acquire(&sb2, 500));
+	EXPECT_EQ(buf1, sb2.getBufStart());
+	EXPECT_EQ(0, sb2.length());
+	EXPECT_EQ(0U, pool.size());
+
+	// too big to keep
+	ASSERT_TRUE(sb2.reserve(200000));
+	pool.release(&sb2);
+	EXPECT_EQ(0U, pool.size());
+
+	// no more reserved than we would keep
+	SafeBuf sb3;
+	ASSERT_TRUE(pool.acquire(&sb3, 10000000));
+	EXPECT_GE(sb3.getCapacity(), 100000);
+	EXPECT_LT(sb3.getCapacity(), 10000000);
+	pool.release(&sb3);
+	EXPECT_EQ(1U, pool.size());
+
+	// a smaller max size throws out the buffers that are too big now
+	pool.configure(2, 1000);
+	EXPECT_EQ(0U, pool.size());
+}
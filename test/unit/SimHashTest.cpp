@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include "SimHash.h"
+#include "hash.h"
+
+static uint64_t makeSimHash(int32_t numFeatures, int32_t firstChanged = -1, int32_t numChanged = 0) {
+	SimHash sh;
+	for (int32_t i = 0; i < numFeatures; i++) {
+		uint64_t feature = hash64((uint64_t)i, 0x1234567ULL);
+		if (i >= firstChanged && i < firstChanged + numChanged) {
+			feature = hash64((uint64_t)i, 0x7654321ULL);
+		}
+		sh.addFeature(feature);
+	}
+	return sh.getSimHash();
+}
+
+TEST(SimHashTest, Empty) {
+	SimHash sh;
+	EXPECT_EQ(0, sh.getNumFeatures());
+	// 0 means no simhash
+	EXPECT_NE(0ULL, sh.getSimHash());
+}
+
+TEST(SimHashTest, Distance) {
+	EXPECT_EQ(0, SimHash::getDistance(0x1234ULL, 0x1234ULL));
+	EXPECT_EQ(1, SimHash::getDistance(0x1234ULL, 0x1235ULL));
+	EXPECT_EQ(64, SimHash::getDistance(0ULL, ~0ULL));
+}
+
+TEST(SimHashTest, NearDuplicates) {
+	uint64_t h = makeSimHash(1000);
+	EXPECT_EQ(h, makeSimHash(1000));
+
+	// a few changed features only flip a few bits
+	EXPECT_LE(SimHash::getDistance(h, makeSimHash(1000, 500, 5)), SIMHASH_MAX_DISTANCE);
+
+	// a different document is about 32 bits away
+	EXPECT_GT(SimHash::getDistance(h, makeSimHash(1000, 0, 1000)), 16);
+}
+
+TEST(SimHashTest, BandKey) {
+	uint64_t h = 0x0123456789abcdefULL;
+	EXPECT_EQ(0x0000cdefULL, SimHash::getBandKey(h, 0));
+	EXPECT_EQ(0x000189abULL, SimHash::getBandKey(h, 1));
+	EXPECT_EQ(0x00024567ULL, SimHash::getBandKey(h, 2));
+	EXPECT_EQ(0x00030123ULL, SimHash::getBandKey(h, 3));
+
+	// within SIMHASH_MAX_DISTANCE bits at least one band is the same
+	uint64_t h2 = h ^ 0x0001000100010000ULL;
+	int32_t numSame = 0;
+	for (int32_t b = 0; b < SIMHASH_NUM_BANDS; b++) {
+		if (SimHash::getBandKey(h, b) == SimHash::getBandKey(h2, b)) {
+			numSame++;
+		}
+	}
+	EXPECT_EQ(1, numSame);
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "SpiderPrefetch.h"
+#include "Conf.h"
+#include "SafeBuf.h"
+#include "fctypes.h"
+
+class TestSpiderPrefetch : public SpiderPrefetch {
+public:
+	using SpiderPrefetch::addState;
+	using SpiderPrefetch::gotTagRec;
+	using SpiderPrefetch::doneLookup;
+	using SpiderPrefetch::purge;
+};
+
+class SpiderPrefetchTest : public ::testing::Test {
+protected:
+	void SetUp() {
+		m_savedMaxUrls = g_conf.m_spiderPrefetchMaxUrls;
+		g_conf.m_spiderPrefetchMaxUrls = 2;
+	}
+
+	void TearDown() {
+		g_conf.m_spiderPrefetchMaxUrls = m_savedMaxUrls;
+	}
+
+	int32_t m_savedMaxUrls;
+};
+
+TEST_F(SpiderPrefetchTest, PendingUntilTagRec) {
+	TestSpiderPrefetch prefetch;
+	const char *url = "http://www.example.test/index.html";
+	int64_t now = gettimeofdayInMilliseconds();
+
+	auto st = prefetch.addState(url, 0, now);
+	ASSERT_TRUE(st != NULL);
+	EXPECT_EQ(1, prefetch.getNumOutstanding());
+
+	// the same url is only looked up once
+	EXPECT_TRUE(prefetch.addState(url, 0, now) == NULL);
+	EXPECT_EQ(1, prefetch.getNumUrls());
+
+	// launches wait for it, but not forever
+	EXPECT_TRUE(prefetch.isPending(url, 0, now));
+	EXPECT_FALSE(prefetch.isPending(url, 0, now + 3600000));
+	EXPECT_FALSE(prefetch.isPending(url, 1, now));
+	EXPECT_FALSE(prefetch.isPending("http://www.example.test/other.html", 0, now));
+
+	SafeBuf sb;
+	EXPECT_FALSE(prefetch.getTagRec(url, 0, now, &sb));
+
+	prefetch.gotTagRec(st);
+	EXPECT_EQ(0, prefetch.getNumOutstanding());
+	EXPECT_FALSE(prefetch.isPending(url, 0, now));
+
+	// the tagrec is handed out once
+	now = gettimeofdayInMilliseconds();
+	EXPECT_TRUE(prefetch.getTagRec(url, 0, now, &sb));
+	EXPECT_EQ(0, prefetch.getNumUrls());
+	EXPECT_FALSE(prefetch.getTagRec(url, 0, now, &sb));
+}
+
+TEST_F(SpiderPrefetchTest, StaleTagRec) {
+	TestSpiderPrefetch prefetch;
+	const char *url = "http://www.example.test/index.html";
+	int64_t now = gettimeofdayInMilliseconds();
+
+	auto st = prefetch.addState(url, 0, now);
+	ASSERT_TRUE(st != NULL);
+	prefetch.gotTagRec(st);
+
+	// too old to trust
+	SafeBuf sb;
+	EXPECT_FALSE(prefetch.getTagRec(url, 0, gettimeofdayInMilliseconds() + 3600000, &sb));
+
+	prefetch.purge(gettimeofdayInMilliseconds() + 3600000);
+	EXPECT_EQ(0, prefetch.getNumUrls());
+}
+
+TEST_F(SpiderPrefetchTest, Full) {
+	TestSpiderPrefetch prefetch;
+	int64_t now = gettimeofdayInMilliseconds();
+
+	auto st1 = prefetch.addState("http://a.example.test/", 0, now);
+	auto st2 = prefetch.addState("http://b.example.test/", 0, now);
+	ASSERT_TRUE(st1 != NULL);
+	ASSERT_TRUE(st2 != NULL);
+	EXPECT_TRUE(prefetch.addState("http://c.example.test/", 0, now) == NULL);
+
+	// urls with lookups out are never purged
+	prefetch.purge(now + 3600000);
+	EXPECT_EQ(2, prefetch.getNumUrls());
+
+	prefetch.gotTagRec(st1);
+	auto st3 = prefetch.addState("http://c.example.test/", 0, now + 3600000);
+	ASSERT_TRUE(st3 != NULL);
+	EXPECT_EQ(2, prefetch.getNumUrls());
+
+	prefetch.gotTagRec(st2);
+	prefetch.gotTagRec(st3);
+}
+
+TEST_F(SpiderPrefetchTest, Disabled) {
+	TestSpiderPrefetch prefetch;
+	g_conf.m_spiderPrefetchMaxUrls = 0;
+	EXPECT_TRUE(prefetch.addState("http://www.example.test/", 0, gettimeofdayInMilliseconds()) == NULL);
+	EXPECT_EQ(0, prefetch.getNumUrls());
+}
@@ -0,0 +1,260 @@
+#include <gtest/gtest.h>
+
+#include "SummaryStore.h"
+#include "Summary.h"
+#include "HttpMime.h" // CT_HTML
+#include "Xml.h"
+#include "tokenizer.h"
+#include "Phrases.h"
+#include "Sections.h"
+#include "Pos.h"
+#include "Query.h"
+#include "Url.h"
+#include "Matches.h"
+#include "Linkdb.h"
+#include "Title.h"
+#include "SafeBuf.h"
+#include <cstdio>
+
+#define MAX_BUF_SIZE 2048
+#define HTML_FORMAT "<html><head>%s</head><body>%s</body></html>"
+
+static const char *s_body =
+	"<script>var s = 'summary scripts are skipped';</script>"
+	"<div><p>The quick brown fox jumps over the lazy dog &amp; the cat.</p>"
+	"<p>Foxes are small omnivorous mammals. A fox lives in a den.</p>"
+	"<ul><li>Red fox</li><li>Arctic fox</li></ul></div>";
+
+static void buildStore(SafeBuf *sb, char *htmlInput, const char *urlStr) {
+	Xml xml;
+	ASSERT_TRUE(xml.set(htmlInput, strlen(htmlInput), TITLEREC_CURRENT_VERSION, CT_HTML));
+
+	Url url;
+	url.set(urlStr);
+
+	ASSERT_TRUE(SummaryStore::build(sb, &xml, &url, CT_HTML, false, 80, 180, SummaryStore::s_robotsNoArchive));
+}
+
+static void generateSummary(Summary &summary, char *htmlInput, const char *queryStr, const char *urlStr) {
+	Xml xml;
+	ASSERT_TRUE(xml.set(htmlInput, strlen(htmlInput), TITLEREC_CURRENT_VERSION, CT_HTML));
+
+	TokenizerResult tr;
+	xml_tokenizer_phase_1(&xml, &tr);
+	calculate_tokens_hashes(&tr);
+
+	Bits bits;
+	ASSERT_TRUE(bits.set(&tr));
+
+	Url url;
+	url.set(urlStr);
+
+	Sections sections;
+	ASSERT_TRUE(sections.set(&tr, &bits, &url, CT_HTML));
+
+	Query query;
+	ASSERT_TRUE(query.set(queryStr, langEnglish, 1.0, 1.0, nullptr, false, true, ABS_MAX_QUERY_TERMS));
+
+	LinkInfo linkInfo;
+	memset(&linkInfo, 0, sizeof(LinkInfo));
+	linkInfo.m_lisize = sizeof(LinkInfo);
+
+	Title title;
+	ASSERT_TRUE(title.setTitleFromTags(&xml, 80, CT_HTML, false));
+
+	Pos pos;
+	ASSERT_TRUE(pos.set(&tr));
+
+	Bits bitsForSummary;
+	ASSERT_TRUE(bitsForSummary.setForSummary(&tr));
+
+	Phrases phrases;
+	ASSERT_TRUE(phrases.set(tr, bits));
+
+	Matches matches;
+	matches.setQuery(&query);
+	ASSERT_TRUE(matches.set(&tr, &phrases, &sections, &bitsForSummary, &pos, &xml, &title, &url, &linkInfo));
+
+	ASSERT_TRUE(summary.setSummary(xml.getVersion(), &tr, &sections, &pos, &query, 180, 3, 3, 180, &url, &matches,
+	                               title.getTitle(), title.getTitleLen()));
+}
+
+static void generateSummaryFromStore(Summary &summary, SummaryStore *store, const char *queryStr, const char *urlStr) {
+	ASSERT_TRUE(store->setTokens());
+
+	Url url;
+	url.set(urlStr);
+
+	Query query;
+	ASSERT_TRUE(query.set(queryStr, langEnglish, 1.0, 1.0, nullptr, false, true, ABS_MAX_QUERY_TERMS));
+
+	LinkInfo linkInfo;
+	memset(&linkInfo, 0, sizeof(LinkInfo));
+	linkInfo.m_lisize = sizeof(LinkInfo);
+
+	Title title;
+	title.setTitle(std::string(store->getTitle(), store->getTitleLen()));
+
+	Matches matches;
+	matches.setQuery(&query);
+	ASSERT_TRUE(matches.set(store->getTokenizerResult(), store->getPhrases(), store->getSections(),
+	                        store->getBitsForSummary(), store->getPos(), NULL, &title, &url, &linkInfo, store));
+
+	ASSERT_TRUE(summary.setSummary(TITLEREC_CURRENT_VERSION, store->getTokenizerResult(), store->getSections(),
+	                               store->getPos(), &query, 180, 3, 3, 180, &url, &matches,
+	                               title.getTitle(), title.getTitleLen()));
+}
+
+TEST(SummaryStoreTest, TokensRoundTrip) {
+	char input[MAX_BUF_SIZE];
+	std::sprintf(input, HTML_FORMAT, "<title>All about foxes</title>", s_body);
+
+	SafeBuf sb;
+	buildStore(&sb, input, "http://www.example.com/");
+
+	SummaryStore store;
+	ASSERT_TRUE(store.set(sb.getBufStart(), sb.length()));
+	EXPECT_EQ(80, store.getTitleMaxLen());
+	EXPECT_EQ(180, store.getSummaryMaxLen());
+	EXPECT_EQ(std::string("All about foxes"), std::string(store.getTitle(), store.getTitleLen()));
+	EXPECT_EQ(0, store.getTagSummaryLen());
+	EXPECT_EQ(SummaryStore::s_robotsNoArchive, store.getRobotsFlags());
+	ASSERT_TRUE(store.setTokens());
+
+	Xml xml;
+	ASSERT_TRUE(xml.set(input, strlen(input), TITLEREC_CURRENT_VERSION, CT_HTML));
+	TokenizerResult tr;
+	xml_tokenizer_phase_1(&xml, &tr);
+	calculate_tokens_hashes(&tr);
+
+	const TokenizerResult *str = store.getTokenizerResult();
+	ASSERT_EQ(tr.size(), str->size());
+	for (size_t i = 0; i < tr.size(); i++) {
+		EXPECT_EQ(tr[i].start_pos, (*str)[i].start_pos);
+		EXPECT_EQ(tr[i].end_pos, (*str)[i].end_pos);
+		EXPECT_EQ(tr[i].nodeid, (*str)[i].nodeid);
+		EXPECT_EQ(tr[i].is_alfanum, (*str)[i].is_alfanum);
+		EXPECT_EQ(tr[i].token_hash, (*str)[i].token_hash);
+		if (!tr[i].nodeid) {
+			EXPECT_EQ(std::string(tr[i].token_start, tr[i].token_len), std::string((*str)[i].token_start, (*str)[i].token_len));
+		}
+	}
+}
+
+TEST(SummaryStoreTest, SameSummaryAsParsing) {
+	char input[MAX_BUF_SIZE];
+	std::sprintf(input, HTML_FORMAT, "<title>All about foxes</title><meta name=\"keywords\" content=\"fox, den\">", s_body);
+
+	const char *queries[] = { "fox den", "omnivorous mammals", "lazy dog", "summary scripts", "giraffe" };
+	for (const char *q : queries) {
+		Summary parsed;
+		generateSummary(parsed, input, q, "http://www.example.com/");
+
+		SafeBuf sb;
+		buildStore(&sb, input, "http://www.example.com/");
+		SummaryStore store;
+		ASSERT_TRUE(store.set(sb.getBufStart(), sb.length()));
+		EXPECT_EQ(1, store.getNumMetaTags());
+
+		Summary stored;
+		generateSummaryFromStore(stored, &store, q, "http://www.example.com/");
+
+		EXPECT_STREQ(parsed.getSummary(), stored.getSummary()) << "query: " << q;
+		EXPECT_EQ(parsed.getSummaryDisplayLen(), stored.getSummaryDisplayLen()) << "query: " << q;
+	}
+}
+
+TEST(SummaryStoreTest, SummaryFromTags) {
+	char input[MAX_BUF_SIZE];
+	std::sprintf(input, HTML_FORMAT,
+	             "<title>All about foxes</title>"
+	             "<meta name=\"description\" content=\"Everything you ever wanted to know about the red fox and the arctic fox.\">",
+	             s_body);
+
+	SafeBuf sb;
+	buildStore(&sb, input, "http://www.example.com/");
+
+	SummaryStore store;
+	ASSERT_TRUE(store.set(sb.getBufStart(), sb.length()));
+	EXPECT_EQ(std::string("Everything you ever wanted to know about the red fox and the arctic fox."),
+	          std::string(store.getTagSummary(), store.getTagSummaryLen()));
+
+	// no tokens needed
+	ASSERT_TRUE(store.setTokens());
+	EXPECT_EQ(0U, store.getTokenizerResult()->size());
+	EXPECT_EQ(0, store.getNumMetaTags());
+
+	Summary summary;
+	summary.setSummaryFromTags(store.getTagSummary(), store.getTagSummaryLen());
+	EXPECT_TRUE(summary.isSetFromTags());
+	EXPECT_EQ(store.getTagSummaryLen(), summary.getSummaryDisplayLen());
+}
+
+TEST(SummaryStoreTest, NoTitleFromTags) {
+	char input[MAX_BUF_SIZE];
+	std::sprintf(input, HTML_FORMAT, "", s_body);
+
+	SafeBuf sb;
+	buildStore(&sb, input, "http://www.example.com/");
+
+	SummaryStore store;
+	ASSERT_TRUE(store.set(sb.getBufStart(), sb.length()));
+	EXPECT_EQ(0, store.getTitleLen());
+	ASSERT_TRUE(store.setTokens());
+	EXPECT_EQ(0U, store.getTokenizerResult()->size());
+}
+
+TEST(SummaryStoreTest, RejectsBadData) {
+	char input[MAX_BUF_SIZE];
+	std::sprintf(input, HTML_FORMAT, "<title>All about foxes</title>", s_body);
+
+	SafeBuf sb;
+	buildStore(&sb, input, "http://www.example.com/");
+
+	SummaryStore store;
+	EXPECT_FALSE(store.set(sb.getBufStart(), sb.length() - 1));
+	EXPECT_FALSE(store.isSet());
+
+	std::string data(sb.getBufStart(), sb.length());
+	data[0] = SummaryStore::s_version + 1;
+	EXPECT_FALSE(store.set(data.data(), data.size()));
+
+	EXPECT_TRUE(store.set(sb.getBufStart(), sb.length()));
+	EXPECT_TRUE(store.isSet());
+}
+
+TEST(SummaryStoreTest, RejectsBadTokenCount) {
+	char input[MAX_BUF_SIZE];
+	std::sprintf(input, HTML_FORMAT, "<title>All about foxes</title>", s_body);
+
+	SafeBuf sb;
+	buildStore(&sb, input, "http://www.example.com/");
+
+	SummaryStore store;
+	ASSERT_TRUE(store.set(sb.getBufStart(), sb.length()));
+	ASSERT_TRUE(store.setTokens());
+	int32_t numTokens = (int32_t)store.getTokenizerResult()->size();
+
+	// the token count is followed by the tokens and the text, which end
+	// the data
+	std::string data(sb.getBufStart(), sb.length());
+	size_t off = 0;
+	for (size_t i = 0; i + 12 <= data.size(); i++) {
+		int32_t n, tokensSize, textSize;
+		memcpy(&n, &data[i], 4);
+		memcpy(&tokensSize, &data[i + 4], 4);
+		if (n != numTokens || tokensSize < 0 || i + 12 + tokensSize > data.size())
+			continue;
+		memcpy(&textSize, &data[i + 8 + tokensSize], 4);
+		if (textSize >= 0 && i + 12 + tokensSize + textSize == data.size()) {
+			off = i;
+			break;
+		}
+	}
+	ASSERT_NE(0U, off);
+
+	int32_t huge = 0x7fffffff;
+	memcpy(&data[off], &huge, 4);
+	EXPECT_FALSE(store.set(data.data(), data.size()));
+	EXPECT_FALSE(store.isSet());
+}
@@ -58,7 +58,7 @@ static void generateSummary( Summary &summary, char *htmlInput, const char *quer
 	matches.setQuery(&query);
 	ASSERT_TRUE(matches.set(&tr, &phrases, &sections, &bitsForSummary, &pos, &xml, &title, &url, &linkInfo));
 
-	summary.setSummary(&xml, &tr, &sections, &pos, &query, 180, 3, 3, 180, &url, &matches, title.getTitle(), title.getTitleLen());
+	summary.setSummary(xml.getVersion(), &tr, &sections, &pos, &query, 180, 3, 3, 180, &url, &matches, title.getTitle(), title.getTitleLen());
 }
 
 TEST( SummaryTest, StripSamePunct ) {
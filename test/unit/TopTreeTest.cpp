@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "TopTree.h"
+#include <map>
+
+static void addDocId(TopTree *tt, int64_t docId, float score, uint32_t siteHash32) {
+	int32_t tn = tt->getEmptyNode();
+	ASSERT_GE(tn, 0);
+	TopNode *t = tt->getNode(tn);
+	t->m_score = score;
+	t->m_docId = docId;
+	t->m_flags = 0;
+	t->m_siteHash32 = siteHash32;
+	tt->addNode(t, tn);
+}
+
+TEST(TopTreeTest, MaxDocIdsPerSite) {
+	TopTree tt;
+	ASSERT_TRUE(tt.setNumNodes(10, true, 2));
+
+	// one site dominating, in increasing score order so it has to replace its nodes
+	for (int32_t i = 0; i < 20; i++) {
+		addDocId(&tt, 1000 + i, 100 + i, 1);
+	}
+	for (int32_t i = 0; i < 5; i++) {
+		addDocId(&tt, 2000 + i, 50 + i, 2);
+	}
+	// unknown site is not limited
+	addDocId(&tt, 3000, 10, 0);
+	addDocId(&tt, 3001, 11, 0);
+	addDocId(&tt, 3002, 12, 0);
+
+	std::map<uint32_t, int32_t> siteCounts;
+	std::vector<int64_t> docIds;
+	for (int32_t ti = tt.getHighNode(); ti >= 0; ti = tt.getPrev(ti)) {
+		const TopNode *t = tt.getNode(ti);
+		siteCounts[t->m_siteHash32]++;
+		docIds.push_back(t->m_docId);
+	}
+
+	EXPECT_EQ(2, siteCounts[1]);
+	EXPECT_EQ(2, siteCounts[2]);
+	EXPECT_EQ(3, siteCounts[0]);
+
+	std::vector<int64_t> expected = { 1019, 1018, 2004, 2003, 3002, 3001, 3000 };
+	EXPECT_EQ(expected, docIds);
+}
+
+TEST(TopTreeTest, NoSiteLimitWithoutClustering) {
+	TopTree tt;
+	ASSERT_TRUE(tt.setNumNodes(10, false, 2));
+	EXPECT_EQ(0, tt.getMaxDocIdsPerSite());
+
+	for (int32_t i = 0; i < 5; i++) {
+		addDocId(&tt, 1000 + i, 100 + i, 1);
+	}
+
+	EXPECT_EQ(5, tt.getNumUsedNodes());
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include "TruncatedTermlists.h"
+#include "RdbList.h"
+#include "Posdb.h"
+#include "GigablastTestUtils.h"
+
+static const int64_t s_termId = 0x1234;
+
+TEST(TruncatedTermlistsTest, KeepsBestDocIds) {
+	RdbList src;
+	GbTest::makePosdbList(&src, s_termId, 10);
+
+	RdbList dst;
+	int32_t maxDroppedSiteRank;
+	PostingsSummary droppedPostings;
+	ASSERT_TRUE(TruncatedTermlists::make_truncated_list(&src, 3, &dst, &maxDroppedSiteRank, &droppedPostings));
+	EXPECT_EQ(7, maxDroppedSiteRank);
+	EXPECT_EQ(1U << HASHGROUP_BODY, droppedPostings.hash_groups);
+	EXPECT_EQ(1U, droppedPostings.density_ranks);
+	EXPECT_EQ(1U, droppedPostings.word_spam_ranks);
+	EXPECT_EQ(0U, droppedPostings.linker_site_ranks);
+
+	// highest siterank docids, still in key order and with all positions
+	const uint64_t expected[] = { 8, 8, 9, 9, 10, 10 };
+	size_t i = 0;
+	for (dst.resetListPtr(); !dst.isExhausted(); dst.skipCurrentRecord(), ++i) {
+		char key[18];
+		dst.getCurrentKey(key);
+		ASSERT_LT(i, sizeof(expected) / sizeof(expected[0]));
+		EXPECT_EQ(expected[i], Posdb::getDocId(key));
+		EXPECT_EQ(s_termId, Posdb::getTermId(key));
+		EXPECT_EQ((i % 2) * 10, (size_t)Posdb::getWordPos(key));
+	}
+	EXPECT_EQ(sizeof(expected) / sizeof(expected[0]), i);
+
+	// one full key, the rest compressed like in the source list
+	EXPECT_EQ(18 + 6 + 12 + 6 + 12 + 6, dst.getListSize());
+}
+
+TEST(TruncatedTermlistsTest, ShortList) {
+	RdbList src;
+	GbTest::makePosdbList(&src, s_termId, 2);
+
+	RdbList dst;
+	int32_t maxDroppedSiteRank;
+	PostingsSummary droppedPostings;
+	ASSERT_TRUE(TruncatedTermlists::make_truncated_list(&src, 10, &dst, &maxDroppedSiteRank, &droppedPostings));
+	EXPECT_EQ(-1, maxDroppedSiteRank);
+	EXPECT_TRUE(droppedPostings.empty());
+	EXPECT_EQ(src.getListSize(), dst.getListSize());
+	EXPECT_EQ(0, memcmp(src.getList(), dst.getList(), src.getListSize()));
+}
+
+TEST(TruncatedTermlistsTest, InsertLookupClear) {
+	TruncatedTermlists tl;
+
+	RdbList src;
+	GbTest::makePosdbList(&src, s_termId, 10);
+
+	// disabled by default
+	tl.insert(0, 1, s_termId, &src, 3);
+	EXPECT_EQ(0U, tl.size());
+
+	tl.configure(1000000);
+	tl.insert(0, 1, s_termId, &src, 3);
+	tl.insert(1, 1, s_termId, &src, 3);
+	EXPECT_EQ(2U, tl.size());
+	EXPECT_TRUE(tl.is_registered(0, 1, s_termId));
+	EXPECT_FALSE(tl.is_registered(0, 3, s_termId));
+
+	RdbList list;
+	int32_t maxDroppedSiteRank;
+	PostingsSummary droppedPostings;
+	EXPECT_FALSE(tl.lookup(0, 3, s_termId, &list, &maxDroppedSiteRank, &droppedPostings));
+	ASSERT_TRUE(tl.lookup(0, 1, s_termId, &list, &maxDroppedSiteRank, &droppedPostings));
+	EXPECT_EQ(18 + 6 + 12 + 6 + 12 + 6, list.getListSize());
+	EXPECT_EQ(7, maxDroppedSiteRank);
+	EXPECT_EQ(1U << HASHGROUP_BODY, droppedPostings.hash_groups);
+
+	tl.clear(0);
+	EXPECT_FALSE(tl.is_registered(0, 1, s_termId));
+	EXPECT_TRUE(tl.is_registered(1, 1, s_termId));
+}
@@ -6,6 +6,8 @@
 #include "ip.h"
 #include "Mem.h"
 #include "Docid.h"
+#include "Errno.h"
+#include "Lang.h"
 
 class XmlDocTest : public ::testing::Test {
 protected:
@@ -246,6 +248,83 @@ TEST_F(XmlDocTest, PosdbGetMetaListDeletedDoc) {
 	/// @todo ALC add other terms
 }
 
+static XmlDoc *makeIndexedOldDoc(const char *url, char *content) {
+	XmlDoc *xmlDocOld = new XmlDoc();
+	mnew(xmlDocOld, sizeof(*xmlDocOld), "XmlDoc");
+	initializeDocForPosdb(xmlDocOld, url, content);
+
+	xmlDocOld->m_indexCode = 0;
+	xmlDocOld->m_httpStatus = 200;
+	xmlDocOld->m_langId = langEnglish;
+	xmlDocOld->m_spideredTimeValid = true;
+	xmlDocOld->m_spideredTime = 1480086000;
+
+	return xmlDocOld;
+}
+
+TEST_F(XmlDocTest, CanShortCircuitUnchanged) {
+	const char *url = "http://www.example.test/index.html";
+	char contentOld[] = "<html><head><title>my title</title></head><body>old document</body></html>";
+	char contentNew[] = "";
+
+	XmlDoc *xmlDocOld = makeIndexedOldDoc(url, contentOld);
+
+	XmlDoc xmlDocNew;
+	initializeDocForPosdb(&xmlDocNew, url, contentNew);
+	xmlDocNew.m_oldDocValid = true;
+	xmlDocNew.m_oldDoc = xmlDocOld;
+
+	EXPECT_FALSE(xmlDocNew.canShortCircuitUnchanged(NULL));
+	EXPECT_TRUE(xmlDocNew.canShortCircuitUnchanged(xmlDocOld));
+
+	// the old doc must have been indexed fine with the current version
+	xmlDocOld->m_indexCode = EDOCBADHTTPSTATUS;
+	EXPECT_FALSE(xmlDocNew.canShortCircuitUnchanged(xmlDocOld));
+	xmlDocOld->m_indexCode = 0;
+
+	xmlDocOld->m_version = TITLEREC_CURRENT_VERSION - 1;
+	EXPECT_FALSE(xmlDocNew.canShortCircuitUnchanged(xmlDocOld));
+	xmlDocOld->m_version = TITLEREC_CURRENT_VERSION;
+
+	// a page reindex wants the document parsed again
+	xmlDocNew.m_sreq.m_isPageReindex = 1;
+	EXPECT_FALSE(xmlDocNew.canShortCircuitUnchanged(xmlDocOld));
+	xmlDocNew.m_sreq.m_isPageReindex = 0;
+
+	xmlDocNew.m_sreqValid = false;
+	EXPECT_FALSE(xmlDocNew.canShortCircuitUnchanged(xmlDocOld));
+}
+
+TEST_F(XmlDocTest, IndexCodeNotModified) {
+	const char *url = "http://www.example.test/index.html";
+	char contentOld[] = "<html><head><title>my title</title></head><body>old document</body></html>";
+	char replyNew[] = "HTTP/1.1 304 Not Modified\r\nDate: Fri, 25 Nov 2016 15:00:00 GMT\r\n\r\n";
+
+	XmlDoc *xmlDocOld = makeIndexedOldDoc(url, contentOld);
+
+	XmlDoc xmlDocNew;
+	initializeDocForPosdb(&xmlDocNew, url, replyNew);
+	xmlDocNew.m_useFakeMime = false;
+	xmlDocNew.m_redirUrlValid = true;
+	xmlDocNew.m_redirUrlPtr = NULL;
+	xmlDocNew.m_redirErrorValid = true;
+	xmlDocNew.m_redirError = 0;
+
+	xmlDocNew.m_oldDocValid = true;
+	xmlDocNew.m_oldDoc = xmlDocOld;
+
+	// the 304 ends the recrawl without parsing the (empty) content
+	int32_t *indexCode = xmlDocNew.getIndexCode();
+	ASSERT_TRUE(indexCode != NULL && indexCode != (int32_t *)-1);
+	EXPECT_EQ(EDOCUNCHANGED, *indexCode);
+	EXPECT_EQ(304, xmlDocNew.getMime()->getHttpStatus());
+
+	// the url filters were matched with the language of the old doc
+	EXPECT_TRUE(xmlDocNew.m_priorityValid);
+	EXPECT_EQ(langEnglish, xmlDocNew.m_langId);
+	EXPECT_FALSE(xmlDocNew.m_tokenizerResultValid);
+}
+
 TEST_F(XmlDocTest, FirstUrlRobotsTxt) {
 	std::vector<std::tuple<const char *, bool>> test_cases = {
 		std::make_tuple("http://example.com/robots.txt", true),
@@ -2,6 +2,9 @@
 
 #include "Xml.h"
 #include "HttpMime.h" // CT_HTML
+#include "Titledb.h" // TITLEREC_CURRENT_VERSION
+#include "hash.h"
+#include <algorithm>
 
 #define MAX_BUF_SIZE 1024
 
@@ -155,4 +158,71 @@ TEST(XmlTest, GetRobotsTag) {
 		EXPECT_EQ(strlen(output), valueLen);
 		EXPECT_STREQ(output, valueStr.c_str());
 	}
-}
\ No newline at end of file
+}
+
+TEST(XmlTest, NodeIndexes) {
+	char input[] = "<html><head><title>t</title><meta name=\"description\" content=\"d\">"
+	               "<link rel=\"canonical\" href=\"http://www.example.com/\"><meta name=\"robots\" content=\"noindex\"></head>"
+	               "<body>a &lt; b < c <p><a href=\"/1\">one</a><a href=\"/2\">two</a>"
+	               "<script>if(a<b) document.write('<a href=\"/3\">');</script>"
+	               "<map><area href=\"/4\"></map></body></html>";
+
+	Xml xml;
+	ASSERT_TRUE(xml.set(input, strlen(input), TITLEREC_CURRENT_VERSION, CT_HTML));
+
+	// same as looking at every node
+	std::vector<int32_t> linkNodes;
+	std::vector<int32_t> metaNodes;
+	std::vector<uint32_t> tagPairHashes;
+	uint32_t lastHash = 0;
+	for (int32_t i = 0; i < xml.getNumNodes(); i++) {
+		nodeid_t id = xml.getNodeId(i);
+		if (id == TAG_META) {
+			metaNodes.push_back(i);
+		}
+		if (id == TAG_A || id == TAG_LINK || id == TAG_AREA) {
+			linkNodes.push_back(i);
+		}
+		if (id <= 0) {
+			continue;
+		}
+		uint32_t h = hash32h(id, 0);
+		if (h == 0) h = 1;
+		if (lastHash) {
+			tagPairHashes.push_back(h == lastHash ? h : h ^ lastHash);
+		}
+		lastHash = h;
+	}
+
+	ASSERT_EQ(6, linkNodes.size());
+	ASSERT_EQ(linkNodes.size(), xml.getNumLinkNodes());
+	EXPECT_TRUE(std::equal(linkNodes.begin(), linkNodes.end(), xml.getLinkNodes()));
+
+	ASSERT_EQ(2, metaNodes.size());
+	ASSERT_EQ(metaNodes.size(), xml.getNumMetaNodes());
+	EXPECT_TRUE(std::equal(metaNodes.begin(), metaNodes.end(), xml.getMetaNodes()));
+
+	ASSERT_EQ(tagPairHashes.size(), xml.getNumTagPairHashes());
+	EXPECT_TRUE(std::equal(tagPairHashes.begin(), tagPairHashes.end(), xml.getTagPairHashes()));
+
+	char buf[MAX_BUF_SIZE];
+	EXPECT_EQ(7, xml.getMetaContent(buf, sizeof(buf), "robots", 6));
+	EXPECT_STREQ("noindex", buf);
+	EXPECT_EQ(0, xml.getMetaContent(buf, sizeof(buf), "robots", 6, "name", metaNodes[1] + 1));
+}
+
+TEST(XmlTest, NullBytes) {
+	char input[] = "<html><body>a\0b<p>c\0\0d</p></body></html>";
+	int32_t inputLen = sizeof(input) - 1;
+
+	Xml xml;
+	ASSERT_TRUE(xml.set(input, inputLen, TITLEREC_CURRENT_VERSION, CT_HTML));
+	EXPECT_EQ(inputLen, (int32_t)strlen(input));
+	EXPECT_STREQ("<html><body>a b<p>c  d</p></body></html>", input);
+
+	// a single tag makes a single hash
+	char input2[] = "text <br> text";
+	Xml xml2;
+	ASSERT_TRUE(xml2.set(input2, strlen(input2), TITLEREC_CURRENT_VERSION, CT_HTML));
+	EXPECT_EQ(1, xml2.getNumTagPairHashes());
+}
@@ -2,9 +2,14 @@
 #include <string.h>
 #include "UCMaps.h"
 #include "utf8_fast.h"
+#include "hash.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 static bool is_word_script(Unicode::script_t s);
+static size_t scan_ascii_token(const char *str, size_t i, size_t len, bool in_alnum_token, uint64_t *token_hash);
 
 //How we tokenize:
 //The string is split into <alfanum> and <not-alfanum> substrings
@@ -13,12 +18,30 @@ static bool is_word_script(Unicode::script_t s);
 //in the middle then we split there. It is complicated by the special script values:
 //  common:	used in multiple scripts, eg digits 0-9, but also eg. thai currency symbol
 //  inherit:	has the script of the preceding character. This is normally a decomposed diacritic or combining mark
+//Most text is plain ASCII, where none of that matters: letters are latin, everything else is common and nothing is
+//ignorable. So ASCII tokens are found (and hashed) by scan_ascii_token() and the codepoint-by-codepoint loop is only
+//used for tokens that contain non-ASCII characters.
+//The hashes of the alfanum tokens are calculated here while the text is still in the cache, so
+//calculate_tokens_hashes() only has to do the phase-2 tokens.
 void plain_tokenizer_phase_1(const char *str, size_t len, TokenizerResult *tr) {
 	plain_tokenizer_phase_1_downcall(str,len,0,tr);
 }
 
 void plain_tokenizer_phase_1_downcall(const char *str, size_t len, size_t pos_base, TokenizerResult *tr) {
 	for(size_t i = 0; i<len; ) {
+		if(is_ascii3(str[i])) {
+			bool in_alnum_token = is_alnum_a(str[i]);
+			uint64_t token_hash = 0;
+			size_t j = scan_ascii_token(str,i,len,in_alnum_token,&token_hash);
+			if(j!=0) {
+				tr->tokens.emplace_back(pos_base+i,pos_base+j, str+i,j-i, true, in_alnum_token);
+				tr->tokens.back().token_hash = token_hash;
+				i = j;
+				continue;
+			}
+			//token continues into non-ASCII text
+		}
+		
 		UChar32 c = utf8Decode(str+i);
 		bool in_alnum_token = ucIsWordChar_fast(c);
 		Unicode::script_t current_token_script = UnicodeMaps::query_script(c);
@@ -50,11 +73,65 @@ void plain_tokenizer_phase_1_downcall(const char *str, size_t len, size_t pos_ba
 		}
 		//found token [i..j)
 		tr->tokens.emplace_back(pos_base+i,pos_base+j, str+i,j-i, true, in_alnum_token);
+		if(in_alnum_token)
+			tr->tokens.back().token_hash = hash64Lower_utf8(str+i,j-i);
 		i = j;
 	}
 }
 
 
+//Find the end of the ASCII token starting at str[i]. Alfanum tokens are lowercased and hashed on the way, giving the
+//same hash as hash64Lower_utf8(). Returns 0 if the token continues into non-ASCII text, in which case the caller
+//must use the generic code.
+static size_t scan_ascii_token(const char *str, size_t i, size_t len, bool in_alnum_token, uint64_t *token_hash) {
+	uint64_t h = 0;
+	size_t j = i;
+#ifdef __SSE2__
+	//16 bytes at a time. Bytes >=0x80 are negative as signed chars so they fall outside all the ranges below
+	const __m128i digit_lo = _mm_set1_epi8('0'-1);
+	const __m128i digit_hi = _mm_set1_epi8('9'+1);
+	const __m128i upper_lo = _mm_set1_epi8('A'-1);
+	const __m128i upper_hi = _mm_set1_epi8('Z'+1);
+	const __m128i lower_lo = _mm_set1_epi8('a'-1);
+	const __m128i lower_hi = _mm_set1_epi8('z'+1);
+	const __m128i case_bit = _mm_set1_epi8(0x20);
+	while(j+16<=len) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(str+j));
+		__m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(v,digit_lo), _mm_cmplt_epi8(v,digit_hi));
+		__m128i is_upper = _mm_and_si128(_mm_cmpgt_epi8(v,upper_lo), _mm_cmplt_epi8(v,upper_hi));
+		__m128i is_lower = _mm_and_si128(_mm_cmpgt_epi8(v,lower_lo), _mm_cmplt_epi8(v,lower_hi));
+		unsigned alnum_mask = _mm_movemask_epi8(_mm_or_si128(is_digit,_mm_or_si128(is_upper,is_lower)));
+		unsigned non_ascii_mask = _mm_movemask_epi8(v);
+		unsigned same_mask = in_alnum_token ? alnum_mask : (~(alnum_mask|non_ascii_mask) & 0xffff);
+		unsigned stop_mask = ~same_mask & 0xffff;
+		unsigned n = stop_mask ? __builtin_ctz(stop_mask) : 16;
+		if(in_alnum_token) {
+			alignas(16) unsigned char lowered[16];
+			_mm_store_si128((__m128i*)lowered, _mm_add_epi8(v,_mm_and_si128(is_upper,case_bit)));
+			for(unsigned k=0; k<n; k++)
+				h ^= g_hashtab[(uint8_t)(j+k-i)][lowered[k]];
+		}
+		j += n;
+		if(stop_mask)
+			break;
+	}
+#endif
+	//the remaining bytes (or all of them without SSE2)
+	for( ; j<len; j++) {
+		char c = str[j];
+		if(!is_ascii3(c) || is_alnum_a(c)!=in_alnum_token)
+			break;
+		if(in_alnum_token)
+			h ^= g_hashtab[(uint8_t)(j-i)][(uint8_t)to_lower_a(c)];
+	}
+	
+	if(j<len && !is_ascii3(str[j]))
+		return 0;
+	*token_hash = h;
+	return j;
+}
+
+
 //Is the script a script where words are separated?
 //Eg. Latin/Coptic/Arabic/Hebrew normally are, while Hiragana/Korean/Thai normally aren't
 //Then there are oddballs where spaces are optional, or ancient forms where spaces weren't
@@ -2,7 +2,8 @@
 #include "hash.h"
 
 void calculate_tokens_hashes(TokenizerResult *tr) {
+	//phase 1 has already hashed the tokens it made
 	for(auto &token : tr->tokens)
-		if(token.is_alfanum)
+		if(token.is_alfanum && token.token_hash==0)
 			token.token_hash = hash64Lower_utf8(token.token_start,token.token_len);
 }
@@ -2,6 +2,7 @@
 #include "UCMaps.h"
 #include <string.h>
 #include "utf8_fast.h"
+#include "hash.h"
 #include <assert.h>
 
 
@@ -433,6 +434,83 @@ int main(void) {
 	}
 //	øhm. skal zerowidth space virkelige være del af et ord?
 	
+	//ASCII fast path vs. generic path
+	//The tokens and hashes must be the same as if every codepoint went through the generic code.
+	printf("Test line %d\n",__LINE__);
+	{
+		//words and separators of all lengths so the boundaries fall everywhere in the 16-byte blocks
+		std::string s;
+		for(int i=1; i<40; i++) {
+			for(int j=0; j<i; j++)
+				s += (char)((j%3==0) ? 'A'+(i+j)%26 : (j%3==1) ? 'a'+(i*j)%26 : '0'+j%10);
+			for(int j=0; j<i%5+1; j++)
+				s += " ,.-/:"[(i+j)%6];
+		}
+		T1 t(s.c_str());
+		size_t pos = 0;
+		for(unsigned i=0; i<t.token_count(); i++) {
+			const TokenRange &token = t.token(i);
+			assert(token.start_pos==pos);
+			assert(token.is_alfanum == is_alnum_a(s[pos]));
+			for(size_t j=token.start_pos; j<token.end_pos; j++)
+				assert(is_alnum_a(s[j])==token.is_alfanum);
+			assert(token.end_pos==s.size() || is_alnum_a(s[token.end_pos])!=token.is_alfanum);
+			if(token.is_alfanum)
+				assert(token.token_hash==(int64_t)hash64Lower_utf8(token.token_start,token.token_len));
+			else
+				assert(token.token_hash==0);
+			pos = token.end_pos;
+		}
+		assert(pos==s.size());
+	}
+	printf("Test line %d\n",__LINE__);
+	{
+		T1 t("ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 abcdefghijklmnopqrstuvwxyz0123456789");
+		assert(t.token_count()==3);
+		assert(t.token(0).token_hash==t.token(2).token_hash);
+		assert(t.token(0).token_hash==(int64_t)hash64Lower_utf8("abcdefghijklmnopqrstuvwxyz0123456789",36));
+	}
+	printf("Test line %d\n",__LINE__);
+	{
+		//a word longer than 256 bytes wraps the hash position like hash64Lower_utf8() does
+		std::string s(300,'x');
+		s += "Y ";
+		T1 t(s.c_str());
+		assert(t.token_count()==2);
+		assert(t.token(0).token_len==301);
+		assert(t.token(0).token_hash==(int64_t)hash64Lower_utf8(s.data(),301));
+	}
+	printf("Test line %d\n",__LINE__);
+	{
+		//ASCII words continuing into non-ASCII text, before and after a 16-byte boundary
+		T1 t("abcdefghijklmnopqrstuvwxyzæøå abcæøå 0123456789abcdeÆØÅ abcdefghijklmnopQ€ x");
+		assert(t.token_count()==9);
+		assert(t.str(0)=="abcdefghijklmnopqrstuvwxyzæøå");
+		assert(t.str(2)=="abcæøå");
+		assert(t.str(4)=="0123456789abcdeÆØÅ");
+		assert(t.str(6)=="abcdefghijklmnopQ");
+		assert(t.str(7)=="€ ");
+		assert(t.str(8)=="x");
+		for(unsigned i=0; i<t.token_count(); i++)
+			if(t.token(i).is_alfanum)
+				assert(t.token(i).token_hash==(int64_t)hash64Lower_utf8(t.token(i).token_start,t.token(i).token_len));
+		assert(t.token(4).token_hash==(int64_t)hash64Lower_utf8("0123456789abcdeæøå",strlen("0123456789abcdeæøå")));
+	}
+	printf("Test line %d\n",__LINE__);
+	{
+		//separators continuing into non-ASCII text
+		T1 t("abc                 « def");
+		assert(t.token_count()==3);
+		assert(t.str(1)=="                 « ");
+	}
+	printf("Test line %d\n",__LINE__);
+	{
+		//soft hyphen in an otherwise ASCII word
+		T1 t("abcdefghijklmnopqrstu\u00ADvwxyz abc");
+		assert(t.token_count()==3);
+		assert(t.str(0)=="abcdefghijklmnopqrstu\u00ADvwxyz");
+	}
+	
 	
 	//////////////////////////////////////////////////////////////////////////////
 	// plain-phase2 tests
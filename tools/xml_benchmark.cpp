@@ -0,0 +1,110 @@
+#include "Xml.h"
+#include "Linkdb.h"
+#include "HttpMime.h"
+#include "Titledb.h"
+#include "Url.h"
+#include "Log.h"
+#include "Mem.h"
+#include "hash.h"
+#include "Version.h"
+#include <libgen.h>
+#include <time.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+
+static void print_usage(const char *argv0) {
+	fprintf(stdout, "Usage: %s [-h] [-n ITERATIONS] FILE...\n", argv0);
+	fprintf(stdout, "Time Xml::set() and Links::set() on html files\n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "  -n ITERATIONS  parse each file this many times (default 100)\n");
+	fprintf(stdout, "  -h, --help     display this help and exit\n");
+}
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0 ) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (strcmp(argv[1], "-v") == 0 || strcmp(argv[1], "--version") == 0 ) {
+		printVersion(basename(argv[0]));
+		return 1;
+	}
+
+	int iterations = 100;
+	int argi = 1;
+	if (strcmp(argv[argi], "-n") == 0 && argi + 1 < argc) {
+		iterations = atoi(argv[argi + 1]);
+		argi += 2;
+	}
+
+	g_log.m_disabled = true;
+
+	// initialize library
+	g_mem.init();
+	hashinit();
+
+	std::vector<std::string> docs;
+	size_t totalBytes = 0;
+	for (; argi < argc; argi++) {
+		std::ifstream file(argv[argi], std::ios::binary);
+		if (!file) {
+			fprintf(stderr, "Unable to open %s\n", argv[argi]);
+			return 1;
+		}
+		std::stringstream ss;
+		ss << file.rdbuf();
+		docs.push_back(ss.str());
+		totalBytes += docs.back().size();
+	}
+
+	if (docs.empty() || totalBytes == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	Url url;
+	url.set("http://www.example.com/");
+
+	double xmlTime = 0;
+	double linksTime = 0;
+	int64_t numNodes = 0;
+	int64_t numLinks = 0;
+	for (int i = 0; i < iterations; i++) {
+		for (auto &doc : docs) {
+			Xml xml;
+			double start = now();
+			xml.set(&doc[0], doc.size(), TITLEREC_CURRENT_VERSION, CT_HTML);
+			double parsed = now();
+
+			Links links;
+			links.set(true, &xml, &url, NULL, TITLEREC_CURRENT_VERSION, false, NULL);
+			double linked = now();
+
+			xmlTime += parsed - start;
+			linksTime += linked - parsed;
+			numNodes += xml.getNumNodes();
+			numLinks += links.getNumLinks();
+		}
+	}
+
+	double mb = (double)totalBytes * iterations / (1024 * 1024);
+	fprintf(stdout, "%zu files, %zu bytes, %d iterations\n", docs.size(), totalBytes, iterations);
+	fprintf(stdout, "Xml::set()   %8.3f s %8.1f MB/s %" PRId64 " nodes\n", xmlTime, mb / xmlTime, numNodes / iterations);
+	fprintf(stdout, "Links::set() %8.3f s %8.1f MB/s %" PRId64 " links\n", linksTime, mb / linksTime, numLinks / iterations);
+
+	return 0;
+}